@@ -19,11 +19,20 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include "circ_buf.h"
 
 #include "cortex_m.h"
 #include "util.h"
 
+// Bytes copied by circ_buf_read and circ_buf_write with interrupts disabled
+#define CIRC_BUF_COPY_CHUNK     16
+
+// Orders the buffer contents against the index that hands them to the other
+// side. It also stops the compiler from moving memory accesses across it.
+#define CIRC_BUF_SPSC_BARRIER() __DMB()
+
 void circ_buf_init(circ_buf_t *circ_buf, uint8_t *buffer, uint32_t size)
 {
     cortex_int_state_t state;
@@ -110,27 +119,256 @@ uint32_t circ_buf_count_free(circ_buf_t *circ_buf)
 uint32_t circ_buf_read(circ_buf_t *circ_buf, uint8_t *data, uint32_t size)
 {
     uint32_t cnt;
-    uint32_t i;
+    uint32_t total = 0;
+    uint8_t *segment;
+    cortex_int_state_t state;
 
-    cnt = circ_buf_count_used(circ_buf);
-    cnt = MIN(size, cnt);
-    for (i = 0; i < cnt; i++) {
-        data[i] = circ_buf_pop(circ_buf);
+    // Copy a few bytes at a time so interrupts are not held off for long
+    while (total < size) {
+        state = cortex_int_get_and_disable();
+        cnt = circ_buf_peek_read(circ_buf, &segment);
+        cnt = MIN(MIN(size - total, cnt), CIRC_BUF_COPY_CHUNK);
+        memcpy(data + total, segment, cnt);
+        circ_buf_commit_read(circ_buf, cnt);
+        cortex_int_restore(state);
+        if (0 == cnt) {
+            break;
+        }
+        total += cnt;
     }
 
-    return cnt;
+    return total;
 }
 
 uint32_t circ_buf_write(circ_buf_t *circ_buf, const uint8_t *data, uint32_t size)
 {
     uint32_t cnt;
-    uint32_t i;
+    uint32_t total = 0;
+    uint8_t *segment;
+    cortex_int_state_t state;
+
+    while (total < size) {
+        state = cortex_int_get_and_disable();
+        cnt = circ_buf_peek_write(circ_buf, &segment);
+        cnt = MIN(MIN(size - total, cnt), CIRC_BUF_COPY_CHUNK);
+        memcpy(segment, data + total, cnt);
+        circ_buf_commit_write(circ_buf, cnt);
+        cortex_int_restore(state);
+        if (0 == cnt) {
+            break;
+        }
+        total += cnt;
+    }
+
+    return total;
+}
+
+uint32_t circ_buf_peek_read(circ_buf_t *circ_buf, uint8_t **data)
+{
+    uint32_t cnt;
+    cortex_int_state_t state;
+
+    state = cortex_int_get_and_disable();
+
+    if (circ_buf->tail >= circ_buf->head) {
+        cnt = circ_buf->tail - circ_buf->head;
+    } else {
+        cnt = circ_buf->size - circ_buf->head;
+    }
+    *data = &circ_buf->buf[circ_buf->head];
+
+    cortex_int_restore(state);
+    return cnt;
+}
+
+void circ_buf_commit_read(circ_buf_t *circ_buf, uint32_t size)
+{
+    cortex_int_state_t state;
+
+    state = cortex_int_get_and_disable();
+
+    // Assert the data was there to read
+    util_assert(size <= circ_buf_count_used(circ_buf));
+
+    circ_buf->head += size;
+    if (circ_buf->head >= circ_buf->size) {
+        circ_buf->head -= circ_buf->size;
+    }
+
+    cortex_int_restore(state);
+}
+
+uint32_t circ_buf_peek_write(circ_buf_t *circ_buf, uint8_t **data)
+{
+    uint32_t cnt;
+    cortex_int_state_t state;
 
-    cnt = circ_buf_count_free(circ_buf);
-    cnt = MIN(size, cnt);
-    for (i = 0; i < cnt; i++) {
-        circ_buf_push(circ_buf, data[i]);
+    state = cortex_int_get_and_disable();
+
+    // One byte always stays free so a full buffer
+    // can be told apart from an empty one
+    if (circ_buf->tail >= circ_buf->head) {
+        cnt = circ_buf->size - circ_buf->tail;
+        if (0 == circ_buf->head) {
+            cnt -= 1;
+        }
+    } else {
+        cnt = circ_buf->head - circ_buf->tail - 1;
     }
+    *data = &circ_buf->buf[circ_buf->tail];
 
+    cortex_int_restore(state);
     return cnt;
 }
+
+void circ_buf_commit_write(circ_buf_t *circ_buf, uint32_t size)
+{
+    cortex_int_state_t state;
+
+    state = cortex_int_get_and_disable();
+
+    // Assert no overflow
+    util_assert(size <= circ_buf_count_free(circ_buf));
+
+    circ_buf->tail += size;
+    if (circ_buf->tail >= circ_buf->size) {
+        circ_buf->tail -= circ_buf->size;
+    }
+
+    cortex_int_restore(state);
+}
+
+void circ_buf_spsc_init(circ_buf_spsc_t *circ_buf, uint8_t *buffer, uint32_t size)
+{
+    // Size must be a power of two
+    util_assert((size != 0) && ((size & (size - 1)) == 0));
+
+    circ_buf->buf = buffer;
+    circ_buf->mask = size - 1;
+    circ_buf->head = 0;
+    circ_buf->tail = 0;
+    CIRC_BUF_SPSC_BARRIER();
+}
+
+uint32_t circ_buf_spsc_count_used(circ_buf_spsc_t *circ_buf)
+{
+    return circ_buf->tail - circ_buf->head;
+}
+
+uint32_t circ_buf_spsc_count_free(circ_buf_spsc_t *circ_buf)
+{
+    return circ_buf->mask + 1 - circ_buf_spsc_count_used(circ_buf);
+}
+
+uint32_t circ_buf_spsc_peek_write(circ_buf_spsc_t *circ_buf, uint8_t **data)
+{
+    uint32_t tail = circ_buf->tail;
+    uint32_t head = circ_buf->head;
+    uint32_t offset = tail & circ_buf->mask;
+    uint32_t cnt;
+
+    // The consumer has finished reading up to head before the space is reused
+    CIRC_BUF_SPSC_BARRIER();
+
+    cnt = circ_buf->mask + 1 - (tail - head);
+    *data = &circ_buf->buf[offset];
+    return MIN(cnt, circ_buf->mask + 1 - offset);
+}
+
+void circ_buf_spsc_commit_write(circ_buf_spsc_t *circ_buf, uint32_t size)
+{
+    // Assert no overflow
+    util_assert(size <= circ_buf_spsc_count_free(circ_buf));
+
+    // The data is in the buffer before the consumer can see it
+    CIRC_BUF_SPSC_BARRIER();
+    circ_buf->tail += size;
+}
+
+uint32_t circ_buf_spsc_peek_read(circ_buf_spsc_t *circ_buf, uint8_t **data)
+{
+    uint32_t head = circ_buf->head;
+    uint32_t tail = circ_buf->tail;
+    uint32_t offset = head & circ_buf->mask;
+
+    // Data up to tail is read after the producer wrote it
+    CIRC_BUF_SPSC_BARRIER();
+
+    *data = &circ_buf->buf[offset];
+    return MIN(tail - head, circ_buf->mask + 1 - offset);
+}
+
+void circ_buf_spsc_commit_read(circ_buf_spsc_t *circ_buf, uint32_t size)
+{
+    // Assert the data was there to read
+    util_assert(size <= circ_buf_spsc_count_used(circ_buf));
+
+    // The data has been read before the producer can reuse the space
+    CIRC_BUF_SPSC_BARRIER();
+    circ_buf->head += size;
+}
+
+void circ_buf_spsc_push(circ_buf_spsc_t *circ_buf, uint8_t data)
+{
+    uint8_t *segment;
+
+    // Assert no overflow
+    util_assert(circ_buf_spsc_peek_write(circ_buf, &segment) > 0);
+
+    *segment = data;
+    circ_buf_spsc_commit_write(circ_buf, 1);
+}
+
+uint8_t circ_buf_spsc_pop(circ_buf_spsc_t *circ_buf)
+{
+    uint8_t *segment;
+    uint8_t data;
+
+    // Assert buffer isn't empty
+    util_assert(circ_buf_spsc_peek_read(circ_buf, &segment) > 0);
+
+    data = *segment;
+    circ_buf_spsc_commit_read(circ_buf, 1);
+    return data;
+}
+
+uint32_t circ_buf_spsc_write(circ_buf_spsc_t *circ_buf, const uint8_t *data, uint32_t size)
+{
+    uint32_t cnt;
+    uint32_t total = 0;
+    uint8_t *segment;
+
+    // At most two segments, up to the end of the buffer and from its start
+    while (total < size) {
+        cnt = circ_buf_spsc_peek_write(circ_buf, &segment);
+        cnt = MIN(size - total, cnt);
+        if (0 == cnt) {
+            break;
+        }
+        memcpy(segment, data + total, cnt);
+        circ_buf_spsc_commit_write(circ_buf, cnt);
+        total += cnt;
+    }
+
+    return total;
+}
+
+uint32_t circ_buf_spsc_read(circ_buf_spsc_t *circ_buf, uint8_t *data, uint32_t size)
+{
+    uint32_t cnt;
+    uint32_t total = 0;
+    uint8_t *segment;
+
+    while (total < size) {
+        cnt = circ_buf_spsc_peek_read(circ_buf, &segment);
+        cnt = MIN(size - total, cnt);
+        if (0 == cnt) {
+            break;
+        }
+        memcpy(data + total, segment, cnt);
+        circ_buf_spsc_commit_read(circ_buf, cnt);
+        total += cnt;
+    }
+
+    return total;
+}
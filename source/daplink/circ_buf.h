@@ -57,6 +57,57 @@ uint32_t circ_buf_read(circ_buf_t *circ_buf, uint8_t *data, uint32_t size);
 // Attempt to write size bytes to the buffer. Return the number of bytes written
 uint32_t circ_buf_write(circ_buf_t *circ_buf, const uint8_t *data, uint32_t size);
 
+// Get the oldest data in the buffer without removing it. Sets data to the start
+// of the data and returns the number of bytes that can be read from there
+// without wrapping, which is less than circ_buf_count_used when the data wraps.
+uint32_t circ_buf_peek_read(circ_buf_t *circ_buf, uint8_t **data);
+
+// Remove size bytes returned by circ_buf_peek_read from the buffer
+void circ_buf_commit_read(circ_buf_t *circ_buf, uint32_t size);
+
+// Get free space in the buffer to write to directly. Sets data to the start
+// of the space and returns the number of bytes that can be written there
+// without wrapping, which is less than circ_buf_count_free when the space wraps.
+uint32_t circ_buf_peek_write(circ_buf_t *circ_buf, uint8_t **data);
+
+// Add size bytes written to the space returned by circ_buf_peek_write to the buffer
+void circ_buf_commit_write(circ_buf_t *circ_buf, uint32_t size);
+
+// Single producer, single consumer circular buffer. One context only adds data
+// and the other only removes it, for example a UART interrupt handler and the
+// main task, so neither side needs to disable interrupts. head and tail count
+// every byte ever read and written and wrap at 2^32, so the whole buffer can be
+// used and the size must be a power of two.
+typedef struct {
+    volatile uint32_t head;     // Only written by the consumer
+    volatile uint32_t tail;     // Only written by the producer
+    uint32_t mask;
+    uint8_t *buf;
+} circ_buf_spsc_t;
+
+// Initialize or reinitialize the buffer while neither side uses it
+void circ_buf_spsc_init(circ_buf_spsc_t *circ_buf, uint8_t *buffer, uint32_t size);
+
+// Get the number of bytes in the buffer. Exact for the consumer, a lower
+// bound for the producer.
+uint32_t circ_buf_spsc_count_used(circ_buf_spsc_t *circ_buf);
+
+// Get the number of free bytes. Exact for the producer, a lower bound for
+// the consumer.
+uint32_t circ_buf_spsc_count_free(circ_buf_spsc_t *circ_buf);
+
+// Producer calls
+void circ_buf_spsc_push(circ_buf_spsc_t *circ_buf, uint8_t data);
+uint32_t circ_buf_spsc_write(circ_buf_spsc_t *circ_buf, const uint8_t *data, uint32_t size);
+uint32_t circ_buf_spsc_peek_write(circ_buf_spsc_t *circ_buf, uint8_t **data);
+void circ_buf_spsc_commit_write(circ_buf_spsc_t *circ_buf, uint32_t size);
+
+// Consumer calls
+uint8_t circ_buf_spsc_pop(circ_buf_spsc_t *circ_buf);
+uint32_t circ_buf_spsc_read(circ_buf_spsc_t *circ_buf, uint8_t *data, uint32_t size);
+uint32_t circ_buf_spsc_peek_read(circ_buf_spsc_t *circ_buf, uint8_t **data);
+void circ_buf_spsc_commit_read(circ_buf_spsc_t *circ_buf, uint32_t size);
+
 #ifdef __cplusplus
 }
 #endif
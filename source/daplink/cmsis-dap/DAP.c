@@ -1744,6 +1744,30 @@ uint32_t DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
 }
 
 
+// Space left in the request and response packets from the command being
+// processed. Less than a packet for the commands within DAP_ExecuteCommands.
+static uint32_t DAP_RequestLeft  = DAP_PACKET_SIZE;
+static uint32_t DAP_ResponseLeft = DAP_PACKET_SIZE;
+
+// Get space left in packet
+//   used:     number of bytes already used in the packet
+//   return:   number of bytes left in the packet
+static uint32_t DAP_PacketLeft(uint32_t used) {
+  return ((used < DAP_PACKET_SIZE) ? (DAP_PACKET_SIZE - used) : 0U);
+}
+
+// Get request space
+//   return:   number of request bytes from the command ID to the end of the packet
+uint32_t DAP_RequestSpace(void) {
+  return (DAP_RequestLeft);
+}
+
+// Get response space
+//   return:   number of response bytes from the command ID to the end of the packet
+uint32_t DAP_ResponseSpace(void) {
+  return (DAP_ResponseLeft);
+}
+
 // Execute DAP command (process request and prepare response)
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -1758,11 +1782,15 @@ uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response) {
     *response++ = (uint8_t)cnt;
     num = (2U << 16) | 2U;
     while (cnt--) {
+      DAP_RequestLeft  = DAP_PacketLeft(num >> 16);
+      DAP_ResponseLeft = DAP_PacketLeft((uint16_t)num);
       n = DAP_ProcessCommand(request, response);
       num += n;
       request  += (uint16_t)(n >> 16);
       response += (uint16_t) n;
     }
+    DAP_RequestLeft  = DAP_PACKET_SIZE;
+    DAP_ResponseLeft = DAP_PACKET_SIZE;
     return (num);
   }
 
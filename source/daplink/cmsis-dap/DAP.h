@@ -286,6 +286,8 @@ extern uint32_t Manchester_SWO_GetCount (void);
 extern uint32_t DAP_ProcessVendorCommand (const uint8_t *request, uint8_t *response);
 extern uint32_t DAP_ProcessCommand       (const uint8_t *request, uint8_t *response);
 extern uint32_t DAP_ExecuteCommand       (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_RequestSpace         (void);
+extern uint32_t DAP_ResponseSpace        (void);
 
 extern void     DAP_Setup (void);
 
@@ -43,6 +43,27 @@
 #include "file_stream.h"
 #endif
 
+// Bytes of the bulk UART commands around the data: the command byte,
+// the count and the buffer level
+#define UART_DAP_READ_REQUEST   3U
+#define UART_DAP_READ_RESPONSE  5U
+#define UART_DAP_WRITE_REQUEST  3U
+#define UART_DAP_WRITE_RESPONSE 5U
+
+// Bytes of the UART statistics command: the command byte and the action,
+// then the command byte and five 32 bit values
+#define UART_DAP_STATS_REQUEST  2U
+#define UART_DAP_STATS_RESPONSE (1U + 5U * 4U)
+
+static uint8_t *put_uint32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value);
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+    return buf + 4;
+}
+
 //**************************************************************************************************
 /**
 \defgroup DAP_Vendor_Adapt_gr Adapt Vendor Commands
@@ -180,9 +201,114 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response) {
         num += (1U << 16) | 1U; // increment request and response count each by 1
         break;
     }
-    case ID_DAP_Vendor14: break;
-    case ID_DAP_Vendor15: break;
-    case ID_DAP_Vendor16: break;
+    case ID_DAP_Vendor14: {
+        // UART buffer statistics
+        //              COMMAND(OUT Packet)
+        //              BYTE 0 1000 1110 0x8E
+        //              BYTE 1 Action:
+        //                                              0x00 - Read
+        //                                              nonzero - Read and clear
+        //              RESPONSE(IN Packet)
+        //              BYTE 0 1000 1110 0x8E
+        //              BYTE 1-4   Read buffer size
+        //              BYTE 5-8   Write buffer size
+        //              BYTE 9-12  Read buffer high water mark
+        //              BYTE 13-16 Write buffer high water mark
+        //              BYTE 17-20 Received bytes dropped
+        //              All values are little endian
+        UART_Statistics statistics;
+        uint8_t *pos = response;
+        if ((DAP_RequestSpace() < UART_DAP_STATS_REQUEST) || (DAP_ResponseSpace() < UART_DAP_STATS_RESPONSE)) {
+            *(response - 1) = ID_DAP_Invalid;
+            break;
+        }
+        uart_get_statistics(&statistics);
+        if (0x00U != *request) {
+            uart_clear_statistics();
+        }
+        pos = put_uint32(pos, statistics.RxBufferSize);
+        pos = put_uint32(pos, statistics.TxBufferSize);
+        pos = put_uint32(pos, statistics.RxHighWater);
+        pos = put_uint32(pos, statistics.TxHighWater);
+        pos = put_uint32(pos, statistics.RxDropped);
+        num += (1U << 16) | (uint32_t)(pos - response);
+        break;
+    }
+    case ID_DAP_Vendor15: {
+        // UART read sized to the DAP packet
+        //              COMMAND(OUT Packet)
+        //              BYTE 0 1000 1111 0x8F
+        //              BYTE 1-2   Most bytes to read, 0x0000 for as many as fit
+        //              RESPONSE(IN Packet)
+        //              BYTE 0 1000 1111 0x8F
+        //              BYTE 1-2   Number of bytes read (N)
+        //              BYTE 3-4   Bytes left in the read buffer, at most 0xFFFF
+        //              BYTE 5-    N bytes of data
+        //              All values are little endian
+        // Within DAP_ExecuteCommands the data is limited to the space
+        // left in the response packet
+        uint32_t read_max = DAP_ResponseSpace();
+        uint32_t read_len;
+        uint32_t used;
+        if ((DAP_RequestSpace() < UART_DAP_READ_REQUEST) || (read_max < UART_DAP_READ_RESPONSE)) {
+            *(response - 1) = ID_DAP_Invalid;
+            break;
+        }
+        read_max -= UART_DAP_READ_RESPONSE;
+        read_len = (uint32_t)request[0] | ((uint32_t)request[1] << 8);
+        if ((0U == read_len) || (read_len > read_max)) {
+            read_len = read_max;
+        }
+        read_len = uart_read_data(response + 4, read_len);
+        used = uart_read_used();
+        if (used > 0xFFFFU) {
+            used = 0xFFFFU;
+        }
+        response[0] = (uint8_t)(read_len);
+        response[1] = (uint8_t)(read_len >> 8);
+        response[2] = (uint8_t)(used);
+        response[3] = (uint8_t)(used >> 8);
+        num += (2U << 16) | (4U + read_len);
+        break;
+    }
+    case ID_DAP_Vendor16: {
+        // UART write sized to the DAP packet
+        //              COMMAND(OUT Packet)
+        //              BYTE 0 1001 0000 0x90
+        //              BYTE 1-2   Number of bytes to write (N)
+        //              BYTE 3-    N bytes of data
+        //              RESPONSE(IN Packet)
+        //              BYTE 0 1001 0000 0x90
+        //              BYTE 1-2   Number of bytes written, less than N when
+        //                         the write buffer is full
+        //              BYTE 3-4   Free space left in the write buffer, at most 0xFFFF
+        //              All values are little endian
+        // Only the data within the request packet is written
+        uint32_t write_max = DAP_RequestSpace();
+        uint32_t write_len;
+        uint32_t written;
+        uint32_t free;
+        if ((write_max < UART_DAP_WRITE_REQUEST) || (DAP_ResponseSpace() < UART_DAP_WRITE_RESPONSE)) {
+            *(response - 1) = ID_DAP_Invalid;
+            break;
+        }
+        write_max -= UART_DAP_WRITE_REQUEST;
+        write_len = (uint32_t)request[0] | ((uint32_t)request[1] << 8);
+        if (write_len > write_max) {
+            write_len = write_max;
+        }
+        written = uart_write_data((uint8_t *)request + 2, write_len);
+        free = uart_write_free();
+        if (free > 0xFFFFU) {
+            free = 0xFFFFU;
+        }
+        response[0] = (uint8_t)(written);
+        response[1] = (uint8_t)(written >> 8);
+        response[2] = (uint8_t)(free);
+        response[3] = (uint8_t)(free >> 8);
+        num += ((2U + write_len) << 16) | 4U;
+        break;
+    }
     case ID_DAP_Vendor17: break;
     case ID_DAP_Vendor18: break;
     case ID_DAP_Vendor19: break;
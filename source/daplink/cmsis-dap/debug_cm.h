@@ -147,6 +147,9 @@
 #define CPUID_REVISION 0x0000000F  // Revision Mask
 #define CPUID_VARIANT  0x00F00000  // Variant Mask
 
+// NVIC: Vector Table Offset Register
+#define NVIC_VTOR      (NVIC_Addr + 0x0D08)
+
 // NVIC: Application Interrupt/Reset Control Register
 #define NVIC_AIRCR     (NVIC_Addr + 0x0D0C)
 #define VECTRESET      0x00000001  // Reset Cortex-M (except Debug)
@@ -0,0 +1,58 @@
+/**
+ * @file    dma_ring.c
+ * @brief   Reader for a circular buffer filled by a DMA channel
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dma_ring.h"
+
+#include "util.h"
+
+void dma_ring_init(dma_ring_t *ring, uint8_t *buffer, uint32_t size)
+{
+    ring->buf = buffer;
+    ring->size = size;
+    ring->tail = 0;
+}
+
+uint32_t dma_ring_peek_read(dma_ring_t *ring, uint32_t remaining, uint8_t **data)
+{
+    uint32_t head;
+
+    util_assert(remaining <= ring->size);
+    // Some channels read back 0 for a moment before reloading the count
+    head = ring->size - remaining;
+    if (head >= ring->size) {
+        head = 0;
+    }
+
+    *data = ring->buf + ring->tail;
+    if (head >= ring->tail) {
+        return head - ring->tail;
+    }
+    return ring->size - ring->tail;
+}
+
+void dma_ring_commit_read(dma_ring_t *ring, uint32_t size)
+{
+    util_assert(size <= ring->size - ring->tail);
+    ring->tail += size;
+    if (ring->tail >= ring->size) {
+        ring->tail = 0;
+    }
+}
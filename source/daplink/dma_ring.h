@@ -0,0 +1,62 @@
+/**
+ * @file    dma_ring.h
+ * @brief   Reader for a circular buffer filled by a DMA channel
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DMA_RING_H
+#define DMA_RING_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A DMA channel in circular mode writes received bytes into buf and
+// restarts at the beginning when it reaches the end. The write position
+// comes from the channel's count of transfers left in the current pass,
+// so only the read position is kept here.
+//
+// A whole pass over the buffer looks the same as no data at all, so the
+// buffer must be read before the channel gets all the way round. Reading
+// it from the half and full transfer interrupts does that.
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t tail;      // Index of the next byte to read
+} dma_ring_t;
+
+// Initialize the ring when the channel is set up to start at the
+// beginning of the buffer with size transfers left
+void dma_ring_init(dma_ring_t *ring, uint8_t *buffer, uint32_t size);
+
+// Get the oldest data the channel wrote. remaining is the channel's
+// transfer count. Sets data to the start of the data and returns the
+// number of bytes that can be read from there without wrapping. Call
+// again after dma_ring_commit_read to get the rest.
+uint32_t dma_ring_peek_read(dma_ring_t *ring, uint32_t remaining, uint8_t **data);
+
+// Remove size bytes returned by dma_ring_peek_read from the ring
+void dma_ring_commit_read(dma_ring_t *ring, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,435 @@
+/**
+ * @file    delta.c
+ * @brief   Implementation of delta.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "delta.h"
+#include "flash_decoder.h"
+#include "flash_manager.h"
+#include "target_board.h"
+#include "crc.h"
+#include "util.h"
+
+// Set to 1 to enable debugging
+#define DEBUG_DELTA     0
+
+#if DEBUG_DELTA
+#include "daplink_debug.h"
+#define delta_printf    debug_msg
+#else
+#define delta_printf(...)
+#endif
+
+// Size of the buffer each target sector is assembled in before it is
+// programmed. Delta updates are disabled when this is 0 and rejected for
+// targets with sectors larger than this.
+#ifndef DELTA_STAGE_SIZE
+#define DELTA_STAGE_SIZE    0
+#endif
+
+bool delta_detect(const uint8_t *data, uint32_t size)
+{
+    if (size < sizeof(delta_header_t)) {
+        return false;
+    }
+
+    return 0 == memcmp(data, DELTA_MAGIC, strlen(DELTA_MAGIC));
+}
+
+#if defined(DAPLINK_IF) && (DELTA_STAGE_SIZE > 0)
+
+typedef enum {
+    DELTA_STATE_CLOSED,
+    DELTA_STATE_HEADER,
+    DELTA_STATE_OP,
+    DELTA_STATE_COPY_SRC,
+    DELTA_STATE_DATA,
+    DELTA_STATE_DONE,
+    DELTA_STATE_ERROR
+} delta_state_t;
+
+static delta_state_t state = DELTA_STATE_CLOSED;
+static delta_header_t header;
+static uint8_t word_buf[4];
+static uint32_t input_pos;
+static const flash_intf_t *intf;
+static bool flash_initialized;
+static uint32_t op_length;          // Bytes left in the current operation
+static uint32_t copy_src;           // Offset from base_addr of the next byte to copy
+static uint32_t out_pos;            // Offset from base_addr of the next byte produced
+static uint32_t new_crc;
+static uint32_t sector_addr;
+static uint32_t sector_size;
+static bool sector_valid;
+static bool sector_modified;
+// Target programming expects buffer
+// passed in to be 4 byte aligned
+__attribute__((aligned(4)))
+static uint8_t stage[DELTA_STAGE_SIZE];
+
+static bool collect(uint8_t *dst, uint32_t dst_size, const uint8_t **data, uint32_t *size);
+static uint32_t word_value(void);
+static bool target_range_valid(uint32_t addr, uint32_t size);
+static error_t start(void);
+static error_t start_op(uint32_t op);
+static error_t output(const uint8_t *data, uint32_t size, uint32_t *used);
+
+error_t delta_open(void)
+{
+    if (state != DELTA_STATE_CLOSED) {
+        util_assert(0);
+        return ERROR_INTERNAL;
+    }
+
+    memset(&header, 0, sizeof(header));
+    input_pos = 0;
+    intf = 0;
+    flash_initialized = false;
+    op_length = 0;
+    copy_src = 0;
+    out_pos = 0;
+    new_crc = 0;
+    sector_valid = false;
+    sector_modified = false;
+    state = DELTA_STATE_HEADER;
+    return ERROR_SUCCESS;
+}
+
+error_t delta_write(const uint8_t *data, uint32_t size)
+{
+    error_t status = ERROR_SUCCESS;
+    uint32_t used;
+
+    if ((DELTA_STATE_CLOSED == state) || (DELTA_STATE_ERROR == state)) {
+        util_assert(0);
+        return ERROR_INTERNAL;
+    }
+
+    while ((size > 0) && (ERROR_SUCCESS == status)) {
+        switch (state) {
+            case DELTA_STATE_HEADER:
+                if (collect((uint8_t *)&header, sizeof(header), &data, &size)) {
+                    status = start();
+                    state = DELTA_STATE_OP;
+                }
+                break;
+
+            case DELTA_STATE_OP:
+                if (collect(word_buf, sizeof(word_buf), &data, &size)) {
+                    status = start_op(word_value());
+                }
+                break;
+
+            case DELTA_STATE_COPY_SRC:
+                if (collect(word_buf, sizeof(word_buf), &data, &size)) {
+                    copy_src = word_value();
+
+                    if ((copy_src > header.base_size) || (op_length > header.base_size - copy_src)) {
+                        status = ERROR_DELTA_PARSER;
+                        break;
+                    }
+
+                    // A copy needs no further input so apply it right away
+                    status = output(0, op_length, &used);
+                    state = DELTA_STATE_OP;
+                }
+                break;
+
+            case DELTA_STATE_DATA:
+                status = output(data, size, &used);
+                data += used;
+                size -= used;
+
+                if (0 == op_length) {
+                    state = DELTA_STATE_OP;
+                }
+                break;
+
+            case DELTA_STATE_DONE:
+                // Ignore any padding after the last operation
+                return ERROR_SUCCESS_DONE;
+
+            default:
+                util_assert(0);
+                status = ERROR_INTERNAL;
+                break;
+        }
+
+        if ((ERROR_SUCCESS == status) && (DELTA_STATE_OP == state) && (out_pos == header.new_size)) {
+            if (new_crc != header.new_crc) {
+                status = ERROR_DELTA_NEW_CRC;
+            } else {
+                state = DELTA_STATE_DONE;
+                delta_printf("delta_write() done, out_pos=0x%x\r\n", out_pos);
+                return ERROR_SUCCESS_DONE;
+            }
+        }
+    }
+
+    if (ERROR_SUCCESS != status) {
+        state = DELTA_STATE_ERROR;
+    }
+
+    return status;
+}
+
+error_t delta_close(void)
+{
+    error_t status = ERROR_SUCCESS;
+
+    if (DELTA_STATE_CLOSED == state) {
+        util_assert(0);
+        return ERROR_INTERNAL;
+    }
+
+    if (flash_initialized) {
+        status = flash_manager_uninit();
+    }
+
+    state = DELTA_STATE_CLOSED;
+    return status;
+}
+
+// Copy input into dst until it holds dst_size bytes. Returns true once it is full.
+static bool collect(uint8_t *dst, uint32_t dst_size, const uint8_t **data, uint32_t *size)
+{
+    uint32_t copy_size = MIN(dst_size - input_pos, *size);
+    memcpy(dst + input_pos, *data, copy_size);
+    input_pos += copy_size;
+    *data += copy_size;
+    *size -= copy_size;
+
+    if (input_pos < dst_size) {
+        return false;
+    }
+
+    input_pos = 0;
+    return true;
+}
+
+static uint32_t word_value(void)
+{
+    return (word_buf[0] << 0) | (word_buf[1] << 8) | (word_buf[2] << 16) | ((uint32_t)word_buf[3] << 24);
+}
+
+// Check that addr to addr + size lies in one of the target's flash regions.
+// Unlike other files, a delta is not passed through the flash decoder, which
+// would otherwise check its addresses.
+static bool target_range_valid(uint32_t addr, uint32_t size)
+{
+    const region_info_t *region;
+
+    if (0 == g_board_info.target_cfg) {
+        return false;
+    }
+
+    for (region = g_board_info.target_cfg->flash_regions; (region->start != 0) || (region->end != 0); ++region) {
+        if ((addr >= region->start) && (addr < region->end) && (size <= region->end - addr)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Validate the header, open the target and check the delta applies to its contents
+static error_t start(void)
+{
+    uint32_t start_addr;
+    uint32_t offset;
+    uint32_t read_size;
+    uint32_t crc = 0;
+    error_t status;
+
+    if ((0 != memcmp(header.magic, DELTA_MAGIC, sizeof(header.magic))) ||
+            (DELTA_VERSION != header.version) || (0 == header.new_size)) {
+        return ERROR_DELTA_PARSER;
+    }
+
+    // Both images are read from and written to the target flash
+    if (!target_range_valid(header.base_addr, MAX(header.base_size, header.new_size))) {
+        return ERROR_DELTA_ADDRESS;
+    }
+
+    status = flash_decoder_get_flash(FLASH_DECODER_TYPE_TARGET, header.base_addr, true, &start_addr, &intf);
+
+    if (ERROR_SUCCESS != status) {
+        return status;
+    }
+
+    if (0 == intf->read) {
+        return ERROR_DELTA_UNSUPPORTED;
+    }
+
+    // Only sectors that change are erased so the rest of the image is kept
+    status = flash_manager_init_sector_erase(intf);
+    delta_printf("delta start(base_addr=0x%x) flash_manager_init ret=%i\r\n", header.base_addr, status);
+
+    if (ERROR_SUCCESS != status) {
+        return status;
+    }
+
+    flash_initialized = true;
+
+    for (offset = 0; offset < header.base_size; offset += read_size) {
+        read_size = MIN(header.base_size - offset, sizeof(stage));
+        status = intf->read(header.base_addr + offset, stage, read_size);
+
+        if (ERROR_SUCCESS != status) {
+            return status;
+        }
+
+        crc = crc32_continue(crc, stage, read_size);
+    }
+
+    if (crc != header.base_crc) {
+        delta_printf("    base crc 0x%x does not match 0x%x\r\n", crc, header.base_crc);
+        return ERROR_DELTA_BASE_CRC;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static error_t start_op(uint32_t op)
+{
+    op_length = op & DELTA_OP_LENGTH_MASK;
+
+    if ((0 == op_length) || (op_length > header.new_size - out_pos)) {
+        return ERROR_DELTA_PARSER;
+    }
+
+    switch (op >> DELTA_OP_TYPE_SHIFT) {
+        case DELTA_OP_COPY:
+            state = DELTA_STATE_COPY_SRC;
+            return ERROR_SUCCESS;
+
+        case DELTA_OP_DATA:
+            state = DELTA_STATE_DATA;
+            return ERROR_SUCCESS;
+
+        default:
+            return ERROR_DELTA_PARSER;
+    }
+}
+
+// Produce the next bytes of the new image for the current operation. Literal
+// data is taken from data, copies are read from the target. Each sector is
+// assembled in the stage buffer and programmed only if it differs from the
+// current contents of the target.
+static error_t output(const uint8_t *data, uint32_t size, uint32_t *used)
+{
+    error_t status = ERROR_SUCCESS;
+    *used = 0;
+
+    while ((op_length > 0) && (size > 0)) {
+        uint32_t addr = header.base_addr + out_pos;
+        uint32_t offset;
+        uint32_t chunk;
+
+        if (!sector_valid) {
+            sector_size = intf->erase_sector_size(addr);
+
+            if ((0 == sector_size) || (sector_size > sizeof(stage))) {
+                return ERROR_DELTA_UNSUPPORTED;
+            }
+
+            // Start from the current contents so data outside the image is kept
+            sector_addr = ROUND_DOWN(addr, sector_size);
+            status = intf->read(sector_addr, stage, sector_size);
+
+            if (ERROR_SUCCESS != status) {
+                return status;
+            }
+
+            sector_valid = true;
+            sector_modified = false;
+        }
+
+        offset = addr - sector_addr;
+        chunk = MIN(MIN(op_length, size), sector_size - offset);
+
+        if (DELTA_STATE_DATA == state) {
+            if (0 != memcmp(stage + offset, data, chunk)) {
+                memcpy(stage + offset, data, chunk);
+                sector_modified = true;
+            }
+
+            data += chunk;
+        } else if (copy_src != out_pos) {
+            // Sectors before this one may have been rewritten already
+            if (header.base_addr + copy_src < sector_addr) {
+                return ERROR_DELTA_PARSER;
+            }
+
+            status = intf->read(header.base_addr + copy_src, stage + offset, chunk);
+
+            if (ERROR_SUCCESS != status) {
+                return status;
+            }
+
+            sector_modified = true;
+            copy_src += chunk;
+        } else {
+            // The stage already holds these bytes
+            copy_src += chunk;
+        }
+
+        new_crc = crc32_continue(new_crc, stage + offset, chunk);
+        out_pos += chunk;
+        op_length -= chunk;
+        size -= chunk;
+        *used += chunk;
+
+        if ((offset + chunk == sector_size) || (out_pos == header.new_size)) {
+            if (sector_modified) {
+                status = flash_manager_data(sector_addr, stage, sector_size);
+                delta_printf("    flash_manager_data(addr=0x%x) ret=%i\r\n", sector_addr, status);
+
+                if (ERROR_SUCCESS != status) {
+                    return status;
+                }
+            }
+
+            sector_valid = false;
+        }
+    }
+
+    return status;
+}
+
+#else
+
+error_t delta_open(void)
+{
+    return ERROR_DELTA_UNSUPPORTED;
+}
+
+error_t delta_write(const uint8_t *data, uint32_t size)
+{
+    return ERROR_DELTA_UNSUPPORTED;
+}
+
+error_t delta_close(void)
+{
+    return ERROR_SUCCESS;
+}
+
+#endif
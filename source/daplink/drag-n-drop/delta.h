@@ -0,0 +1,73 @@
+/**
+ * @file    delta.h
+ * @brief   Apply a delta file on top of the image already on the target
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "compiler.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A delta file is generated by tools/make_delta.py. All fields are little
+// endian. The header is followed by a list of operations. Each operation
+// starts with a word holding the type in the upper 4 bits and the length
+// in the lower 28 bits:
+//  - DELTA_OP_COPY is followed by a word with the offset from base_addr to
+//    copy length bytes from. The source may not lie in a sector before the
+//    one currently being written since that sector may have been rewritten.
+//  - DELTA_OP_DATA is followed by length bytes of literal data.
+// Operations produce the new image sequentially starting at base_addr and
+// the file ends once new_size bytes have been produced.
+#define DELTA_MAGIC             "DAPDELTA"
+#define DELTA_VERSION           1
+
+#define DELTA_OP_COPY           0x1
+#define DELTA_OP_DATA           0x2
+#define DELTA_OP_TYPE_SHIFT     28
+#define DELTA_OP_LENGTH_MASK    0x0FFFFFFF
+
+typedef struct __attribute__((packed)) {
+    char magic[8];
+    uint32_t version;
+    uint32_t base_addr;     // Address of both the current and new image
+    uint32_t base_size;     // Size of the image the delta was made against
+    uint32_t base_crc;      // crc32 of the image the delta was made against
+    uint32_t new_size;      // Size of the image produced
+    uint32_t new_crc;       // crc32 of the image produced
+} delta_header_t;
+COMPILER_ASSERT(sizeof(delta_header_t) == 32);
+
+bool delta_detect(const uint8_t *data, uint32_t size);
+error_t delta_open(void);
+error_t delta_write(const uint8_t *data, uint32_t size);
+error_t delta_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file    elf.h
+ * @brief   ELF32 structures needed to stream loadable segments
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ELF_MAG0            0x7F
+#define ELF_MAG1            'E'
+#define ELF_MAG2            'L'
+#define ELF_MAG3            'F'
+#define ELF_CLASS32         1
+#define ELF_DATA2LSB        1
+#define ELF_ET_EXEC         2
+#define ELF_PT_LOAD         1
+
+#define ELF_EI_MAG0         0
+#define ELF_EI_CLASS        4
+#define ELF_EI_DATA         5
+#define ELF_EI_NIDENT       16
+
+typedef struct __attribute__((packed)) {
+    uint8_t  e_ident[ELF_EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf32_ehdr_t;
+COMPILER_ASSERT(sizeof(elf32_ehdr_t) == 52);
+
+typedef struct __attribute__((packed)) {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} elf32_phdr_t;
+COMPILER_ASSERT(sizeof(elf32_phdr_t) == 32);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
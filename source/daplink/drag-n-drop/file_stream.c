@@ -24,6 +24,9 @@
 #include "file_stream.h"
 #include "util.h"
 #include "intelhex.h"
+#include "srec.h"
+#include "elf.h"
+#include "delta.h"
 #include "flash_decoder.h"
 #include "error.h"
 #include "cmsis_os2.h"
@@ -60,9 +63,41 @@ typedef struct {
     uint8_t bin_buffer[256];
 } hex_state_t;
 
+typedef struct {
+    srec_parser_t parser;
+} srec_state_t;
+
+// Maximum number of PT_LOAD segments with file data in an ELF image
+#define ELF_MAX_LOAD_SEGMENTS   8
+
+typedef struct {
+    uint32_t offset;    // Offset of the segment data in the file
+    uint32_t size;      // Size of the segment data in the file
+    uint32_t addr;      // Physical address the segment is loaded to
+} elf_segment_t;
+
+typedef struct {
+    union {
+        elf32_ehdr_t ehdr;
+        elf32_phdr_t phdr;
+        uint8_t buf[sizeof(elf32_ehdr_t)];
+    } hdr;
+    uint32_t hdr_pos;
+    uint32_t file_pos;
+    uint32_t phoff;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t ph_idx;
+    uint8_t segment_count;
+    uint8_t segment_idx;
+    elf_segment_t segments[ELF_MAX_LOAD_SEGMENTS];
+} elf_state_t;
+
 typedef union {
     bin_state_t bin;
     hex_state_t hex;
+    srec_state_t srec;
+    elf_state_t elf;
 } shared_state_t;
 
 static bool detect_bin(const uint8_t *data, uint32_t size);
@@ -73,11 +108,31 @@ static error_t close_bin(void *state);
 static bool detect_hex(const uint8_t *data, uint32_t size);
 static error_t open_hex(void *state);
 static error_t write_hex(void *state, const uint8_t *data, uint32_t size);
+static error_t write_hex_chunk(hex_state_t *hex_state, const uint8_t *data, uint32_t size);
 static error_t close_hex(void *state);
 
+static bool detect_srec(const uint8_t *data, uint32_t size);
+static error_t open_srec(void *state);
+static error_t write_srec(void *state, const uint8_t *data, uint32_t size);
+static error_t close_srec(void *state);
+
+static bool detect_elf(const uint8_t *data, uint32_t size);
+static error_t open_elf(void *state);
+static error_t write_elf(void *state, const uint8_t *data, uint32_t size);
+static error_t close_elf(void *state);
+static bool elf_complete(const elf_state_t *elf_state);
+
+static bool detect_delta(const uint8_t *data, uint32_t size);
+static error_t open_delta(void *state);
+static error_t write_delta(void *state, const uint8_t *data, uint32_t size);
+static error_t close_delta(void *state);
+
 stream_t stream[] = {
-    {detect_bin, open_bin, write_bin, close_bin},   // STREAM_TYPE_BIN
-    {detect_hex, open_hex, write_hex, close_hex},   // STREAM_TYPE_HEX
+    {detect_bin, open_bin, write_bin, close_bin},       // STREAM_TYPE_BIN
+    {detect_hex, open_hex, write_hex, close_hex},       // STREAM_TYPE_HEX
+    {detect_srec, open_srec, write_srec, close_srec},   // STREAM_TYPE_SREC
+    {detect_elf, open_elf, write_elf, close_elf},       // STREAM_TYPE_ELF
+    {detect_delta, open_delta, write_delta, close_delta}, // STREAM_TYPE_DELTA
 };
 COMPILER_ASSERT(ARRAY_SIZE(stream) == STREAM_TYPE_COUNT);
 // STREAM_TYPE_NONE must not be included in count
@@ -119,6 +174,16 @@ stream_type_t stream_type_from_name(const vfs_filename_t filename)
         return STREAM_TYPE_BIN;
     } else if (0 == strncmp("HEX", &filename[8], 3)) {
         return STREAM_TYPE_HEX;
+    } else if ((0 == strncmp("SRE", &filename[8], 3)) ||
+               (0 == strncmp("S19", &filename[8], 3)) ||
+               (0 == strncmp("S28", &filename[8], 3)) ||
+               (0 == strncmp("S37", &filename[8], 3))) {
+        return STREAM_TYPE_SREC;
+    } else if ((0 == strncmp("ELF", &filename[8], 3)) ||
+               (0 == strncmp("AXF", &filename[8], 3))) {
+        return STREAM_TYPE_ELF;
+    } else if (0 == strncmp("DLT", &filename[8], 3)) {
+        return STREAM_TYPE_DELTA;
     } else {
         return STREAM_TYPE_NONE;
     }
@@ -307,6 +372,23 @@ static error_t write_hex(void *state, const uint8_t *data, uint32_t size)
 {
     error_t status = ERROR_SUCCESS;
     hex_state_t *hex_state = (hex_state_t *)state;
+    uint32_t chunk;
+
+    // Each hex byte takes at least two characters so limiting the input
+    // to twice the size of bin_buffer keeps the decoded data in bounds
+    while ((size > 0) && (ERROR_SUCCESS == status)) {
+        chunk = MIN(size, sizeof(hex_state->bin_buffer) * 2);
+        status = write_hex_chunk(hex_state, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+
+    return status;
+}
+
+static error_t write_hex_chunk(hex_state_t *hex_state, const uint8_t *data, uint32_t size)
+{
+    error_t status = ERROR_SUCCESS;
     hexfile_parse_status_t parse_status = HEX_PARSE_UNINIT;
     uint32_t bin_start_address = 0; // Decoded from the hex file, the binary buffer data starts at this address
     uint32_t bin_buf_written = 0;   // The amount of data in the binary buffer starting at address above
@@ -364,3 +446,318 @@ static error_t close_hex(void *state)
     status = flash_decoder_close();
     return status;
 }
+
+/* S-record file processing */
+
+static bool detect_srec(const uint8_t *data, uint32_t size)
+{
+    return 1 == validate_srecfile(data);
+}
+
+static error_t open_srec(void *state)
+{
+    error_t status;
+    srec_state_t *srec_state = (srec_state_t *)state;
+    reset_srec_parser(&srec_state->parser);
+    status = flash_decoder_open();
+    return status;
+}
+
+static error_t write_srec(void *state, const uint8_t *data, uint32_t size)
+{
+    error_t status = ERROR_SUCCESS;
+    srec_state_t *srec_state = (srec_state_t *)state;
+    srec_parse_status_t parse_status;
+    uint32_t block_amt_parsed;      // amount of data parsed in the block on the last call
+    uint32_t bin_address;           // address of the decoded data record
+    const uint8_t *bin_data;        // decoded data record
+    uint32_t bin_size;              // size of the decoded data record
+
+    while (1) {
+        parse_status = parse_srec_blob(&srec_state->parser, data, size, &block_amt_parsed, &bin_address, &bin_data, &bin_size);
+        size -= block_amt_parsed;
+        data += block_amt_parsed;
+
+        if (SREC_PARSE_DATA == parse_status) {
+            // flash_manager buffers records until a full page is available
+            if (bin_size > 0) {
+                status = flash_decoder_write(bin_address, bin_data, bin_size);
+
+                if (ERROR_SUCCESS != status) {
+                    break;
+                }
+            }
+        } else if (SREC_PARSE_OK == parse_status) {
+            break;
+        } else if (SREC_PARSE_EOF == parse_status) {
+            status = ERROR_SUCCESS_DONE;
+            break;
+        } else if (SREC_PARSE_CKSUM_FAIL == parse_status) {
+            status = ERROR_SREC_CKSUM;
+            break;
+        } else {
+            status = ERROR_SREC_PARSER;
+            break;
+        }
+    }
+
+    return status;
+}
+
+static error_t close_srec(void *state)
+{
+    error_t status;
+    status = flash_decoder_close();
+    return status;
+}
+
+/* ELF file processing */
+
+static bool detect_elf(const uint8_t *data, uint32_t size)
+{
+    elf32_ehdr_t ehdr;
+
+    if (size < sizeof(ehdr)) {
+        return false;
+    }
+
+    memcpy(&ehdr, data, sizeof(ehdr));
+    return (ELF_MAG0 == ehdr.e_ident[ELF_EI_MAG0 + 0]) &&
+           (ELF_MAG1 == ehdr.e_ident[ELF_EI_MAG0 + 1]) &&
+           (ELF_MAG2 == ehdr.e_ident[ELF_EI_MAG0 + 2]) &&
+           (ELF_MAG3 == ehdr.e_ident[ELF_EI_MAG0 + 3]) &&
+           (ELF_CLASS32 == ehdr.e_ident[ELF_EI_CLASS]) &&
+           (ELF_DATA2LSB == ehdr.e_ident[ELF_EI_DATA]) &&
+           (ELF_ET_EXEC == ehdr.e_type);
+}
+
+static error_t open_elf(void *state)
+{
+    error_t status;
+    elf_state_t *elf_state = (elf_state_t *)state;
+    memset(elf_state, 0, sizeof(*elf_state));
+    status = flash_decoder_open();
+    return status;
+}
+
+// Validate the ELF header and locate the program header table
+static error_t elf_parse_ehdr(elf_state_t *elf_state)
+{
+    const elf32_ehdr_t *ehdr = &elf_state->hdr.ehdr;
+
+    if (!detect_elf(elf_state->hdr.buf, sizeof(elf_state->hdr.buf)) ||
+            (0 == ehdr->e_phnum) ||
+            (ehdr->e_phentsize < sizeof(elf32_phdr_t)) ||
+            (ehdr->e_phoff < sizeof(elf32_ehdr_t))) {
+        return ERROR_ELF_PARSER;
+    }
+
+    elf_state->phoff = ehdr->e_phoff;
+    elf_state->phentsize = ehdr->e_phentsize;
+    elf_state->phnum = ehdr->e_phnum;
+    return ERROR_SUCCESS;
+}
+
+// Record a program header if it has data to be loaded
+static error_t elf_parse_phdr(elf_state_t *elf_state)
+{
+    const elf32_phdr_t *phdr = &elf_state->hdr.phdr;
+    elf_segment_t *segment;
+
+    // Sections such as .bss have no file data to be programmed
+    if ((ELF_PT_LOAD != phdr->p_type) || (0 == phdr->p_filesz)) {
+        return ERROR_SUCCESS;
+    }
+
+    if (elf_state->segment_count >= ELF_MAX_LOAD_SEGMENTS) {
+        return ERROR_ELF_UNSUPPORTED;
+    }
+
+    segment = &elf_state->segments[elf_state->segment_count];
+    segment->offset = phdr->p_offset;
+    segment->size = phdr->p_filesz;
+    segment->addr = phdr->p_paddr;
+    elf_state->segment_count++;
+    return ERROR_SUCCESS;
+}
+
+// Put the loadable segments in file order so they can be
+// programmed as the file is streamed in
+static error_t elf_sort_segments(elf_state_t *elf_state)
+{
+    uint32_t headers_end = elf_state->phoff + elf_state->phnum * elf_state->phentsize;
+    elf_segment_t *segments = elf_state->segments;
+    uint32_t count = 0;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < elf_state->segment_count; i++) {
+        elf_segment_t segment = segments[i];
+
+        // Some linkers include the ELF header and program header table in the
+        // first segment. That data has already streamed past and is not part
+        // of the image. Any other data before the headers end, such as data
+        // between the ELF header and late program headers, is lost.
+        if (segment.offset < headers_end) {
+            uint32_t skip = headers_end - segment.offset;
+
+            if (segment.offset != 0) {
+                return ERROR_ELF_UNSUPPORTED;
+            }
+
+            if ((elf_state->phoff != sizeof(elf32_ehdr_t)) &&
+                    (segment.size > sizeof(elf32_ehdr_t))) {
+                return ERROR_ELF_UNSUPPORTED;
+            }
+
+            if (skip >= segment.size) {
+                continue;
+            }
+
+            segment.offset += skip;
+            segment.addr += skip;
+            segment.size -= skip;
+        }
+
+        // Insertion sort by file offset
+        for (j = count; (j > 0) && (segments[j - 1].offset > segment.offset); j--) {
+            segments[j] = segments[j - 1];
+        }
+
+        segments[j] = segment;
+        count++;
+    }
+
+    elf_state->segment_count = count;
+
+    if (0 == count) {
+        return ERROR_ELF_UNSUPPORTED;
+    }
+
+    for (i = 1; i < count; i++) {
+        if (segments[i].offset < segments[i - 1].offset + segments[i - 1].size) {
+            return ERROR_ELF_UNSUPPORTED;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static error_t write_elf(void *state, const uint8_t *data, uint32_t size)
+{
+    error_t status = ERROR_SUCCESS;
+    elf_state_t *elf_state = (elf_state_t *)state;
+
+    while (size > 0) {
+        uint32_t copy_size;
+
+        if (elf_state->file_pos < sizeof(elf32_ehdr_t)) {
+            // Buffer the ELF header
+            copy_size = MIN(size, sizeof(elf32_ehdr_t) - elf_state->hdr_pos);
+            memcpy(&elf_state->hdr.buf[elf_state->hdr_pos], data, copy_size);
+            elf_state->hdr_pos += copy_size;
+
+            if (sizeof(elf32_ehdr_t) == elf_state->hdr_pos) {
+                elf_state->hdr_pos = 0;
+                status = elf_parse_ehdr(elf_state);
+            }
+        } else if (elf_state->ph_idx < elf_state->phnum) {
+            uint32_t ph_pos = elf_state->phoff + elf_state->ph_idx * elf_state->phentsize + elf_state->hdr_pos;
+
+            if (elf_state->file_pos < ph_pos) {
+                // Skip data until the next program header
+                copy_size = MIN(size, ph_pos - elf_state->file_pos);
+            } else {
+                // Buffer the program header
+                copy_size = MIN(size, sizeof(elf32_phdr_t) - elf_state->hdr_pos);
+                memcpy(&elf_state->hdr.buf[elf_state->hdr_pos], data, copy_size);
+                elf_state->hdr_pos += copy_size;
+            }
+
+            if (sizeof(elf32_phdr_t) == elf_state->hdr_pos) {
+                elf_state->hdr_pos = 0;
+                elf_state->ph_idx++;
+                status = elf_parse_phdr(elf_state);
+
+                if ((ERROR_SUCCESS == status) && (elf_state->ph_idx == elf_state->phnum)) {
+                    status = elf_sort_segments(elf_state);
+                }
+            }
+        } else if (elf_state->segment_idx < elf_state->segment_count) {
+            elf_segment_t *segment = &elf_state->segments[elf_state->segment_idx];
+
+            if (elf_state->file_pos < segment->offset) {
+                // Skip data that is not part of a loadable segment
+                copy_size = MIN(size, segment->offset - elf_state->file_pos);
+            } else {
+                uint32_t segment_pos = elf_state->file_pos - segment->offset;
+                copy_size = MIN(size, segment->size - segment_pos);
+                status = flash_decoder_write(segment->addr + segment_pos, data, copy_size);
+
+                if (segment_pos + copy_size == segment->size) {
+                    elf_state->segment_idx++;
+                }
+            }
+        } else {
+            // Everything after the last segment is debug or symbol information
+            break;
+        }
+
+        if (ERROR_SUCCESS != status) {
+            return status;
+        }
+
+        elf_state->file_pos += copy_size;
+        data += copy_size;
+        size -= copy_size;
+    }
+
+    if (elf_complete(elf_state)) {
+        return ERROR_SUCCESS_DONE;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static error_t close_elf(void *state)
+{
+    error_t status;
+    elf_state_t *elf_state = (elf_state_t *)state;
+    status = flash_decoder_close();
+
+    // The file ended before the last of its segments
+    if ((ERROR_SUCCESS == status) && !elf_complete(elf_state)) {
+        status = ERROR_ELF_PARSER;
+    }
+
+    return status;
+}
+
+// All program headers have been read and every loadable segment written
+static bool elf_complete(const elf_state_t *elf_state)
+{
+    return (elf_state->ph_idx == elf_state->phnum) && (elf_state->phnum > 0) &&
+           (elf_state->segment_idx == elf_state->segment_count);
+}
+
+/* Delta file processing */
+
+static bool detect_delta(const uint8_t *data, uint32_t size)
+{
+    return delta_detect(data, size);
+}
+
+static error_t open_delta(void *state)
+{
+    return delta_open();
+}
+
+static error_t write_delta(void *state, const uint8_t *data, uint32_t size)
+{
+    return delta_write(data, size);
+}
+
+static error_t close_delta(void *state)
+{
+    return delta_close();
+}
@@ -36,6 +36,9 @@ typedef enum {
 
     STREAM_TYPE_BIN = STREAM_TYPE_START,
     STREAM_TYPE_HEX,
+    STREAM_TYPE_SREC,
+    STREAM_TYPE_ELF,
+    STREAM_TYPE_DELTA,
 
     // Add new stream types here
 
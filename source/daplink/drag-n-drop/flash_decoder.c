@@ -25,6 +25,7 @@
 #include "util.h"
 #include "daplink.h"
 #include "flash_manager.h"
+#include "flash_stats.h"
 #include "target_config.h"  // for target_device
 #include "settings.h"       // for config_get_automation_allowed
 #include "validation.h"
@@ -56,8 +57,13 @@ static uint32_t current_addr;
 static bool flash_initialized;
 static bool initial_addr_set;
 static bool flash_type_target_bin;
+static uint32_t ram_image_start;
+// Set when data is written straight to the interface instead of the flash manager
+static const flash_intf_t *direct_intf;
 
 static bool flash_decoder_is_at_end(uint32_t addr, const uint8_t *data, uint32_t size);
+static error_t flash_decoder_data(uint32_t addr, const uint8_t *data, uint32_t size);
+static bool ram_addr_valid(uint32_t addr);
 
 flash_decoder_type_t flash_decoder_detect_type(const uint8_t *data, uint32_t size, uint32_t addr, bool addr_valid)
 {
@@ -88,6 +94,23 @@ flash_decoder_type_t flash_decoder_detect_type(const uint8_t *data, uint32_t siz
         return FLASH_DECODER_TYPE_TARGET;
     }
 
+    // Check if this is an image that runs from target RAM
+    if (validate_bin_ram_nvic(data)) {
+        if(!addr_valid){ //binary is a bin type, load it at the start of the RAM holding Reset_Handler
+            region_info_t * region = g_board_info.target_cfg->ram_regions;
+            uint32_t reset_handler;
+            memcpy(&reset_handler, data + 4, sizeof(reset_handler));
+            for (; region->start != 0 || region->end != 0; ++region) {
+                if (reset_handler >= region->start && reset_handler <= region->end) {
+                    ram_image_start = region->start;
+                    break;
+                }
+            }
+            flash_type_target_bin = true;
+        }
+        return FLASH_DECODER_TYPE_TARGET_RAM;
+    }
+
     // If an address is specified then the data can be decoded
     if (addr_valid) {
         // TODO - future improvement - make sure address is within target's flash
@@ -153,6 +176,14 @@ error_t flash_decoder_get_flash(flash_decoder_type_t type, uint32_t addr, bool a
             } else {
                 status = ERROR_FD_UNSUPPORTED_UPDATE;
             }
+        } else if ((FLASH_DECODER_TYPE_TARGET_RAM == type) && flash_intf_target_ram) {
+            if (addr_valid && !ram_addr_valid(addr)) {
+                // A hex, S-record or ELF image that starts outside of RAM
+                status = ERROR_FD_RAM_IMAGE_ADDR_WRONG;
+            } else {
+                flash_start_local = addr_valid ? addr : ram_image_start;
+                flash_intf_local = flash_intf_target_ram;
+            }
         } else {
             status = ERROR_FD_UNSUPPORTED_UPDATE;
         }
@@ -197,6 +228,7 @@ error_t flash_decoder_open(void)
     current_addr = 0;
     flash_initialized = false;
     initial_addr_set = false;
+    direct_intf = 0;
     return ERROR_SUCCESS;
 }
 
@@ -266,7 +298,15 @@ error_t flash_decoder_write(uint32_t addr, const uint8_t *data, uint32_t size)
             flash_decoder_printf("    flash_start_addr=0x%x\r\n", flash_start_addr);
             // Initialize flash manager
             util_assert(!flash_initialized);
-            status = flash_manager_init(flash_intf);
+            if (FLASH_DECODER_TYPE_TARGET_RAM == flash_type) {
+                // RAM needs no erase or page buffering so write data straight through
+                uint32_t start = flash_stats_start();
+                status = flash_intf->init();
+                flash_stats_end(FLASH_STATS_PHASE_INIT, start, status);
+                direct_intf = flash_intf;
+            } else {
+                status = flash_manager_init(flash_intf);
+            }
             flash_decoder_printf("    flash_manager_init ret %i\r\n", status);
 
             if (ERROR_SUCCESS != status) {
@@ -279,7 +319,7 @@ error_t flash_decoder_write(uint32_t addr, const uint8_t *data, uint32_t size)
 
         // If flash has been initalized then write out buffered data
         if (flash_initialized) {
-            status = flash_manager_data(initial_addr, flash_buf, flash_buf_pos);
+            status = flash_decoder_data(initial_addr, flash_buf, flash_buf_pos);
             flash_decoder_printf("    Flushing buffer initial_addr=0x%x, flash_buf_pos=%i, flash_manager_data ret=%i\r\n",
                                  initial_addr, flash_buf_pos, status);
 
@@ -292,7 +332,7 @@ error_t flash_decoder_write(uint32_t addr, const uint8_t *data, uint32_t size)
 
     // Write data as normal if flash has been initialized
     if (flash_initialized) {
-        status = flash_manager_data(addr, data, size);
+        status = flash_decoder_data(addr, data, size);
         flash_decoder_printf("    Writing data, addr=0x%x, size=0x%x, flash_manager_data ret %i\r\n",
                              addr, size, status);
 
@@ -327,12 +367,19 @@ error_t flash_decoder_close(void)
     state = DECODER_STATE_CLOSED;
 
     if (flash_initialized) {
-        status = flash_manager_uninit();
+        if (direct_intf) {
+            uint32_t start = flash_stats_start();
+            status = direct_intf->uninit();
+            flash_stats_end(FLASH_STATS_PHASE_UNINIT, start, status);
+        } else {
+            status = flash_manager_uninit();
+        }
         flash_decoder_printf("    flash_manager_uninit ret %i\r\n", status);
     }
 
     if ((DECODER_STATE_DONE != prev_state) &&
             (flash_type != FLASH_DECODER_TYPE_TARGET) &&
+            (flash_type != FLASH_DECODER_TYPE_TARGET_RAM) &&
             (status == ERROR_SUCCESS)) {
         status = ERROR_IAP_UPDT_INCOMPLETE;
     }
@@ -354,9 +401,11 @@ static bool flash_decoder_is_at_end(uint32_t addr, const uint8_t *data, uint32_t
             break;
 
         case FLASH_DECODER_TYPE_TARGET:
+        case FLASH_DECODER_TYPE_TARGET_RAM:
             //only if we are sure it is a bin for the target; without check unordered hex files will cause to terminate flashing
             if (flash_type_target_bin && g_board_info.target_cfg) {
-                region_info_t * region = g_board_info.target_cfg->flash_regions;
+                region_info_t * region = (FLASH_DECODER_TYPE_TARGET == flash_type) ?
+                                         g_board_info.target_cfg->flash_regions : g_board_info.target_cfg->ram_regions;
                 for (; region->start != 0 || region->end != 0; ++region) {
                     if (addr >= region->start &&  addr<=region->end) {
                         end_addr = region->end;
@@ -383,3 +432,41 @@ static bool flash_decoder_is_at_end(uint32_t addr, const uint8_t *data, uint32_t
         return false;
     }
 }
+
+static bool ram_addr_valid(uint32_t addr)
+{
+    region_info_t * region;
+
+    if (!g_board_info.target_cfg) {
+        return false;
+    }
+
+    region = g_board_info.target_cfg->ram_regions;
+    for (; region->start != 0 || region->end != 0; ++region) {
+        if (addr >= region->start && addr <= region->end) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static error_t flash_decoder_data(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    if (direct_intf) {
+        error_t status;
+        uint32_t start;
+
+        if (0 == size) {
+            return ERROR_SUCCESS;
+        }
+
+        start = flash_stats_start();
+        status = direct_intf->program_page(addr, data, size);
+        flash_stats_end(FLASH_STATS_PHASE_PROGRAM, start, status);
+        flash_stats_add_programmed(size);
+        return status;
+    }
+
+    return flash_manager_data(addr, data, size);
+}
@@ -28,3 +28,5 @@ __attribute__((weak))
 const flash_intf_t *const flash_intf_target = 0;
 __attribute__((weak))
 const flash_intf_t *const flash_intf_target_custom = 0;
+__attribute__((weak))
+const flash_intf_t *const flash_intf_target_ram = 0;
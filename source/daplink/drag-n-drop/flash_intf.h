@@ -23,6 +23,7 @@
 #define FLASH_INTF_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "error.h"
 
@@ -46,6 +47,8 @@ typedef uint32_t (*flash_program_page_min_size_cb_t)(uint32_t addr);
 typedef uint32_t (*flash_erase_sector_size_cb_t)(uint32_t addr);
 typedef uint8_t (*flash_busy_cb_t)(void);
 typedef error_t (*flash_algo_set_cb_t)(uint32_t addr);
+typedef error_t (*flash_intf_read_cb_t)(uint32_t addr, uint8_t *buf, uint32_t size);
+typedef bool (*flash_erased_value_cb_t)(uint32_t addr, uint8_t *value);
 
 typedef struct {
     flash_intf_init_cb_t init;
@@ -57,12 +60,15 @@ typedef struct {
     flash_erase_sector_size_cb_t erase_sector_size;
     flash_busy_cb_t flash_busy;
     flash_algo_set_cb_t flash_algo_set;
+    flash_intf_read_cb_t read;  // Optional, NULL if memory cannot be read back
+    flash_erased_value_cb_t erased_value;   // Optional, NULL if erased pages are always programmed
 } flash_intf_t;
 
 // All flash interfaces.  Unsupported interfaces are NULL.
 extern const flash_intf_t *const flash_intf_iap_protected;
 extern const flash_intf_t *const flash_intf_target;
 extern const flash_intf_t *const flash_intf_target_custom;
+extern const flash_intf_t *const flash_intf_target_ram;
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,8 @@
  */
 
 #include "flash_manager.h"
+#include "flash_stats.h"
+#include "vfs_manager.h"
 #include "util.h"
 #include "error.h"
 #include "settings.h"
@@ -49,21 +51,36 @@ static uint8_t buf[1024];
 static bool buf_empty;
 static bool current_sector_valid;
 static bool page_erase_enabled = false;
+static bool sector_erase;
 static uint32_t current_write_block_addr;
 static uint32_t current_write_block_size;
 static uint32_t current_sector_addr;
 static uint32_t current_sector_size;
 static uint32_t last_addr;
+static uint32_t skipped_size;
 static const flash_intf_t *intf;
 static state_t state = STATE_CLOSED;
 
 static bool flash_intf_valid(const flash_intf_t *flash_intf);
+static bool current_block_erased(void);
 static error_t flush_current_block(uint32_t addr);
 static error_t setup_next_sector(uint32_t addr);
+static error_t flash_manager_open(const flash_intf_t *flash_intf, bool erase_sectors);
 
 error_t flash_manager_init(const flash_intf_t *flash_intf)
+{
+    return flash_manager_open(flash_intf, page_erase_enabled);
+}
+
+error_t flash_manager_init_sector_erase(const flash_intf_t *flash_intf)
+{
+    return flash_manager_open(flash_intf, true);
+}
+
+static error_t flash_manager_open(const flash_intf_t *flash_intf, bool erase_sectors)
 {
     error_t status;
+    uint32_t start;
     // Assert that interface has been properly uninitialized
     flash_manager_printf("flash_manager_init()\r\n");
 
@@ -87,18 +104,24 @@ error_t flash_manager_init(const flash_intf_t *flash_intf)
     current_sector_addr = 0;
     current_sector_size = 0;
     last_addr = 0;
+    skipped_size = 0;
+    sector_erase = erase_sectors;
     intf = flash_intf;
     // Initialize flash
+    start = flash_stats_start();
     status = intf->init();
+    flash_stats_end(FLASH_STATS_PHASE_INIT, start, status);
     flash_manager_printf("    intf->init ret=%i\r\n", status);
 
     if (ERROR_SUCCESS != status) {
         return status;
     }
 
-    if (!page_erase_enabled) {
+    if (!sector_erase) {
         // Erase flash and unint if there are errors
+        start = flash_stats_start();
         status = intf->erase_chip();
+        flash_stats_end(FLASH_STATS_PHASE_ERASE, start, status);
         flash_manager_printf("    intf->erase_chip ret=%i\r\n", status);
 
         if (ERROR_SUCCESS != status) {
@@ -198,6 +221,7 @@ error_t flash_manager_uninit(void)
 {
     error_t flash_uninit_error;
     error_t flash_write_error = ERROR_SUCCESS;
+    uint32_t start;
     flash_manager_printf("flash_manager_uninit()\r\n");
 
     if (STATE_CLOSED == state) {
@@ -205,13 +229,16 @@ error_t flash_manager_uninit(void)
         return ERROR_INTERNAL;
     }
 
-    // Flush last buffer if its not empty
-    if (STATE_OPEN == state) {
+    // Flush last buffer if its not empty. No sector is setup if
+    // no data was written, such as when a delta changes nothing.
+    if ((STATE_OPEN == state) && current_sector_valid) {
         flash_write_error = flush_current_block(0);
         flash_manager_printf("    last flush_current_block ret=%i\r\n",flash_write_error);
     }
     // Close flash interface (even if there was an error during program_page)
+    start = flash_stats_start();
     flash_uninit_error = intf->uninit();
+    flash_stats_end(FLASH_STATS_PHASE_UNINIT, start, flash_uninit_error);
     flash_manager_printf("    intf->uninit() ret=%i\r\n", flash_uninit_error);
     // Reset variables to catch accidental use
     memset(buf, 0xFF, sizeof(buf));
@@ -237,10 +264,17 @@ error_t flash_manager_uninit(void)
     return ERROR_SUCCESS;
 }
 
+uint32_t flash_manager_get_skipped_size(void)
+{
+    return skipped_size;
+}
+
 void flash_manager_set_page_erase(bool enabled)
 {
     config_ram_set_page_erase(enabled);
     page_erase_enabled = enabled;
+    // Shown in DETAILS.TXT
+    vfs_user_state_changed();
 }
 
 static bool flash_intf_valid(const flash_intf_t *flash_intf)
@@ -281,12 +315,52 @@ static bool flash_intf_valid(const flash_intf_t *flash_intf)
     return true;
 }
 
+static bool current_block_erased(void)
+{
+    const uint32_t *words = (const uint32_t *)buf;
+    uint32_t erased_word;
+    uint8_t erased;
+    uint32_t i;
+
+    // Only skip when the interface knows what erased flash holds, so
+    // targets that erase to another value and the IAP interface always
+    // program every page
+    if ((0 == intf->erased_value) || !intf->erased_value(current_write_block_addr, &erased)) {
+        return false;
+    }
+    erased_word = erased * 0x01010101u;
+
+    for (i = 0; i < current_write_block_size / sizeof(uint32_t); i++) {
+        if (words[i] != erased_word) {
+            return false;
+        }
+    }
+
+    for (i = i * sizeof(uint32_t); i < current_write_block_size; i++) {
+        if (buf[i] != erased) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static error_t flush_current_block(uint32_t addr){
     // Write out current buffer if there is data in it
     error_t status = ERROR_SUCCESS;
     if (!buf_empty) {
-        status = intf->program_page(current_write_block_addr, buf, current_write_block_size);
-        flash_manager_printf("    intf->program_page(addr=0x%x, size=0x%x) ret=%i\r\n", current_write_block_addr, current_write_block_size, status);
+        if (current_block_erased()) {
+            // The sector has been erased by the chip or sector erase, so a page of
+            // erased values (such as --gap-fill padding) does not need programming
+            skipped_size += current_write_block_size;
+            flash_manager_printf("    skipping erased block(addr=0x%x, size=0x%x)\r\n", current_write_block_addr, current_write_block_size);
+        } else {
+            uint32_t start = flash_stats_start();
+            status = intf->program_page(current_write_block_addr, buf, current_write_block_size);
+            flash_stats_end(FLASH_STATS_PHASE_PROGRAM, start, status);
+            flash_stats_add_programmed(current_write_block_size);
+            flash_manager_printf("    intf->program_page(addr=0x%x, size=0x%x) ret=%i\r\n", current_write_block_addr, current_write_block_size, status);
+        }
         buf_empty = true;
     }
 
@@ -301,6 +375,7 @@ static error_t setup_next_sector(uint32_t addr)
     uint32_t min_prog_size;
     uint32_t sector_size;
     error_t status;
+    uint32_t start;
     min_prog_size = intf->program_page_min_size(addr);
     sector_size = intf->erase_sector_size(addr);
 
@@ -323,16 +398,20 @@ static error_t setup_next_sector(uint32_t addr)
 
     //check flash algo every sector change, addresses with different flash algo should be sector aligned
     if (intf->flash_algo_set) {
+        start = flash_stats_start();
         status = intf->flash_algo_set(current_sector_addr);
+        flash_stats_end(FLASH_STATS_PHASE_INIT, start, status);
         if (ERROR_SUCCESS != status) {
             intf->uninit();
             return status;
         }
     }
 
-    if (page_erase_enabled) {
+    if (sector_erase) {
         // Erase the current sector
+        start = flash_stats_start();
         status = intf->erase_sector(current_sector_addr);
+        flash_stats_end(FLASH_STATS_PHASE_ERASE, start, status);
         flash_manager_printf("    intf->erase_sector(addr=0x%x) ret=%i\r\n", current_sector_addr);
         if (ERROR_SUCCESS != status) {
             intf->uninit();
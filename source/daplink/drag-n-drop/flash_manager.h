@@ -32,8 +32,13 @@ extern "C" {
 #endif
 
 error_t flash_manager_init(const flash_intf_t *flash_intf);
+// Like flash_manager_init but never erases the whole chip. Each sector is
+// erased just before it is first written, so untouched sectors are preserved.
+error_t flash_manager_init_sector_erase(const flash_intf_t *flash_intf);
 error_t flash_manager_data(uint32_t addr, const uint8_t *data, uint32_t size);
 error_t flash_manager_uninit(void);
+// Number of bytes not programmed in the last transfer because they held the erased value
+uint32_t flash_manager_get_skipped_size(void);
 void flash_manager_set_page_erase(bool enabled);
 
 #ifdef __cplusplus
@@ -0,0 +1,118 @@
+/**
+ * @file    flash_stats.c
+ * @brief   Implementation of flash_stats.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "flash_stats.h"
+#include "cmsis_os2.h"
+#include "compiler.h"
+#include "util.h"
+
+static const char *const phase_names[] = {
+    "Stream",
+    "Init",
+    "Erase",
+    "Program",
+    "Verify",
+    "Uninit",
+};
+COMPILER_ASSERT(ARRAY_SIZE(phase_names) == FLASH_STATS_PHASE_COUNT);
+
+static flash_stats_t stats = {
+    .failed_phase = FLASH_STATS_PHASE_NONE,
+};
+
+// Microseconds since startup, wrapping after 71 minutes. The system timer
+// wraps within a minute on the faster HICs, so the kernel tick count gives
+// the time and the system timer only the part within the tick.
+static uint32_t now_us(void)
+{
+    uint32_t timer_freq = osKernelGetSysTimerFreq();
+    uint32_t ticks_per_us = MAX(timer_freq / 1000000, 1);
+    uint32_t timer_per_tick = timer_freq / osKernelGetTickFreq();
+    uint32_t tick = osKernelGetTickCount();
+    uint32_t count = osKernelGetSysTimerCount();
+    uint64_t expected = (uint64_t)tick * timer_per_tick;
+    uint64_t timer;
+
+    // The count holds the low 32 bits of the system timer, which is
+    // within a tick or so of the time from the tick count
+    timer = expected + (int32_t)(count - (uint32_t)expected);
+    return (uint32_t)(timer / ticks_per_us);
+}
+
+void flash_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.failed_phase = FLASH_STATS_PHASE_NONE;
+}
+
+uint32_t flash_stats_start(void)
+{
+    return now_us();
+}
+
+void flash_stats_end(flash_stats_phase_t phase, uint32_t start, error_t status)
+{
+    if (phase >= FLASH_STATS_PHASE_COUNT) {
+        util_assert(0);
+        return;
+    }
+
+    stats.time_us[phase] += now_us() - start;
+
+    // Stream status codes other than ERROR_SUCCESS can still mean success
+    if ((ERROR_SUCCESS != status) && (ERROR_SUCCESS_DONE != status) &&
+            (ERROR_SUCCESS_DONE_OR_CONTINUE != status) &&
+            (FLASH_STATS_PHASE_NONE == stats.failed_phase)) {
+        stats.failed_phase = phase;
+    }
+}
+
+void flash_stats_syscall(uint32_t start)
+{
+    stats.syscall_count++;
+    stats.syscall_time_us += now_us() - start;
+}
+
+void flash_stats_add_received(uint32_t size)
+{
+    stats.bytes_received += size;
+}
+
+void flash_stats_add_programmed(uint32_t size)
+{
+    stats.bytes_programmed += size;
+}
+
+const flash_stats_t *flash_stats_get(void)
+{
+    return &stats;
+}
+
+const char *flash_stats_phase_name(flash_stats_phase_t phase)
+{
+    if (phase >= FLASH_STATS_PHASE_COUNT) {
+        return "None";
+    }
+
+    return phase_names[phase];
+}
@@ -0,0 +1,78 @@
+/**
+ * @file    flash_stats.h
+ * @brief   Timing and size statistics for the last drag-n-drop transfer
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLASH_STATS_H
+#define FLASH_STATS_H
+
+#include <stdint.h>
+
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FLASH_STATS_PHASE_STREAM,   // stream_write, includes all of the phases below
+    FLASH_STATS_PHASE_INIT,     // Flash interface init and flash algorithm download
+    FLASH_STATS_PHASE_ERASE,    // Chip and sector erase
+    FLASH_STATS_PHASE_PROGRAM,  // Page programming, includes verify
+    FLASH_STATS_PHASE_VERIFY,   // Verifying programmed pages
+    FLASH_STATS_PHASE_UNINIT,   // Flash interface uninit and target reset
+
+    FLASH_STATS_PHASE_COUNT,
+
+    FLASH_STATS_PHASE_NONE = FLASH_STATS_PHASE_COUNT
+} flash_stats_phase_t;
+
+typedef struct {
+    uint32_t time_us[FLASH_STATS_PHASE_COUNT];
+    uint32_t syscall_count;         // Number of flash algorithm calls
+    uint32_t syscall_time_us;       // Time spent waiting for flash algorithm calls
+    uint32_t bytes_received;        // Bytes of file data passed to the stream
+    uint32_t bytes_programmed;      // Bytes passed to program_page
+    flash_stats_phase_t failed_phase;
+} flash_stats_t;
+
+// Clear the statistics at the start of a transfer
+void flash_stats_reset(void);
+
+// Get a timestamp in microseconds to pass to flash_stats_end or flash_stats_syscall
+uint32_t flash_stats_start(void);
+
+// Add the time since start to a phase. The first phase to
+// end with an error is reported as the failed phase.
+void flash_stats_end(flash_stats_phase_t phase, uint32_t start, error_t status);
+
+// Count a flash algorithm call that began at start
+void flash_stats_syscall(uint32_t start);
+
+void flash_stats_add_received(uint32_t size);
+void flash_stats_add_programmed(uint32_t size);
+
+const flash_stats_t *flash_stats_get(void);
+const char *flash_stats_phase_name(flash_stats_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
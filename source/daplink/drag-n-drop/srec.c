@@ -0,0 +1,198 @@
+/**
+ * @file    srec.c
+ * @brief   Implementation of srec.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "srec.h"
+
+/** Converts a character representation of a hex digit to its value.
+ *   @param c is the hex digit in char format
+ *   @param val is set to the value of the hex digit
+ *   @return true if c is a hex digit otherwise false
+ */
+static bool ctoh(uint8_t c, uint8_t *val)
+{
+    if ((c >= '0') && (c <= '9')) {
+        *val = c - '0';
+    } else if ((c >= 'A') && (c <= 'F')) {
+        *val = c - 'A' + 10;
+    } else if ((c >= 'a') && (c <= 'f')) {
+        *val = c - 'a' + 10;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/** Number of address bytes used by a record type
+ *   @param type is the record type digit
+ *   @return the address size or 0 if the type is not valid
+ */
+static uint8_t address_size(uint8_t type)
+{
+    switch (type) {
+        case '0':
+        case '1':
+        case '5':
+        case '9':
+            return 2;
+
+        case '2':
+        case '6':
+        case '8':
+            return 3;
+
+        case '3':
+        case '7':
+            return 4;
+
+        default:
+            // S4 is reserved
+            return 0;
+    }
+}
+
+void reset_srec_parser(srec_parser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+}
+
+uint8_t validate_srecfile(const uint8_t *buf)
+{
+    uint8_t val;
+    // Every S-record file starts with a record, usually the S0 header
+    return ((buf[0] == 'S') && (address_size(buf[1]) != 0) && ctoh(buf[2], &val) && ctoh(buf[3], &val)) ? 1 : 0;
+}
+
+srec_parse_status_t parse_srec_blob(srec_parser_t *parser, const uint8_t *srec_blob, uint32_t srec_blob_size, uint32_t *srec_parse_cnt,
+                                    uint32_t *bin_address, const uint8_t **bin_data, uint32_t *bin_size)
+{
+    srec_parse_status_t status = SREC_PARSE_OK;
+    uint32_t pos;
+    *bin_size = 0;
+
+    for (pos = 0; pos < srec_blob_size; pos++) {
+        uint8_t c = srec_blob[pos];
+        uint8_t nibble;
+        uint8_t addr_size;
+        uint8_t sum;
+        uint32_t i;
+
+        // Start of a new record
+        if ('S' == c) {
+            parser->header = true;
+            parser->type = 0;
+            parser->idx = 0;
+            parser->low_nibble = false;
+            continue;
+        }
+
+        // Record type follows the 'S'
+        if (parser->header) {
+            parser->header = false;
+
+            if (0 == address_size(c)) {
+                status = SREC_PARSE_FAILURE;
+                break;
+            }
+
+            parser->type = c;
+            continue;
+        }
+
+        // Outside of a record only line endings and padding are allowed
+        if (0 == parser->type) {
+            if (('\r' == c) || ('\n' == c) || (' ' == c) || (0x00 == c) || (0xFF == c)) {
+                continue;
+            }
+
+            status = SREC_PARSE_FAILURE;
+            break;
+        }
+
+        if (!ctoh(c, &nibble)) {
+            status = SREC_PARSE_FAILURE;
+            break;
+        }
+
+        if (!parser->low_nibble) {
+            parser->record[parser->idx] = nibble << 4;
+            parser->low_nibble = true;
+            continue;
+        }
+
+        parser->record[parser->idx] |= nibble;
+        parser->low_nibble = false;
+        parser->idx++;
+
+        // Wait until the byte count and the bytes it describes have arrived
+        if (parser->idx < (uint16_t)parser->record[0] + 1) {
+            continue;
+        }
+
+        addr_size = address_size(parser->type);
+
+        if (parser->record[0] < addr_size + 1) {
+            status = SREC_PARSE_FAILURE;
+            break;
+        }
+
+        // Checksum is the ones complement of the sum of the other bytes
+        sum = 0;
+
+        for (i = 0; i < parser->idx; i++) {
+            sum += parser->record[i];
+        }
+
+        if (0xFF != sum) {
+            status = SREC_PARSE_CKSUM_FAIL;
+            break;
+        }
+
+        if (('1' == parser->type) || ('2' == parser->type) || ('3' == parser->type)) {
+            uint32_t addr = 0;
+
+            for (i = 0; i < addr_size; i++) {
+                addr = (addr << 8) | parser->record[1 + i];
+            }
+
+            *bin_address = addr;
+            *bin_data = &parser->record[1 + addr_size];
+            *bin_size = parser->record[0] - addr_size - 1;
+            parser->type = 0;
+            pos++;
+            status = SREC_PARSE_DATA;
+            break;
+        } else if (('7' == parser->type) || ('8' == parser->type) || ('9' == parser->type)) {
+            parser->type = 0;
+            pos++;
+            status = SREC_PARSE_EOF;
+            break;
+        }
+
+        // Header and count records carry nothing to program
+        parser->type = 0;
+    }
+
+    *srec_parse_cnt = pos;
+    return status;
+}
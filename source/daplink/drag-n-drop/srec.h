@@ -0,0 +1,92 @@
+/**
+ * @file    srec.h
+ * @brief   Parser for the Motorola S-record file format
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SREC_H
+#define SREC_H
+
+/** \ingroup srec_parser
+ *  @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Byte count field plus the largest record it can describe
+#define SREC_MAX_RECORD_SIZE    (1 + 0xFF)
+
+/** Type of states that the parser can return
+ *  @enum srec_parse_status_t
+ */
+typedef enum {
+    SREC_PARSE_OK = 0,      /*!< The input buffer was completely parsed */
+    SREC_PARSE_DATA,        /*!< A data record was decoded. Program it and continue to parse the input buffer */
+    SREC_PARSE_EOF,         /*!< Termination record (S7, S8 or S9) found */
+    SREC_PARSE_CKSUM_FAIL,  /*!< Error state when the record checksum doesnt properly compute */
+    SREC_PARSE_FAILURE      /*!< Error state when the record is malformed */
+} srec_parse_status_t;
+
+/** Parser state that is maintained between calls to parse_srec_blob
+ *  @struct srec_parser_t
+ */
+typedef struct {
+    uint8_t record[SREC_MAX_RECORD_SIZE];   /*!< Decoded byte count, address, data and checksum */
+    uint16_t idx;                           /*!< Number of bytes decoded into record */
+    uint8_t type;                           /*!< Record type digit, 0 if not inside a record */
+    bool low_nibble;                        /*!< Next character is the low nibble of a byte */
+    bool header;                            /*!< The 'S' of a new record was the last character */
+} srec_parser_t;
+
+/** Prepare any state that is maintained for the start of a file
+ *  @param parser The parser state to reset
+ *  @return none
+ */
+void reset_srec_parser(srec_parser_t *parser);
+
+/** Check if a buffer looks like the start of an S-record file
+ *  @param buf Start of the file, at least 4 bytes
+ *  @return 1 if the buffer starts with an S-record otherwise 0
+ */
+uint8_t validate_srecfile(const uint8_t *buf);
+
+/** Decode a blob of S-record data one data record at a time
+ *  @param parser The parser state
+ *  @param srec_blob A block of ascii encoded S-record data
+ *  @param srec_blob_size The amount of valid data in the srec_blob
+ *  @param srec_parse_cnt The amount of srec_blob data from the call that was parsed
+ *  @param bin_address The address of the decoded data record
+ *  @param bin_data Pointer to the decoded data record, valid until the next call
+ *  @param bin_size The size of the decoded data record
+ *  @return A member of srec_parse_status_t that describes the state of decoding
+ */
+srec_parse_status_t parse_srec_blob(srec_parser_t *parser, const uint8_t *srec_blob, uint32_t srec_blob_size, uint32_t *srec_parse_cnt,
+                                    uint32_t *bin_address, const uint8_t **bin_data, uint32_t *bin_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * @file    target_dump.h
+ * @brief   Read only files on the drive holding the target's memory
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TARGET_DUMP_H
+#define TARGET_DUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Add FLASH.BIN and RAM.BIN to the drive. Reading them reads the first
+// flash and RAM region of the target over SWD. This does nothing unless
+// the interface firmware is built with TARGET_DUMP_FILES set to 1.
+void target_dump_create_files(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,6 +34,7 @@
 #include "version_git.h"
 #include "IO_Config.h"
 #include "file_stream.h"
+#include "flash_stats.h"
 #include "error.h"
 
 // Set to 1 to enable debugging
@@ -49,13 +50,38 @@
 #define MAX_EVENT_TIME_MS   60000
 
 #define CONNECT_DELAY_MS 0
+#ifndef RECONNECT_DELAY_MS
 #define RECONNECT_DELAY_MS 2500    // Must be above 1s for windows (more for linux)
+#endif
 // TRANSFER_IN_PROGRESS
 #define DISCONNECT_DELAY_TRANSFER_TIMEOUT_MS 20000
 // TRANSFER_CAN_BE_FINISHED
 #define DISCONNECT_DELAY_TRANSFER_IDLE_MS 500
 // TRANSFER_NOT_STARTED || TRASNFER_FINISHED
 #define DISCONNECT_DELAY_MS 500
+// TRASNFER_FINISHED successfully
+#define DISCONNECT_DELAY_TRANSFER_DONE_MS 0
+
+// Number of sectors the MSC class collects before passing them to
+// usbd_msc_write_sect, or reads with one call to usbd_msc_read_sect
+#ifndef VFS_BLOCK_GROUP
+#define VFS_BLOCK_GROUP 1
+#endif
+
+// Number of file sectors that can arrive ahead of the next expected sector
+// and be held until the sectors before them are written. Set to 0 to
+// discard sectors that arrive early.
+#ifndef VFS_REORDER_SECTORS
+#define VFS_REORDER_SECTORS 0
+#endif
+
+// Remount by swapping in the new filesystem and reporting a UNIT ATTENTION
+// (medium may have changed) instead of removing the media for
+// RECONNECT_DELAY_MS. If the host has not fetched the sense data after this
+// many ms the media is removed as usual. Set to 0 to always remove the media.
+#ifndef VFS_MEDIA_CHANGE_TIMEOUT_MS
+#define VFS_MEDIA_CHANGE_TIMEOUT_MS 0
+#endif
 
 // Make sure none of the delays exceed the max time
 COMPILER_ASSERT(CONNECT_DELAY_MS < MAX_EVENT_TIME_MS);
@@ -63,6 +89,10 @@ COMPILER_ASSERT(RECONNECT_DELAY_MS < MAX_EVENT_TIME_MS);
 COMPILER_ASSERT(DISCONNECT_DELAY_TRANSFER_TIMEOUT_MS < MAX_EVENT_TIME_MS);
 COMPILER_ASSERT(DISCONNECT_DELAY_TRANSFER_IDLE_MS < MAX_EVENT_TIME_MS);
 COMPILER_ASSERT(DISCONNECT_DELAY_MS < MAX_EVENT_TIME_MS);
+COMPILER_ASSERT(DISCONNECT_DELAY_TRANSFER_DONE_MS < MAX_EVENT_TIME_MS);
+COMPILER_ASSERT(VFS_MEDIA_CHANGE_TIMEOUT_MS < MAX_EVENT_TIME_MS);
+// Each drive is a logical unit of the MSC interface
+COMPILER_ASSERT(VFS_DRIVE_COUNT <= USBD_MSC_MAX_LUN_COUNT);
 
 typedef enum {
     TRANSFER_NOT_STARTED,
@@ -87,15 +117,24 @@ typedef struct {
     bool stream_optional_finish;    // True if the stream processing can be considered done
     bool file_info_optional_finish; // True if the file transfer can be considered done
     bool transfer_timeout;          // Set if the transfer was finished because of a timeout. This only gets reset remount
+    bool size_finish;               // Set if the transfer was finished at the root dir size before the stream saw its end. This only gets reset remount
     stream_type_t stream;           // Current stream or STREAM_TYPE_NONE is stream is closed.  This only gets reset remount
 } file_transfer_state_t;
 
 typedef enum {
     VFS_MNGR_STATE_DISCONNECTED,
     VFS_MNGR_STATE_RECONNECTING,
+    VFS_MNGR_STATE_MEDIA_CHANGING,
     VFS_MNGR_STATE_CONNECTED
 } vfs_mngr_state_t;
 
+typedef enum {
+    CONFIG_STATE_CONNECTED,
+    CONFIG_STATE_REMOUNT_PENDING,
+    CONFIG_STATE_MEDIA_CHANGING,
+    CONFIG_STATE_RECONNECTING,
+} config_state_t;
+
 static const file_transfer_state_t default_transfer_state = {
     VFS_FILE_INVALID,
     VFS_INVALID_SECTOR,
@@ -112,29 +151,43 @@ static const file_transfer_state_t default_transfer_state = {
     false,
     false,
     false,
+    false,
     STREAM_TYPE_NONE,
 };
 
 //Compile option not to include MSC at all, these will be dummy variables
 #ifndef MSC_ENDPOINT
-BOOL USBD_MSC_MediaReady = __FALSE;
-BOOL USBD_MSC_ReadOnly = __FALSE;
-U32 USBD_MSC_MemorySize;
+U8 USBD_MSC_LunCount;
+BOOL USBD_MSC_MediaReady[USBD_MSC_MAX_LUN_COUNT];
+BOOL USBD_MSC_MediaChanged[USBD_MSC_MAX_LUN_COUNT];
+BOOL USBD_MSC_ReadOnly[USBD_MSC_MAX_LUN_COUNT];
+U32 USBD_MSC_MemorySize[USBD_MSC_MAX_LUN_COUNT];
 U32 USBD_MSC_BlockSize;
 U32 USBD_MSC_BlockGroup;
-U32 USBD_MSC_BlockCount;
+U32 USBD_MSC_BlockCount[USBD_MSC_MAX_LUN_COUNT];
 U8 *USBD_MSC_BlockBuf;
 #endif
 
-static uint32_t usb_buffer[VFS_SECTOR_SIZE / sizeof(uint32_t)];
+static uint32_t usb_buffer[VFS_SECTOR_SIZE * VFS_BLOCK_GROUP / sizeof(uint32_t)];
 static error_t fail_reason = ERROR_SUCCESS;
 static file_transfer_state_t file_transfer_state;
 
+#if VFS_REORDER_SECTORS > 0
+typedef struct {
+    vfs_sector_t sector;    // VFS_INVALID_SECTOR if the entry is free
+    uint32_t data[VFS_SECTOR_SIZE / sizeof(uint32_t)];
+} reorder_entry_t;
+
+static reorder_entry_t reorder_buffer[VFS_REORDER_SECTORS];
+#endif
+
 // These variables can be access from multiple threads
 // so access to them must be synchronized
 static vfs_mngr_state_t vfs_state;
 static vfs_mngr_state_t vfs_state_next;
 static uint32_t time_usb_idle;
+static config_state_t config_state;
+static uint32_t config_time_idle;
 
 static osMutexId_t sync_mutex;
 static osThreadId_t sync_thread = 0;
@@ -149,8 +202,19 @@ static bool changing_state(void);
 static void build_filesystem(void);
 static void file_change_handler(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data);
 static void file_data_handler(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors);
+static void file_data_process(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors);
+static bool file_sector_in_range(uint32_t sector);
+static void reorder_reset(void);
+static bool reorder_hold(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors);
+static void reorder_replay(void);
 static bool ready_for_state_change(void);
 static void abort_remount(void);
+static void config_periodic(uint32_t elapsed_ms);
+static void config_connect(bool connect);
+#if VFS_DRIVE_COUNT > 1
+static void build_config_filesystem(void);
+static void config_file_change_handler(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data);
+#endif
 
 static void transfer_update_file_info(vfs_file_t file, uint32_t start_sector, uint32_t size, stream_type_t stream);
 static void transfer_reset_file_info(void);
@@ -180,7 +244,27 @@ void vfs_mngr_fs_remount(void)
 
     // Only start a remount if in the connected state and not in a transition
     if (!changing_state() && (VFS_MNGR_STATE_CONNECTED == vfs_state)) {
-        vfs_state_next = VFS_MNGR_STATE_RECONNECTING;
+        vfs_state_next = VFS_MEDIA_CHANGE_TIMEOUT_MS > 0 ?
+                         VFS_MNGR_STATE_MEDIA_CHANGING : VFS_MNGR_STATE_RECONNECTING;
+    }
+
+    sync_unlock();
+}
+
+void vfs_mngr_config_remount(void)
+{
+    if (VFS_DRIVE_CONFIG == VFS_DRIVE_MAIN) {
+        vfs_mngr_fs_remount();
+        return;
+    }
+
+    sync_lock();
+
+    // The config drive is only present while the main drive is not disconnected
+    if ((VFS_MNGR_STATE_DISCONNECTED != vfs_state) &&
+            ((CONFIG_STATE_CONNECTED == config_state) || (CONFIG_STATE_MEDIA_CHANGING == config_state))) {
+        config_state = CONFIG_STATE_REMOUNT_PENDING;
+        config_time_idle = 0;
     }
 
     sync_unlock();
@@ -194,12 +278,14 @@ void vfs_mngr_init(bool enable)
     if (enable) {
         vfs_state = VFS_MNGR_STATE_CONNECTED;
         vfs_state_next = VFS_MNGR_STATE_CONNECTED;
-        USBD_MSC_MediaReady = 1;
+        USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 1;
     } else {
         vfs_state = VFS_MNGR_STATE_DISCONNECTED;
         vfs_state_next = VFS_MNGR_STATE_DISCONNECTED;
-        USBD_MSC_MediaReady = 0;
+        USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 0;
     }
+
+    config_connect(enable);
 }
 
 void vfs_mngr_periodic(uint32_t elapsed_ms)
@@ -208,6 +294,7 @@ void vfs_mngr_periodic(uint32_t elapsed_ms)
     vfs_mngr_state_t vfs_state_local;
     vfs_mngr_state_t vfs_state_local_prev;
     sync_assert_usb_thread();
+    config_periodic(elapsed_ms);
     sync_lock();
 
     // Return immediately if the desired state has been reached
@@ -222,6 +309,15 @@ void vfs_mngr_periodic(uint32_t elapsed_ms)
         time_usb_idle += elapsed_ms;
     }
 
+    // Fall back to removing the media if the host never
+    // asked for the sense data reporting the media change
+    if ((VFS_MNGR_STATE_MEDIA_CHANGING == vfs_state) &&
+            (VFS_MNGR_STATE_CONNECTED == vfs_state_next) &&
+            USBD_MSC_MediaChanged[VFS_DRIVE_MAIN] && (time_usb_idle > VFS_MEDIA_CHANGE_TIMEOUT_MS)) {
+        vfs_state_next = VFS_MNGR_STATE_RECONNECTING;
+        change_state = true;
+    }
+
     if (!change_state) {
         sync_unlock();
         return;
@@ -236,6 +332,7 @@ void vfs_mngr_periodic(uint32_t elapsed_ms)
 
     switch (vfs_state) {
         case VFS_MNGR_STATE_RECONNECTING:
+        case VFS_MNGR_STATE_MEDIA_CHANGING:
             // Transition back to the connected state
             vfs_state_next = VFS_MNGR_STATE_CONNECTED;
             break;
@@ -260,6 +357,11 @@ void vfs_mngr_periodic(uint32_t elapsed_ms)
             // No action needed
             break;
 
+        case VFS_MNGR_STATE_MEDIA_CHANGING:
+            // Drop the UNIT ATTENTION if the host never fetched it
+            USBD_MSC_MediaChanged[VFS_DRIVE_MAIN] = 0;
+            break;
+
         case VFS_MNGR_STATE_CONNECTED:
 
             // Close ongoing transfer if there is one
@@ -271,22 +373,42 @@ void vfs_mngr_periodic(uint32_t elapsed_ms)
 
             util_assert(TRASNFER_FINISHED == file_transfer_state.transfer_state);
             vfs_user_disconnecting();
+            // Show the result of the transfer on the config drive
+            vfs_mngr_config_remount();
             break;
     }
 
     // Processing when entering a state
     switch (vfs_state_local) {
         case VFS_MNGR_STATE_DISCONNECTED:
-            USBD_MSC_MediaReady = 0;
+            USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 0;
+            config_connect(false);
             break;
 
         case VFS_MNGR_STATE_RECONNECTING:
-            USBD_MSC_MediaReady = 0;
+            USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 0;
             break;
 
-        case VFS_MNGR_STATE_CONNECTED:
+        case VFS_MNGR_STATE_MEDIA_CHANGING:
+            // The host is told about the new filesystem before it
+            // can access it so the media can stay ready
             build_filesystem();
-            USBD_MSC_MediaReady = 1;
+            USBD_MSC_MediaChanged[VFS_DRIVE_MAIN] = 1;
+            break;
+
+        case VFS_MNGR_STATE_CONNECTED:
+
+            // Already built if the host picked up the media change
+            if (VFS_MNGR_STATE_MEDIA_CHANGING != vfs_state_local_prev) {
+                build_filesystem();
+            }
+
+            USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 1;
+
+            if (VFS_MNGR_STATE_DISCONNECTED == vfs_state_local_prev) {
+                config_connect(true);
+            }
+
             break;
     }
 
@@ -306,28 +428,42 @@ void usbd_msc_init(void)
     vfs_state = VFS_MNGR_STATE_DISCONNECTED;
     vfs_state_next = VFS_MNGR_STATE_DISCONNECTED;
     time_usb_idle = 0;
-    USBD_MSC_MediaReady = 0;
+    USBD_MSC_LunCount = VFS_DRIVE_COUNT;
+    USBD_MSC_MediaReady[VFS_DRIVE_MAIN] = 0;
+    config_connect(false);
 }
 
-void usbd_msc_read_sect(uint32_t sector, uint8_t *buf, uint32_t num_of_sectors)
+void usbd_msc_read_sect(uint8_t lun, uint32_t sector, uint8_t *buf, uint32_t num_of_sectors)
 {
     sync_assert_usb_thread();
 
     // dont proceed if we're not ready
-    if (!USBD_MSC_MediaReady) {
+    if ((lun >= VFS_DRIVE_COUNT) || !USBD_MSC_MediaReady[lun]) {
         return;
     }
 
     // indicate msc activity
     main_blink_msc_led(MAIN_LED_FLASH);
+    vfs_select(lun);
     vfs_read(sector, buf, num_of_sectors);
 }
 
-void usbd_msc_write_sect(uint32_t sector, uint8_t *buf, uint32_t num_of_sectors)
+void usbd_msc_write_sect(uint8_t lun, uint32_t sector, uint8_t *buf, uint32_t num_of_sectors)
 {
     sync_assert_usb_thread();
 
-    if (!USBD_MSC_MediaReady) {
+    if ((lun >= VFS_DRIVE_COUNT) || !USBD_MSC_MediaReady[lun]) {
+        return;
+    }
+
+    // Nothing is programmed from the config drive
+    if (VFS_DRIVE_MAIN != lun) {
+        sync_lock();
+        config_time_idle = 0;
+        sync_unlock();
+        main_blink_msc_led(MAIN_LED_FLASH);
+        vfs_select(lun);
+        vfs_write(sector, buf, num_of_sectors);
         return;
     }
 
@@ -336,12 +472,16 @@ void usbd_msc_write_sect(uint32_t sector, uint8_t *buf, uint32_t num_of_sectors)
     // transfer.
     time_usb_idle = 0;
 
-    if (TRASNFER_FINISHED == file_transfer_state.transfer_state) {
+    // Directory updates are still needed after finishing
+    // at the root dir size to see if the file grows
+    if ((TRASNFER_FINISHED == file_transfer_state.transfer_state) &&
+            !file_transfer_state.size_finish) {
         return;
     }
 
     // indicate msc activity
     main_blink_msc_led(MAIN_LED_FLASH);
+    vfs_select(VFS_DRIVE_MAIN);
     vfs_write(sector, buf, num_of_sectors);
     if (TRASNFER_FINISHED == file_transfer_state.transfer_state) {
         return;
@@ -379,13 +519,15 @@ static void build_filesystem()
 {
     // Update anything that could have changed file system state
     file_transfer_state = default_transfer_state;
+    reorder_reset();
+    vfs_select(VFS_DRIVE_MAIN);
     vfs_user_build_filesystem();
     vfs_set_file_change_callback(file_change_handler);
     // Set mass storage parameters
-    USBD_MSC_MemorySize = vfs_get_total_size();
+    USBD_MSC_MemorySize[VFS_DRIVE_MAIN] = vfs_get_total_size();
     USBD_MSC_BlockSize  = VFS_SECTOR_SIZE;
-    USBD_MSC_BlockGroup = 1;
-    USBD_MSC_BlockCount = USBD_MSC_MemorySize / USBD_MSC_BlockSize;
+    USBD_MSC_BlockGroup = VFS_BLOCK_GROUP;
+    USBD_MSC_BlockCount[VFS_DRIVE_MAIN] = USBD_MSC_MemorySize[VFS_DRIVE_MAIN] / USBD_MSC_BlockSize;
     USBD_MSC_BlockBuf   = (uint8_t *)usb_buffer;
 }
 
@@ -395,6 +537,18 @@ static void file_change_handler(const vfs_filename_t filename, vfs_file_change_t
     vfs_mngr_printf("vfs_manager file_change_handler(name=%*s, file=%p, change=%i)\r\n", 11, filename, file, change);
     vfs_user_file_change_handler(filename, change, file, new_file_data);
     if (TRASNFER_FINISHED == file_transfer_state.transfer_state) {
+        // The stream was closed at the size in the root dir, so data past
+        // what it processed is lost if the host makes the file bigger
+        if (file_transfer_state.size_finish && (VFS_FILE_CHANGED == change) &&
+                (file == file_transfer_state.file_to_program) &&
+                (vfs_file_get_size(new_file_data) > file_transfer_state.size_processed)) {
+            vfs_mngr_printf("    error: file grew to %i after the transfer finished\r\n",
+                            vfs_file_get_size(new_file_data));
+            file_transfer_state.size_finish = false;
+            fail_reason = ERROR_ERROR_DURING_TRANSFER;
+            vfs_user_state_changed();
+        }
+
         // If the transfer is finished stop further processing
         return;
     }
@@ -438,17 +592,22 @@ static void file_change_handler(const vfs_filename_t filename, vfs_file_change_t
 static void file_data_handler(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors)
 {
     stream_type_t stream;
-    uint32_t size;
 
     // this is the key for starting a file write - we dont care what file types are sent
     //  just look for something unique (NVIC table, hex, srec, etc) until root dir is updated
-    if (!file_transfer_state.stream_started) {
+    //  Each sector of a multi-sector write could be the start of the file.
+    while (!file_transfer_state.stream_started && (num_of_sectors > 0)) {
         // look for file types we can program
-        stream = stream_start_identify((uint8_t *)buf, VFS_SECTOR_SIZE * num_of_sectors);
+        stream = stream_start_identify((uint8_t *)buf, VFS_SECTOR_SIZE);
 
         if (STREAM_TYPE_NONE != stream) {
             transfer_stream_open(stream, sector);
+            break;
         }
+
+        sector++;
+        buf += VFS_SECTOR_SIZE;
+        num_of_sectors--;
     }
 
     if (file_transfer_state.stream_started) {
@@ -471,8 +630,17 @@ static void file_data_handler(uint32_t sector, const uint8_t *buf, uint32_t num_
 
                 file_transfer_state.last_ooo_sector =
                     MIN(file_transfer_state.last_ooo_sector, sector);
-            } else {
+            } else if (!file_sector_in_range(sector)) {
                 vfs_mngr_printf("    sector not part of file transfer\r\n");
+            } else if (reorder_hold(sector, buf, num_of_sectors)) {
+                vfs_mngr_printf("    sector early, held until sector %i is written\r\n",
+                                file_transfer_state.file_next_sector);
+                return;
+            } else if ((VFS_REORDER_SECTORS > 0) && (file_transfer_state.file_size > 0)) {
+                // The sector is known to be part of the file so it cannot be dropped
+                vfs_mngr_printf("    error: too many sectors out of order\r\n");
+                transfer_update_state(ERROR_OOO_BUFFER_FULL);
+                return;
             }
 
             vfs_mngr_printf("    discarding data - size transferred=0x%x, data=%x,%x,%x,%x,...\r\n",
@@ -480,24 +648,147 @@ static void file_data_handler(uint32_t sector, const uint8_t *buf, uint32_t num_
             return;
         }
 
-        // This sector could be part of the file so record it
-        size = VFS_SECTOR_SIZE * num_of_sectors;
-        file_transfer_state.size_transferred += size;
-        file_transfer_state.file_next_sector = sector + num_of_sectors;
+        file_data_process(sector, buf, num_of_sectors);
+        reorder_replay();
+    }
+}
 
-        // If stream processing is done then discard the data
-        if (file_transfer_state.stream_finished) {
-            vfs_mngr_printf("vfs_manager file_data_handler\r\n    sector=%i, size=%i\r\n", sector, size);
-            vfs_mngr_printf("    discarding data - size transferred=0x%x, data=%x,%x,%x,%x,...\r\n",
-                            file_transfer_state.size_transferred, buf[0], buf[1], buf[2], buf[3]);
-            transfer_update_state(ERROR_SUCCESS);
-            return;
+// Pass the next sectors of the file to the stream
+static void file_data_process(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors)
+{
+    // This sector could be part of the file so record it
+    uint32_t size = VFS_SECTOR_SIZE * num_of_sectors;
+    file_transfer_state.size_transferred += size;
+    file_transfer_state.file_next_sector = sector + num_of_sectors;
+
+    // If stream processing is done then discard the data
+    if (file_transfer_state.stream_finished) {
+        vfs_mngr_printf("vfs_manager file_data_handler\r\n    sector=%i, size=%i\r\n", sector, size);
+        vfs_mngr_printf("    discarding data - size transferred=0x%x, data=%x,%x,%x,%x,...\r\n",
+                        file_transfer_state.size_transferred, buf[0], buf[1], buf[2], buf[3]);
+        transfer_update_state(ERROR_SUCCESS);
+        return;
+    }
+
+    transfer_stream_data(sector, buf, size);
+}
+
+// Check if a sector after the next expected one could belong to the file.
+// Before the root directory is updated the size of the file is unknown.
+static bool file_sector_in_range(uint32_t sector)
+{
+    uint32_t file_sectors;
+
+    if (0 == file_transfer_state.file_size) {
+        return true;
+    }
+
+    file_sectors = (file_transfer_state.file_size + VFS_SECTOR_SIZE - 1) / VFS_SECTOR_SIZE;
+    return sector - file_transfer_state.start_sector < file_sectors;
+}
+
+#if VFS_REORDER_SECTORS > 0
+
+static void reorder_reset(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < ARRAY_SIZE(reorder_buffer); i++) {
+        reorder_buffer[i].sector = VFS_INVALID_SECTOR;
+    }
+}
+
+// Hold sectors that arrived before the next expected sector.
+// Returns false if there was not enough space for all of them.
+static bool reorder_hold(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors)
+{
+    uint32_t i;
+    uint32_t j;
+    uint32_t free_entries = 0;
+
+    // Entries outside the file now that its size is known will never be used
+    for (i = 0; i < ARRAY_SIZE(reorder_buffer); i++) {
+        if ((VFS_INVALID_SECTOR != reorder_buffer[i].sector) &&
+                !file_sector_in_range(reorder_buffer[i].sector)) {
+            reorder_buffer[i].sector = VFS_INVALID_SECTOR;
         }
 
-        transfer_stream_data(sector, buf, size);
+        if (VFS_INVALID_SECTOR == reorder_buffer[i].sector) {
+            free_entries++;
+        }
+    }
+
+    // Sectors written again replace the held copy
+    for (i = 0; i < ARRAY_SIZE(reorder_buffer); i++) {
+        if ((VFS_INVALID_SECTOR != reorder_buffer[i].sector) &&
+                (reorder_buffer[i].sector >= sector) && (reorder_buffer[i].sector - sector < num_of_sectors)) {
+            reorder_buffer[i].sector = VFS_INVALID_SECTOR;
+            free_entries++;
+        }
+    }
+
+    if (free_entries < num_of_sectors) {
+        return false;
     }
+
+    for (i = 0, j = 0; j < num_of_sectors; i++) {
+        if (VFS_INVALID_SECTOR == reorder_buffer[i].sector) {
+            reorder_buffer[i].sector = sector + j;
+            memcpy(reorder_buffer[i].data, buf + j * VFS_SECTOR_SIZE, VFS_SECTOR_SIZE);
+            j++;
+        }
+    }
+
+    return true;
 }
 
+// Process held sectors that are now next in the file
+static void reorder_replay(void)
+{
+    uint32_t i;
+    bool found = true;
+
+    while (found && (TRASNFER_FINISHED != file_transfer_state.transfer_state)) {
+        found = false;
+
+        for (i = 0; i < ARRAY_SIZE(reorder_buffer); i++) {
+            vfs_sector_t sector = reorder_buffer[i].sector;
+
+            if (VFS_INVALID_SECTOR == sector) {
+                continue;
+            }
+
+            if (sector < file_transfer_state.file_next_sector) {
+                // Overwritten by the host since it was held
+                reorder_buffer[i].sector = VFS_INVALID_SECTOR;
+            } else if (sector == file_transfer_state.file_next_sector) {
+                vfs_mngr_printf("vfs_manager reorder_replay sector=%i\r\n", sector);
+                reorder_buffer[i].sector = VFS_INVALID_SECTOR;
+                file_data_process(sector, (uint8_t *)reorder_buffer[i].data, 1);
+                found = true;
+                break;
+            }
+        }
+    }
+}
+
+#else
+
+static void reorder_reset(void)
+{
+}
+
+static bool reorder_hold(uint32_t sector, const uint8_t *buf, uint32_t num_of_sectors)
+{
+    return false;
+}
+
+static void reorder_replay(void)
+{
+}
+
+#endif
+
 static bool ready_for_state_change(void)
 {
     uint32_t timeout_ms = INVALID_TIMEOUT_MS;
@@ -506,10 +797,21 @@ static bool ready_for_state_change(void)
     if (VFS_MNGR_STATE_CONNECTED == vfs_state) {
         switch (file_transfer_state.transfer_state) {
             case TRANSFER_NOT_STARTED:
-            case TRASNFER_FINISHED:
                 timeout_ms = DISCONNECT_DELAY_MS;
                 break;
 
+            case TRASNFER_FINISHED:
+                // Show the result of a successful transfer right away, unless
+                // the host may still grow the file it was finished on
+                if (ERROR_SUCCESS != fail_reason) {
+                    timeout_ms = DISCONNECT_DELAY_MS;
+                } else if (file_transfer_state.size_finish) {
+                    timeout_ms = DISCONNECT_DELAY_TRANSFER_IDLE_MS;
+                } else {
+                    timeout_ms = DISCONNECT_DELAY_TRANSFER_DONE_MS;
+                }
+                break;
+
             case TRANSFER_IN_PROGRESS:
                 timeout_ms = DISCONNECT_DELAY_TRANSFER_TIMEOUT_MS;
                 break;
@@ -532,6 +834,12 @@ static bool ready_for_state_change(void)
     } else if ((VFS_MNGR_STATE_RECONNECTING == vfs_state) &&
                (VFS_MNGR_STATE_DISCONNECTED == vfs_state_next)) {
         timeout_ms = 0;
+    } else if ((VFS_MNGR_STATE_MEDIA_CHANGING == vfs_state) &&
+               (VFS_MNGR_STATE_CONNECTED == vfs_state_next)) {
+        // Wait for the host to fetch the sense data
+        timeout_ms = USBD_MSC_MediaChanged[VFS_DRIVE_MAIN] ? MAX_EVENT_TIME_MS : 0;
+    } else if (VFS_MNGR_STATE_MEDIA_CHANGING == vfs_state) {
+        timeout_ms = 0;
     }
 
     if (INVALID_TIMEOUT_MS == timeout_ms) {
@@ -548,13 +856,132 @@ void abort_remount(void)
     sync_lock();
 
     // Only abort a remount if in the connected state and reconnecting is the next state
-    if ((VFS_MNGR_STATE_RECONNECTING == vfs_state_next) && (VFS_MNGR_STATE_CONNECTED == vfs_state)) {
+    if (((VFS_MNGR_STATE_RECONNECTING == vfs_state_next) || (VFS_MNGR_STATE_MEDIA_CHANGING == vfs_state_next)) &&
+            (VFS_MNGR_STATE_CONNECTED == vfs_state)) {
         vfs_state_next = VFS_MNGR_STATE_CONNECTED;
     }
 
     sync_unlock();
 }
 
+#if VFS_DRIVE_COUNT > 1
+
+// Run the remount of the config drive. This works like a remount of
+// the main drive but there is no transfer to wait for.
+static void config_periodic(uint32_t elapsed_ms)
+{
+    bool connect = false;
+    bool media_change = false;
+
+    sync_lock();
+
+    if (config_time_idle < MAX_EVENT_TIME_MS) {
+        config_time_idle += elapsed_ms;
+    }
+
+    switch (config_state) {
+        case CONFIG_STATE_REMOUNT_PENDING:
+
+            // Let the host finish writing to the drive first
+            if (config_time_idle > DISCONNECT_DELAY_MS) {
+                if (VFS_MEDIA_CHANGE_TIMEOUT_MS > 0) {
+                    config_state = CONFIG_STATE_MEDIA_CHANGING;
+                    media_change = true;
+                } else {
+                    config_state = CONFIG_STATE_RECONNECTING;
+                    USBD_MSC_MediaReady[VFS_DRIVE_CONFIG] = 0;
+                }
+
+                config_time_idle = 0;
+            }
+
+            break;
+
+        case CONFIG_STATE_MEDIA_CHANGING:
+
+            // Fall back to removing the media if the host never
+            // asked for the sense data reporting the media change
+            if (!USBD_MSC_MediaChanged[VFS_DRIVE_CONFIG]) {
+                config_state = CONFIG_STATE_CONNECTED;
+            } else if (config_time_idle > VFS_MEDIA_CHANGE_TIMEOUT_MS) {
+                config_state = CONFIG_STATE_RECONNECTING;
+                USBD_MSC_MediaChanged[VFS_DRIVE_CONFIG] = 0;
+                USBD_MSC_MediaReady[VFS_DRIVE_CONFIG] = 0;
+                config_time_idle = 0;
+            }
+
+            break;
+
+        case CONFIG_STATE_RECONNECTING:
+            if (config_time_idle > RECONNECT_DELAY_MS) {
+                config_state = CONFIG_STATE_CONNECTED;
+                connect = VFS_MNGR_STATE_DISCONNECTED != vfs_state;
+            }
+
+            break;
+
+        default:
+            // Nothing to do when connected
+            break;
+    }
+
+    sync_unlock();
+
+    if (media_change) {
+        build_config_filesystem();
+        USBD_MSC_MediaChanged[VFS_DRIVE_CONFIG] = 1;
+    }
+
+    if (connect) {
+        build_config_filesystem();
+        USBD_MSC_MediaReady[VFS_DRIVE_CONFIG] = 1;
+    }
+}
+
+// Attach or detach the config drive along with the main drive
+static void config_connect(bool connect)
+{
+    sync_lock();
+    config_state = CONFIG_STATE_CONNECTED;
+    config_time_idle = 0;
+    sync_unlock();
+
+    if (connect) {
+        build_config_filesystem();
+    }
+
+    USBD_MSC_MediaChanged[VFS_DRIVE_CONFIG] = 0;
+    USBD_MSC_MediaReady[VFS_DRIVE_CONFIG] = connect;
+}
+
+static void build_config_filesystem(void)
+{
+    vfs_select(VFS_DRIVE_CONFIG);
+    vfs_user_build_config_filesystem();
+    vfs_set_file_change_callback(config_file_change_handler);
+    USBD_MSC_MemorySize[VFS_DRIVE_CONFIG] = vfs_get_total_size();
+    USBD_MSC_BlockCount[VFS_DRIVE_CONFIG] = USBD_MSC_MemorySize[VFS_DRIVE_CONFIG] / VFS_SECTOR_SIZE;
+}
+
+// Files on the config drive are only checked for magic files
+static void config_file_change_handler(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data)
+{
+    vfs_mngr_printf("vfs_manager config_file_change_handler(name=%*s, file=%p, change=%i)\r\n", 11, filename, file, change);
+    vfs_user_file_change_handler(filename, change, file, new_file_data);
+}
+
+#else
+
+static void config_periodic(uint32_t elapsed_ms)
+{
+}
+
+static void config_connect(bool connect)
+{
+}
+
+#endif
+
 // Update the tranfer state with file information
 static void transfer_update_file_info(vfs_file_t file, uint32_t start_sector, uint32_t size, stream_type_t stream)
 {
@@ -632,6 +1059,7 @@ static void transfer_reset_file_info()
         file_transfer_state.file_size = 0;
     }else{
           file_transfer_state = default_transfer_state;
+          reorder_reset();
           abort_remount();
     }
 
@@ -641,6 +1069,7 @@ static void transfer_reset_file_info()
 static void transfer_stream_open(stream_type_t stream, uint32_t start_sector)
 {
     error_t status;
+    uint32_t start;
     util_assert(!file_transfer_state.stream_open);
     util_assert(start_sector != VFS_INVALID_SECTOR);
     vfs_mngr_printf("vfs_manager transfer_update_stream_open(stream=%i, start_sector=%i)\r\n",
@@ -679,7 +1108,10 @@ static void transfer_stream_open(stream_type_t stream, uint32_t start_sector)
     }
 
     // Open stream
+    flash_stats_reset();
+    start = flash_stats_start();
     status = stream_open(stream);
+    flash_stats_end(FLASH_STATS_PHASE_STREAM, start, status);
     vfs_mngr_printf("    stream_open stream=%i ret %i\r\n", stream, status);
 
     if (ERROR_SUCCESS == status) {
@@ -695,6 +1127,7 @@ static void transfer_stream_open(stream_type_t stream, uint32_t start_sector)
 static void transfer_stream_data(uint32_t sector, const uint8_t *data, uint32_t size)
 {
     error_t status;
+    uint32_t start;
     vfs_mngr_printf("vfs_manager transfer_stream_data(sector=%i, size=%i)\r\n", sector, size);
     vfs_mngr_printf("    size processed=0x%x, data=%x,%x,%x,%x,...\r\n",
                     file_transfer_state.size_processed, data[0], data[1], data[2], data[3]);
@@ -706,13 +1139,18 @@ static void transfer_stream_data(uint32_t sector, const uint8_t *data, uint32_t
 
     util_assert(size % VFS_SECTOR_SIZE == 0);
     util_assert(file_transfer_state.stream_open);
+    start = flash_stats_start();
     status = stream_write((uint8_t *)data, size);
+    flash_stats_end(FLASH_STATS_PHASE_STREAM, start, status);
+    flash_stats_add_received(size);
     vfs_mngr_printf("    stream_write ret=%i\r\n", status);
 
     if (ERROR_SUCCESS_DONE == status) {
         // Override status so ERROR_SUCCESS_DONE
         // does not get passed into transfer_update_state
+        start = flash_stats_start();
         status = stream_close();
+        flash_stats_end(FLASH_STATS_PHASE_STREAM, start, status);
         vfs_mngr_printf("    stream_close ret=%i\r\n", status);
         file_transfer_state.stream_open = false;
         file_transfer_state.stream_finished = true;
@@ -735,6 +1173,7 @@ static void transfer_update_state(error_t status)
     bool transfer_started;
     bool transfer_can_be_finished;
     bool transfer_must_be_finished;
+    bool transfer_size_reached;
     bool out_of_order_sector;
     error_t local_status = status;
     util_assert((status != ERROR_SUCCESS_DONE) &&
@@ -768,6 +1207,11 @@ static void transfer_update_state(error_t status)
     // and file processing can be considered complete
     transfer_must_be_finished = file_transfer_state.stream_finished &&
                                 file_transfer_state.file_info_optional_finish;
+    // The transfer is also finished once the stream has processed the size in
+    // the root dir, rather than waiting for the host to go idle. A host that
+    // grows the file after this point gets the transfer failed.
+    transfer_size_reached = transfer_can_be_finished &&
+                            (file_transfer_state.size_processed >= file_transfer_state.file_size);
     out_of_order_sector = false;
 
     if (file_transfer_state.last_ooo_sector != VFS_INVALID_SECTOR) {
@@ -797,8 +1241,9 @@ static void transfer_update_state(error_t status)
         }
 
         file_transfer_state.transfer_state = TRASNFER_FINISHED;
-    } else if (transfer_must_be_finished) {
+    } else if (transfer_must_be_finished || transfer_size_reached) {
         file_transfer_state.transfer_state = TRASNFER_FINISHED;
+        file_transfer_state.size_finish = !transfer_must_be_finished;
     } else if (transfer_can_be_finished) {
         file_transfer_state.transfer_state = TRANSFER_CAN_BE_FINISHED;
     } else if (transfer_started) {
@@ -817,7 +1262,9 @@ static void transfer_update_state(error_t status)
         // Close the file stream if it is open
         if (file_transfer_state.stream_open) {
             error_t close_status;
+            uint32_t start = flash_stats_start();
             close_status = stream_close();
+            flash_stats_end(FLASH_STATS_PHASE_STREAM, start, close_status);
             vfs_mngr_printf("    stream closed ret=%i\r\n", close_status);
             file_transfer_state.stream_open = false;
 
@@ -828,6 +1275,7 @@ static void transfer_update_state(error_t status)
 
         // Set the fail reason
         fail_reason = local_status;
+        vfs_user_state_changed();
         vfs_mngr_printf("    Transfer finished, status: %i=%s\r\n", fail_reason, error_get_string(fail_reason));
     }
 
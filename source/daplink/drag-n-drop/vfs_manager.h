@@ -33,6 +33,12 @@ extern "C" {
 #endif
 
 
+// Drive programming the target
+#define VFS_DRIVE_MAIN      0
+// Drive showing the configuration and status files. This is the
+// main drive when only one drive is built in.
+#define VFS_DRIVE_CONFIG    (VFS_DRIVE_COUNT - 1)
+
 extern const vfs_filename_t daplink_mode_file_name;
 
 /* Callable from anywhere */
@@ -43,6 +49,10 @@ void vfs_mngr_fs_enable(bool enabled);
 // Remount the virtual filesystem
 void vfs_mngr_fs_remount(void);
 
+// Remount only the drive with the configuration files so a
+// transfer on the main drive is not interrupted
+void vfs_mngr_config_remount(void);
+
 
 /* Callable only from the thread running the virtual fs */
 
@@ -65,12 +75,20 @@ error_t vfs_mngr_get_transfer_status(void);
 // Build the filesystem by calling vfs_init and then adding files with vfs_create_file
 void vfs_user_build_filesystem(void);
 
+// Build the filesystem of VFS_DRIVE_CONFIG. Only called when
+// there is more than one drive.
+void vfs_user_build_config_filesystem(void);
+
 // Called when a file on the filesystem changes
 void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data);
 
 // Called when VFS is disconnecting
 void vfs_user_disconnecting(void);
 
+// Called when the config, assert or transfer status shown
+// in the generated files changes
+void vfs_user_state_changed(void);
+
 
 #ifdef __cplusplus
 }
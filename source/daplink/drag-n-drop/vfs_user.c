@@ -38,12 +38,29 @@
 #include "cortex_m.h"
 #include "target_board.h"
 #include "flash_manager.h"
+#include "flash_stats.h"
+#include "target_dump.h"
+#include "serial_capture.h"
 
 //! @brief Size in bytes of the virtual disk.
 //!
 //! Must be bigger than 4x the flash size of the biggest supported
 //! device.  This is to accomodate for hex file programming.
+#ifndef VFS_DISK_SIZE
 #define VFS_DISK_SIZE (MB(64))
+#endif
+// The drive must be FAT16 with VFS_CLUSTER_SIZE clusters
+COMPILER_ASSERT(VFS_DISK_SIZE / VFS_CLUSTER_SIZE >= VFS_CLUSTERS_MIN);
+COMPILER_ASSERT(VFS_DISK_SIZE / VFS_CLUSTER_SIZE <= VFS_CLUSTERS_MAX);
+
+//! @brief Size in bytes of the configuration drive.
+//!
+//! Only used when the configuration files have a drive of their own.
+#ifndef VFS_CONFIG_DISK_SIZE
+#define VFS_CONFIG_DISK_SIZE (VFS_CLUSTERS_MIN * VFS_CLUSTER_SIZE)
+#endif
+COMPILER_ASSERT(VFS_CONFIG_DISK_SIZE / VFS_CLUSTER_SIZE >= VFS_CLUSTERS_MIN);
+COMPILER_ASSERT(VFS_CONFIG_DISK_SIZE / VFS_CLUSTER_SIZE <= VFS_CLUSTERS_MAX);
 
 //! @brief Constants for magic action or config files.
 //!
@@ -91,10 +108,15 @@ static const char mbed_redirect_file[] =
     "</body>\r\n"
     "</html>\r\n";
 
+static const char need_bl_file[] =
+    "A bootloader update was started but unable to complete.\r\n"
+    "Reload the bootloader to fix this error message.\r\n";
+
 static const char error_prefix[] = "error: ";
 static const char error_type_prefix[] = "type: ";
 
 static const vfs_filename_t assert_file = "ASSERT  TXT";
+static const vfs_filename_t config_drive_name = "DAPLINK_CFG";
 
 //! @brief Table of magic files and their names.
 static const magic_file_info_t s_magic_file_info[] = {
@@ -114,13 +136,68 @@ static const magic_file_info_t s_magic_file_info[] = {
         { "PAGE_OFFACT", kChipEraseActionFile       },
     };
 
-static uint8_t file_buffer[VFS_SECTOR_SIZE];
+//! @brief Index of each generated file in #file_cache.
+typedef enum _cached_file {
+    kMbedHtmFile,
+    kDetailsTxtFile,
+    kFailTxtFile,
+    kAssertTxtFile,
+} cached_file_t;
+
+//! @brief Rendered contents of a generated file.
+//!
+//! Files are rendered into #file_buffer the first time they are needed in a
+//! generation and read back from there until the generation changes. A
+//! change to the config, asserts or transfer status starts a new generation
+//! on every drive, see vfs_user_state_changed(). Remounting a drive starts
+//! a new generation of that drive for the target info and remount count.
+typedef struct _file_cache {
+    uint32_t (*render)(uint8_t *data, uint32_t datasize);
+    uint32_t offset;        //!< Offset of the file's space in #file_buffer.
+    uint32_t max_size;      //!< Space the file may need, including the null terminator.
+    uint32_t drive;         //!< Drive the file is on.
+    uint32_t generation;    //!< Generation the contents were rendered in, 0 if none.
+    uint32_t size;          //!< Size of the contents.
+} file_cache_t;
+
+static uint32_t update_html_file(uint8_t *data, uint32_t datasize);
+static uint32_t update_details_txt_file(uint8_t *data, uint32_t datasize);
+static uint32_t update_fail_txt_file(uint8_t *data, uint32_t datasize);
+static uint32_t update_assert_txt_file(uint8_t *data, uint32_t datasize);
+
+// Each file has its own space in #file_buffer, so reading one
+// never drops another that is still being read
+#define MBED_HTM_SIZE       VFS_SECTOR_SIZE
+#define DETAILS_TXT_SIZE    (VFS_SECTOR_SIZE * 2)
+// Longest the last transfer section of DETAILS.TXT can be, with every
+// number at 10 digits and every phase name at 7 characters
+#define DETAILS_TXT_LAST_TRANSFER_MAX   (19 + 28 + 30 + 34 + FLASH_STATS_PHASE_COUNT * 31 + 30 + 34 + 32 + 23)
+#define FAIL_TXT_SIZE       VFS_SECTOR_SIZE
+#define ASSERT_TXT_SIZE     VFS_SECTOR_SIZE
+
+#define MBED_HTM_OFFSET     0
+#define DETAILS_TXT_OFFSET  (MBED_HTM_OFFSET + MBED_HTM_SIZE)
+#define FAIL_TXT_OFFSET     (DETAILS_TXT_OFFSET + DETAILS_TXT_SIZE)
+#define ASSERT_TXT_OFFSET   (FAIL_TXT_OFFSET + FAIL_TXT_SIZE)
+#define FILE_BUFFER_SIZE    (ASSERT_TXT_OFFSET + ASSERT_TXT_SIZE)
+
+static file_cache_t file_cache[] = {
+    [kMbedHtmFile]    = { update_html_file,         MBED_HTM_OFFSET,    MBED_HTM_SIZE,      VFS_DRIVE_MAIN },
+    [kDetailsTxtFile] = { update_details_txt_file,  DETAILS_TXT_OFFSET, DETAILS_TXT_SIZE,   VFS_DRIVE_CONFIG },
+    [kFailTxtFile]    = { update_fail_txt_file,     FAIL_TXT_OFFSET,    FAIL_TXT_SIZE,      VFS_DRIVE_MAIN },
+    [kAssertTxtFile]  = { update_assert_txt_file,   ASSERT_TXT_OFFSET,  ASSERT_TXT_SIZE,    VFS_DRIVE_CONFIG },
+};
+
+// Holds the contents of all cached files
+static uint8_t file_buffer[FILE_BUFFER_SIZE];
+static uint32_t file_generation[VFS_DRIVE_COUNT];
 static char assert_buf[64 + 1];
 static uint16_t assert_line;
 static assert_source_t assert_source;
 static uint32_t remount_count;
 
-static uint32_t get_file_size(vfs_read_cb_t read_func);
+static const uint8_t *get_cached_file(cached_file_t file, uint32_t *size);
+static uint32_t read_cached_file(cached_file_t file, uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
 
 static uint32_t read_file_mbed_htm(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
 static uint32_t read_file_details_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
@@ -128,38 +205,36 @@ static uint32_t read_file_fail_txt(uint32_t sector_offset, uint8_t *data, uint32
 static uint32_t read_file_assert_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
 static uint32_t read_file_need_bl_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
 
-static uint32_t update_html_file(uint8_t *data, uint32_t datasize);
-static uint32_t update_details_txt_file(uint8_t *data, uint32_t datasize);
 static void erase_target(void);
+static void new_file_generation(uint32_t drive);
+static void create_config_files(void);
 
+static uint32_t update_details_txt_last_transfer(char *buf, uint32_t pos, uint32_t datasize);
 static uint32_t expand_info(uint8_t *buf, uint32_t bufsize);
 
 void vfs_user_build_filesystem()
 {
     uint32_t file_size;
-    vfs_file_t file_handle;
+    // Contents rendered before this remount are out of date
+    new_file_generation(VFS_DRIVE_MAIN);
+
     // Setup the filesystem based on target parameters
     vfs_init(get_daplink_drive_name(), VFS_DISK_SIZE);
     // MBED.HTM
-    file_size = get_file_size(read_file_mbed_htm);
+    get_cached_file(kMbedHtmFile, &file_size);
     vfs_create_file(get_daplink_url_name(), read_file_mbed_htm, 0, file_size);
-    // DETAILS.TXT
-    file_size = get_file_size(read_file_details_txt);
-    vfs_create_file("DETAILS TXT", read_file_details_txt, 0, file_size);
+
+    // DETAILS.TXT, ASSERT.TXT and SERIAL.TXT
+    if (VFS_DRIVE_CONFIG == VFS_DRIVE_MAIN) {
+        create_config_files();
+    }
 
     // FAIL.TXT
     if (vfs_mngr_get_transfer_status() != ERROR_SUCCESS) {
-        file_size = get_file_size(read_file_fail_txt);
+        get_cached_file(kFailTxtFile, &file_size);
         vfs_create_file("FAIL    TXT", read_file_fail_txt, 0, file_size);
     }
 
-    // ASSERT.TXT
-    if (config_ram_get_assert(assert_buf, sizeof(assert_buf), &assert_line, &assert_source)) {
-        file_size = get_file_size(read_file_assert_txt);
-        file_handle = vfs_create_file(assert_file, read_file_assert_txt, 0, file_size);
-        vfs_file_set_attr(file_handle, (vfs_file_attr_bit_t)0); // Remove read only attribute
-    }
-
     // NEED_BL.TXT
     volatile uint32_t bl_start = DAPLINK_ROM_BL_START; // Silence warnings about null pointer
     volatile uint32_t if_start = DAPLINK_ROM_IF_START; // Silence warnings about null pointer
@@ -170,9 +245,29 @@ void vfs_user_build_filesystem()
         // If the bootloader contains a copy of the interfaces vector table
         // then an error occurred when updating so warn that the bootloader is
         // missing.
-        file_size = get_file_size(read_file_need_bl_txt);
+        file_size = strlen(need_bl_file);
         vfs_create_file("NEED_BL TXT", read_file_need_bl_txt, 0, file_size);
     }
+
+    // FLASH.BIN and RAM.BIN
+    target_dump_create_files();
+}
+
+void vfs_user_build_config_filesystem(void)
+{
+    new_file_generation(VFS_DRIVE_CONFIG);
+    vfs_init(config_drive_name, VFS_CONFIG_DISK_SIZE);
+    create_config_files();
+}
+
+// Default when the target memory files are not built in.
+__WEAK void target_dump_create_files(void)
+{
+}
+
+// Default when the serial capture is not built in.
+__WEAK void serial_capture_create_files(void)
+{
 }
 
 // Default file change hook.
@@ -211,6 +306,7 @@ void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change
 
     else if (VFS_FILE_CREATED == change) {
         bool do_remount = true; // Almost all magic files cause a remount.
+        bool config_only = false; // Remount only the drive showing the config
         int32_t which_magic_file = -1;
 
         // Let the hook examine the filename. If it returned false then look for the standard
@@ -240,27 +336,34 @@ void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change
                         break;
                     case kRefreshActionFile:
                         // Remount to update the drive
+                        config_only = true;
                         break;
                     case kEraseActionFile:
                         erase_target();
                         break;
                     case kAutoResetConfigFile:
                         config_set_auto_rst(true);
+                        config_only = true;
                         break;
                     case kHardResetConfigFile:
                         config_set_auto_rst(false);
+                        config_only = true;
                         break;
                     case kAutomationOnConfigFile:
                         config_set_automation_allowed(true);
+                        config_only = true;
                         break;
                     case kAutomationOffConfigFile:
                         config_set_automation_allowed(false);
+                        config_only = true;
                         break;
                     case kOverflowOnConfigFile:
                         config_set_overflow_detect(true);
+                        config_only = true;
                         break;
                     case kOverflowOffConfigFile:
                         config_set_overflow_detect(false);
+                        config_only = true;
                         break;
                     case kMSDOnConfigFile:
                         config_ram_set_disable_msd(false);
@@ -270,9 +373,11 @@ void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change
                         break;
                     case kPageEraseActionFile:
                         config_ram_set_page_erase(true);
+                        config_only = true;
                         break;
                     case kChipEraseActionFile:
                         config_ram_set_page_erase(false);
+                        config_only = true;
                         break;
                     default:
                         util_assert(false);
@@ -281,10 +386,17 @@ void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change
             else {
                 do_remount = false;
             }
+
+            // The magic files change what the generated files show
+            if (which_magic_file != -1) {
+                vfs_user_state_changed();
+            }
         }
 
         // Remount if requested.
-        if (do_remount) {
+        if (do_remount && config_only) {
+            vfs_mngr_config_remount();
+        } else if (do_remount) {
             vfs_mngr_fs_remount();
         }
     }
@@ -293,7 +405,8 @@ void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change
         if (!memcmp(filename, assert_file, sizeof(vfs_filename_t))) {
             // Clear assert and remount to update the drive
             util_assert_clear();
-            vfs_mngr_fs_remount();
+            vfs_user_state_changed();
+            vfs_mngr_config_remount();
         }
     }
 }
@@ -313,33 +426,87 @@ void vfs_user_disconnecting()
     remount_count++;
 }
 
-// Get the filesize from a filesize callback.
-// The file data must be null terminated for this to work correctly.
-static uint32_t get_file_size(vfs_read_cb_t read_func)
+void vfs_user_state_changed(void)
 {
-    // Determine size of the file by faking a read
-    return read_func(0, file_buffer, 1);
+    uint32_t drive;
+
+    for (drive = 0; drive < VFS_DRIVE_COUNT; drive++) {
+        new_file_generation(drive);
+    }
 }
 
-// File callback to be used with vfs_add_file to return file contents
-static uint32_t read_file_mbed_htm(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+// Start a new generation of the files on a drive
+static void new_file_generation(uint32_t drive)
 {
-    if (sector_offset != 0) {
-        return 0;
+    file_generation[drive]++;
+
+    if (0 == file_generation[drive]) {
+        file_generation[drive] = 1;
+    }
+}
+
+// Add the files showing the configuration and status of DAPLink
+static void create_config_files(void)
+{
+    uint32_t file_size;
+    vfs_file_t file_handle;
+
+    // DETAILS.TXT
+    get_cached_file(kDetailsTxtFile, &file_size);
+    vfs_create_file("DETAILS TXT", read_file_details_txt, 0, file_size);
+
+    // ASSERT.TXT
+    if (config_ram_get_assert(assert_buf, sizeof(assert_buf), &assert_line, &assert_source)) {
+        get_cached_file(kAssertTxtFile, &file_size);
+        file_handle = vfs_create_file(assert_file, read_file_assert_txt, 0, file_size);
+        vfs_file_set_attr(file_handle, (vfs_file_attr_bit_t)0); // Remove read only attribute
     }
 
-    return update_html_file(data, VFS_SECTOR_SIZE);
+    // SERIAL.TXT, on the config drive so refreshing it does not
+    // interrupt a copy to the programming drive
+    serial_capture_create_files();
 }
 
-// File callback to be used with vfs_add_file to return file contents
-static uint32_t read_file_details_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+// Get the contents of a generated file, rendering it if
+// this has not been done since the last remount.
+static const uint8_t *get_cached_file(cached_file_t file, uint32_t *size)
 {
+    file_cache_t *entry = &file_cache[file];
 
-    if (sector_offset != 0) {
+    if (entry->generation != file_generation[entry->drive]) {
+        entry->size = entry->render(file_buffer + entry->offset, entry->max_size);
+        entry->generation = file_generation[entry->drive];
+    }
+
+    *size = entry->size;
+    return file_buffer + entry->offset;
+}
+
+static uint32_t read_cached_file(cached_file_t file, uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    uint32_t size;
+    uint32_t offset = sector_offset * VFS_SECTOR_SIZE;
+    const uint8_t *contents = get_cached_file(file, &size);
+
+    if (offset >= size) {
         return 0;
     }
 
-    return update_details_txt_file(data, VFS_SECTOR_SIZE);
+    size = MIN(size - offset, num_sectors * VFS_SECTOR_SIZE);
+    memcpy(data, contents + offset, size);
+    return size;
+}
+
+// File callback to be used with vfs_add_file to return file contents
+static uint32_t read_file_mbed_htm(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_cached_file(kMbedHtmFile, sector_offset, data, num_sectors);
+}
+
+// File callback to be used with vfs_add_file to return file contents
+static uint32_t read_file_details_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_cached_file(kDetailsTxtFile, sector_offset, data, num_sectors);
 }
 
 // Text representation of each error type, starting from the rightmost bit
@@ -355,6 +522,11 @@ COMPILER_ASSERT(1 << ARRAY_SIZE(error_type_names) == ERROR_TYPE_MASK + 1);
 
 // File callback to be used with vfs_add_file to return file contents
 static uint32_t read_file_fail_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_cached_file(kFailTxtFile, sector_offset, data, num_sectors);
+}
+
+static uint32_t update_fail_txt_file(uint8_t *data, uint32_t datasize)
 {
     uint32_t size = 0;
     char *buf = (char *)data;
@@ -362,10 +534,6 @@ static uint32_t read_file_fail_txt(uint32_t sector_offset, uint8_t *data, uint32
     const char *contents = error_get_string(status);
     error_type_t type = error_get_type(status);
 
-    if (sector_offset != 0) {
-        return 0;
-    }
-
     size += util_write_string(buf + size, error_prefix);
     size += util_write_string(buf + size, contents);
     size += util_write_string(buf + size, "\r\n");
@@ -387,11 +555,24 @@ static uint32_t read_file_fail_txt(uint32_t sector_offset, uint8_t *data, uint32
     }
 
     size += util_write_string(buf + size, "\r\n");
+
+    // Programming step that was running when the error occurred
+    if (flash_stats_get()->failed_phase != FLASH_STATS_PHASE_NONE) {
+        size += util_write_string(buf + size, "Failed phase: ");
+        size += util_write_string(buf + size, flash_stats_phase_name(flash_stats_get()->failed_phase));
+        size += util_write_string(buf + size, "\r\n");
+    }
+
     return size;
 }
 
 // File callback to be used with vfs_add_file to return file contents
 static uint32_t read_file_assert_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_cached_file(kAssertTxtFile, sector_offset, data, num_sectors);
+}
+
+static uint32_t update_assert_txt_file(uint8_t *data, uint32_t datasize)
 {
     uint32_t pos;
     const char *source_str;
@@ -400,10 +581,6 @@ static uint32_t read_file_assert_txt(uint32_t sector_offset, uint8_t *data, uint
     uint8_t valid_hexdumps = 0;
     uint8_t index = 0;
 
-    if (sector_offset != 0) {
-        return 0;
-    }
-
     pos = 0;
 
     if (ASSERT_SOURCE_BL == assert_source) {
@@ -432,7 +609,7 @@ static uint32_t read_file_assert_txt(uint32_t sector_offset, uint8_t *data, uint
     if ((valid_hexdumps > 0) && (hexdumps != 0)) {
         //print hexdumps
         pos += util_write_string(buf + pos, "Hexdumps\r\n");
-        while ((index < valid_hexdumps) && ((pos + 10) < VFS_SECTOR_SIZE)) { //hexdumps + newline is always 10 characters
+        while ((index < valid_hexdumps) && ((pos + 10) < datasize)) { //hexdumps + newline is always 10 characters
             pos += util_write_hex32(buf + pos, hexdumps[index++]);
             pos += util_write_string(buf + pos, "\r\n");
         }
@@ -444,15 +621,13 @@ static uint32_t read_file_assert_txt(uint32_t sector_offset, uint8_t *data, uint
 // File callback to be used with vfs_add_file to return file contents
 static uint32_t read_file_need_bl_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
 {
-    const char *contents = "A bootloader update was started but unable to complete.\r\n"
-                           "Reload the bootloader to fix this error message.\r\n";
-    uint32_t size = strlen(contents);
+    uint32_t size = strlen(need_bl_file);
 
     if (sector_offset != 0) {
         return 0;
     }
 
-    memcpy(data, contents, size);
+    memcpy(data, need_bl_file, size);
     return size;
 }
 
@@ -561,9 +736,65 @@ static uint32_t update_details_txt_file(uint8_t *data, uint32_t datasize)
     //Target URL
     pos += util_write_string(buf + pos, "URL: @R\r\n");
 
+    // Where the time of the last drag-n-drop transfer went
+    pos = update_details_txt_last_transfer(buf, pos, datasize);
+
     return expand_info(data, datasize);
 }
 
+static uint32_t update_details_txt_last_transfer(char *buf, uint32_t pos, uint32_t datasize)
+{
+    uint32_t i;
+    const flash_stats_t *stats = flash_stats_get();
+
+    // The writes below are unbounded, so leave the section
+    // out rather than overflow when it might not fit
+    if (pos + DETAILS_TXT_LAST_TRANSFER_MAX >= datasize) {
+        return pos;
+    }
+
+    pos += util_write_string(buf + pos, "\r\n# Last transfer\r\n");
+    pos += util_write_string(buf + pos, "Bytes received: ");
+    pos += util_write_uint32(buf + pos, stats->bytes_received);
+    pos += util_write_string(buf + pos, "\r\n");
+    pos += util_write_string(buf + pos, "Bytes programmed: ");
+    pos += util_write_uint32(buf + pos, stats->bytes_programmed);
+    pos += util_write_string(buf + pos, "\r\n");
+    // Erased pages that the last transfer did not need to program
+    pos += util_write_string(buf + pos, "Skipped erased bytes: ");
+    pos += util_write_uint32(buf + pos, flash_manager_get_skipped_size());
+    pos += util_write_string(buf + pos, "\r\n");
+
+    for (i = 0; i < FLASH_STATS_PHASE_COUNT; i++) {
+        pos += util_write_string(buf + pos, flash_stats_phase_name((flash_stats_phase_t)i));
+        pos += util_write_string(buf + pos, " time (us): ");
+        pos += util_write_uint32(buf + pos, stats->time_us[i]);
+        pos += util_write_string(buf + pos, "\r\n");
+    }
+
+    pos += util_write_string(buf + pos, "Flash algo calls: ");
+    pos += util_write_uint32(buf + pos, stats->syscall_count);
+    pos += util_write_string(buf + pos, "\r\n");
+    pos += util_write_string(buf + pos, "Flash algo time (us): ");
+    pos += util_write_uint32(buf + pos, stats->syscall_time_us);
+    pos += util_write_string(buf + pos, "\r\n");
+
+    if (stats->time_us[FLASH_STATS_PHASE_PROGRAM] > 0) {
+        pos += util_write_string(buf + pos, "Program rate (B/s): ");
+        pos += util_write_uint32(buf + pos, (uint32_t)((uint64_t)stats->bytes_programmed * 1000000 /
+                                             stats->time_us[FLASH_STATS_PHASE_PROGRAM]));
+        pos += util_write_string(buf + pos, "\r\n");
+    }
+
+    if (stats->failed_phase != FLASH_STATS_PHASE_NONE) {
+        pos += util_write_string(buf + pos, "Failed phase: ");
+        pos += util_write_string(buf + pos, flash_stats_phase_name(stats->failed_phase));
+        pos += util_write_string(buf + pos, "\r\n");
+    }
+
+    return pos;
+}
+
 // Fill buf with the contents of the mbed redirect file by
 // expanding the special characters in mbed_redirect_file.
 static uint32_t expand_info(uint8_t *buf, uint32_t bufsize)
@@ -33,10 +33,6 @@
 //   - data written cannot be read back
 //   - data should only be read once
 
-// FAT16 limitations +- safety margin
-#define FAT_CLUSTERS_MAX (65525 - 100)
-#define FAT_CLUSTERS_MIN (4086 + 100)
-
 typedef struct {
     uint8_t boot_sector[11];
     /* DOS 2.0 BPB - Bios Parameter Block, 11 bytes */
@@ -71,10 +67,6 @@ typedef struct {
     uint16_t signature;
 } __attribute__((packed)) mbr_t;
 
-typedef struct file_allocation_table {
-    uint8_t f[512];
-} file_allocation_table_t;
-
 typedef struct FatDirectoryEntry {
     vfs_filename_t filename;
     uint8_t attributes;
@@ -94,6 +86,13 @@ COMPILER_ASSERT(sizeof(FatDirectoryEntry_t) == 32);
 // to save RAM all files must be in the first root dir entry (512 bytes)
 //  but 2 actually exist on disc (32 entries) to accomodate hidden OS files,
 //  folders and metadata
+// The clusters of a file. Files are contiguous so the FAT
+// is generated from these when it is read.
+typedef struct fat_chain {
+    uint32_t first_cluster;
+    uint32_t last_cluster;
+} fat_chain_t;
+
 typedef struct root_dir {
     FatDirectoryEntry_t f[32];
 } root_dir_t;
@@ -104,12 +103,34 @@ typedef struct virtual_media {
     uint32_t length;
 } virtual_media_t;
 
+// State of one drive
+typedef struct vfs_drive {
+    mbr_t mbr;
+    virtual_media_t virtual_media[16];
+    root_dir_t dir_current;
+    uint8_t file_count;
+    vfs_file_change_cb_t file_change_cb;
+    uint32_t virtual_media_idx;
+    uint32_t fat_idx;
+    uint32_t dir_idx;
+    uint32_t data_start;
+    fat_chain_t fat_chains[VFS_MAX_FILES];
+    uint32_t fat_chain_count;
+    // First sector of each metadata region
+    uint32_t fat1_sector;
+    uint32_t fat2_sector;
+    uint32_t dir_sector;
+    uint32_t data_sector;
+    // Number of clusters in the data region
+    uint32_t cluster_count;
+} vfs_drive_t;
+
 static uint32_t read_zero(uint32_t offset, uint8_t *data, uint32_t size);
 static void write_none(uint32_t offset, const uint8_t *data, uint32_t size);
 
-static uint32_t read_mbr(uint32_t offset, uint8_t *data, uint32_t size);
-static uint32_t read_fat(uint32_t offset, uint8_t *data, uint32_t size);
-static uint32_t read_dir(uint32_t offset, uint8_t *data, uint32_t size);
+static void read_metadata_sector(uint32_t sector, uint8_t *data);
+static void read_fat_sector(uint32_t fat_sector, uint8_t *data);
+static void read_dir_sector(uint32_t dir_sector, uint8_t *data);
 static void write_dir(uint32_t offset, const uint8_t *data, uint32_t size);
 static void file_change_cb_stub(const vfs_filename_t filename, vfs_file_change_t change,
                                 vfs_file_t file, vfs_file_t new_file_data);
@@ -119,6 +140,10 @@ static bool filename_character_valid(char character);
 
 // If sector size changes update comment below
 COMPILER_ASSERT(0x0200 == VFS_SECTOR_SIZE);
+// Cluster size must be a power of two number of sectors, at most 32KB
+COMPILER_ASSERT((VFS_CLUSTER_SIZE % VFS_SECTOR_SIZE) == 0);
+COMPILER_ASSERT((VFS_CLUSTER_SIZE & (VFS_CLUSTER_SIZE - 1)) == 0);
+COMPILER_ASSERT(VFS_CLUSTER_SIZE <= 0x8000);
 // If root directory size changes update max_root_dir_entries
 COMPILER_ASSERT(0x0020 == sizeof(root_dir_t) / sizeof(FatDirectoryEntry_t));
 static const mbr_t mbr_tmpl = {
@@ -127,17 +152,17 @@ static const mbr_t mbr_tmpl = {
         'M', 'S', 'D', '0', 'S', '4', '.', '1' // OEM Name in text (8 chars max)
     },
     /*uint16_t*/.bytes_per_sector           = 0x0200,       // 512 bytes per sector
-    /*uint8_t */.sectors_per_cluster        = 0x08,         // 4k cluser
+    /*uint8_t */.sectors_per_cluster        = VFS_CLUSTER_SIZE / 0x0200,
     /*uint16_t*/.reserved_logical_sectors   = 0x0001,       // mbr is 1 sector
     /*uint8_t */.num_fats                   = 0x02,         // 2 FATs
     /*uint16_t*/.max_root_dir_entries       = 0x0020,       // 32 dir entries (max)
-    /*uint16_t*/.total_logical_sectors      = 0x1f50,       // sector size * # of sectors = drive size
+    /*uint16_t*/.total_logical_sectors      = 0x0000,       // Set at runtime from the drive size
     /*uint8_t */.media_descriptor           = 0xf8,         // fixed disc = F8, removable = F0
-    /*uint16_t*/.logical_sectors_per_fat    = 0x0001,       // FAT is 1k - ToDO:need to edit this
+    /*uint16_t*/.logical_sectors_per_fat    = 0x0000,       // Set at runtime from the number of clusters
     /*uint16_t*/.physical_sectors_per_track = 0x0001,       // flat
     /*uint16_t*/.heads                      = 0x0001,       // flat
     /*uint32_t*/.hidden_sectors             = 0x00000000,   // before mbt, 0
-    /*uint32_t*/.big_sectors_on_drive       = 0x00000000,   // 4k sector. not using large clusters
+    /*uint32_t*/.big_sectors_on_drive       = 0x00000000,   // Set at runtime if total_logical_sectors does not fit
     /*uint8_t */.physical_drive_number      = 0x00,
     /*uint8_t */.not_used                   = 0x00,         // Current head. Linux tries to set this to 0x1
     /*uint8_t */.boot_record_signature      = 0x29,         // signature is present
@@ -247,12 +272,14 @@ enum virtual_media_idx_t {
 };
 
 // Note - everything in virtual media must be a multiple of VFS_SECTOR_SIZE
+// Reads of the MBR, FATs and root directory are served by vfs_read from
+// mbr, fat_chains and dir_current, see read_metadata_sector.
 const virtual_media_t virtual_media_tmpl[] = {
     /*  Read CB         Write CB        Region Size                 Region Name     */
-    {   read_mbr,       write_none,     VFS_SECTOR_SIZE         },  /* MBR          */
-    {   read_fat,       write_none,     0 /* Set at runtime */  },  /* FAT1         */
-    {   read_fat,       write_none,     0 /* Set at runtime */  },  /* FAT2         */
-    {   read_dir,       write_dir,      VFS_SECTOR_SIZE * 2     },  /* Root Dir     */
+    {   read_zero,      write_none,     VFS_SECTOR_SIZE         },  /* MBR          */
+    {   read_zero,      write_none,     0 /* Set at runtime */  },  /* FAT1         */
+    {   read_zero,      write_none,     0 /* Set at runtime */  },  /* FAT2         */
+    {   read_zero,      write_dir,      VFS_SECTOR_SIZE * 2     },  /* Root Dir     */
     /* Raw filesystem contents follow */
 };
 // Keep virtual_media_idx_t in sync with virtual_media_tmpl
@@ -288,35 +315,26 @@ static const FatDirectoryEntry_t dir_entry_tmpl = {
     /*uint32_t*/ .filesize = 0x00000000
 };
 
-mbr_t mbr;
-file_allocation_table_t fat;
-virtual_media_t virtual_media[16];
-root_dir_t dir_current;
-uint8_t file_count;
-vfs_file_change_cb_t file_change_cb;
-uint32_t virtual_media_idx;
-uint32_t fat_idx;
-uint32_t dir_idx;
-uint32_t data_start;
+// The MBR and the root directory are kept as the exact sectors
+// sent to the host. The FAT sectors are generated from fat_chains.
+COMPILER_ASSERT(sizeof(mbr_t) == VFS_SECTOR_SIZE);
+COMPILER_ASSERT(sizeof(root_dir_t) == VFS_SECTOR_SIZE * 2);
+
+static vfs_drive_t drives[VFS_DRIVE_COUNT];
+// Drive the functions below work on
+static vfs_drive_t *drive = &drives[0];
 
 // Virtual media must be larger than the template
-COMPILER_ASSERT(sizeof(virtual_media) > sizeof(virtual_media_tmpl));
+COMPILER_ASSERT(sizeof(drives[0].virtual_media) > sizeof(virtual_media_tmpl));
 
-static void write_fat(file_allocation_table_t *fat, uint32_t idx, uint16_t val)
+void vfs_select(uint32_t drive_idx)
 {
-    uint32_t low_idx;
-    uint32_t high_idx;
-    low_idx = idx * 2 + 0;
-    high_idx = idx * 2 + 1;
-
-    // Assert that this is still within the fat table
-    if (high_idx >= ARRAY_SIZE(fat->f)) {
+    if (drive_idx >= VFS_DRIVE_COUNT) {
         util_assert(0);
         return;
     }
 
-    fat->f[low_idx] = (val >> 0) & 0xFF;
-    fat->f[high_idx] = (val >> 8) & 0xFF;
+    drive = &drives[drive_idx];
 }
 
 void vfs_init(const vfs_filename_t drive_name, uint32_t disk_size)
@@ -325,70 +343,72 @@ void vfs_init(const vfs_filename_t drive_name, uint32_t disk_size)
     uint32_t num_clusters;
     uint32_t total_sectors;
     // Clear everything
-    memset(&mbr, 0, sizeof(mbr));
-    memset(&fat, 0, sizeof(fat));
-    fat_idx = 0;
-    memset(&virtual_media, 0, sizeof(virtual_media));
-    memset(&dir_current, 0, sizeof(dir_current));
-    dir_idx = 0;
-    file_count = 0;
-    file_change_cb = file_change_cb_stub;
-    virtual_media_idx = 0;
-    data_start = 0;
+    memset(&drive->mbr, 0, sizeof(drive->mbr));
+    drive->fat_idx = 0;
+    drive->fat_chain_count = 0;
+    memset(&drive->virtual_media, 0, sizeof(drive->virtual_media));
+    memset(&drive->dir_current, 0, sizeof(drive->dir_current));
+    drive->dir_idx = 0;
+    drive->file_count = 0;
+    drive->file_change_cb = file_change_cb_stub;
+    drive->virtual_media_idx = 0;
+    drive->data_start = 0;
     // Initialize MBR
-    memcpy(&mbr, &mbr_tmpl, sizeof(mbr_t));
-    total_sectors = ((disk_size + KB(64)) / mbr.bytes_per_sector);
+    memcpy(&drive->mbr, &mbr_tmpl, sizeof(mbr_t));
+    total_sectors = ((disk_size + KB(64)) / drive->mbr.bytes_per_sector);
     // Make sure this is the right size for a FAT16 volume
-    if (total_sectors < FAT_CLUSTERS_MIN * mbr.sectors_per_cluster) {
+    if (total_sectors < VFS_CLUSTERS_MIN * drive->mbr.sectors_per_cluster) {
         util_assert(0);
-        total_sectors = FAT_CLUSTERS_MIN * mbr.sectors_per_cluster;
-    } else if (total_sectors > FAT_CLUSTERS_MAX * mbr.sectors_per_cluster) {
+        total_sectors = VFS_CLUSTERS_MIN * drive->mbr.sectors_per_cluster;
+    } else if (total_sectors > VFS_CLUSTERS_MAX * drive->mbr.sectors_per_cluster) {
         util_assert(0);
-        total_sectors = FAT_CLUSTERS_MAX * mbr.sectors_per_cluster;
+        total_sectors = VFS_CLUSTERS_MAX * drive->mbr.sectors_per_cluster;
     }
     if (total_sectors >= 0x10000) {
-        mbr.total_logical_sectors = 0;
-        mbr.big_sectors_on_drive  = total_sectors;
+        drive->mbr.total_logical_sectors = 0;
+        drive->mbr.big_sectors_on_drive  = total_sectors;
     } else {
-        mbr.total_logical_sectors = total_sectors;
-        mbr.big_sectors_on_drive  = 0;
+        drive->mbr.total_logical_sectors = total_sectors;
+        drive->mbr.big_sectors_on_drive  = 0;
     }
     // FAT table will likely be larger than needed, but this is allowed by the
-    // fat specification
-    num_clusters = total_sectors / mbr.sectors_per_cluster;
-    mbr.logical_sectors_per_fat = (num_clusters * 2 + VFS_SECTOR_SIZE - 1) / VFS_SECTOR_SIZE;
+    // fat specification. Include the two reserved entries.
+    num_clusters = total_sectors / drive->mbr.sectors_per_cluster;
+    drive->mbr.logical_sectors_per_fat = ((num_clusters + 2) * 2 + VFS_SECTOR_SIZE - 1) / VFS_SECTOR_SIZE;
     // Initailize virtual media
-    memcpy(&virtual_media, &virtual_media_tmpl, sizeof(virtual_media_tmpl));
-    virtual_media[MEDIA_IDX_FAT1].length = VFS_SECTOR_SIZE * mbr.logical_sectors_per_fat;
-    virtual_media[MEDIA_IDX_FAT2].length = VFS_SECTOR_SIZE * mbr.logical_sectors_per_fat;
+    memcpy(&drive->virtual_media, &virtual_media_tmpl, sizeof(virtual_media_tmpl));
+    drive->virtual_media[MEDIA_IDX_FAT1].length = VFS_SECTOR_SIZE * drive->mbr.logical_sectors_per_fat;
+    drive->virtual_media[MEDIA_IDX_FAT2].length = VFS_SECTOR_SIZE * drive->mbr.logical_sectors_per_fat;
     // Initialize indexes
-    virtual_media_idx = MEDIA_IDX_COUNT;
-    data_start = 0;
+    drive->virtual_media_idx = MEDIA_IDX_COUNT;
+    drive->data_start = 0;
 
     for (i = 0; i < ARRAY_SIZE(virtual_media_tmpl); i++) {
-        data_start += virtual_media[i].length;
+        drive->data_start += drive->virtual_media[i].length;
     }
 
-    // Initialize FAT
-    fat_idx = 0;
-    write_fat(&fat, fat_idx, 0xFFF8);    // Media type "media_descriptor"
-    fat_idx++;
-    write_fat(&fat, fat_idx, 0xFFFF);    // FAT12 - always 0xFFF (no meaning), FAT16 - dirty/clean (clean = 0xFFFF)
-    fat_idx++;
+    drive->fat1_sector = drive->virtual_media[MEDIA_IDX_MBR].length / VFS_SECTOR_SIZE;
+    drive->fat2_sector = drive->fat1_sector + drive->virtual_media[MEDIA_IDX_FAT1].length / VFS_SECTOR_SIZE;
+    drive->dir_sector = drive->fat2_sector + drive->virtual_media[MEDIA_IDX_FAT2].length / VFS_SECTOR_SIZE;
+    drive->data_sector = drive->data_start / VFS_SECTOR_SIZE;
+    drive->cluster_count = (total_sectors - drive->data_sector) / drive->mbr.sectors_per_cluster;
+
+    // Initialize FAT, the first two entries are reserved
+    drive->fat_idx = 2;
     // Initialize root dir
-    dir_idx = 0;
-    dir_current.f[dir_idx] = root_dir_entry;
-    memcpy(dir_current.f[dir_idx].filename, drive_name, sizeof(dir_current.f[0].filename));
-    dir_idx++;
+    drive->dir_idx = 0;
+    drive->dir_current.f[drive->dir_idx] = root_dir_entry;
+    memcpy(drive->dir_current.f[drive->dir_idx].filename, drive_name, sizeof(drive->dir_current.f[0].filename));
+    drive->dir_idx++;
 }
 
 uint32_t vfs_get_total_size()
 {
     uint32_t size;
-    if (mbr.total_logical_sectors > 0) {
-        size = mbr.total_logical_sectors * mbr.bytes_per_sector;
-    } else if (mbr.big_sectors_on_drive > 0) {
-        size = mbr.big_sectors_on_drive * mbr.bytes_per_sector;
+    if (drive->mbr.total_logical_sectors > 0) {
+        size = drive->mbr.total_logical_sectors * drive->mbr.bytes_per_sector;
+    } else if (drive->mbr.big_sectors_on_drive > 0) {
+        size = drive->mbr.big_sectors_on_drive * drive->mbr.bytes_per_sector;
     } else {
         size = 0;
         util_assert(0);
@@ -399,37 +419,41 @@ uint32_t vfs_get_total_size()
 vfs_file_t vfs_create_file(const vfs_filename_t filename, vfs_read_cb_t read_cb, vfs_write_cb_t write_cb, uint32_t len)
 {
     uint32_t first_cluster;
+    uint32_t last_cluster;
     FatDirectoryEntry_t *de;
     uint32_t clusters;
     uint32_t cluster_size;
-    uint32_t i;
     util_assert(filename_valid(filename));
     // Compute the number of clusters in the file
-    cluster_size = mbr.bytes_per_sector * mbr.sectors_per_cluster;
+    cluster_size = drive->mbr.bytes_per_sector * drive->mbr.sectors_per_cluster;
     clusters = (len + cluster_size - 1) / cluster_size;
     // Write the cluster chain to the fat table
     first_cluster = 0;
 
     if (len > 0) {
-        first_cluster = fat_idx;
+        first_cluster = drive->fat_idx;
+        last_cluster = first_cluster + clusters - 1;
 
-        for (i = 0; i < clusters - 1; i++) {
-            write_fat(&fat, fat_idx, fat_idx + 1);
-            fat_idx++;
+        if ((drive->fat_chain_count >= ARRAY_SIZE(drive->fat_chains)) ||
+                (last_cluster >= drive->cluster_count + 2)) {
+            util_assert(0);
+            return VFS_FILE_INVALID;
         }
 
-        write_fat(&fat, fat_idx, 0xFFFF);
-        fat_idx++;
+        drive->fat_chains[drive->fat_chain_count].first_cluster = first_cluster;
+        drive->fat_chains[drive->fat_chain_count].last_cluster = last_cluster;
+        drive->fat_chain_count++;
+        drive->fat_idx = last_cluster + 1;
     }
 
     // Update directory entry
-    if (dir_idx >= ARRAY_SIZE(dir_current.f)) {
+    if (drive->dir_idx >= ARRAY_SIZE(drive->dir_current.f)) {
         util_assert(0);
         return VFS_FILE_INVALID;
     }
 
-    de = &dir_current.f[dir_idx];
-    dir_idx++;
+    de = &drive->dir_current.f[drive->dir_idx];
+    drive->dir_idx++;
     memcpy(de, &dir_entry_tmpl, sizeof(dir_entry_tmpl));
     memcpy(de->filename, filename, 11);
     de->filesize = len;
@@ -437,25 +461,25 @@ vfs_file_t vfs_create_file(const vfs_filename_t filename, vfs_read_cb_t read_cb,
     de->first_cluster_low_16 = (first_cluster >> 0) & 0xFFFF;
 
     // Update virtual media
-    if (virtual_media_idx >= ARRAY_SIZE(virtual_media)) {
+    if (drive->virtual_media_idx >= ARRAY_SIZE(drive->virtual_media)) {
         util_assert(0);
         return VFS_FILE_INVALID;
     }
 
-    virtual_media[virtual_media_idx].read_cb = read_zero;
-    virtual_media[virtual_media_idx].write_cb = write_none;
+    drive->virtual_media[drive->virtual_media_idx].read_cb = read_zero;
+    drive->virtual_media[drive->virtual_media_idx].write_cb = write_none;
 
     if (0 != read_cb) {
-        virtual_media[virtual_media_idx].read_cb = read_cb;
+        drive->virtual_media[drive->virtual_media_idx].read_cb = read_cb;
     }
 
     if (0 != write_cb) {
-        virtual_media[virtual_media_idx].write_cb = write_cb;
+        drive->virtual_media[drive->virtual_media_idx].write_cb = write_cb;
     }
 
-    virtual_media[virtual_media_idx].length = clusters * mbr.bytes_per_sector * mbr.sectors_per_cluster;
-    virtual_media_idx++;
-    file_count += 1;
+    drive->virtual_media[drive->virtual_media_idx].length = clusters * drive->mbr.bytes_per_sector * drive->mbr.sectors_per_cluster;
+    drive->virtual_media_idx++;
+    drive->file_count += 1;
     return de;
 }
 
@@ -490,19 +514,33 @@ vfs_file_attr_bit_t vfs_file_get_attr(vfs_file_t file)
 
 void vfs_set_file_change_callback(vfs_file_change_cb_t cb)
 {
-    file_change_cb = cb;
+    drive->file_change_cb = cb;
 }
 
 void vfs_read(uint32_t requested_sector, uint8_t *buf, uint32_t num_sectors)
 {
     uint8_t i = 0;
     uint32_t current_sector;
+
+    // Metadata is read often by the host after each remount
+    // so build it straight from the drive state
+    while ((num_sectors > 0) && (requested_sector < drive->data_sector)) {
+        read_metadata_sector(requested_sector, buf);
+        buf += VFS_SECTOR_SIZE;
+        requested_sector++;
+        num_sectors--;
+    }
+
+    if (0 == num_sectors) {
+        return;
+    }
+
     // Zero out the buffer
     memset(buf, 0, num_sectors * VFS_SECTOR_SIZE);
-    current_sector = 0;
+    current_sector = drive->data_sector;
 
-    for (i = 0; i < ARRAY_SIZE(virtual_media); i++) {
-        uint32_t vm_sectors = virtual_media[i].length / VFS_SECTOR_SIZE;
+    for (i = MEDIA_IDX_COUNT; i < ARRAY_SIZE(drive->virtual_media); i++) {
+        uint32_t vm_sectors = drive->virtual_media[i].length / VFS_SECTOR_SIZE;
         uint32_t vm_start = current_sector;
         uint32_t vm_end = current_sector + vm_sectors;
 
@@ -512,8 +550,9 @@ void vfs_read(uint32_t requested_sector, uint8_t *buf, uint32_t num_sectors)
             uint32_t sectors_to_write = vm_end - requested_sector;
             sectors_to_write = MIN(sectors_to_write, num_sectors);
             sector_offset = requested_sector - current_sector;
-            virtual_media[i].read_cb(sector_offset, buf, sectors_to_write);
+            drive->virtual_media[i].read_cb(sector_offset, buf, sectors_to_write);
             // Update requested sector
+            buf += sectors_to_write * VFS_SECTOR_SIZE;
             requested_sector += sectors_to_write;
             num_sectors -= sectors_to_write;
         }
@@ -534,8 +573,8 @@ void vfs_write(uint32_t requested_sector, const uint8_t *buf, uint32_t num_secto
     uint32_t current_sector;
     current_sector = 0;
 
-    for (i = 0; i < virtual_media_idx; i++) {
-        uint32_t vm_sectors = virtual_media[i].length / VFS_SECTOR_SIZE;
+    for (i = 0; i < drive->virtual_media_idx; i++) {
+        uint32_t vm_sectors = drive->virtual_media[i].length / VFS_SECTOR_SIZE;
         uint32_t vm_start = current_sector;
         uint32_t vm_end = current_sector + vm_sectors;
 
@@ -545,8 +584,9 @@ void vfs_write(uint32_t requested_sector, const uint8_t *buf, uint32_t num_secto
             uint32_t sectors_to_read = vm_end - requested_sector;
             sectors_to_read = MIN(sectors_to_read, num_sectors);
             sector_offset = requested_sector - current_sector;
-            virtual_media[i].write_cb(sector_offset, buf, sectors_to_read);
+            drive->virtual_media[i].write_cb(sector_offset, buf, sectors_to_read);
             // Update requested sector
+            buf += sectors_to_read * VFS_SECTOR_SIZE;
             requested_sector += sectors_to_read;
             num_sectors -= sectors_to_read;
         }
@@ -573,55 +613,65 @@ static void write_none(uint32_t sector_offset, const uint8_t *data, uint32_t num
     // Do nothing
 }
 
-static uint32_t read_mbr(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+// Read a sector before the start of the data region
+static void read_metadata_sector(uint32_t sector, uint8_t *data)
 {
-    uint32_t read_size = sizeof(mbr_t);
-    COMPILER_ASSERT(sizeof(mbr_t) <= VFS_SECTOR_SIZE);
-
-    if (sector_offset != 0) {
-        // Don't worry about reading other sectors
-        return 0;
+    if (sector < drive->fat1_sector) {
+        memcpy(data, &drive->mbr, VFS_SECTOR_SIZE);
+    } else if (sector < drive->fat2_sector) {
+        read_fat_sector(sector - drive->fat1_sector, data);
+    } else if (sector < drive->dir_sector) {
+        read_fat_sector(sector - drive->fat2_sector, data);
+    } else if (sector < drive->data_sector) {
+        read_dir_sector(sector - drive->dir_sector, data);
+    } else {
+        util_assert(0);
     }
-
-    memcpy(data, &mbr, read_size);
-    return read_size;
 }
 
-/* No need to handle writes to the mbr */
-
-static uint32_t read_fat(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+// Each read builds the sector from fat_chains. This is intended: a FAT for
+// the largest drive takes up to 128KB, far more than the RAM of any HIC,
+// while a sector is built with one pass over at most VFS_MAX_FILES chains.
+static void read_fat_sector(uint32_t fat_sector, uint8_t *data)
 {
-    uint32_t read_size = sizeof(file_allocation_table_t);
-    COMPILER_ASSERT(sizeof(file_allocation_table_t) <= VFS_SECTOR_SIZE);
+    const uint32_t entries = VFS_SECTOR_SIZE / 2;
+    uint32_t first = fat_sector * entries;
+    uint32_t i;
+    uint32_t idx;
+
+    memset(data, 0, VFS_SECTOR_SIZE);
 
-    if (sector_offset != 0) {
-        // Don't worry about reading other sectors
-        return 0;
+    if (0 == fat_sector) {
+        data[0] = drive->mbr.media_descriptor;     // Media type in the low byte
+        data[1] = 0xFF;
+        data[2] = 0xFF;                     // FAT16 - dirty/clean (clean = 0xFFFF)
+        data[3] = 0xFF;
     }
 
-    memcpy(data, &fat, read_size);
-    return read_size;
-}
+    for (i = 0; i < drive->fat_chain_count; i++) {
+        uint32_t start = MAX(drive->fat_chains[i].first_cluster, first);
+        uint32_t end = MIN(drive->fat_chains[i].last_cluster, first + entries - 1);
 
-/* No need to handle writes to the fat */
+        for (idx = start; idx <= end; idx++) {
+            uint16_t val = idx == drive->fat_chains[i].last_cluster ? 0xFFFF : idx + 1;
+            data[(idx - first) * 2 + 0] = (val >> 0) & 0xFF;
+            data[(idx - first) * 2 + 1] = (val >> 8) & 0xFF;
+        }
+    }
+}
 
-static uint32_t read_dir(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+// Only the entries created by DAPLink are shown. Entries written by the host
+// point at clusters the FAT does not have, since FAT writes are discarded.
+static void read_dir_sector(uint32_t dir_sector, uint8_t *data)
 {
-    if ((sector_offset + num_sectors) * VFS_SECTOR_SIZE > sizeof(dir_current)) {
-        // Trying to read too much of the root directory
-        util_assert(0);
-        return 0;
-    }
+    uint32_t offset = dir_sector * VFS_SECTOR_SIZE;
+    uint32_t size = drive->dir_idx * sizeof(FatDirectoryEntry_t);
 
-    // Zero buffer data is VFS_SECTOR_SIZE max
     memset(data, 0, VFS_SECTOR_SIZE);
 
-    if (sector_offset == 0) { //Handle the first 512 bytes
-        // Copy data that is actually created in the directory
-        memcpy(data, &dir_current.f[0], dir_idx*sizeof(FatDirectoryEntry_t));
+    if (offset < size) {
+        memcpy(data, (uint8_t *)&drive->dir_current + offset, MIN(size - offset, VFS_SECTOR_SIZE));
     }
-
-    return num_sectors * VFS_SECTOR_SIZE;
 }
 
 static void write_dir(uint32_t sector_offset, const uint8_t *data, uint32_t num_sectors)
@@ -632,7 +682,7 @@ static void write_dir(uint32_t sector_offset, const uint8_t *data, uint32_t num_
     uint32_t num_entries;
     uint32_t i;
 
-    if ((sector_offset + num_sectors) * VFS_SECTOR_SIZE > sizeof(dir_current)) {
+    if ((sector_offset + num_sectors) * VFS_SECTOR_SIZE > sizeof(drive->dir_current)) {
         // Trying to write too much of the root directory
         util_assert(0);
         return;
@@ -640,7 +690,7 @@ static void write_dir(uint32_t sector_offset, const uint8_t *data, uint32_t num_
 
     start_index = sector_offset * VFS_SECTOR_SIZE / sizeof(FatDirectoryEntry_t);
     num_entries = num_sectors * VFS_SECTOR_SIZE / sizeof(FatDirectoryEntry_t);
-    old_entry = &dir_current.f[start_index];
+    old_entry = &drive->dir_current.f[start_index];
     new_entry = (FatDirectoryEntry_t *)data;
     // If this is the first sector start at index 1 to get past drive name
     i = 0 == sector_offset ? 1 : 0;
@@ -655,22 +705,22 @@ static void write_dir(uint32_t sector_offset, const uint8_t *data, uint32_t num_
         // If were at this point then something has changed in the file
         same_name = (0 == memcmp(old_entry[i].filename, new_entry[i].filename, sizeof(new_entry[i].filename))) ? 1 : 0;
         // Changed
-        file_change_cb(new_entry[i].filename, VFS_FILE_CHANGED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
+        drive->file_change_cb(new_entry[i].filename, VFS_FILE_CHANGED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
 
         // Deleted
         if (0xe5 == (uint8_t)new_entry[i].filename[0]) {
-            file_change_cb(old_entry[i].filename, VFS_FILE_DELETED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
+            drive->file_change_cb(old_entry[i].filename, VFS_FILE_DELETED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
             continue;
         }
 
         // Created
         if (!same_name && filename_valid(new_entry[i].filename)) {
-            file_change_cb(new_entry[i].filename, VFS_FILE_CREATED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
+            drive->file_change_cb(new_entry[i].filename, VFS_FILE_CREATED, (vfs_file_t)&old_entry[i], (vfs_file_t)&new_entry[i]);
             continue;
         }
     }
 
-    memcpy(&dir_current.f[start_index], data, num_sectors * VFS_SECTOR_SIZE);
+    memcpy(&drive->dir_current.f[start_index], data, num_sectors * VFS_SECTOR_SIZE);
 }
 
 static void file_change_cb_stub(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data)
@@ -680,8 +730,8 @@ static void file_change_cb_stub(const vfs_filename_t filename, vfs_file_change_t
 
 static uint32_t cluster_to_sector(uint32_t cluster_idx)
 {
-    uint32_t sectors_before_data = data_start / mbr.bytes_per_sector;
-    return sectors_before_data + (cluster_idx - 2) * mbr.sectors_per_cluster;
+    uint32_t sectors_before_data = drive->data_start / drive->mbr.bytes_per_sector;
+    return sectors_before_data + (cluster_idx - 2) * drive->mbr.sectors_per_cluster;
 }
 
 static bool filename_valid(const vfs_filename_t  filename)
@@ -28,12 +28,27 @@
 extern "C" {
 #endif
 
+// Cluster size of the drive. Larger clusters let the drive hold
+// larger files and mean fewer FAT updates from the host.
+#ifndef VFS_CLUSTER_SIZE
 #define VFS_CLUSTER_SIZE        0x1000
+#endif
 #define VFS_SECTOR_SIZE         512
 #define VFS_INVALID_SECTOR      0xFFFFFFFF
 #define VFS_FILE_INVALID        0
 #define VFS_MAX_FILES           16
 
+// Number of separate drives, each with its own FAT volume.
+// vfs_select picks the drive the other functions work on.
+#ifndef VFS_DRIVE_COUNT
+#define VFS_DRIVE_COUNT         1
+#endif
+
+// Range of cluster counts the drive size passed to vfs_init must give
+// for the drive to be FAT16 (spec limits +- safety margin)
+#define VFS_CLUSTERS_MAX        (65525 - 100)
+#define VFS_CLUSTERS_MIN        (4086 + 100)
+
 typedef char vfs_filename_t[11];
 
 typedef enum {
@@ -67,6 +82,10 @@ typedef uint32_t (*vfs_read_cb_t)(uint32_t sector_offset, uint8_t *data, uint32_
 typedef void (*vfs_file_change_cb_t)(const vfs_filename_t filename, vfs_file_change_t change,
                                      vfs_file_t file, vfs_file_t new_file_data);
 
+// Select the drive used by all of the functions below. Drive 0
+// is selected at startup.
+void vfs_select(uint32_t drive);
+
 // Initialize the filesystem with the given size and name
 void vfs_init(const vfs_filename_t drive_name, uint32_t disk_size);
 
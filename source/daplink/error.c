@@ -97,6 +97,8 @@ static const char *const error_message[] = {
     "The starting address for the interface update is wrong.",
     // ERROR_FD_UNSUPPORTED_UPDATE
     "The application file format is unknown and cannot be parsed and/or processed.",
+    // ERROR_FD_RAM_IMAGE_ADDR_WRONG
+    "The RAM image is for addresses outside of the target RAM.",
 
     /* Flash IAP interface */
 
@@ -121,6 +123,35 @@ static const char *const error_message[] = {
     // ERROR_BL_UPDT_BAD_CRC
     "The bootloader CRC did not pass.",
 
+    /* File stream errors for S-record and ELF */
+
+    // ERROR_SREC_CKSUM
+    "The S-record file cannot be decoded. Checksum calculation failure occurred.",
+    // ERROR_SREC_PARSER
+    "The S-record file cannot be decoded. Parser logic failure occurred.",
+    // ERROR_ELF_PARSER
+    "The ELF file cannot be decoded. Only 32-bit little endian executables are supported.",
+    // ERROR_ELF_UNSUPPORTED
+    "The ELF file has too many or overlapping loadable segments.",
+
+    /* File stream errors for delta updates */
+
+    // ERROR_DELTA_PARSER
+    "The delta file cannot be decoded.",
+    // ERROR_DELTA_BASE_CRC
+    "The delta file was not made for the image currently on the target.",
+    // ERROR_DELTA_NEW_CRC
+    "The image produced by applying the delta file has the wrong CRC.",
+    // ERROR_DELTA_UNSUPPORTED
+    "Delta updates are not supported for this target.",
+    // ERROR_DELTA_ADDRESS
+    "The delta file is for addresses outside of the target flash.",
+
+    /* VFS user errors for sector reordering */
+
+    // ERROR_OOO_BUFFER_FULL
+    "Too many sectors sent out of order by PC. Try copying the file again.",
+
 };
 
 static error_type_t error_type[] = {
@@ -197,6 +228,8 @@ static error_type_t error_type[] = {
     ERROR_TYPE_USER,
     // ERROR_FD_UNSUPPORTED_UPDATE
     ERROR_TYPE_USER,
+    // ERROR_FD_RAM_IMAGE_ADDR_WRONG
+    ERROR_TYPE_USER,
 
     /* Flash IAP interface */
 
@@ -220,6 +253,35 @@ static error_type_t error_type[] = {
     ERROR_TYPE_INTERFACE,
     // ERROR_BL_UPDT_BAD_CRC
     ERROR_TYPE_INTERFACE,
+
+    /* File stream errors for S-record and ELF */
+
+    // ERROR_SREC_CKSUM
+    ERROR_TYPE_USER | ERROR_TYPE_TRANSIENT,
+    // ERROR_SREC_PARSER
+    ERROR_TYPE_USER | ERROR_TYPE_TRANSIENT,
+    // ERROR_ELF_PARSER
+    ERROR_TYPE_USER,
+    // ERROR_ELF_UNSUPPORTED
+    ERROR_TYPE_USER,
+
+    /* File stream errors for delta updates */
+
+    // ERROR_DELTA_PARSER
+    ERROR_TYPE_USER | ERROR_TYPE_TRANSIENT,
+    // ERROR_DELTA_BASE_CRC
+    ERROR_TYPE_USER,
+    // ERROR_DELTA_NEW_CRC
+    ERROR_TYPE_TARGET,
+    // ERROR_DELTA_UNSUPPORTED
+    ERROR_TYPE_USER,
+    // ERROR_DELTA_ADDRESS
+    ERROR_TYPE_USER,
+
+    /* VFS user errors for sector reordering */
+
+    // ERROR_OOO_BUFFER_FULL
+    ERROR_TYPE_TRANSIENT,
 };
 
 COMPILER_ASSERT(ERROR_COUNT == ARRAY_SIZE(error_message));
@@ -66,6 +66,7 @@ typedef enum {
     ERROR_FD_BL_UPDT_ADDR_WRONG,
     ERROR_FD_INTF_UPDT_ADDR_WRONG,
     ERROR_FD_UNSUPPORTED_UPDATE,
+    ERROR_FD_RAM_IMAGE_ADDR_WRONG,
 
     /* Flash IAP interface */
     ERROR_IAP_INIT,
@@ -79,6 +80,22 @@ typedef enum {
     ERROR_IAP_NO_INTERCEPT,
     ERROR_BL_UPDT_BAD_CRC,
 
+    /* File stream errors for S-record and ELF */
+    ERROR_SREC_CKSUM,
+    ERROR_SREC_PARSER,
+    ERROR_ELF_PARSER,
+    ERROR_ELF_UNSUPPORTED,
+
+    /* File stream errors for delta updates */
+    ERROR_DELTA_PARSER,
+    ERROR_DELTA_BASE_CRC,
+    ERROR_DELTA_NEW_CRC,
+    ERROR_DELTA_UNSUPPORTED,
+    ERROR_DELTA_ADDRESS,
+
+    /* VFS user errors for sector reordering */
+    ERROR_OOO_BUFFER_FULL,
+
     // Add new values here
 
     ERROR_COUNT
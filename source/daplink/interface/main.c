@@ -39,6 +39,7 @@
 #include "sdk.h"
 #include "target_family.h"
 #include "target_board.h"
+#include "serial_capture.h"
 
 #ifdef DRAG_N_DROP_SUPPORT
 #include "vfs_manager.h"
@@ -454,6 +455,8 @@ void main_task(void * arg)
                 // Update hardware
                 gpio_set_cdc_led(cdc_led_value);
             }
+
+            serial_capture_periodic();
         }
     }
 }
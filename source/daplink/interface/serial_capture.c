@@ -0,0 +1,333 @@
+/**
+ * @file    serial_capture.c
+ * @brief   Implementation of serial_capture.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "serial_capture.h"
+#include "virtual_fs.h"
+#include "cmsis_os2.h"
+#include "cortex_m.h"
+#include "compiler.h"
+#include "util.h"
+
+#ifndef SERIAL_CAPTURE_SIZE
+#define SERIAL_CAPTURE_SIZE     0
+#endif
+
+#if SERIAL_CAPTURE_SIZE
+
+// Times are kept for the lines that start in a new millisecond, so a
+// burst of lines shares one. Lines older than the oldest time kept
+// show an unknown time.
+#ifndef SERIAL_CAPTURE_MARKS
+#define SERIAL_CAPTURE_MARKS    (SERIAL_CAPTURE_SIZE / 64)
+#endif
+
+COMPILER_ASSERT((SERIAL_CAPTURE_SIZE & (SERIAL_CAPTURE_SIZE - 1)) == 0);
+COMPILER_ASSERT((SERIAL_CAPTURE_MARKS > 0) && ((SERIAL_CAPTURE_MARKS & (SERIAL_CAPTURE_MARKS - 1)) == 0));
+
+#define CAPTURE_MASK            (SERIAL_CAPTURE_SIZE - 1)
+#define MARK_MASK               (SERIAL_CAPTURE_MARKS - 1)
+
+// SERIAL.TXT shows at most this much of the ring, so characters that
+// arrive while the drive is mounted take a while to reach what it shows
+#define FILE_DATA_SIZE          (SERIAL_CAPTURE_SIZE / 4 * 3)
+
+// "[    12.345] " before each line, in seconds since DAPLink started
+#define PREFIX_SIZE             13
+static const char prefix_unknown[] = "[     ?.???] ";
+
+typedef struct {
+    uint32_t pos;               // First character of the line
+    uint32_t time_ms;
+} capture_mark_t;
+
+// Positions count characters since startup. The ring holds the last
+// SERIAL_CAPTURE_SIZE of them.
+static uint8_t capture_buf[SERIAL_CAPTURE_SIZE];
+static volatile uint32_t capture_head;
+static volatile uint32_t capture_used;
+static bool capture_line_start = true;
+
+static capture_mark_t marks[SERIAL_CAPTURE_MARKS];
+static volatile uint32_t mark_count;
+
+static uint32_t clock_ms;
+static uint32_t clock_last;
+
+// What SERIAL.TXT shows, fixed when the drive is built
+static struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t size;
+} view;
+
+// Where the last read of SERIAL.TXT stopped, so reading the file in
+// order does not render it from the start for every sector
+static struct {
+    uint32_t offset;            // Offset in the file
+    uint32_t pos;               // Next character
+    uint32_t mark;              // Newest mark at or before the current line
+    uint32_t prefix_idx;        // Next character of the prefix
+    bool line_start;            // Prefix still to be written
+    char prefix[PREFIX_SIZE];
+} cursor;
+
+static uint32_t clock_update(void);
+static void add_mark(uint32_t pos);
+static bool line_time(uint32_t pos, uint32_t *time_ms);
+static void write_prefix(char *str, uint32_t pos);
+static void cursor_reset(void);
+static uint8_t cursor_next(void);
+static uint32_t read_file_serial_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
+
+// Called from the UART interrupt handler, so the main task only sees
+// whole updates when it reads the ring
+void serial_capture_write(const uint8_t *data, uint32_t size)
+{
+    uint32_t head = capture_head;
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        if (capture_line_start) {
+            add_mark(head);
+        }
+        capture_buf[head & CAPTURE_MASK] = data[i];
+        capture_line_start = ('\n' == data[i]);
+        head++;
+    }
+    capture_head = head;
+    if (capture_used < SERIAL_CAPTURE_SIZE) {
+        capture_used = MIN(capture_used + size, SERIAL_CAPTURE_SIZE);
+    }
+}
+
+void serial_capture_periodic(void)
+{
+    clock_update();
+}
+
+void serial_capture_create_files(void)
+{
+    cortex_int_state_t state;
+    uint32_t start;
+    uint32_t end;
+    uint32_t used;
+    uint32_t lines;
+    uint32_t pos;
+
+    state = cortex_int_get_and_disable();
+    end = capture_head;
+    used = capture_used;
+    cortex_int_restore(state);
+
+    start = end - MIN(used, FILE_DATA_SIZE);
+
+    // Begin with a whole line unless the last line fills the file
+    if ((used > end - start) && ('\n' != capture_buf[(start - 1) & CAPTURE_MASK])) {
+        for (pos = start; pos != end; pos++) {
+            if ('\n' == capture_buf[pos & CAPTURE_MASK]) {
+                break;
+            }
+        }
+        if ((pos != end) && (pos + 1 != end)) {
+            start = pos + 1;
+        }
+    }
+
+    // A newline starts a line unless it is the last character
+    lines = 0;
+    if (start != end) {
+        lines = 1;
+        for (pos = start; pos != end - 1; pos++) {
+            if ('\n' == capture_buf[pos & CAPTURE_MASK]) {
+                lines++;
+            }
+        }
+    }
+
+    view.start = start;
+    view.end = end;
+    view.size = (end - start) + lines * PREFIX_SIZE;
+    cursor_reset();
+
+    vfs_create_file("SERIAL  TXT", read_file_serial_txt, 0, view.size);
+}
+
+// Advance the clock by the whole milliseconds since the last update.
+// The system timer wraps within a minute on the faster HICs, so this
+// runs from the main task as well as for each line received. A count
+// behind the last update is taken as no time rather than a wrap, so
+// updates must be less than half a wrap apart.
+static uint32_t clock_update(void)
+{
+    cortex_int_state_t state;
+    uint32_t ticks_per_ms;
+    uint32_t elapsed;
+    uint32_t now;
+
+    state = cortex_int_get_and_disable();
+    ticks_per_ms = osKernelGetSysTimerFreq() / 1000;
+    elapsed = osKernelGetSysTimerCount() - clock_last;
+    if ((int32_t)elapsed < 0) {
+        elapsed = 0;
+    }
+    elapsed /= ticks_per_ms;
+    clock_ms += elapsed;
+    clock_last += elapsed * ticks_per_ms;
+    now = clock_ms;
+    cortex_int_restore(state);
+    return now;
+}
+
+static void add_mark(uint32_t pos)
+{
+    uint32_t now = clock_update();
+    uint32_t count = mark_count;
+    capture_mark_t *mark;
+
+    if ((count > 0) && (marks[(count - 1) & MARK_MASK].time_ms == now)) {
+        // Same time as the line before
+        return;
+    }
+    mark = &marks[count & MARK_MASK];
+    mark->pos = pos;
+    mark->time_ms = now;
+    mark_count = count + 1;
+}
+
+// Find the time of the line starting at pos from the newest mark at or
+// before it. Lines are looked up in order, so the search carries on
+// from the mark of the line before. Returns false if the mark has been
+// overwritten.
+static bool line_time(uint32_t pos, uint32_t *time_ms)
+{
+    uint32_t count = mark_count;
+    uint32_t idx = cursor.mark;
+    bool found = false;
+    capture_mark_t mark;
+
+    if (count - idx > SERIAL_CAPTURE_MARKS) {
+        idx = count - MIN(count, SERIAL_CAPTURE_MARKS);
+    }
+    for (; idx != count; idx++) {
+        mark = marks[idx & MARK_MASK];
+        __COMPILER_BARRIER();
+        if (mark_count - idx > SERIAL_CAPTURE_MARKS) {
+            // Overwritten while reading
+            found = false;
+            continue;
+        }
+        if ((int32_t)(mark.pos - pos) > 0) {
+            break;
+        }
+        cursor.mark = idx;
+        *time_ms = mark.time_ms;
+        found = true;
+    }
+    return found;
+}
+
+static void write_prefix(char *str, uint32_t pos)
+{
+    uint32_t time_ms;
+    uint32_t sec;
+    uint32_t ms;
+    uint32_t i;
+
+    memcpy(str, prefix_unknown, PREFIX_SIZE);
+    if (!line_time(pos, &time_ms)) {
+        return;
+    }
+    sec = time_ms / 1000 % 1000000;
+    ms = time_ms % 1000;
+    for (i = 10; i >= 8; i--) {
+        str[i] = '0' + ms % 10;
+        ms /= 10;
+    }
+    i = 6;
+    do {
+        str[i--] = '0' + sec % 10;
+        sec /= 10;
+    } while ((sec > 0) && (i > 0));
+}
+
+static void cursor_reset(void)
+{
+    cursor.offset = 0;
+    cursor.pos = view.start;
+    cursor.mark = 0;
+    cursor.prefix_idx = 0;
+    cursor.line_start = (view.start != view.end);
+}
+
+// Render the next character of SERIAL.TXT. Characters overwritten since
+// the drive was built and anything past the end show as spaces.
+static uint8_t cursor_next(void)
+{
+    uint8_t c = ' ';
+
+    if (cursor.line_start) {
+        if (0 == cursor.prefix_idx) {
+            write_prefix(cursor.prefix, cursor.pos);
+        }
+        c = cursor.prefix[cursor.prefix_idx++];
+        if (PREFIX_SIZE == cursor.prefix_idx) {
+            cursor.prefix_idx = 0;
+            cursor.line_start = false;
+        }
+    } else if (cursor.pos != view.end) {
+        c = capture_buf[cursor.pos & CAPTURE_MASK];
+        __COMPILER_BARRIER();
+        cursor.pos++;
+        if (capture_head - (cursor.pos - 1) > SERIAL_CAPTURE_SIZE) {
+            c = ' ';
+        }
+        cursor.line_start = ('\n' == c) && (cursor.pos != view.end);
+    }
+    cursor.offset++;
+    return c;
+}
+
+static uint32_t read_file_serial_txt(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    uint32_t offset = sector_offset * VFS_SECTOR_SIZE;
+    uint32_t size;
+    uint32_t i;
+
+    if (offset >= view.size) {
+        return 0;
+    }
+    size = MIN(view.size - offset, num_sectors * VFS_SECTOR_SIZE);
+
+    if (offset < cursor.offset) {
+        cursor_reset();
+    }
+    while (cursor.offset < offset) {
+        cursor_next();
+    }
+    for (i = 0; i < size; i++) {
+        data[i] = cursor_next();
+    }
+    return size;
+}
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * @file    target_dump.c
+ * @brief   Implementation of target_dump.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "target_dump.h"
+#include "virtual_fs.h"
+#include "swd_host.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "target_config.h"
+#include "target_board.h"
+#include "util.h"
+
+#ifndef TARGET_DUMP_FILES
+#define TARGET_DUMP_FILES   0
+#endif
+
+#if TARGET_DUMP_FILES
+
+// Reads smaller than this fetch the sectors that follow as well so a
+// sequential copy of the file needs fewer SWD connections
+#define READ_AHEAD_SIZE     (VFS_SECTOR_SIZE * 4)
+
+static uint32_t read_ahead_buf[READ_AHEAD_SIZE / sizeof(uint32_t)];
+static uint32_t read_ahead_addr;
+static uint32_t read_ahead_size;
+
+static uint32_t read_file_flash_bin(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
+static uint32_t read_file_ram_bin(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
+static uint32_t read_region(const region_info_t *region, uint32_t sector_offset, uint8_t *data, uint32_t num_sectors);
+static bool read_target(uint32_t addr, uint8_t *data, uint32_t size);
+static uint32_t region_size(const region_info_t *region);
+static void read_ahead_invalidate(void);
+
+void target_dump_create_files(void)
+{
+    const target_cfg_t *cfg = g_board_info.target_cfg;
+    uint32_t size;
+
+    // The target may have been programmed since the drive was last built
+    read_ahead_invalidate();
+
+    if (0 == cfg) {
+        return;
+    }
+
+    size = region_size(&cfg->flash_regions[0]);
+
+    if (size > 0) {
+        vfs_create_file("FLASH   BIN", read_file_flash_bin, 0, size);
+    }
+
+    size = region_size(&cfg->ram_regions[0]);
+
+    if (size > 0) {
+        vfs_create_file("RAM     BIN", read_file_ram_bin, 0, size);
+    }
+}
+
+// File callback to be used with vfs_add_file to return file contents
+static uint32_t read_file_flash_bin(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_region(&g_board_info.target_cfg->flash_regions[0], sector_offset, data, num_sectors);
+}
+
+// File callback to be used with vfs_add_file to return file contents
+static uint32_t read_file_ram_bin(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    return read_region(&g_board_info.target_cfg->ram_regions[0], sector_offset, data, num_sectors);
+}
+
+// Memory that cannot be read is returned as zeros
+static uint32_t read_region(const region_info_t *region, uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    uint32_t offset = sector_offset * VFS_SECTOR_SIZE;
+    uint32_t size = region_size(region);
+    uint32_t addr;
+
+    if (offset >= size) {
+        return 0;
+    }
+
+    size = MIN(size - offset, num_sectors * VFS_SECTOR_SIZE);
+    addr = region->start + offset;
+
+    if ((addr >= read_ahead_addr) && (addr + size <= read_ahead_addr + read_ahead_size)) {
+        memcpy(data, (uint8_t *)read_ahead_buf + (addr - read_ahead_addr), size);
+        return size;
+    }
+
+    read_ahead_invalidate();
+
+    if (size >= sizeof(read_ahead_buf)) {
+        if (!read_target(addr, data, size)) {
+            memset(data, 0, size);
+        }
+
+        return size;
+    }
+
+    if (read_target(addr, (uint8_t *)read_ahead_buf, MIN(sizeof(read_ahead_buf), region->end - addr))) {
+        read_ahead_addr = addr;
+        read_ahead_size = MIN(sizeof(read_ahead_buf), region->end - addr);
+        memcpy(data, read_ahead_buf, size);
+    } else {
+        memset(data, 0, size);
+    }
+
+    return size;
+}
+
+static bool read_target(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    bool success = false;
+
+    // Leave the port to a debugger that has connected, as reading
+    // would disturb its session
+    if (DAP_Data.debug_port != DAP_PORT_DISABLED) {
+        return false;
+    }
+
+    // A debugger may have used the DAP since the last read so
+    // connect again rather than relying on the cached DAP state
+    if (swd_init_debug()) {
+        success = 0 != swd_read_memory(addr, data, size);
+    }
+
+    // The host may never read the rest of the file, so release the
+    // SWD pins after each read as after programming
+    swd_off();
+    return success;
+}
+
+static uint32_t region_size(const region_info_t *region)
+{
+    return region->end > region->start ? region->end - region->start : 0;
+}
+
+static void read_ahead_invalidate(void)
+{
+    read_ahead_addr = 0;
+    read_ahead_size = 0;
+}
+
+#endif
@@ -29,6 +29,7 @@
 #include "intelhex.h"
 #include "swd_host.h"
 #include "flash_intf.h"
+#include "flash_stats.h"
 #include "util.h"
 #include "settings.h"
 #include "target_family.h"
@@ -51,6 +52,9 @@ static uint32_t target_flash_program_page_min_size(uint32_t addr);
 static uint32_t target_flash_erase_sector_size(uint32_t addr);
 static uint8_t target_flash_busy(void);
 static error_t target_flash_set(uint32_t addr);
+static error_t target_flash_read(uint32_t addr, uint8_t *buf, uint32_t size);
+static bool target_flash_erased_value(uint32_t addr, uint8_t *value);
+static uint8_t target_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, flash_algo_return_t return_type);
 
 static const flash_intf_t flash_intf = {
     target_flash_init,
@@ -62,6 +66,8 @@ static const flash_intf_t flash_intf = {
     target_flash_erase_sector_size,
     target_flash_busy,
     target_flash_set,
+    target_flash_read,
+    target_flash_erased_value,
 };
 
 static state_t state = STATE_CLOSED;
@@ -112,14 +118,14 @@ static error_t flash_func_start(flash_func_t func)
         // Finish the currently active function.
         if (FLASH_FUNC_NOP != last_flash_func &&
             ((flash->algo_flags & kAlgoSingleInitType) == 0 || FLASH_FUNC_NOP == func ) &&
-            0 == swd_flash_syscall_exec(&flash->sys_call_s, flash->uninit, last_flash_func, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
+            0 == target_flash_syscall_exec(&flash->sys_call_s, flash->uninit, last_flash_func, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
             return ERROR_UNINIT;
         }
 
         // Start a new function.
         if (FLASH_FUNC_NOP != func &&
             ((flash->algo_flags & kAlgoSingleInitType) == 0 || FLASH_FUNC_NOP == last_flash_func ) &&
-            0 == swd_flash_syscall_exec(&flash->sys_call_s, flash->init, flash_start, 0, func, 0, FLASHALGO_RETURN_BOOL)) {
+            0 == target_flash_syscall_exec(&flash->sys_call_s, flash->init, flash_start, 0, func, 0, FLASHALGO_RETURN_BOOL)) {
             return ERROR_INIT;
         }
 
@@ -152,6 +158,55 @@ static error_t target_flash_set(uint32_t addr)
     return ERROR_SUCCESS;
 }
 
+static uint8_t target_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, flash_algo_return_t return_type)
+{
+    uint32_t start = flash_stats_start();
+    uint8_t ret = swd_flash_syscall_exec(sysCallParam, entry, arg1, arg2, arg3, arg4, return_type);
+    flash_stats_syscall(start);
+    return ret;
+}
+
+static error_t target_flash_verify_page(program_target_t *flash, uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    if (flash->verify != 0) {
+        flash_algo_return_t return_type;
+        error_t status = flash_func_start(FLASH_FUNC_VERIFY);
+        if (status != ERROR_SUCCESS) {
+            return status;
+        }
+        if ((flash->algo_flags & kAlgoVerifyReturnsAddress) != 0) {
+            return_type = FLASHALGO_RETURN_POINTER;
+        } else {
+            return_type = FLASHALGO_RETURN_BOOL;
+        }
+        if (!target_flash_syscall_exec(&flash->sys_call_s,
+                            flash->verify,
+                            addr,
+                            size,
+                            flash->program_buffer,
+                            0,
+                            return_type)) {
+            return ERROR_WRITE_VERIFY;
+        }
+    } else {
+        while (size > 0) {
+            uint8_t rb_buf[16];
+            uint32_t verify_size = MIN(size, sizeof(rb_buf));
+            if (!swd_read_memory(addr, rb_buf, verify_size)) {
+                return ERROR_ALGO_DATA_SEQ;
+            }
+            if (memcmp(buf, rb_buf, verify_size) != 0) {
+                return ERROR_WRITE_VERIFY;
+            }
+            addr += verify_size;
+            buf += verify_size;
+            size -= verify_size;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
 static error_t target_flash_init()
 {
     if (g_board_info.target_cfg) {
@@ -238,7 +293,7 @@ static error_t target_flash_program_page(uint32_t addr, const uint8_t *buf, uint
             }
 
             // Run flash programming
-            if (!swd_flash_syscall_exec(&flash->sys_call_s,
+            if (!target_flash_syscall_exec(&flash->sys_call_s,
                                         flash->program_page,
                                         addr,
                                         write_size,
@@ -250,42 +305,11 @@ static error_t target_flash_program_page(uint32_t addr, const uint8_t *buf, uint
 
             if (config_get_automation_allowed()) {
                 // Verify data flashed if in automation mode
-                if (flash->verify != 0) {
-                    status = flash_func_start(FLASH_FUNC_VERIFY);
-                    if (status != ERROR_SUCCESS) {
-                        return status;
-                    }
-                    flash_algo_return_t return_type;
-                    if ((flash->algo_flags & kAlgoVerifyReturnsAddress) != 0) {
-                        return_type = FLASHALGO_RETURN_POINTER;
-                    } else {
-                        return_type = FLASHALGO_RETURN_BOOL;
-                    }
-                    if (!swd_flash_syscall_exec(&flash->sys_call_s,
-                                        flash->verify,
-                                        addr,
-                                        write_size,
-                                        flash->program_buffer,
-                                        0,
-                                        return_type)) {
-                        return ERROR_WRITE_VERIFY;
-                    }
-                } else {
-                    while (write_size > 0) {
-                        uint8_t rb_buf[16];
-                        uint32_t verify_size = MIN(write_size, sizeof(rb_buf));
-                        if (!swd_read_memory(addr, rb_buf, verify_size)) {
-                            return ERROR_ALGO_DATA_SEQ;
-                        }
-                        if (memcmp(buf, rb_buf, verify_size) != 0) {
-                            return ERROR_WRITE_VERIFY;
-                        }
-                        addr += verify_size;
-                        buf += verify_size;
-                        size -= verify_size;
-                        write_size -= verify_size;
-                    }
-                    continue;
+                uint32_t start = flash_stats_start();
+                status = target_flash_verify_page(flash, addr, buf, write_size);
+                flash_stats_end(FLASH_STATS_PHASE_VERIFY, start, status);
+                if (status != ERROR_SUCCESS) {
+                    return status;
                 }
             }
             addr += write_size;
@@ -322,7 +346,7 @@ static error_t target_flash_erase_sector(uint32_t addr)
             return status;
         }
 
-        if (0 == swd_flash_syscall_exec(&flash->sys_call_s, flash->erase_sector, addr, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
+        if (0 == target_flash_syscall_exec(&flash->sys_call_s, flash->erase_sector, addr, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
             return ERROR_ERASE_SECTOR;
         }
 
@@ -352,7 +376,7 @@ static error_t target_flash_erase_chip(void)
             if (status != ERROR_SUCCESS) {
                 return status;
             }
-            if (0 == swd_flash_syscall_exec(&current_flash_algo->sys_call_s, current_flash_algo->erase_chip, 0, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
+            if (0 == target_flash_syscall_exec(&current_flash_algo->sys_call_s, current_flash_algo->erase_chip, 0, 0, 0, 0, FLASHALGO_RETURN_BOOL)) {
                 return ERROR_ERASE_ALL;
             }
         }
@@ -403,4 +427,24 @@ static uint32_t target_flash_erase_sector_size(uint32_t addr)
 static uint8_t target_flash_busy(void){
     return (state == STATE_OPEN);
 }
+
+static error_t target_flash_read(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    if (!swd_read_memory(addr, buf, size)) {
+        return ERROR_ALGO_DATA_SEQ;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// The value the current flash algorithm leaves in erased flash
+static bool target_flash_erased_value(uint32_t addr, uint8_t *value)
+{
+    if (NULL == current_flash_algo) {
+        return false;
+    }
+
+    *value = (current_flash_algo->algo_flags & kAlgoErasedZero) ? 0x00 : 0xFF;
+    return true;
+}
 #endif
@@ -0,0 +1,223 @@
+/**
+ * @file    target_ram.c
+ * @brief   Flash interface that loads an image into target RAM and runs it
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifdef DRAG_N_DROP_SUPPORT
+#include "target_config.h"
+#include "swd_host.h"
+#include "debug_cm.h"
+#include "flash_intf.h"
+#include "target_family.h"
+#include "target_board.h"
+
+#define NVIC_Addr           (0xe000e000)
+
+// Core register numbers used with swd_write_core_register
+#define CORE_REG_SP         13
+#define CORE_REG_PC         15
+#define CORE_REG_XPSR       16
+#define XPSR_THUMB          0x01000000
+
+typedef enum {
+    STATE_CLOSED,
+    STATE_OPEN,
+    STATE_ERROR
+} state_t;
+
+static error_t target_ram_init(void);
+static error_t target_ram_uninit(void);
+static error_t target_ram_program_page(uint32_t addr, const uint8_t *buf, uint32_t size);
+static error_t target_ram_erase_sector(uint32_t addr);
+static error_t target_ram_erase_chip(void);
+static uint32_t target_ram_program_page_min_size(uint32_t addr);
+static uint32_t target_ram_erase_sector_size(uint32_t addr);
+static uint8_t target_ram_busy(void);
+static error_t target_ram_read(uint32_t addr, uint8_t *buf, uint32_t size);
+static error_t start_image(void);
+
+static const flash_intf_t flash_intf = {
+    target_ram_init,
+    target_ram_uninit,
+    target_ram_program_page,
+    target_ram_erase_sector,
+    target_ram_erase_chip,
+    target_ram_program_page_min_size,
+    target_ram_erase_sector_size,
+    target_ram_busy,
+    0,
+    target_ram_read,
+};
+
+static state_t state = STATE_CLOSED;
+static bool image_valid;
+static uint32_t image_start;
+
+const flash_intf_t *const flash_intf_target_ram = &flash_intf;
+
+static bool in_ram(uint32_t addr, uint32_t size)
+{
+    region_info_t * region = g_board_info.target_cfg->ram_regions;
+
+    for (; region->start != 0 || region->end != 0; ++region) {
+        if ((addr >= region->start) && (addr < region->end) && (size <= region->end - addr)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The initial stack pointer may be the end of a region, since the stack
+// grows down from there
+static bool stack_in_ram(uint32_t sp)
+{
+    region_info_t * region = g_board_info.target_cfg->ram_regions;
+
+    for (; region->start != 0 || region->end != 0; ++region) {
+        if ((sp > region->start) && (sp <= region->end)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static error_t target_ram_init(void)
+{
+    if (!g_board_info.target_cfg) {
+        return ERROR_FAILURE;
+    }
+
+    // Reset and halt so the image starts from a clean core state
+    if (0 == target_set_state(RESET_PROGRAM)) {
+        swd_off();
+        return ERROR_RESET;
+    }
+
+    image_valid = false;
+    image_start = 0;
+    state = STATE_OPEN;
+    return ERROR_SUCCESS;
+}
+
+static error_t target_ram_uninit(void)
+{
+    error_t status = ERROR_SUCCESS;
+
+    if (STATE_CLOSED == state) {
+        return ERROR_SUCCESS;
+    }
+
+    // Leave the core halted if the image was not written in full
+    if ((STATE_OPEN == state) && image_valid) {
+        status = start_image();
+    }
+
+    state = STATE_CLOSED;
+    swd_off();
+    return status;
+}
+
+static error_t target_ram_program_page(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    if (!in_ram(addr, size)) {
+        state = STATE_ERROR;
+        return ERROR_WRITE;
+    }
+
+    if (!swd_write_memory(addr, (uint8_t *)buf, size)) {
+        state = STATE_ERROR;
+        return ERROR_WRITE;
+    }
+
+    if (!image_valid || (addr < image_start)) {
+        image_start = addr;
+        image_valid = true;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static error_t target_ram_erase_sector(uint32_t addr)
+{
+    // RAM does not need to be erased
+    return ERROR_SUCCESS;
+}
+
+static error_t target_ram_erase_chip(void)
+{
+    // RAM does not need to be erased
+    return ERROR_SUCCESS;
+}
+
+static uint32_t target_ram_program_page_min_size(uint32_t addr)
+{
+    return 4;
+}
+
+static uint32_t target_ram_erase_sector_size(uint32_t addr)
+{
+    return 4;
+}
+
+static uint8_t target_ram_busy(void)
+{
+    return (state == STATE_OPEN);
+}
+
+static error_t target_ram_read(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    if (!swd_read_memory(addr, buf, size)) {
+        return ERROR_ALGO_DATA_SEQ;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Start the image from its vector table, which is at the lowest address written
+static error_t start_image(void)
+{
+    uint32_t sp;
+    uint32_t pc;
+
+    if (!swd_read_word(image_start + 0, &sp) || !swd_read_word(image_start + 4, &pc)) {
+        return ERROR_RESET;
+    }
+
+    // The image may not start with its vector table, so check the entry
+    // point and stack before running it
+    if (!in_ram(pc & ~1, 2) || !stack_in_ram(sp)) {
+        return ERROR_FD_RAM_IMAGE_ADDR_WRONG;
+    }
+
+    if (!swd_write_word(NVIC_VTOR, image_start) ||
+            !swd_write_core_register(CORE_REG_SP, sp) ||
+            !swd_write_core_register(CORE_REG_PC, pc & ~1) ||
+            !swd_write_core_register(CORE_REG_XPSR, XPSR_THUMB)) {
+        return ERROR_RESET;
+    }
+
+    // Resume the core without a reset, which would start the image in flash
+    if (0 == target_set_state(RUN)) {
+        return ERROR_RESET;
+    }
+
+    return ERROR_SUCCESS;
+}
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file    serial_capture.h
+ * @brief   Capture of the target's serial output
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SERIAL_CAPTURE_H
+#define SERIAL_CAPTURE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interface firmware built with SERIAL_CAPTURE_SIZE set keeps the most
+// recent characters received from the target in a ring of that many bytes,
+// whether or not the host reads the serial port, and shows them on the
+// drive as SERIAL.TXT. Each line starts with the time it arrived. Without
+// SERIAL_CAPTURE_SIZE these functions do nothing.
+
+// Record received characters. Called by the UART drivers from their
+// interrupt handlers before the characters are buffered for the host.
+void serial_capture_write(const uint8_t *data, uint32_t size);
+
+// Keep the capture clock running while no characters arrive. Called from
+// the main task at least every few seconds.
+void serial_capture_periodic(void);
+
+// Add SERIAL.TXT to the drive with what has been captured so far
+void serial_capture_create_files(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
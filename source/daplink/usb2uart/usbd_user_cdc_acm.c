@@ -28,8 +28,17 @@
 #endif
 #include "target_family.h"
 
+// Boards that wire the target's RTS and CTS to the HIC set this to 1 to
+// use hardware flow control on the virtual COM port
+#ifndef CDC_UART_RTS_CTS
+#define CDC_UART_RTS_CTS 0
+#endif
+
 UART_Configuration UART_Config;
 
+// For UART drivers without modem control lines
+__attribute__((weak)) void uart_set_control_line_state(uint16_t ctrl_bmp) {}
+
 /** @brief  Vitual COM Port initialization
  *
  *  The function inititalizes the hardware resources of the port used as
@@ -88,7 +97,7 @@ int32_t USBD_CDC_ACM_PortSetLineCoding(CDC_LINE_CODING *line_coding)
     UART_Config.DataBits    = (UART_DataBits) line_coding->bDataBits;
     UART_Config.Parity      = (UART_Parity)   line_coding->bParityType;
     UART_Config.StopBits    = (UART_StopBits) line_coding->bCharFormat;
-    UART_Config.FlowControl = UART_FLOW_CONTROL_NONE;
+    UART_Config.FlowControl = CDC_UART_RTS_CTS ? UART_FLOW_CONTROL_RTS_CTS : UART_FLOW_CONTROL_NONE;
     return uart_set_configuration(&UART_Config);
 }
 
@@ -120,13 +129,13 @@ int32_t USBD_CDC_ACM_SendBreak(uint16_t dur)
     { //added checking if flashing on target is in progress
         // reset and send the unique id over CDC
         if (dur != 0) {
-            start_break_time = osKernelGetSysTimerCount();
+            start_break_time = osKernelGetTickCount();
             target_set_state(RESET_HOLD);
         } else {
-            end_break_time = osKernelGetSysTimerCount();
+            end_break_time = osKernelGetTickCount();
 
-            // long reset -> send uID over serial (300 -> break > 3s)
-            if ((end_break_time - start_break_time) >= (300)) {
+            // long reset -> send uID over serial (break > 3s)
+            if ((end_break_time - start_break_time) >= (3 * osKernelGetTickFreq())) {
                 main_reset_target(1);
             } else {
                 main_reset_target(0);
@@ -148,46 +157,72 @@ int32_t USBD_CDC_ACM_SendBreak(uint16_t dur)
  */
 int32_t USBD_CDC_ACM_PortSetControlLineState(uint16_t ctrl_bmp)
 {
+    uart_set_control_line_state(ctrl_bmp);
     return (1);
 }
 
+// The UART driver, the CDC OUT endpoint and the CDC IN endpoint each signal
+// the main task when there may be data to move, instead of the main task
+// polling for it.
+void uart_data_event(void)
+{
+    main_cdc_send_event();
+}
+
+int32_t USBD_CDC_ACM_DataReceived(int32_t len)
+{
+    main_cdc_send_event();
+    return 1;
+}
+
+int32_t USBD_CDC_ACM_DataSent(int32_t len)
+{
+    main_cdc_send_event();
+    return 1;
+}
+
 void cdc_process_event()
 {
     int32_t len_data = 0;
-    uint8_t data[64];
+    int32_t moved = 0;
+    uint8_t *data;
 
-    len_data = USBD_CDC_ACM_DataFree();
+    // Keep copying until neither side can take or give any more data.
+    // Whatever is left waits for the next event. The UART driver reads
+    // straight into the USB send buffer and writes straight from the USB
+    // receive buffer, so each byte is only copied once.
+    while (1) {
+        int32_t len_uart_to_usb = 0;
+        int32_t len_usb_to_uart = 0;
 
-    if (len_data > sizeof(data)) {
-        len_data = sizeof(data);
-    }
+        len_data = USBD_CDC_ACM_DataSendPeek(&data);
 
-    if (len_data) {
-        len_data = uart_read_data(data, len_data);
-    }
+        if (len_data) {
+            len_uart_to_usb = uart_read_data(data, len_data);
+        }
 
-    if (len_data) {
-        if (USBD_CDC_ACM_DataSend(data , len_data)) {
-            main_blink_cdc_led(MAIN_LED_FLASH);
+        if (len_uart_to_usb) {
+            USBD_CDC_ACM_DataSendCommit(len_uart_to_usb);
         }
-    }
 
-    len_data = uart_write_free();
+        len_data = USBD_CDC_ACM_DataReadPeek(&data);
 
-    if (len_data > sizeof(data)) {
-        len_data = sizeof(data);
-    }
+        if (len_data) {
+            len_usb_to_uart = uart_write_data(data, len_data);
+        }
 
-    if (len_data) {
-        len_data = USBD_CDC_ACM_DataRead(data, len_data);
-    }
+        if (len_usb_to_uart) {
+            USBD_CDC_ACM_DataReadCommit(len_usb_to_uart);
+        }
 
-    if (len_data) {
-        if (uart_write_data(data, len_data)) {
-            main_blink_cdc_led(MAIN_LED_FLASH);
+        if (!len_uart_to_usb && !len_usb_to_uart) {
+            break;
         }
+
+        moved += len_uart_to_usb + len_usb_to_uart;
     }
 
-    // Always process events
-    main_cdc_send_event();
+    if (moved) {
+        main_blink_cdc_led(MAIN_LED_FLASH);
+    }
 }
@@ -26,7 +26,12 @@
 #include "cortex_m.h"
 
 //remove dependency from vfs_manager
-__attribute__((weak)) void vfs_mngr_fs_remount(void) {}
+__attribute__((weak)) void vfs_mngr_config_remount(void) {}
+//remove dependency from usb2uart
+__attribute__((weak)) void uart_data_event(void) {}
+//remove dependency from serial_capture
+__attribute__((weak)) void serial_capture_write(const uint8_t *data, uint32_t size) {}
+__attribute__((weak)) void serial_capture_periodic(void) {}
 
 uint32_t util_write_hex8(char *str, uint8_t value)
 {
@@ -145,9 +150,9 @@ void _util_assert(bool expression, const char *filename, uint16_t line)
     cortex_int_restore(int_state);
 
     // Start a remount if this is the first assert
-    // Do not call vfs_mngr_fs_remount from an ISR!
+    // Do not call vfs_mngr_config_remount from an ISR!
     if (!assert_set && !cortex_in_isr()) {
-        vfs_mngr_fs_remount();
+        vfs_mngr_config_remount();
     }
 }
 
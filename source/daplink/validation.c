@@ -77,6 +77,36 @@ uint8_t validate_bin_nvic(const uint8_t *buf)
     }
 }
 
+// Check for a vector table of an image that runs from target RAM
+uint8_t validate_bin_ram_nvic(const uint8_t *buf)
+{
+    uint32_t i, nvic_val;
+    region_info_t * region;
+
+    if (!g_board_info.target_cfg) {
+        return 0;
+    }
+
+    // Initial SP, Reset_Handler, NMI_Handler and HardFault_Handler
+    // must all point into RAM
+    for (i = 0; i <= 12; i += 4) {
+        uint8_t in_range = 0;
+        memcpy(&nvic_val, buf + i, sizeof(nvic_val));
+        region = g_board_info.target_cfg->ram_regions;
+        for (; region->start != 0 || region->end != 0; ++region) {
+            if (1 == test_range(nvic_val, region->start, region->end)) {
+                in_range = 1;
+                break;
+            }
+        }
+        if (in_range == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 uint8_t validate_hexfile(const uint8_t *buf)
 {
     if (g_target_family && g_target_family->validate_hexfile) {
@@ -29,6 +29,7 @@ extern "C" {
 #endif
 
 uint8_t validate_bin_nvic(const uint8_t *buf);
+uint8_t validate_bin_ram_nvic(const uint8_t *buf);
 uint8_t validate_hexfile(const uint8_t *buf);
 
 #ifdef __cplusplus
@@ -73,5 +73,6 @@ static const program_target_t flash = {
     0x20000000,               // location to write prog_blob in target RAM
     sizeof(stm32l1xx_256_flash_prog_blob),   // prog_blob size
     stm32l1xx_256_flash_prog_blob,           // address of prog_blob
-    0x00000100       // ram_to_flash_bytes_to_be_written
+    0x00000100,      // ram_to_flash_bytes_to_be_written
+    kAlgoErasedZero  // algo_flags
 };
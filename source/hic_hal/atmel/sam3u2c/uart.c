@@ -24,11 +24,15 @@
 #include "sam3u.h"
 #include "uart.h"
 #include "circ_buf.h"
+#include "serial_capture.h"
 #include "cortex_m.h"
 #include "util.h"
 #include "settings.h" // for config_get_overflow_detect
 
-#define  BUFFER_SIZE  512
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    512
+#endif
+#define  BUFFER_SIZE  UART_BUFFER_SIZE
 #define _CPU_CLK_HZ   SystemCoreClock
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
@@ -118,6 +122,7 @@ circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 static U32        _Baudrate;
 static U8         _FlowControl;
@@ -361,6 +366,7 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint32_t cnt;
 
     cnt = circ_buf_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     //
     // Atomically trigger transfer if not already in progress
@@ -374,6 +380,11 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     return cnt;
 }
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     cortex_int_state_t state;
@@ -396,6 +407,22 @@ void uart_enable_flow_control(bool enabled)
     _FlowControlEnabled = (U8)enabled;
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART_IRQHandler(void)
 {
     int Status;
@@ -412,10 +439,12 @@ void UART_IRQHandler(void)
     //
     if (Status & UART_RXRDY_FLAG) {                   // Data received?
         data = UART_RHR;
+        serial_capture_write(&data, 1);
         cnt = (int32_t)circ_buf_count_free(&read_buffer) - RX_OVRF_MSG_SIZE;
         if (cnt > 0) {
             circ_buf_push(&read_buffer, data);
         } else if (config_get_overflow_detect()) {
+            stats.RxDropped++;
             if (0 == cnt) {
                 circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
             } else {
@@ -423,14 +452,22 @@ void UART_IRQHandler(void)
             }
         } else {
             // Drop oldest
+            stats.RxDropped++;
             circ_buf_pop(&read_buffer);
             circ_buf_push(&read_buffer, data);
         }
 
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
         //If this was the last available byte on the buffer then assert RTS
         if (cnt == 1) {
             set_rx_ready(0);
         }
+
+        // Wake the main task when the first byte lands in an empty buffer
+        if (circ_buf_count_used(&read_buffer) == 1) {
+            uart_data_event();
+        }
     }
 
     //
@@ -442,6 +479,7 @@ void UART_IRQHandler(void)
             UART_IDR = UART_TX_INT_FLAG;
             PIOA->PIO_MDER = (1 << UART_TX_PIN);    //enable open-drain
             _TxInProgress = 0;
+            uart_data_event();                      // Room for more data
         } else if (get_tx_ready()) {
             _Send1();                               //More bytes to send? Trigger sending of next byte
         } else {
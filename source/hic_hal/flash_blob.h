@@ -35,6 +35,7 @@ enum {
     kAlgoVerifyReturnsAddress = (1u << 0u),     /*!< Verify function returns address if bit set */
     kAlgoSingleInitType =       (1u << 1u),     /*!< The init function ignores the function code. */
     kAlgoSkipChipErase =        (1u << 2u),     /*!< Skip region when erase.act action triggers. */
+    kAlgoErasedZero =           (1u << 3u),     /*!< Erased flash reads as 0x00 instead of 0xFF. */
 };
 
 typedef struct __attribute__((__packed__)) {
@@ -56,7 +57,7 @@ typedef struct __attribute__((__packed__)) {
     const uint32_t  algo_size;
     const uint32_t *algo_blob;
     const uint32_t  program_buffer_size;
-    const uint32_t  algo_flags;         /*!< Combination of kAlgoVerifyReturnsAddress, kAlgoSingleInitType and kAlgoSkipChipErase*/
+    const uint32_t  algo_flags;         /*!< Combination of kAlgoVerifyReturnsAddress, kAlgoSingleInitType, kAlgoSkipChipErase and kAlgoErasedZero*/
 } program_target_t;
 
 typedef struct __attribute__((__packed__)) {
@@ -26,6 +26,8 @@
 #include "util.h"
 #include "cortex_m.h"
 #include "circ_buf.h"
+#include "dma_ring.h"
+#include "serial_capture.h"
 #include "settings.h" // for config_get_overflow_detect
 
 #define UART_INSTANCE (UART0)
@@ -37,13 +39,124 @@ static void clear_buffers(void);
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define BUFFER_SIZE         (512)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (512)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
+
+// Received characters are moved from the UART by DMA instead of one
+// interrupt each. The half and full transfer interrupts and the idle
+// line interrupt at the end of a burst copy them to read_buffer.
+// Characters with noise or framing errors are kept in this mode.
+#ifndef UART_RX_DMA
+#define UART_RX_DMA         1
+#endif
+
+// UART0 RX requests are served by DMA channel 0
+#define RX_DMA_CHANNEL      0
+#define RX_DMA_SOURCE       2       // DMAMUX source 2 is UART0 RX
+#define RX_DMA_IRQn         DMA0_DMA16_IRQn
+#define RX_DMA_IRQHandler   DMA0_DMA16_IRQHandler
+// Characters the DMA channel can take before read_buffer is updated. The
+// interrupts at each half must be served within RX_DMA_SIZE / 2 characters.
+#define RX_DMA_SIZE         (128)
+
+#if UART_RX_DMA
+#define RX_IE_MASK          (UART_C2_RIE_MASK | UART_C2_ILIE_MASK)
+#else
+#define RX_IE_MASK          UART_C2_RIE_MASK
+#endif
 
 
 circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
+
+#if UART_RX_DMA
+static dma_ring_t rx_dma_ring;
+static uint8_t rx_dma_data[RX_DMA_SIZE];
+#endif
+
+// Add received characters to read_buffer. The last few free bytes are
+// kept for the overflow message.
+static void rx_write(const uint8_t *data, uint32_t size)
+{
+    uint32_t free = circ_buf_count_free(&read_buffer);
+    uint32_t cnt = 0;
+
+    serial_capture_write(data, size);
+
+    if (free > RX_OVRF_MSG_SIZE) {
+        cnt = MIN(size, free - RX_OVRF_MSG_SIZE);
+        circ_buf_write(&read_buffer, data, cnt);
+    }
+    if ((cnt < size) && (RX_OVRF_MSG_SIZE == circ_buf_count_free(&read_buffer)) &&
+            config_get_overflow_detect()) {
+        circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
+    }
+    // Drop the rest
+    stats.RxDropped += size - cnt;
+    stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+}
+
+#if UART_RX_DMA
+// Start the DMA channel at the beginning of rx_dma_data
+static void rx_dma_start(void)
+{
+    DMA0->CERQ = DMA_CERQ_CERQ(RX_DMA_CHANNEL);
+    // Bytes from the data register to incrementing memory addresses
+    DMA0->TCD[RX_DMA_CHANNEL].SADDR = (uint32_t)&UART_INSTANCE->D;
+    DMA0->TCD[RX_DMA_CHANNEL].SOFF = 0;
+    DMA0->TCD[RX_DMA_CHANNEL].SLAST = 0;
+    DMA0->TCD[RX_DMA_CHANNEL].ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+    DMA0->TCD[RX_DMA_CHANNEL].NBYTES_MLNO = 1;
+    DMA0->TCD[RX_DMA_CHANNEL].DADDR = (uint32_t)rx_dma_data;
+    DMA0->TCD[RX_DMA_CHANNEL].DOFF = 1;
+    DMA0->TCD[RX_DMA_CHANNEL].CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(RX_DMA_SIZE);
+    DMA0->TCD[RX_DMA_CHANNEL].BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(RX_DMA_SIZE);
+    // Back to the start of the buffer after each pass, without
+    // clearing the request enable, so the channel runs in a circle
+    DMA0->TCD[RX_DMA_CHANNEL].DLAST_SGA = (uint32_t)(-RX_DMA_SIZE);
+    DMA0->TCD[RX_DMA_CHANNEL].CSR = DMA_CSR_INTHALF_MASK | DMA_CSR_INTMAJOR_MASK;
+    dma_ring_init(&rx_dma_ring, rx_dma_data, sizeof(rx_dma_data));
+
+    DMAMUX->CHCFG[RX_DMA_CHANNEL] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(RX_DMA_SOURCE);
+    DMA0->SERQ = DMA_SERQ_SERQ(RX_DMA_CHANNEL);
+}
+
+static void rx_dma_stop(void)
+{
+    DMA0->CERQ = DMA_CERQ_CERQ(RX_DMA_CHANNEL);
+    DMAMUX->CHCFG[RX_DMA_CHANNEL] = 0;
+    DMA0->CINT = DMA_CINT_CINT(RX_DMA_CHANNEL);
+}
+
+// Copy everything the DMA channel received to read_buffer
+static void rx_dma_read(void)
+{
+    bool rx_was_empty = (circ_buf_count_used(&read_buffer) == 0);
+    uint8_t *data;
+    uint32_t cnt;
+    uint32_t remaining;
+
+    for (;;) {
+        remaining = DMA0->TCD[RX_DMA_CHANNEL].CITER_ELINKNO & DMA_CITER_ELINKNO_CITER_MASK;
+        cnt = dma_ring_peek_read(&rx_dma_ring, remaining, &data);
+        if (0 == cnt) {
+            break;
+        }
+        rx_write(data, cnt);
+        dma_ring_commit_read(&rx_dma_ring, cnt);
+    }
+
+    // Wake the main task when the first bytes land in an empty buffer
+    if (rx_was_empty && circ_buf_count_used(&read_buffer)) {
+        uart_data_event();
+    }
+}
+#endif
 
 void clear_buffers(void)
 {
@@ -59,13 +172,18 @@ int32_t uart_initialize(void)
     SIM->SCGC5 |= SIM_SCGC5_PORTB_MASK;
     // enable clk uart
     SIM->SCGC4 |= SIM_SCGC4_UART0_MASK;
+#if UART_RX_DMA
+    // enable clk dma and dmamux
+    SIM->SCGC7 |= SIM_SCGC7_DMA_MASK;
+    SIM->SCGC6 |= SIM_SCGC6_DMAMUX_MASK;
+#endif
 
     // disable interrupt
     NVIC_DisableIRQ(UART_IRQ);
     // transmitter and receiver disabled
     UART_INSTANCE->C2 &= ~(UART_C2_RE_MASK | UART_C2_TE_MASK);
     // disable interrupt
-    UART_INSTANCE->C2 &= ~(UART_C2_RIE_MASK | UART_C2_TIE_MASK);
+    UART_INSTANCE->C2 &= ~(RX_IE_MASK | UART_C2_TIE_MASK);
 
     clear_buffers();
 
@@ -76,8 +194,16 @@ int32_t uart_initialize(void)
     PORTB->PCR[16] = PORT_PCR_MUX(3);
     PORTB->PCR[17] = PORT_PCR_MUX(3);
 
+#if UART_RX_DMA
+    // Receive data full requests the DMA channel, overrun interrupts
+    UART_INSTANCE->C5 |= UART_C5_RDMAS_MASK;
+    UART_INSTANCE->C3 |= UART_C3_ORIE_MASK;
+    rx_dma_start();
+    NVIC_ClearPendingIRQ(RX_DMA_IRQn);
+    NVIC_EnableIRQ(RX_DMA_IRQn);
+#endif
     // Enable receive interrupt
-    UART_INSTANCE->C2 |= UART_C2_RIE_MASK;
+    UART_INSTANCE->C2 |= RX_IE_MASK;
     NVIC_ClearPendingIRQ(UART_IRQ);
     NVIC_EnableIRQ(UART_IRQ);
 
@@ -89,7 +215,10 @@ int32_t uart_uninitialize(void)
     // transmitter and receiver disabled
     UART_INSTANCE->C2 &= ~(UART_C2_RE_MASK | UART_C2_TE_MASK);
     // disable interrupt
-    UART_INSTANCE->C2 &= ~(UART_C2_RIE_MASK | UART_C2_TIE_MASK);
+    UART_INSTANCE->C2 &= ~(RX_IE_MASK | UART_C2_TIE_MASK);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
     clear_buffers();
     return 1;
 }
@@ -100,7 +229,13 @@ int32_t uart_reset(void)
     NVIC_DisableIRQ(UART_IRQ);
     // disable TIE interrupt
     UART_INSTANCE->C2 &= ~(UART_C2_TIE_MASK);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
     clear_buffers();
+#if UART_RX_DMA
+    rx_dma_start();
+#endif
     // enable interrupt
     NVIC_EnableIRQ(UART_IRQ);
     return 1;
@@ -114,9 +249,12 @@ int32_t uart_set_configuration(UART_Configuration *config)
     uint32_t dll;
     // disable interrupt
     NVIC_DisableIRQ(UART_IRQ);
-    UART_INSTANCE->C2 &= ~(UART_C2_RIE_MASK | UART_C2_TIE_MASK);
+    UART_INSTANCE->C2 &= ~(RX_IE_MASK | UART_C2_TIE_MASK);
     // Disable receiver and transmitter while updating
     UART_INSTANCE->C2 &= ~(UART_C2_RE_MASK | UART_C2_TE_MASK);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
     clear_buffers();
 
     // set data bits, stop bits, parity
@@ -143,8 +281,9 @@ int32_t uart_set_configuration(UART_Configuration *config)
         parity_type = 0;
     }
 
-    // data bits, parity and parity mode
-    UART_INSTANCE->C1 = data_bits << UART_C1_M_SHIFT
+    // data bits, parity and parity mode, idle line counted after the stop bit
+    UART_INSTANCE->C1 = UART_C1_ILT_MASK
+                | data_bits << UART_C1_M_SHIFT
                 | parity_enable << UART_C1_PE_SHIFT
                 | parity_type << UART_C1_PT_SHIFT;
     dll =  SystemCoreClock / (16 * config->Baudrate);
@@ -156,7 +295,10 @@ int32_t uart_set_configuration(UART_Configuration *config)
     // Enable UART interrupt
     NVIC_ClearPendingIRQ(UART_IRQ);
     NVIC_EnableIRQ(UART_IRQ);
-    UART_INSTANCE->C2 |= UART_C2_RIE_MASK;
+#if UART_RX_DMA
+    rx_dma_start();
+#endif
+    UART_INSTANCE->C2 |= RX_IE_MASK;
     return 1;
 }
 
@@ -176,6 +318,7 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint32_t cnt;
 
     cnt = circ_buf_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     // Atomically enable TX
     state = cortex_int_get_and_disable();
@@ -187,11 +330,32 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     return cnt;
 }
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART0_RX_TX_IRQHandler(void)
 {
     uint32_t s1;
@@ -199,9 +363,17 @@ void UART0_RX_TX_IRQHandler(void)
     // read interrupt status
     s1 = UART_INSTANCE->S1;
     // mask off interrupts that are not enabled
+#if UART_RX_DMA
+    // Receive data full requests the DMA channel
+    s1 &= ~UART_S1_RDRF_MASK;
+    if (!(UART_INSTANCE->C2 & UART_C2_ILIE_MASK)) {
+        s1 &= ~UART_S1_IDLE_MASK;
+    }
+#else
     if (!(UART_INSTANCE->C2 & UART_C2_RIE_MASK)) {
         s1 &= ~UART_S1_RDRF_MASK;
     }
+#endif
     if (!(UART_INSTANCE->C2 & UART_C2_TIE_MASK)) {
         s1 &= ~UART_S1_TDRE_MASK;
     }
@@ -217,26 +389,43 @@ void UART0_RX_TX_IRQHandler(void)
         if (circ_buf_count_used(&write_buffer) == 0) {
             // disable TIE interrupt
             UART_INSTANCE->C2 &= ~(UART_C2_TIE_MASK);
+            // Let the main task refill the buffer
+            uart_data_event();
         }
     }
 
+#if UART_RX_DMA
+    // Line idle after a burst, or the UART overran while the DMA channel
+    // was held up. Reading D after S1 clears both flags.
+    if (s1 & (UART_S1_IDLE_MASK | UART_S1_OR_MASK)) {
+        errorData = UART_INSTANCE->D;
+        if (s1 & UART_S1_OR_MASK) {
+            stats.RxDropped++;
+        }
+        rx_dma_read();
+    }
+#else
     // handle received character
     if (s1 & UART_S1_RDRF_MASK) {
         if ((s1 & UART_S1_NF_MASK) || (s1 & UART_S1_FE_MASK)) {
             errorData = UART_INSTANCE->D;
         } else {
-            uint32_t free;
-            uint8_t data;
-
-            data = UART_INSTANCE->D;
-            free = circ_buf_count_free(&read_buffer);
-            if (free > RX_OVRF_MSG_SIZE) {
-                circ_buf_push(&read_buffer, data);
-            } else if ((RX_OVRF_MSG_SIZE == free) && config_get_overflow_detect()) {
-                circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
-            } else {
-                // Drop character
-            }
+            uint8_t data = UART_INSTANCE->D;
+            rx_write(&data, 1);
+        }
+
+        // Wake the main task when the first byte lands in an empty buffer
+        if (circ_buf_count_used(&read_buffer) == 1) {
+            uart_data_event();
         }
     }
+#endif
+}
+
+#if UART_RX_DMA
+void RX_DMA_IRQHandler(void)
+{
+    DMA0->CINT = DMA_CINT_CINT(RX_DMA_CHANNEL);
+    rx_dma_read();
 }
+#endif
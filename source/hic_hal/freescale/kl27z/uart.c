@@ -26,17 +26,22 @@
 #include "cortex_m.h"
 #include "IO_Config.h"
 #include "circ_buf.h"
+#include "serial_capture.h"
 #include "settings.h" // for config_get_overflow_detect
 #include "fsl_clock.h"
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define BUFFER_SIZE         (512)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (512)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
 
 circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 void clear_buffers(void)
 {
@@ -198,6 +203,7 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint32_t cnt;
 
     cnt = circ_buf_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     // Atomically enable TX
     state = cortex_int_get_and_disable();
@@ -209,6 +215,11 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     return cnt;
 }
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
@@ -219,6 +230,22 @@ void uart_enable_flow_control(bool enabled)
     // Flow control not implemented for this platform
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART_RX_TX_IRQHandler(void)
 {
     uint32_t s1;
@@ -238,6 +265,7 @@ void UART_RX_TX_IRQHandler(void)
     {
         // Clear overrun flag, otherwise the RX does not work.
         UART->STAT = ((UART->STAT & 0x3FE00000U) | LPUART_STAT_OR_MASK);
+        stats.RxDropped++;
 
         if (config_get_overflow_detect()) {
             if (RX_OVRF_MSG_SIZE <= circ_buf_count_free(&read_buffer)) {
@@ -258,6 +286,8 @@ void UART_RX_TX_IRQHandler(void)
             UART->CTRL &= ~(LPUART_CTRL_TIE_MASK);
             // Clear any pending irq that could be triggered before disabling TIE
             NVIC_ClearPendingIRQ(UART_RX_TX_IRQn);
+            // Let the main task refill the buffer
+            uart_data_event();
         }
     }
 
@@ -272,10 +302,12 @@ void UART_RX_TX_IRQHandler(void)
             uint8_t data;
 
             data = UART->DATA;
+            serial_capture_write(&data, 1);
             free = circ_buf_count_free(&read_buffer);
             if (free > RX_OVRF_MSG_SIZE) {
                 circ_buf_push(&read_buffer, data);
             } else if (config_get_overflow_detect()) {
+                stats.RxDropped++;
                 if (RX_OVRF_MSG_SIZE == free) {
                     circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
                 } else {
@@ -283,9 +315,16 @@ void UART_RX_TX_IRQHandler(void)
                 }
             } else {
                 // Drop oldest
+                stats.RxDropped++;
                 circ_buf_pop(&read_buffer);
                 circ_buf_push(&read_buffer, data);
             }
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
+        // Wake the main task when the first byte lands in an empty buffer
+        if (circ_buf_count_used(&read_buffer) == 1) {
+            uart_data_event();
+        }
     }
 }
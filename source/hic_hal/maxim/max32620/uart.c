@@ -21,9 +21,18 @@
 #include "gpio_regs.h"
 #include "uart_regs.h"
 #include "uart.h"
+#include "util.h"
+#include "cortex_m.h"
+#include "serial_capture.h"
 
 // Size must be 2^n
-#define BUFFER_SIZE	(4096)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE	(4096)
+#endif
+#define BUFFER_SIZE	UART_BUFFER_SIZE
+#if (BUFFER_SIZE & (BUFFER_SIZE - 1))
+#error "UART_BUFFER_SIZE must be a power of 2"
+#endif
 
 #define UART_ERRORS (MXC_F_UART_INTFL_RX_FRAMING_ERR | \
                      MXC_F_UART_INTFL_RX_PARITY_ERR | \
@@ -46,6 +55,8 @@ static struct {
     volatile  int16_t cnt_out;
 } write_buffer, read_buffer;
 
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
+
 /******************************************************************************/
 static void set_bitrate(uint32_t bps)
 {
@@ -254,9 +265,16 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
             break;
         }
     }
+    stats.TxHighWater = MAX(stats.TxHighWater, (uint16_t)(write_buffer.cnt_in - write_buffer.cnt_out));
     return size - xfer_count;
 }
 
+/******************************************************************************/
+int32_t uart_read_used(void)
+{
+    return (uint16_t)(read_buffer.cnt_in - read_buffer.cnt_out);
+}
+
 /******************************************************************************/
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
@@ -271,15 +289,36 @@ int32_t uart_read_data(uint8_t *data, uint16_t size)
     return cnt;
 }
 
+/******************************************************************************/
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+/******************************************************************************/
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 /******************************************************************************/
 void UART0_IRQHandler(void)
 {
     /* Capture interrupt flag state at entry */
     uint32_t intfl = CdcAcmUart->intfl;
+    /* Only wake the main task for data arriving in an empty read buffer */
+    int rx_was_empty = (read_buffer.cnt_in == read_buffer.cnt_out);
     /* Clear interrupts that will be serviced */
     CdcAcmUart->intfl = intfl;
 
     if (intfl & MXC_F_UART_INTFL_RX_FIFO_OVERFLOW) {
+            stats.RxDropped++;
             read_buffer.data[read_buffer.idx_in++] = '*';
             read_buffer.idx_in &= (BUFFER_SIZE - 1);
             read_buffer.cnt_in++;
@@ -288,16 +327,20 @@ void UART0_IRQHandler(void)
     if (intfl & (MXC_F_UART_INTFL_RX_FIFO_NOT_EMPTY | UART_ERRORS)) {
         while ((CdcAcmUart->rx_fifo_ctrl & MXC_F_UART_RX_FIFO_CTRL_FIFO_ENTRY) &&
              ((read_buffer.cnt_in - read_buffer.cnt_out) < BUFFER_SIZE)) {
-            read_buffer.data[read_buffer.idx_in++] = CdcAcmUartFifo->rx;
+            uint8_t data = CdcAcmUartFifo->rx;
+            serial_capture_write(&data, 1);
+            read_buffer.data[read_buffer.idx_in++] = data;
             CdcAcmUart->intfl = MXC_F_UART_INTFL_RX_FIFO_NOT_EMPTY;
             read_buffer.idx_in &= (BUFFER_SIZE - 1);
             read_buffer.cnt_in++;
         }
         if (((read_buffer.cnt_in - read_buffer.cnt_out) >= BUFFER_SIZE)) {
+            stats.RxDropped++;
             read_buffer.data[read_buffer.idx_in++] = '%';
             read_buffer.idx_in &= (BUFFER_SIZE - 1);
             read_buffer.cnt_in++;
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, (uint16_t)(read_buffer.cnt_in - read_buffer.cnt_out));
     }
 
     if (intfl & MXC_F_UART_INTFL_TX_FIFO_AE) {
@@ -312,5 +355,14 @@ void UART0_IRQHandler(void)
             write_buffer.idx_out &= (BUFFER_SIZE - 1);
             write_buffer.cnt_out++;
         }
+
+        /* Let the main task refill the write buffer once it is empty */
+        if (write_buffer.cnt_out == write_buffer.cnt_in) {
+            uart_data_event();
+        }
+    }
+
+    if (rx_was_empty && (read_buffer.cnt_in != read_buffer.cnt_out)) {
+        uart_data_event();
     }
 }
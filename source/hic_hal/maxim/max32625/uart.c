@@ -24,9 +24,15 @@
 #include "pwrman_regs.h"
 #include "uart.h"
 #include "circ_buf.h"
+#include "cortex_m.h"
+#include "util.h"
+#include "serial_capture.h"
 
 // Size must be 2^n
-#define BUFFER_SIZE (4096)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE (4096)
+#endif
+#define BUFFER_SIZE UART_BUFFER_SIZE
 
 // Track bit rate to avoid calculation from bus clock, clock scaler and baud divisor values
 static uint32_t baudrate;
@@ -39,6 +45,7 @@ circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 /******************************************************************************/
 static void set_bitrate(uint32_t target_baud)
@@ -348,17 +355,42 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
         }
     }
 
-    xfer_count = circ_buf_write(&write_buffer, data, xfer_count);
+    xfer_count -= circ_buf_write(&write_buffer, data, xfer_count);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     return size - xfer_count;
 }
 
+/******************************************************************************/
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 /******************************************************************************/
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
 }
 
+/******************************************************************************/
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+/******************************************************************************/
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 /******************************************************************************/
 void UART_IRQHandler(void)
 {
@@ -368,17 +400,29 @@ void UART_IRQHandler(void)
     CdcAcmUart->intfl = intfl;
 
     if (intfl & MXC_F_UART_INTFL_RX_FIFO_OVERFLOW) {
-        // Flush RX FIFO, prepare for new characters
+        // Flush RX FIFO, prepare for new characters. At least one
+        // character was lost.
+        stats.RxDropped++;
         CdcAcmUart->ctrl &= ~MXC_F_UART_CTRL_RX_FIFO_EN;
         CdcAcmUart->ctrl |= MXC_F_UART_CTRL_RX_FIFO_EN;
     }
 
     if (intfl & MXC_F_UART_INTFL_RX_FIFO_NOT_EMPTY) {
+        // Only wake the main task for data arriving in an empty read buffer
+        uint32_t rx_was_empty = (circ_buf_count_used(&read_buffer) == 0);
+
         while ((CdcAcmUart->rx_fifo_ctrl & MXC_F_UART_RX_FIFO_CTRL_FIFO_ENTRY) &&
                 circ_buf_count_free(&read_buffer)) {
-            circ_buf_push(&read_buffer, CdcAcmUartFifo->rx);
+            uint8_t data = CdcAcmUartFifo->rx;
+            serial_capture_write(&data, 1);
+            circ_buf_push(&read_buffer, data);
             CdcAcmUart->intfl = MXC_F_UART_INTFL_RX_FIFO_NOT_EMPTY;
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
+        if (rx_was_empty && circ_buf_count_used(&read_buffer)) {
+            uart_data_event();
+        }
     }
 
     if (intfl & MXC_F_UART_INTFL_TX_FIFO_AE) {
@@ -391,6 +435,11 @@ void UART_IRQHandler(void)
                 (((CdcAcmUart->tx_fifo_ctrl & MXC_F_UART_TX_FIFO_CTRL_FIFO_ENTRY) >> MXC_F_UART_TX_FIFO_CTRL_FIFO_ENTRY_POS) < MXC_UART_FIFO_DEPTH)) {
             CdcAcmUartFifo->tx = circ_buf_pop(&write_buffer);
         }
+
+        // Let the main task refill the write buffer once it is empty
+        if (circ_buf_count_used(&write_buffer) == 0) {
+            uart_data_event();
+        }
     }
 }
 
@@ -23,12 +23,17 @@
 #include "uart.h"
 #include "gpio.h"
 #include "util.h"
+#include "cortex_m.h"
 #include "circ_buf.h"
+#include "serial_capture.h"
 #include "NuMicro.h"
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define BUFFER_SIZE         (512)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (512)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
 
 #define TX_FIFO_SIZE        16 /* TX Hardware FIFO size */
 
@@ -36,6 +41,7 @@ circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 static UART_Configuration configuration = {
     .Baudrate = 9600,
@@ -156,6 +162,8 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint8_t bInChar;
     uint32_t u32Size = circ_buf_write(&write_buffer, data, size);
 
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
+
     if (circ_buf_count_used(&write_buffer) > 0) {
         if ((UART0->INTEN & UART_INTEN_THREIEN_Msk) == 0) {
             bInChar = circ_buf_pop(&write_buffer);
@@ -169,11 +177,32 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     return u32Size;
 }
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART0_IRQHandler(void)
 {
     uint8_t bInChar;
@@ -183,10 +212,14 @@ void UART0_IRQHandler(void)
 
     if ((u32IntStatus & UART_INTSTS_RDAINT_Msk) || (u32IntStatus & UART_INTSTS_RXTOINT_Msk)) {
         /* Receiver FIFO threshold level is reached or Rx time out */
+        /* Only wake the main task for data arriving in an empty buffer */
+        uint32_t u32WasEmpty = (circ_buf_count_used(&read_buffer) == 0);
+
         /* Get all the input characters */
         while ((!UART_GET_RX_EMPTY(UART0))) {
             /* Get the character from UART Buffer */
             bInChar = UART_READ(UART0); /* Rx trigger level is 1 byte*/
+            serial_capture_write(&bInChar, 1);
             /* Check if buffer full */
             uint32_t u32Free = circ_buf_count_free(&read_buffer);
 
@@ -194,10 +227,17 @@ void UART0_IRQHandler(void)
                 circ_buf_push(&read_buffer, bInChar);
             } else if (RX_OVRF_MSG_SIZE == u32Free) {
                 circ_buf_write(&read_buffer, (uint8_t *)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
+                stats.RxDropped++;
             } else {
                 // Drop character
+                stats.RxDropped++;
             }
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
+        if (u32WasEmpty && circ_buf_count_used(&read_buffer)) {
+            uart_data_event();
+        }
     }
 
     if (u32IntStatus & UART_INTSTS_THREINT_Msk) {
@@ -217,6 +257,8 @@ void UART0_IRQHandler(void)
         } else {
             /* No more data, just stop Tx (Stop work) */
             UART0->INTEN &= ~UART_INTEN_THREIEN_Msk;
+            /* Let the main task refill the buffer */
+            uart_data_event();
         }
     }
 }
@@ -22,7 +22,9 @@
 #include "LPC11Uxx.h"
 #include "uart.h"
 #include "util.h"
+#include "cortex_m.h"
 #include "circ_buf.h"
+#include "serial_capture.h"
 #include "settings.h" // for config_get_overflow_detect
 
 static uint32_t baudrate;
@@ -33,12 +35,16 @@ extern uint32_t SystemCoreClock;
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define BUFFER_SIZE         (64)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (64)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
 
 circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 static uint8_t flow_control_enabled = 0;
 
@@ -270,6 +276,7 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint32_t cnt;
 
     cnt = circ_buf_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     // enable THRE interrupt
     LPC_USART->IER |= (1 << 1);
@@ -283,6 +290,11 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
 }
 
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
@@ -293,6 +305,22 @@ void uart_enable_flow_control(bool enabled)
     flow_control_enabled = (uint8_t)enabled;
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART_IRQHandler(void)
 {
     uint32_t iir;
@@ -311,20 +339,27 @@ void UART_IRQHandler(void)
         tx_in_progress = 0;
         // disable THRE interrupt
         LPC_USART->IER &= ~(1 << 1);
+        // Let the main task refill the buffer
+        uart_data_event();
     }
 
     // handle received character
     if (((iir & 0x0E) == 0x04)  ||        // Rx interrupt (RDA)
             ((iir & 0x0E) == 0x0C))  {        // Rx interrupt (CTI)
+        // Only wake the main task for data arriving in an empty buffer
+        bool rx_was_empty = (circ_buf_count_used(&read_buffer) == 0);
+
         while (LPC_USART->LSR & 0x01) {
             uint32_t free;
             uint8_t data;
             
             data = LPC_USART->RBR;
+            serial_capture_write(&data, 1);
             free = circ_buf_count_free(&read_buffer);
             if (free > RX_OVRF_MSG_SIZE) {
                 circ_buf_push(&read_buffer, data);
             } else if (config_get_overflow_detect()) {
+                stats.RxDropped++;
                 if (RX_OVRF_MSG_SIZE == free) {
                     circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
                 } else {
@@ -332,10 +367,16 @@ void UART_IRQHandler(void)
                 }
             } else {
                 // Drop oldest
+                stats.RxDropped++;
                 circ_buf_pop(&read_buffer);
                 circ_buf_push(&read_buffer, data);
             }
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
+        if (rx_was_empty && circ_buf_count_used(&read_buffer)) {
+            uart_data_event();
+        }
     }
 
     LPC_USART->LSR;
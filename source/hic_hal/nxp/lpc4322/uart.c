@@ -24,7 +24,9 @@
 #include "lpc43xx_cgu.h"
 #include "lpc43xx_scu.h"
 #include "util.h"
+#include "cortex_m.h"
 #include "circ_buf.h"
+#include "serial_capture.h"
 #include "settings.h" // for config_get_overflow_detect
 
 static uint32_t baudrate;
@@ -35,12 +37,16 @@ extern uint32_t SystemCoreClock;
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define  BUFFER_SIZE    (512)
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (512)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
 
 circ_buf_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
 circ_buf_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
 
 static int32_t reset(void);
 
@@ -70,7 +76,7 @@ int32_t uart_initialize(void)
     //   UARTCTRL low:   The LPC1549 gets uart input from the ISP_RX on the pinlist
     LPC_GPIO_PORT->CLR[PORT_UARTCTRL] = PIN_UARTCTRL;
     LPC_GPIO_PORT->DIR[PORT_UARTCTRL] |= (PIN_UARTCTRL);
-    // enable FIFOs (trigger level 1) and clear them
+    // enable FIFOs (trigger level 2, 8 characters) and clear them
     LPC_USART->FCR = 0x87;
     // Transmit Enable
     LPC_USART->TER     = 0x01;
@@ -267,6 +273,7 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
     uint32_t cnt;
 
     cnt = circ_buf_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_count_used(&write_buffer));
 
     // Make sure that the target LPC1549 can receive the output
     LPC_GPIO_PORT->SET[PORT_UARTCTRL] = PIN_UARTCTRL;
@@ -283,6 +290,11 @@ int32_t uart_write_data(uint8_t *data, uint16_t size)
 }
 
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
     return circ_buf_read(&read_buffer, data, size);
@@ -293,6 +305,22 @@ void uart_enable_flow_control(bool enabled)
     // Flow control not implemented for this platform
 }
 
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
+}
+
 void UART_IRQHandler(void)
 {
     uint32_t iir;
@@ -313,20 +341,27 @@ void UART_IRQHandler(void)
         LPC_GPIO_PORT->CLR[PORT_UARTCTRL] = PIN_UARTCTRL;
         // disable THRE interrupt
         LPC_USART->IER &= ~(1 << 1);
+        // Let the main task refill the buffer
+        uart_data_event();
     }
 
     // handle received character
     if (((iir & 0x0E) == 0x04)  ||        // Rx interrupt (RDA)
             ((iir & 0x0E) == 0x0C))  {        // Rx interrupt (CTI)
+        // Only wake the main task for data arriving in an empty buffer
+        bool rx_was_empty = (circ_buf_count_used(&read_buffer) == 0);
+
         while (LPC_USART->LSR & 0x01) {
             uint32_t free;
             uint8_t data;
 
             data = LPC_USART->RBR;
+            serial_capture_write(&data, 1);
             free = circ_buf_count_free(&read_buffer);
             if (free > RX_OVRF_MSG_SIZE) {
                 circ_buf_push(&read_buffer, data);
             } else if (config_get_overflow_detect()) {
+                stats.RxDropped++;
                 if (RX_OVRF_MSG_SIZE == free) {
                     circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
                 } else {
@@ -334,10 +369,16 @@ void UART_IRQHandler(void)
                 }
             } else {
                 // Drop oldest
+                stats.RxDropped++;
                 circ_buf_pop(&read_buffer);
                 circ_buf_push(&read_buffer, data);
             }
         }
+        stats.RxHighWater = MAX(stats.RxHighWater, circ_buf_count_used(&read_buffer));
+
+        if (rx_was_empty && circ_buf_count_used(&read_buffer)) {
+            uart_data_event();
+        }
     }
 
     LPC_USART->LSR;
@@ -345,8 +386,10 @@ void UART_IRQHandler(void)
 
 static int32_t reset(void)
 {
-    // Reset FIFOs
-    LPC_USART->FCR = 0x06;
+    // Reset FIFOs. They stay enabled, so a receive interrupt comes every
+    // 8 characters, or from the character timeout at the end of a burst,
+    // instead of for each character.
+    LPC_USART->FCR = 0x87;
     baudrate  = 0;
     dll       = 0;
     tx_in_progress = 0;
@@ -25,9 +25,19 @@
 #include "uart.h"
 #include "gpio.h"
 #include "util.h"
+#include "cortex_m.h"
 #include "circ_buf.h"
+#include "dma_ring.h"
+#include "serial_capture.h"
 #include "IO_Config.h"
 
+// Received characters are moved from the USART by DMA instead of one
+// interrupt each. The half and full transfer interrupts and the idle
+// line interrupt at the end of a burst copy them to read_buffer.
+#ifndef UART_RX_DMA
+#define UART_RX_DMA                  1
+#endif
+
 // For usart
 #define CDC_UART                     USART2
 #define CDC_UART_ENABLE()            __HAL_RCC_USART2_CLK_ENABLE()
@@ -35,6 +45,19 @@
 #define CDC_UART_IRQn                USART2_IRQn
 #define CDC_UART_IRQn_Handler        USART2_IRQHandler
 
+// USART2 RX requests are served by DMA1 channel 6
+#define CDC_UART_RX_DMA              DMA1_Channel6
+#define CDC_UART_RX_DMA_ENABLE()     __HAL_RCC_DMA1_CLK_ENABLE()
+#define CDC_UART_RX_DMA_CLEAR()      (DMA1->IFCR = DMA_IFCR_CGIF6)
+#define CDC_UART_RX_DMA_IRQn         DMA1_Channel6_IRQn
+#define CDC_UART_RX_DMA_IRQn_Handler DMA1_Channel6_IRQHandler
+
+#if UART_RX_DMA
+#define CDC_UART_RX_IT               USART_CR1_IDLEIE
+#else
+#define CDC_UART_RX_IT               USART_IT_RXNE
+#endif
+
 #define UART_PINS_PORT_ENABLE()      __HAL_RCC_GPIOA_CLK_ENABLE()
 #define UART_PINS_PORT_DISABLE()     __HAL_RCC_GPIOA_CLK_DISABLE()
 
@@ -53,12 +76,35 @@
 
 #define RX_OVRF_MSG         "<DAPLink:Overflow>\n"
 #define RX_OVRF_MSG_SIZE    (sizeof(RX_OVRF_MSG) - 1)
-#define BUFFER_SIZE         (512)
-
-circ_buf_t write_buffer;
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE    (512)
+#endif
+#define BUFFER_SIZE         UART_BUFFER_SIZE
+#if (BUFFER_SIZE & (BUFFER_SIZE - 1))
+#error "UART_BUFFER_SIZE must be a power of 2"
+#endif
+// Characters the DMA channel can take before read_buffer is updated. The
+// interrupts at each half must be served within RX_DMA_SIZE / 2 characters.
+#define RX_DMA_SIZE         (128)
+
+// With flow control on, RTS asks the target to stop sending once the read
+// buffer is this full. The rest of the buffer takes the bytes the target
+// sends before it sees RTS. Sending resumes when the buffer has drained.
+#define RX_HIGH_WATER       (BUFFER_SIZE * 3 / 4)
+#define RX_LOW_WATER        (BUFFER_SIZE / 4)
+
+// The interrupt handler is the only consumer of write_buffer and the
+// only producer of read_buffer, so they need no critical sections
+circ_buf_spsc_t write_buffer;
 uint8_t write_buffer_data[BUFFER_SIZE];
-circ_buf_t read_buffer;
+circ_buf_spsc_t read_buffer;
 uint8_t read_buffer_data[BUFFER_SIZE];
+static UART_Statistics stats = {BUFFER_SIZE, BUFFER_SIZE, 0, 0, 0};
+
+#if UART_RX_DMA
+static dma_ring_t rx_dma_ring;
+uint8_t rx_dma_data[RX_DMA_SIZE];
+#endif
 
 static UART_Configuration configuration = {
     .Baudrate = 9600,
@@ -68,25 +114,122 @@ static UART_Configuration configuration = {
     .FlowControl = UART_FLOW_CONTROL_NONE,
 };
 
+// Flow control turned on by the board regardless of the configuration
+static bool flow_control_enabled;
+// RTS as set by the host with SET_CONTROL_LINE_STATE
+static bool host_rts = true;
+// RTS released because the read buffer is nearly full
+static volatile bool rx_throttled;
+
 extern uint32_t SystemCoreClock;
 
+// RTS and CTS are active low. Without flow control RTS stays asserted.
+static void update_rts(void)
+{
+    bool ready = (configuration.FlowControl != UART_FLOW_CONTROL_RTS_CTS) ||
+                 (host_rts && !rx_throttled);
+    HAL_GPIO_WritePin(UART_RTS_PORT, UART_RTS_PIN, ready ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+
+
+// Add received characters to read_buffer. The last few free bytes are
+// kept for the overflow message and characters that do not fit are dropped.
+static void rx_write(const uint8_t *data, uint32_t size)
+{
+    uint32_t free = circ_buf_spsc_count_free(&read_buffer);
+    uint32_t cnt = 0;
+
+    serial_capture_write(data, size);
+
+    if (free > RX_OVRF_MSG_SIZE) {
+        cnt = MIN(size, free - RX_OVRF_MSG_SIZE);
+        circ_buf_spsc_write(&read_buffer, data, cnt);
+        free -= cnt;
+    }
+    if ((cnt < size) && (RX_OVRF_MSG_SIZE == free)) {
+        circ_buf_spsc_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
+    }
+    stats.RxDropped += size - cnt;
+}
+
+// Called by the interrupt handlers after adding to read_buffer
+static void rx_written(bool rx_was_empty)
+{
+    uint32_t used = circ_buf_spsc_count_used(&read_buffer);
+
+    stats.RxHighWater = MAX(stats.RxHighWater, used);
+
+    // Wake the main task when the first bytes land in an empty buffer
+    if (rx_was_empty && (used > 0)) {
+        uart_data_event();
+    }
+
+    if ((configuration.FlowControl == UART_FLOW_CONTROL_RTS_CTS) && !rx_throttled &&
+            (used >= RX_HIGH_WATER)) {
+        rx_throttled = true;
+        update_rts();
+    }
+}
+
+#if UART_RX_DMA
+// Start the DMA channel at the beginning of rx_dma_data
+static void rx_dma_start(void)
+{
+    CDC_UART_RX_DMA->CCR = 0;
+    CDC_UART_RX_DMA_CLEAR();
+    CDC_UART_RX_DMA->CPAR = (uint32_t)&CDC_UART->DR;
+    CDC_UART_RX_DMA->CMAR = (uint32_t)rx_dma_data;
+    CDC_UART_RX_DMA->CNDTR = sizeof(rx_dma_data);
+    dma_ring_init(&rx_dma_ring, rx_dma_data, sizeof(rx_dma_data));
+    // Bytes from the data register to incrementing memory addresses
+    CDC_UART_RX_DMA->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PL_1 |
+                           DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+    CDC_UART->CR3 |= USART_CR3_DMAR;
+}
+
+static void rx_dma_stop(void)
+{
+    CDC_UART->CR3 &= ~USART_CR3_DMAR;
+    CDC_UART_RX_DMA->CCR = 0;
+    CDC_UART_RX_DMA_CLEAR();
+}
+
+// Copy everything the DMA channel received to read_buffer
+static void rx_dma_read(void)
+{
+    bool rx_was_empty = (circ_buf_spsc_count_used(&read_buffer) == 0);
+    uint8_t *data;
+    uint32_t cnt;
+
+    while ((cnt = dma_ring_peek_read(&rx_dma_ring, CDC_UART_RX_DMA->CNDTR, &data)) > 0) {
+        rx_write(data, cnt);
+        dma_ring_commit_read(&rx_dma_ring, cnt);
+    }
 
+    rx_written(rx_was_empty);
+}
+#endif
 
 static void clear_buffers(void)
 {
-    circ_buf_init(&write_buffer, write_buffer_data, sizeof(write_buffer_data));
-    circ_buf_init(&read_buffer, read_buffer_data, sizeof(read_buffer_data));
+    circ_buf_spsc_init(&write_buffer, write_buffer_data, sizeof(write_buffer_data));
+    circ_buf_spsc_init(&read_buffer, read_buffer_data, sizeof(read_buffer_data));
+    rx_throttled = false;
 }
 
 int32_t uart_initialize(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
 
-    CDC_UART->CR1 &= ~(USART_IT_TXE | USART_IT_RXNE);
+    CDC_UART->CR1 &= ~(USART_IT_TXE | CDC_UART_RX_IT);
     clear_buffers();
 
     CDC_UART_ENABLE();
     UART_PINS_PORT_ENABLE();
+#if UART_RX_DMA
+    CDC_UART_RX_DMA_ENABLE();
+#endif
 
     //TX pin
     GPIO_InitStructure.Pin = UART_TX_PIN;
@@ -105,21 +248,27 @@ int32_t uart_initialize(void)
     GPIO_InitStructure.Mode = GPIO_MODE_INPUT;
     GPIO_InitStructure.Pull = GPIO_PULLUP;
     HAL_GPIO_Init(UART_CTS_PORT, &GPIO_InitStructure);
-    //RTS pin, output low
-    HAL_GPIO_WritePin(UART_RTS_PORT, UART_RTS_PIN, GPIO_PIN_RESET);
+    //RTS pin, output low unless flow control released it
+    update_rts();
     GPIO_InitStructure.Pin = UART_RTS_PIN;
     GPIO_InitStructure.Speed = GPIO_SPEED_FREQ_HIGH;
     GPIO_InitStructure.Mode = GPIO_MODE_OUTPUT_PP;
     HAL_GPIO_Init(UART_RTS_PORT, &GPIO_InitStructure);
 
     NVIC_EnableIRQ(CDC_UART_IRQn);
+#if UART_RX_DMA
+    NVIC_EnableIRQ(CDC_UART_RX_DMA_IRQn);
+#endif
 
     return 1;
 }
 
 int32_t uart_uninitialize(void)
 {
-    CDC_UART->CR1 &= ~(USART_IT_TXE | USART_IT_RXNE);
+    CDC_UART->CR1 &= ~(USART_IT_TXE | CDC_UART_RX_IT);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
     clear_buffers();
     return 1;
 }
@@ -127,8 +276,16 @@ int32_t uart_uninitialize(void)
 int32_t uart_reset(void)
 {
     const uint32_t cr1 = CDC_UART->CR1;
-    CDC_UART->CR1 = cr1 & ~(USART_IT_TXE | USART_IT_RXNE);
+    CDC_UART->CR1 = cr1 & ~(USART_IT_TXE | CDC_UART_RX_IT);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
     clear_buffers();
+#if UART_RX_DMA
+    if (cr1 & CDC_UART_RX_IT) {
+        rx_dma_start();
+    }
+#endif
     CDC_UART->CR1 = cr1 & ~USART_IT_TXE;
     return 1;
 }
@@ -176,9 +333,15 @@ int32_t uart_set_configuration(UART_Configuration *config)
         uart_handle.Init.WordLength = UART_WORDLENGTH_8B;
     }
 
-    // No flow control
-    configuration.FlowControl = UART_FLOW_CONTROL_NONE;
-    uart_handle.Init.HwFlowCtl  = UART_HWCONTROL_NONE;
+    // The USART stops transmitting while CTS is high. RTS is a GPIO
+    // driven from the read buffer level.
+    if (flow_control_enabled || (config->FlowControl == UART_FLOW_CONTROL_RTS_CTS)) {
+        configuration.FlowControl = UART_FLOW_CONTROL_RTS_CTS;
+        uart_handle.Init.HwFlowCtl = UART_HWCONTROL_CTS;
+    } else {
+        configuration.FlowControl = UART_FLOW_CONTROL_NONE;
+        uart_handle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    }
     
     // Specified baudrate
     configuration.Baudrate = config->Baudrate;
@@ -188,7 +351,10 @@ int32_t uart_set_configuration(UART_Configuration *config)
     uart_handle.Init.Mode = UART_MODE_TX_RX;
     
     // Disable uart and tx/rx interrupt
-    CDC_UART->CR1 &= ~(USART_IT_TXE | USART_IT_RXNE);
+    CDC_UART->CR1 &= ~(USART_IT_TXE | CDC_UART_RX_IT);
+#if UART_RX_DMA
+    rx_dma_stop();
+#endif
 
     clear_buffers();
 
@@ -197,8 +363,12 @@ int32_t uart_set_configuration(UART_Configuration *config)
     status = HAL_UART_Init(&uart_handle);
     util_assert(HAL_OK == status);
     (void)status;
+    update_rts();
 
-    CDC_UART->CR1 |= USART_IT_RXNE;
+#if UART_RX_DMA
+    rx_dma_start();
+#endif
+    CDC_UART->CR1 |= CDC_UART_RX_IT;
 
     return 1;
 }
@@ -209,50 +379,115 @@ int32_t uart_get_configuration(UART_Configuration *config)
     config->DataBits = configuration.DataBits;
     config->Parity   = configuration.Parity;
     config->StopBits = configuration.StopBits;
-    config->FlowControl = UART_FLOW_CONTROL_NONE;
+    config->FlowControl = configuration.FlowControl;
 
     return 1;
 }
 
+void uart_set_control_line_state(uint16_t ctrl_bmp)
+{
+    host_rts = (ctrl_bmp & (1 << 1)) != 0;
+    update_rts();
+}
+
+void uart_enable_flow_control(bool enabled)
+{
+    flow_control_enabled = enabled;
+
+    if (enabled) {
+        configuration.FlowControl = UART_FLOW_CONTROL_RTS_CTS;
+        CDC_UART->CR3 |= USART_CR3_CTSE;
+    } else {
+        configuration.FlowControl = UART_FLOW_CONTROL_NONE;
+        CDC_UART->CR3 &= ~USART_CR3_CTSE;
+        rx_throttled = false;
+    }
+
+    update_rts();
+}
+
 int32_t uart_write_free(void)
 {
-    return circ_buf_count_free(&write_buffer);
+    return circ_buf_spsc_count_free(&write_buffer);
 }
 
 int32_t uart_write_data(uint8_t *data, uint16_t size)
 {
-    uint32_t cnt = circ_buf_write(&write_buffer, data, size);
+    uint32_t cnt = circ_buf_spsc_write(&write_buffer, data, size);
+    stats.TxHighWater = MAX(stats.TxHighWater, circ_buf_spsc_count_used(&write_buffer));
     CDC_UART->CR1 |= USART_IT_TXE;
 
     return cnt;
 }
 
+int32_t uart_read_used(void)
+{
+    return circ_buf_spsc_count_used(&read_buffer);
+}
+
 int32_t uart_read_data(uint8_t *data, uint16_t size)
 {
-    return circ_buf_read(&read_buffer, data, size);
+    int32_t cnt = circ_buf_spsc_read(&read_buffer, data, size);
+
+    if (rx_throttled && (circ_buf_spsc_count_used(&read_buffer) <= RX_LOW_WATER)) {
+        rx_throttled = false;
+        update_rts();
+    }
+
+    return cnt;
+}
+
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    *statistics = stats;
+    cortex_int_restore(state);
+}
+
+void uart_clear_statistics(void)
+{
+    cortex_int_state_t state = cortex_int_get_and_disable();
+    stats.RxHighWater = 0;
+    stats.TxHighWater = 0;
+    stats.RxDropped = 0;
+    cortex_int_restore(state);
 }
 
 void CDC_UART_IRQn_Handler(void)
 {
     const uint32_t sr = CDC_UART->SR;
 
+#if UART_RX_DMA
+    if ((sr & USART_SR_IDLE) && (CDC_UART->CR1 & USART_CR1_IDLEIE)) {
+        // Reading DR after SR clears IDLE. The DMA channel has already
+        // taken the last character, so nothing is lost.
+        (void)CDC_UART->DR;
+        rx_dma_read();
+    }
+#else
     if (sr & USART_SR_RXNE) {
+        bool rx_was_empty = (circ_buf_spsc_count_used(&read_buffer) == 0);
         uint8_t dat = CDC_UART->DR;
-        uint32_t free = circ_buf_count_free(&read_buffer);
-        if (free > RX_OVRF_MSG_SIZE) {
-            circ_buf_push(&read_buffer, dat);
-        } else if (RX_OVRF_MSG_SIZE == free) {
-            circ_buf_write(&read_buffer, (uint8_t*)RX_OVRF_MSG, RX_OVRF_MSG_SIZE);
-        } else {
-            // Drop character
-        }
+        rx_write(&dat, 1);
+        rx_written(rx_was_empty);
     }
+#endif
 
-    if (sr & USART_SR_TXE) {
-        if (circ_buf_count_used(&write_buffer) > 0) {
-            CDC_UART->DR = circ_buf_pop(&write_buffer);
+    if ((sr & USART_SR_TXE) && (CDC_UART->CR1 & USART_CR1_TXEIE)) {
+        if (circ_buf_spsc_count_used(&write_buffer) > 0) {
+            CDC_UART->DR = circ_buf_spsc_pop(&write_buffer);
         } else {
             CDC_UART->CR1 &= ~USART_IT_TXE;
+            // Let the main task refill the buffer
+            uart_data_event();
         }
     }
 }
+
+#if UART_RX_DMA
+void CDC_UART_RX_DMA_IRQn_Handler(void)
+{
+    CDC_UART_RX_DMA_CLEAR();
+    rx_dma_read();
+}
+#endif
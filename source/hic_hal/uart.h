@@ -70,6 +70,18 @@ typedef struct {
     UART_FlowControl   FlowControl;
 } UART_Configuration;
 
+/* UART buffer statistics structure. The high water marks and dropped
+   count cover the time since the statistics were last cleared, which
+   is not done by uart_reset, so data lost before the host opens the
+   port still shows up. */
+typedef struct {
+    uint32_t           RxBufferSize;    /* Size of the read buffer */
+    uint32_t           TxBufferSize;    /* Size of the write buffer */
+    uint32_t           RxHighWater;     /* Most bytes held in the read buffer */
+    uint32_t           TxHighWater;     /* Most bytes held in the write buffer */
+    uint32_t           RxDropped;       /* Received bytes lost to a full read buffer */
+} UART_Statistics;
+
 /*-----------------------------------------------------------------------------
  * FUNCTION PROTOTYPES
  *----------------------------------------------------------------------------*/
@@ -82,10 +94,18 @@ extern int32_t uart_set_configuration(UART_Configuration *config);
 extern int32_t uart_get_configuration(UART_Configuration *config);
 extern int32_t uart_write_free(void);
 extern int32_t uart_write_data(uint8_t *data, uint16_t size);
+extern int32_t uart_read_used(void);
 extern int32_t uart_read_data(uint8_t *data, uint16_t size);
 extern void uart_set_control_line_state(uint16_t ctrl_bmp);
 extern void uart_software_flow_control(void);
 extern void uart_enable_flow_control(bool enabled);
+extern void uart_get_statistics(UART_Statistics *statistics);
+extern void uart_clear_statistics(void);
+
+/* Called by the UART driver from its interrupt handler when received data
+   arrives in an empty read buffer or the write buffer has drained, so the
+   USB to UART bridge only runs when there is work for it */
+extern void uart_data_event(void);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,9 @@
 #include "RTL.h"
 #include "cortex_m.h"
 
+// Kernel tick counter, from rt_Time.h
+extern U32 os_time;
+
 #define MAIN_TASK_PRIORITY      (10)
 #define MAIN_TASK_STACK         (800)
 static uint64_t stk_main_task [MAIN_TASK_STACK / sizeof(uint64_t)];
@@ -134,8 +137,39 @@ osStatus_t osDelay(uint32_t ticks)
     return osOK;
 }
 
+uint32_t osKernelGetTickCount(void)
+{
+    return os_time;
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return 1000000 / OS_TICK;
+}
+
 uint32_t osKernelGetSysTimerCount(void)
 {
-    return os_time_get();
+    cortex_int_state_t state;
+    uint32_t tick;
+    uint32_t val;
+
+    // Combine the kernel tick with the SysTick counter. With interrupts
+    // masked the counter can wrap before the tick is counted, so a pending
+    // SysTick is one more tick.
+    state = cortex_int_get_and_disable();
+    tick = os_time;
+    val = SysTick->VAL;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        val = SysTick->VAL;
+        tick++;
+    }
+    cortex_int_restore(state);
+
+    return tick * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return OS_CLOCK;
 }
 
@@ -21,6 +21,7 @@
 
 #include "SysTick_Handler.h"
 #include "device.h"
+#include "cortex_m.h"
 
 //SysTick Timer Configuration
 #ifndef OS_CLOCK
@@ -105,6 +106,35 @@ uint32_t sysTickTime(void)
     return tick_counter;
 }
 
+uint32_t sysTickCount(void)
+{
+    cortex_int_state_t state;
+    uint32_t tick;
+    uint32_t val;
+    // SysTick_Config loads one less than the count it is given, so take
+    // the period from the timer rather than OS_TRV
+    uint32_t load = SysTick->LOAD;
+
+    // Combine the tick counter with the SysTick counter. With interrupts
+    // masked the counter can wrap before the tick is counted, so a pending
+    // SysTick is one more tick.
+    state = cortex_int_get_and_disable();
+    tick = tick_counter;
+    val = SysTick->VAL;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        val = SysTick->VAL;
+        tick++;
+    }
+    cortex_int_restore(state);
+
+    return tick * (load + 1) + (load - val);
+}
+
+uint32_t sysTickCountFreq(void)
+{
+    return OS_CLOCK;
+}
+
 void sysTickRegMainFunc(osThreadFunc_t func)
 {
     mainFuncCb = func;
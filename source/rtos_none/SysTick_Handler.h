@@ -38,6 +38,8 @@ void sysTickWait(uint32_t wait);
 void sysTickEvtSet(uint32_t flag);
 uint32_t sysTickEvtWaitOr(uint32_t flag);
 uint32_t sysTickTime(void);
+uint32_t sysTickCount(void);
+uint32_t sysTickCountFreq(void);
 void sysTickRegMainFunc(osThreadFunc_t func);
 void sysTickStartMain(void);
 
@@ -87,3 +87,23 @@ osThreadId_t osThreadGetId (void)
 {
     return (osThreadId_t)1;
 }
+
+uint32_t osKernelGetTickCount(void)
+{
+    return sysTickTime();
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return 1000000 / OS_TICK;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    return sysTickCount();
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return sysTickCountFreq();
+}
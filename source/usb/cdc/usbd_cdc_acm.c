@@ -24,6 +24,13 @@
 #include "rl_usb.h"
 #include "usb_for_lib.h"
 
+/* Start Bulk In transfers from USBD_CDC_ACM_DataSend when the endpoint is
+   idle instead of waiting for the next SOF. SOF then only flushes what the
+   immediate start could not send.                                           */
+#ifndef USBD_CDC_ACM_SEND_IMMEDIATE
+#define USBD_CDC_ACM_SEND_IMMEDIATE 0
+#endif
+
 
 /* Module global variables                                                    */
 
@@ -34,6 +41,7 @@
 int32_t data_send_access;              /*!< Flag active while send data (in the send intermediate buffer) is being accessed */
 int32_t data_send_active;              /*!< Flag active while data is being sent */
 int32_t data_send_zlp;                 /*!< Flag active when ZLP needs to be sent */
+int32_t data_send_in_pending;          /*!< Flag active when a Bulk In event arrived while send data was being accessed */
 int32_t data_to_send_wr;               /*!< Number of bytes written to the send intermediate buffer */
 int32_t data_to_send_rd;               /*!< Number of bytes read from the send intermediate buffer */
 uint8_t *ptr_data_to_send;             /*!< Pointer to the send intermediate buffer to the data to be sent */
@@ -83,13 +91,21 @@ __weak int32_t USBD_CDC_ACM_PortSetControlLineState(uint16_t ctrl_bmp)
 /* Functions that can be used by user to use standard Virtual COM port
    functionality                                                              */
 int32_t USBD_CDC_ACM_DataSend(const uint8_t *buf, int32_t len);
+int32_t USBD_CDC_ACM_DataSendPeek(uint8_t **buf);
+int32_t USBD_CDC_ACM_DataSendCommit(int32_t len);
 int32_t USBD_CDC_ACM_PutChar(const uint8_t  ch);
 int32_t USBD_CDC_ACM_DataRead(uint8_t *buf, int32_t len);
+int32_t USBD_CDC_ACM_DataReadPeek(uint8_t **buf);
+int32_t USBD_CDC_ACM_DataReadCommit(int32_t len);
 int32_t USBD_CDC_ACM_GetChar(void);
 __weak int32_t USBD_CDC_ACM_DataReceived(int32_t len)
 {
     return (0);
 }
+__weak int32_t USBD_CDC_ACM_DataSent(int32_t len)
+{
+    return (0);
+}
 int32_t USBD_CDC_ACM_DataAvailable(void);
 int32_t USBD_CDC_ACM_Notify(uint16_t stat);
 
@@ -124,6 +140,9 @@ __weak int32_t USBD_CDC_ACM_SendBreak(uint16_t dur)
 /* Local function prototypes                                                  */
 static void USBD_CDC_ACM_EP_BULKOUT_HandleData(void);
 static void USBD_CDC_ACM_EP_BULKIN_HandleData(void);
+#if (USBD_CDC_ACM_SEND_IMMEDIATE)
+static void USBD_CDC_ACM_EP_BULKIN_Start(void);
+#endif
 
 
 /*----------------- USB CDC ACM class handling functions ---------------------*/
@@ -142,6 +161,7 @@ __weak int32_t USBD_CDC_ACM_Initialize(void)
     data_send_access            = 0;
     data_send_active            = 0;
     data_send_zlp               = 0;
+    data_send_in_pending        = 0;
     data_to_send_wr             = 0;
     data_to_send_rd             = 0;
     ptr_data_to_send            = USBD_CDC_ACM_SendBuf;
@@ -193,6 +213,7 @@ __weak int32_t USBD_CDC_ACM_Reset(void)
     data_send_access            = 0;
     data_send_active            = 0;
     data_send_zlp               = 0;
+    data_send_in_pending        = 0;
     data_to_send_wr             = 0;
     data_to_send_rd             = 0;
     ptr_data_to_send            = USBD_CDC_ACM_SendBuf;
@@ -340,10 +361,65 @@ int32_t USBD_CDC_ACM_DataSend(const uint8_t *buf, int32_t len)
     len += len_before_wrap;               /* Total number of bytes prepared for
                                            send                               */
     data_to_send_wr += len;               /* Bytes prepared to send counter     */
+#if (USBD_CDC_ACM_SEND_IMMEDIATE)
+    USBD_CDC_ACM_EP_BULKIN_Start();       /* Send now if the endpoint is idle   */
+#endif
     return (len);                         /* Number of bytes accepted for send  */
 }
 
 
+/** \brief  Gets space in the send buffer to write data to directly
+
+    The function gets the free space of the send intermediate buffer that
+    can be written without wrapping, so data can be placed there without
+    copying it through another buffer. The data is sent once it is
+    committed with USBD_CDC_ACM_DataSendCommit.
+
+    \param [out]        buf      Pointer to the start of the free space.
+    \return                      Number of bytes that can be written.
+ */
+
+int32_t USBD_CDC_ACM_DataSendPeek(uint8_t **buf)
+{
+    int32_t len_available, len_before_wrap;
+
+    len_available = ((int32_t)usbd_cdc_acm_sendbuf_sz) - (data_to_send_wr - data_to_send_rd);
+    len_before_wrap = USBD_CDC_ACM_SendBuf + usbd_cdc_acm_sendbuf_sz - ptr_data_to_send;
+    *buf = ptr_data_to_send;
+
+    if (len_available > len_before_wrap) {
+        len_available = len_before_wrap;  /* Correct to space before the wrap   */
+    }
+
+    return (len_available);
+}
+
+
+/** \brief  Sends data written to the send buffer
+
+    The function prepares len bytes written to the space returned by
+    USBD_CDC_ACM_DataSendPeek for sending over the Virtual COM Port.
+
+    \param [in]         len      Number of bytes written.
+    \return                      Number of bytes accepted to be sent.
+ */
+
+int32_t USBD_CDC_ACM_DataSendCommit(int32_t len)
+{
+    ptr_data_to_send += len;              /* Correct position of write pointer  */
+
+    if (ptr_data_to_send == USBD_CDC_ACM_SendBuf + usbd_cdc_acm_sendbuf_sz) {
+        ptr_data_to_send = USBD_CDC_ACM_SendBuf;  /* Wrap to the start of buffer */
+    }
+
+    data_to_send_wr += len;               /* Bytes prepared to send counter     */
+#if (USBD_CDC_ACM_SEND_IMMEDIATE)
+    USBD_CDC_ACM_EP_BULKIN_Start();       /* Send now if the endpoint is idle   */
+#endif
+    return (len);
+}
+
+
 /** \brief  Sends a single character over the USB CDC ACM Virtual COM Port
 
     The function puts requested data character to the send intermediate buffer
@@ -395,6 +471,40 @@ int32_t USBD_CDC_ACM_DataRead(uint8_t *buf, int32_t len)
 }
 
 
+/** \brief  Gets data received over the USB CDC ACM Virtual COM Port without copying it
+
+    The function gets the data in the receive intermediate buffer, so it can
+    be used in place. The data stays in the buffer until it is released with
+    USBD_CDC_ACM_DataReadCommit.
+
+    \param [out]        buf      Pointer to the received data.
+    \return                      Number of bytes available.
+ */
+
+int32_t USBD_CDC_ACM_DataReadPeek(uint8_t **buf)
+{
+    *buf = ptr_data_read;
+    return (ptr_data_received - ptr_data_read);
+}
+
+
+/** \brief  Releases data got with USBD_CDC_ACM_DataReadPeek
+
+    \param [in]         len      Number of bytes used.
+    \return                      Number of bytes released.
+ */
+
+int32_t USBD_CDC_ACM_DataReadCommit(int32_t len)
+{
+    if (len > (ptr_data_received - ptr_data_read)) {
+        len = ptr_data_received - ptr_data_read;
+    }
+
+    ptr_data_read += len;                 /* Correct position of read pointer   */
+    return (len);
+}
+
+
 /** \brief  Reads one character of data received over the USB CDC ACM Virtual COM Port
 
     The function reads data character from the receive intermediate buffer that
@@ -535,6 +645,14 @@ void USBD_CDC_ACM_SOF_Event(void)
                                            received callback                  */
     }
 
+    if (data_send_in_pending &&           /* If a Bulk In event was missed      */
+            (!data_send_access)) {           /* and send data is not being accessed*/
+        data_send_in_pending = 0;
+        data_send_access = 1;               /* Block access to send data          */
+        USBD_CDC_ACM_EP_BULKIN_HandleData();/* Continue sending                   */
+        data_send_access = 0;               /* Allow access to send data          */
+    }
+
     if ((!data_send_access)         &&    /* If send data is not being accessed */
             (!data_send_active)         &&    /* and send is not active             */
             (data_to_send_wr - data_to_send_rd) /* and if there is data to be sent    */
@@ -661,6 +779,10 @@ static void USBD_CDC_ACM_EP_BULKIN_HandleData(void)
 
                                            buffer                             */
 
+    if (len_sent) {                       /* If space was freed in send buffer  */
+        USBD_CDC_ACM_DataSent(len_sent);    /* Call sent callback                 */
+    }
+
     if ((data_to_send_wr == data_to_send_rd) &&   /* If there are no more
                                            bytes available to be sent         */
             (len_sent == usbd_cdc_acm_maxpacketsize1[USBD_HighSpeed])) {
@@ -673,6 +795,35 @@ static void USBD_CDC_ACM_EP_BULKIN_HandleData(void)
 }
 
 
+#if (USBD_CDC_ACM_SEND_IMMEDIATE)
+/** \brief  Start Sending Data on the Bulk In Endpoint
+
+    The function starts sending data from the send intermediate buffer if
+    the Bulk In endpoint is idle. It runs outside of the USB interrupt, so a
+    Bulk In event that arrives while it blocks access to send data is left
+    for the next SOF (USBD_CDC_ACM_SOF_Event).
+ */
+
+static void USBD_CDC_ACM_EP_BULKIN_Start(void)
+{
+    if ((!USBD_Configuration)        ||   /* If not configured                  */
+            data_send_active         ||   /* or send is already active          */
+            data_send_access) {           /* or send data is being accessed     */
+        return;
+    }
+
+    data_send_access = 1;                 /* Block access to send data          */
+
+    if (!data_send_active) {              /* If SOF did not start sending first */
+        data_send_active = 1;               /* Start data sending                 */
+        USBD_CDC_ACM_EP_BULKIN_HandleData();/* Handle data to send                */
+    }
+
+    data_send_access = 0;                 /* Allow access to send data          */
+}
+#endif
+
+
 /** \brief  Handle Bulk Out Endpoint Events
 
     The function handles Bulk Out endpoint events. It calls
@@ -721,6 +872,7 @@ void USBD_CDC_ACM_EP_BULKIN_Event(uint32_t event)
     if (data_send_access                  /* If send data is being accessed     */
 // ||((control_line_state & 3) != 3)    /* or if DTR or RTS is 0              */
        ) {
+        data_send_in_pending = 1;           /* Handle it on the next SOF          */
         return;
     }
 
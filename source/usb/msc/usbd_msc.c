@@ -25,18 +25,20 @@
 #include "usb_for_lib.h"
 #include "util.h"
 
-BOOL USBD_MSC_MediaReady = __FALSE;
-BOOL USBD_MSC_ReadOnly = __FALSE;
-U32 USBD_MSC_MemorySize;
+U8 USBD_MSC_LunCount = 1;
+BOOL USBD_MSC_MediaReady[USBD_MSC_MAX_LUN_COUNT];
+BOOL USBD_MSC_MediaChanged[USBD_MSC_MAX_LUN_COUNT];
+BOOL USBD_MSC_ReadOnly[USBD_MSC_MAX_LUN_COUNT];
+U32 USBD_MSC_MemorySize[USBD_MSC_MAX_LUN_COUNT];
 U32 USBD_MSC_BlockSize;
 U32 USBD_MSC_BlockGroup;
-U32 USBD_MSC_BlockCount;
+U32 USBD_MSC_BlockCount[USBD_MSC_MAX_LUN_COUNT];
 U8 *USBD_MSC_BlockBuf;
 
 MSC_CBW USBD_MSC_CBW;       /* Command Block Wrapper */
 MSC_CSW USBD_MSC_CSW;       /* Command Status Wrapper */
 
-BOOL USBD_MSC_MediaReadyEx = __FALSE;   /* Previous state of Media ready */
+BOOL USBD_MSC_MediaReadyEx[USBD_MSC_MAX_LUN_COUNT];   /* Previous state of Media ready */
 BOOL MemOK;     /* Memory OK */
 
 U32 Block;      /* R/W Block  */
@@ -52,11 +54,11 @@ __weak void usbd_msc_init()
 {
 
 }
-__weak void usbd_msc_read_sect(U32 block, U8 *buf, U32 num_of_blocks)
+__weak void usbd_msc_read_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks)
 {
 
 }
-__weak void usbd_msc_write_sect(U32 block, U8 *buf, U32 num_of_blocks)
+__weak void usbd_msc_write_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks)
 {
 
 }
@@ -129,7 +131,7 @@ BOOL USBD_MSC_Reset(void)
 
 BOOL USBD_MSC_GetMaxLUN(void)
 {
-    USBD_EP0Buf[0] = 0;                      /* one LUN associated with this device */
+    USBD_EP0Buf[0] = USBD_MSC_LunCount - 1;  /* Index of the last LUN */
     return (__TRUE);
 }
 
@@ -142,9 +144,10 @@ BOOL USBD_MSC_GetMaxLUN(void)
 
 BOOL USBD_MSC_CheckMedia(void)
 {
-    USBD_MSC_MediaReadyEx = USBD_MSC_MediaReady;
+    USBD_MSC_MediaReadyEx[USBD_MSC_CBW.bLUN] = USBD_MSC_MediaReady[USBD_MSC_CBW.bLUN];
 
-    if (!USBD_MSC_MediaReady) {
+    /* Fail commands until the host has fetched the pending UNIT ATTENTION */
+    if (!USBD_MSC_MediaReady[USBD_MSC_CBW.bLUN] || USBD_MSC_MediaChanged[USBD_MSC_CBW.bLUN]) {
         if (USBD_MSC_CBW.dDataLength) {
             if ((USBD_MSC_CBW.bmFlags & 0x80) != 0) {
                 USBD_MSC_SetStallEP(usbd_msc_ep_bulkin | 0x80);
@@ -176,7 +179,7 @@ void USBD_MSC_MemoryRead(void)
 {
     U32 n, m;
 
-    if (Block >= USBD_MSC_BlockCount) {
+    if (Block >= USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN]) {
         n = 0;
         USBD_MSC_SetStallEP(usbd_msc_ep_bulkin | 0x80);
         USBD_MSC_CSW.bStatus = CSW_CMD_PASSED;
@@ -200,7 +203,7 @@ void USBD_MSC_MemoryRead(void)
             m = USBD_MSC_BlockGroup;
         }
 
-        usbd_msc_read_sect(Block, USBD_MSC_BlockBuf, m);
+        usbd_msc_read_sect(USBD_MSC_CBW.bLUN, Block, USBD_MSC_BlockBuf, m);
     }
 
     if (n) {
@@ -238,7 +241,7 @@ void USBD_MSC_MemoryWrite(void)
 {
     U32 n;
 
-    if (Block >= USBD_MSC_BlockCount) {
+    if (Block >= USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN]) {
         BulkLen = 0;
         USBD_MSC_SetStallEP(usbd_msc_ep_bulkout);
         USBD_MSC_CSW.bStatus = CSW_CMD_PASSED;
@@ -249,15 +252,13 @@ void USBD_MSC_MemoryWrite(void)
         BulkLen = 0;
     }
 
-    if (Offset + BulkLen > USBD_MSC_BlockSize) {
+    if (Offset + BulkLen > USBD_MSC_BlockGroup * USBD_MSC_BlockSize) {
         // This write would have overflowed USBD_MSC_BlockBuf
         util_assert(0);
         return;
     }
 
-    for (n = 0; n < BulkLen; n++) {
-        USBD_MSC_BlockBuf[Offset + n] = USBD_MSC_BulkBuf[n];
-    }
+    memcpy(&USBD_MSC_BlockBuf[Offset], USBD_MSC_BulkBuf, BulkLen);
 
     Offset += BulkLen;
     Length -= BulkLen;
@@ -270,11 +271,11 @@ void USBD_MSC_MemoryWrite(void)
                 n = USBD_MSC_BlockGroup;
             }
 
-            usbd_msc_write_sect(Block, USBD_MSC_BlockBuf, n);
+            usbd_msc_write_sect(USBD_MSC_CBW.bLUN, Block, USBD_MSC_BlockBuf, n);
             Offset = 0;
             Block += n;
         } else if (Offset == USBD_MSC_BlockGroup * USBD_MSC_BlockSize) {
-            usbd_msc_write_sect(Block, USBD_MSC_BlockBuf, USBD_MSC_BlockGroup);
+            usbd_msc_write_sect(USBD_MSC_CBW.bLUN, Block, USBD_MSC_BlockBuf, USBD_MSC_BlockGroup);
             Offset = 0;
             Block += USBD_MSC_BlockGroup;
         }
@@ -304,7 +305,7 @@ void USBD_MSC_MemoryVerify(void)
 {
     U32 n;
 
-    if (Block >= USBD_MSC_BlockCount) {
+    if (Block >= USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN]) {
         BulkLen = 0;
         USBD_MSC_SetStallEP(usbd_msc_ep_bulkout);
         USBD_MSC_CSW.bStatus = CSW_CMD_PASSED;
@@ -323,7 +324,7 @@ void USBD_MSC_MemoryVerify(void)
                 n = USBD_MSC_BlockGroup;
             }
 
-            usbd_msc_read_sect(Block, USBD_MSC_BlockBuf, n);
+            usbd_msc_read_sect(USBD_MSC_CBW.bLUN, Block, USBD_MSC_BlockBuf, n);
         }
 
         for (n = 0; n < BulkLen; n++) {
@@ -505,6 +506,8 @@ void USBD_MSC_TestUnitReady(void)
 
 void USBD_MSC_RequestSense(void)
 {
+    U8 lun = USBD_MSC_CBW.bLUN;
+
     if (!USBD_MSC_DataInFormat()) {
         return;
     }
@@ -512,12 +515,18 @@ void USBD_MSC_RequestSense(void)
     USBD_MSC_BulkBuf[ 0] = 0x70;             /* Response Code */
     USBD_MSC_BulkBuf[ 1] = 0x00;
 
-    if ((USBD_MSC_MediaReadyEx ^ USBD_MSC_MediaReady) & USBD_MSC_MediaReady) {  /* If media state changed to ready */
+    if ((USBD_MSC_MediaReadyEx[lun] ^ USBD_MSC_MediaReady[lun]) & USBD_MSC_MediaReady[lun]) {  /* If media state changed to ready */
         USBD_MSC_BulkBuf[ 2] = 0x06;           /* UNIT ATTENTION */
         USBD_MSC_BulkBuf[12] = 0x28;           /* Additional Sense Code: Not ready to ready transition */
         USBD_MSC_BulkBuf[13] = 0x00;           /* Additional Sense Code Qualifier */
-        USBD_MSC_MediaReadyEx = USBD_MSC_MediaReady;
-    } else if (!USBD_MSC_MediaReady) {
+        USBD_MSC_MediaReadyEx[lun] = USBD_MSC_MediaReady[lun];
+        USBD_MSC_MediaChanged[lun] = __FALSE;
+    } else if (USBD_MSC_MediaChanged[lun] && USBD_MSC_MediaReady[lun]) {  /* If the media was replaced while ready */
+        USBD_MSC_BulkBuf[ 2] = 0x06;           /* UNIT ATTENTION */
+        USBD_MSC_BulkBuf[12] = 0x28;           /* Additional Sense Code: Medium may have changed */
+        USBD_MSC_BulkBuf[13] = 0x00;           /* Additional Sense Code Qualifier */
+        USBD_MSC_MediaChanged[lun] = __FALSE;
+    } else if (!USBD_MSC_MediaReady[lun]) {
         USBD_MSC_BulkBuf[ 2] = 0x02;           /* NOT READY */
         USBD_MSC_BulkBuf[12] = 0x3A;           /* Additional Sense Code: Medium not present */
         USBD_MSC_BulkBuf[13] = 0x00;           /* Additional Sense Code Qualifier */
@@ -598,8 +607,8 @@ void USBD_MSC_Inquiry(void)
 void USBD_MSC_StartStopUnit(void)
 {
     if (!USBD_MSC_CBW.CB[3]) {               /* If power condition modifier is 0 */
-        USBD_MSC_MediaReady  = USBD_MSC_CBW.CB[4] & 0x01;   /* Media ready = START bit value */
-        usbd_msc_start_stop(USBD_MSC_MediaReady);
+        USBD_MSC_MediaReady[USBD_MSC_CBW.bLUN]  = USBD_MSC_CBW.CB[4] & 0x01;   /* Media ready = START bit value */
+        usbd_msc_start_stop(USBD_MSC_MediaReady[USBD_MSC_CBW.bLUN]);
         USBD_MSC_CSW.bStatus = CSW_CMD_PASSED; /* Start Stop Unit -> pass */
         USBD_MSC_SetCSW();
         return;
@@ -646,7 +655,7 @@ void USBD_MSC_ModeSense6(void)
 
     USBD_MSC_BulkBuf[ 0] = 0x03;
     USBD_MSC_BulkBuf[ 1] = 0x00;
-    USBD_MSC_BulkBuf[ 2] = (USBD_MSC_ReadOnly << 7);
+    USBD_MSC_BulkBuf[ 2] = (USBD_MSC_ReadOnly[USBD_MSC_CBW.bLUN] << 7);
     USBD_MSC_BulkBuf[ 3] = 0x00;
     BulkLen = 4;
 
@@ -680,7 +689,7 @@ void USBD_MSC_ModeSense10(void)
     USBD_MSC_BulkBuf[ 0] = 0x00;
     USBD_MSC_BulkBuf[ 1] = 0x06;
     USBD_MSC_BulkBuf[ 2] = 0x00;
-    USBD_MSC_BulkBuf[ 3] = (USBD_MSC_ReadOnly << 7);
+    USBD_MSC_BulkBuf[ 3] = (USBD_MSC_ReadOnly[USBD_MSC_CBW.bLUN] << 7);
     USBD_MSC_BulkBuf[ 4] = 0x00;
     USBD_MSC_BulkBuf[ 5] = 0x00;
     USBD_MSC_BulkBuf[ 6] = 0x00;
@@ -715,10 +724,10 @@ void USBD_MSC_ReadCapacity(void)
     }
 
     /* Last Logical Block */
-    USBD_MSC_BulkBuf[ 0] = ((USBD_MSC_BlockCount - 1) >> 24) & 0xFF;
-    USBD_MSC_BulkBuf[ 1] = ((USBD_MSC_BlockCount - 1) >> 16) & 0xFF;
-    USBD_MSC_BulkBuf[ 2] = ((USBD_MSC_BlockCount - 1) >>  8) & 0xFF;
-    USBD_MSC_BulkBuf[ 3] = ((USBD_MSC_BlockCount - 1) >>  0) & 0xFF;
+    USBD_MSC_BulkBuf[ 0] = ((USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] - 1) >> 24) & 0xFF;
+    USBD_MSC_BulkBuf[ 1] = ((USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] - 1) >> 16) & 0xFF;
+    USBD_MSC_BulkBuf[ 2] = ((USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] - 1) >>  8) & 0xFF;
+    USBD_MSC_BulkBuf[ 3] = ((USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] - 1) >>  0) & 0xFF;
     /* Block Length */
     USBD_MSC_BulkBuf[ 4] = (USBD_MSC_BlockSize        >> 24) & 0xFF;
     USBD_MSC_BulkBuf[ 5] = (USBD_MSC_BlockSize        >> 16) & 0xFF;
@@ -750,10 +759,10 @@ void USBD_MSC_ReadFormatCapacity(void)
     USBD_MSC_BulkBuf[ 2] = 0x00;
     USBD_MSC_BulkBuf[ 3] = 0x08;                      /* Capacity List Length */
     /* Block Count */
-    USBD_MSC_BulkBuf[ 4] = (USBD_MSC_BlockCount >> 24) & 0xFF;
-    USBD_MSC_BulkBuf[ 5] = (USBD_MSC_BlockCount >> 16) & 0xFF;
-    USBD_MSC_BulkBuf[ 6] = (USBD_MSC_BlockCount >>  8) & 0xFF;
-    USBD_MSC_BulkBuf[ 7] = (USBD_MSC_BlockCount >>  0) & 0xFF;
+    USBD_MSC_BulkBuf[ 4] = (USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] >> 24) & 0xFF;
+    USBD_MSC_BulkBuf[ 5] = (USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] >> 16) & 0xFF;
+    USBD_MSC_BulkBuf[ 6] = (USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] >>  8) & 0xFF;
+    USBD_MSC_BulkBuf[ 7] = (USBD_MSC_BlockCount[USBD_MSC_CBW.bLUN] >>  0) & 0xFF;
     /* Block Length */
     USBD_MSC_BulkBuf[ 8] = 0x02;                      /* Descriptor Code: Formatted Media */
     USBD_MSC_BulkBuf[ 9] = (USBD_MSC_BlockSize  >> 16) & 0xFF;
@@ -861,7 +870,7 @@ void USBD_MSC_GetCBW(void)
         USBD_MSC_CSW.dTag = USBD_MSC_CBW.dTag;
         USBD_MSC_CSW.dDataResidue = USBD_MSC_CBW.dDataLength;
 
-        if ((USBD_MSC_CBW.bLUN      >  0) ||
+        if ((USBD_MSC_CBW.bLUN      >= USBD_MSC_LunCount) ||
                 (USBD_MSC_CBW.bCBLength <  1) ||
                 (USBD_MSC_CBW.bCBLength > 16)) {
 fail:
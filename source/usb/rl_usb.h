@@ -47,8 +47,8 @@ extern void  usbd_hid_set_protocol(U8 protocol);
 
 /* USB Device user functions imported to USB Mass Storage Class module        */
 extern void  usbd_msc_init(void);
-extern void  usbd_msc_read_sect(U32 block, U8 *buf, U32 num_of_blocks);
-extern void  usbd_msc_write_sect(U32 block, U8 *buf, U32 num_of_blocks);
+extern void  usbd_msc_read_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks);
+extern void  usbd_msc_write_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks);
 extern void  usbd_msc_start_stop(BOOL start);
 
 /* USB Device user functions imported to USB Audio Class module               */
@@ -67,8 +67,12 @@ extern int32_t  USBD_CDC_ACM_PortGetLineCoding(CDC_LINE_CODING *line_coding);
 extern int32_t  USBD_CDC_ACM_PortSetControlLineState(uint16_t ctrl_bmp);
 extern int32_t  USBD_CDC_ACM_DataSend(const uint8_t *buf, int32_t len);
 extern int32_t  USBD_CDC_ACM_DataFree(void);
+extern int32_t  USBD_CDC_ACM_DataSendPeek(uint8_t **buf);
+extern int32_t  USBD_CDC_ACM_DataSendCommit(int32_t len);
 extern int32_t  USBD_CDC_ACM_PutChar(const uint8_t  ch);
 extern int32_t  USBD_CDC_ACM_DataRead(uint8_t *buf, int32_t len);
+extern int32_t  USBD_CDC_ACM_DataReadPeek(uint8_t **buf);
+extern int32_t  USBD_CDC_ACM_DataReadCommit(int32_t len);
 extern int32_t  USBD_CDC_ACM_GetChar(void);
 extern int32_t  USBD_CDC_ACM_DataAvailable(void);
 extern int32_t  USBD_CDC_ACM_Notify(uint16_t stat);
@@ -82,6 +86,8 @@ extern int32_t  USBD_CDC_ACM_SetLineCoding(void);
 extern int32_t  USBD_CDC_ACM_GetLineCoding(void);
 extern int32_t  USBD_CDC_ACM_SetControlLineState(uint16_t ctrl_bmp);
 extern int32_t  USBD_CDC_ACM_SendBreak(uint16_t dur);
+extern int32_t  USBD_CDC_ACM_DataReceived(int32_t len);
+extern int32_t  USBD_CDC_ACM_DataSent(int32_t len);
 
 /* USB Device user functions imported to USB Custom Class module              */
 extern void  usbd_cls_init(void);
@@ -44,12 +44,14 @@ OS_TID USBD_RTX_CoreTask;           /* USB Core Task ID */
 #endif
 
 
+#if (defined(__CC_ARM))
 __asm void $$USBD$$version(void)
 {
     /* Export a version number symbol for a version control. */
     EXPORT  __RL_USBD_VER
 __RL_USBD_VER   EQU     0x470
 }
+#endif
 
 
 /*
@@ -25,13 +25,18 @@
 
 /*--------------------------- Global variables -------------------------------*/
 
+/* Maximum number of logical units */
+#define USBD_MSC_MAX_LUN_COUNT  2
+
 /* USB Device Mass Storage Device Class Global Variables */
-extern BOOL USBD_MSC_MediaReady;
-extern BOOL USBD_MSC_ReadOnly;
-extern U32 USBD_MSC_MemorySize;
+extern U8 USBD_MSC_LunCount;
+extern BOOL USBD_MSC_MediaReady[USBD_MSC_MAX_LUN_COUNT];
+extern BOOL USBD_MSC_MediaChanged[USBD_MSC_MAX_LUN_COUNT];
+extern BOOL USBD_MSC_ReadOnly[USBD_MSC_MAX_LUN_COUNT];
+extern U32 USBD_MSC_MemorySize[USBD_MSC_MAX_LUN_COUNT];
 extern U32 USBD_MSC_BlockSize;
 extern U32 USBD_MSC_BlockGroup;
-extern U32 USBD_MSC_BlockCount;
+extern U32 USBD_MSC_BlockCount[USBD_MSC_MAX_LUN_COUNT];
 extern U8 *USBD_MSC_BlockBuf;
 
 
@@ -0,0 +1,78 @@
+/**
+ * @file    DAP_config.h
+ * @brief   Debug unit with no pins, for the host tests of the DAP commands
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DAP_CONFIG_H__
+#define __DAP_CONFIG_H__
+
+#include "cmsis_compiler.h"
+
+// A full speed SWD debug unit. The commands that reach the pins are
+// not exercised, so the pins read as zero.
+#define CPU_CLOCK               48000000
+#define IO_PORT_WRITE_CYCLES    2
+#define DAP_SWD                 1
+#define DAP_JTAG                0
+#define DAP_JTAG_DEV_CNT        8
+#define DAP_DEFAULT_PORT        1
+#define DAP_DEFAULT_SWJ_CLOCK   5000000
+#define DAP_PACKET_SIZE         64
+#define DAP_PACKET_COUNT        1
+#define SWO_UART                0
+#define SWO_UART_MAX_BAUDRATE   10000000U
+#define SWO_MANCHESTER          0
+#define SWO_BUFFER_SIZE         4096U
+#define SWO_STREAM              0
+#define TIMESTAMP_CLOCK         0
+#define TARGET_DEVICE_FIXED     0
+#define TARGET_DEVICE_VENDOR    ""
+#define TARGET_DEVICE_NAME      ""
+
+static inline void PORT_JTAG_SETUP(void) {}
+static inline void PORT_SWD_SETUP(void) {}
+static inline void PORT_OFF(void) {}
+
+static inline void PIN_SWCLK_TCK_SET(void) {}
+static inline void PIN_SWCLK_TCK_CLR(void) {}
+static inline uint32_t PIN_SWCLK_TCK_IN(void) { return 0; }
+static inline void PIN_SWDIO_TMS_SET(void) {}
+static inline void PIN_SWDIO_TMS_CLR(void) {}
+static inline uint32_t PIN_SWDIO_TMS_IN(void) { return 0; }
+static inline uint32_t PIN_SWDIO_IN(void) { return 0; }
+static inline void PIN_SWDIO_OUT(uint32_t bit) {}
+static inline void PIN_SWDIO_OUT_ENABLE(void) {}
+static inline void PIN_SWDIO_OUT_DISABLE(void) {}
+static inline uint32_t PIN_TDI_IN(void) { return 0; }
+static inline void PIN_TDI_OUT(uint32_t bit) {}
+static inline uint32_t PIN_TDO_IN(void) { return 0; }
+static inline uint32_t PIN_nTRST_IN(void) { return 0; }
+static inline void PIN_nTRST_OUT(uint32_t bit) {}
+static inline uint32_t PIN_nRESET_IN(void) { return 0; }
+static inline void PIN_nRESET_OUT(uint32_t bit) {}
+
+static inline void LED_CONNECTED_OUT(uint32_t bit) {}
+static inline void LED_RUNNING_OUT(uint32_t bit) {}
+
+static inline uint32_t TIMESTAMP_GET(void) { return 0; }
+
+static inline void DAP_SETUP(void) {}
+static inline uint32_t RESET_TARGET(void) { return 0; }
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * @file    cmsis_compiler.h
+ * @brief   Compiler definitions for the host tests of the DAP commands
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CMSIS_COMPILER_H
+#define __CMSIS_COMPILER_H
+
+#include <stdint.h>
+
+// The DAP sources are built with __CC_ARM defined so DAP.h takes the
+// delay loop written in C rather than the Thumb one
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    static inline
+#define __WEAK                  __attribute__((weak))
+#define __NOP()
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * @file    test_dap_vendor.c
+ * @brief   Host tests for the DAP vendor commands
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "uart.h"
+#include "rl_usb.h"
+#include "target_family.h"
+#include "file_stream.h"
+#include "host_test.h"
+
+// Bytes past the end of a packet, to check nothing is read or written there
+#define CANARY              0xA5
+#define BUF_SIZE            (DAP_PACKET_SIZE * 2)
+
+// Serial data from the target waiting to be read, and what was written
+// to the target
+static struct {
+    uint8_t rx[BUF_SIZE * 2];
+    uint32_t rx_size;
+    uint32_t rx_pos;
+    uint8_t tx[BUF_SIZE * 2];
+    uint32_t tx_size;
+    bool stats_cleared;
+} uart;
+
+static uint8_t request[BUF_SIZE];
+static uint8_t response[BUF_SIZE];
+
+int32_t uart_read_data(uint8_t *data, uint16_t size)
+{
+    uint32_t cnt = uart.rx_size - uart.rx_pos;
+
+    if (cnt > size) {
+        cnt = size;
+    }
+    memcpy(data, &uart.rx[uart.rx_pos], cnt);
+    uart.rx_pos += cnt;
+    return cnt;
+}
+
+int32_t uart_read_used(void)
+{
+    return uart.rx_size - uart.rx_pos;
+}
+
+int32_t uart_write_data(uint8_t *data, uint16_t size)
+{
+    CHECK(uart.tx_size + size <= sizeof(uart.tx));
+    memcpy(&uart.tx[uart.tx_size], data, size);
+    uart.tx_size += size;
+    return size;
+}
+
+int32_t uart_write_free(void)
+{
+    return sizeof(uart.tx) - uart.tx_size;
+}
+
+void uart_get_statistics(UART_Statistics *statistics)
+{
+    statistics->RxBufferSize = 0x11223344;
+    statistics->TxBufferSize = 0x200;
+    statistics->RxHighWater = 0x1FF;
+    statistics->TxHighWater = 7;
+    statistics->RxDropped = 0x80000001;
+}
+
+void uart_clear_statistics(void)
+{
+    uart.stats_cleared = true;
+}
+
+// Used by the other commands, which are not tested here
+const char *info_get_unique_id(void) { return ""; }
+const char *info_get_version(void) { return ""; }
+void main_usb_set_test_mode(bool enabled) {}
+bool config_get_auto_rst(void) { return false; }
+void flash_manager_set_page_erase(bool enabled) {}
+uint8_t target_set_state(target_state_t state) { return 0; }
+error_t stream_open(stream_type_t stream_type) { return ERROR_SUCCESS; }
+error_t stream_write(const uint8_t *data, uint32_t size) { return ERROR_SUCCESS; }
+error_t stream_close(void) { return ERROR_SUCCESS; }
+int32_t USBD_CDC_ACM_PortSetLineCoding(CDC_LINE_CODING *line_coding) { return 0; }
+int32_t USBD_CDC_ACM_PortGetLineCoding(CDC_LINE_CODING *line_coding) { return 0; }
+int32_t USBD_CDC_ACM_SendBreak(uint16_t dur) { return 0; }
+void SWJ_Sequence(uint32_t count, const uint8_t *data) {}
+void SWD_Sequence(uint32_t info, const uint8_t *swdo, uint8_t *swdi) {}
+uint8_t SWD_Transfer(uint32_t request, uint32_t *data) { return 0; }
+
+// Reset the UART with size bytes waiting to be read, and the request
+// and response packets to the canary
+static void reset(uint32_t size)
+{
+    uint32_t i;
+
+    memset(&uart, 0, sizeof(uart));
+    for (i = 0; i < sizeof(uart.rx); i++) {
+        uart.rx[i] = (uint8_t)(i * 3 + 1);
+    }
+    uart.rx_size = size;
+    memset(request, CANARY, sizeof(request));
+    memset(response, CANARY, sizeof(response));
+}
+
+static bool canary(const uint8_t *buf, uint32_t start)
+{
+    uint32_t i;
+
+    for (i = start; i < BUF_SIZE; i++) {
+        if (CANARY != buf[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t get16(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void put_read(uint8_t *buf, uint32_t len)
+{
+    buf[0] = ID_DAP_Vendor15;
+    buf[1] = (uint8_t)len;
+    buf[2] = (uint8_t)(len >> 8);
+}
+
+// Write command with len bytes following it in the request
+static void put_write(uint8_t *buf, uint32_t len, uint32_t data_len)
+{
+    uint32_t i;
+
+    buf[0] = ID_DAP_Vendor16;
+    buf[1] = (uint8_t)len;
+    buf[2] = (uint8_t)(len >> 8);
+    for (i = 0; i < data_len; i++) {
+        buf[3 + i] = (uint8_t)(i * 5 + 2);
+    }
+}
+
+// Check a read response and return the bytes in it
+static uint32_t check_read(const uint8_t *buf, uint32_t len, uint32_t data_pos)
+{
+    CHECK(ID_DAP_Vendor15 == buf[0]);
+    CHECK(len == get16(&buf[1]));
+    CHECK(uart.rx_size - (data_pos + len) == get16(&buf[3]));
+    CHECK(0 == memcmp(&buf[5], &uart.rx[data_pos], len));
+    return 5 + len;
+}
+
+// A read fills the packet, however much the host asks for
+static void test_read(void)
+{
+    reset(200);
+    put_read(request, 0);
+    CHECK(((3 << 16) | DAP_PACKET_SIZE) == DAP_ExecuteCommand(request, response));
+    check_read(response, DAP_PACKET_SIZE - 5, 0);
+    CHECK(canary(response, DAP_PACKET_SIZE));
+
+    put_read(request, 1000);
+    CHECK(((3 << 16) | DAP_PACKET_SIZE) == DAP_ExecuteCommand(request, response));
+    check_read(response, DAP_PACKET_SIZE - 5, DAP_PACKET_SIZE - 5);
+
+    put_read(request, 7);
+    CHECK(((3 << 16) | 12) == DAP_ExecuteCommand(request, response));
+    check_read(response, 7, 2 * (DAP_PACKET_SIZE - 5));
+}
+
+// Reads in DAP_ExecuteCommands only fill what is left of the response
+static void test_read_batched(void)
+{
+    uint32_t num;
+
+    reset(200);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_read(&request[2], 4);
+    put_read(&request[5], 0);
+    CHECK(((8 << 16) | DAP_PACKET_SIZE) == DAP_ExecuteCommand(request, response));
+    CHECK(ID_DAP_ExecuteCommands == response[0]);
+    CHECK(2 == response[1]);
+    CHECK(9 == check_read(&response[2], 4, 0));
+    CHECK(DAP_PACKET_SIZE - 11 == check_read(&response[11], DAP_PACKET_SIZE - 16, 4));
+    CHECK(canary(response, DAP_PACKET_SIZE));
+    CHECK(DAP_PACKET_SIZE - 12 == uart.rx_pos);
+
+    // Too little room for the counts
+    reset(200);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_read(&request[2], DAP_PACKET_SIZE - 10);
+    put_read(&request[5], 0);
+    num = DAP_ExecuteCommand(request, response);
+    CHECK(((6 << 16) | (DAP_PACKET_SIZE - 2)) == num);
+    check_read(&response[2], DAP_PACKET_SIZE - 10, 0);
+    CHECK(ID_DAP_Invalid == response[DAP_PACKET_SIZE - 3]);
+    CHECK(canary(response, DAP_PACKET_SIZE - 2));
+    CHECK(DAP_PACKET_SIZE - 10 == uart.rx_pos);
+
+    // Space is a whole packet again after the batch
+    put_read(request, 0);
+    CHECK(((3 << 16) | DAP_PACKET_SIZE) == DAP_ExecuteCommand(request, response));
+}
+
+// A write takes no more than the data in the packet
+static void test_write(void)
+{
+    reset(0);
+    put_write(request, 10, 10);
+    CHECK(((13 << 16) | 5) == DAP_ExecuteCommand(request, response));
+    CHECK(ID_DAP_Vendor16 == response[0]);
+    CHECK(10 == get16(&response[1]));
+    CHECK(sizeof(uart.tx) - 10 == get16(&response[3]));
+    CHECK(0 == memcmp(uart.tx, &request[3], 10));
+
+    reset(0);
+    put_write(request, 1000, DAP_PACKET_SIZE - 3);
+    CHECK(((DAP_PACKET_SIZE << 16) | 5) == DAP_ExecuteCommand(request, response));
+    CHECK(DAP_PACKET_SIZE - 3 == get16(&response[1]));
+    CHECK(DAP_PACKET_SIZE - 3 == uart.tx_size);
+    CHECK(0 == memcmp(uart.tx, &request[3], uart.tx_size));
+    CHECK(canary(response, 5));
+}
+
+// Writes in DAP_ExecuteCommands only take what is left of the request
+static void test_write_batched(void)
+{
+    uint32_t num;
+
+    reset(0);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_write(&request[2], 20, 20);
+    put_write(&request[25], 1000, DAP_PACKET_SIZE - 28);
+    CHECK(((DAP_PACKET_SIZE << 16) | 12) == DAP_ExecuteCommand(request, response));
+    CHECK(20 == get16(&response[3]));
+    CHECK(DAP_PACKET_SIZE - 28 == get16(&response[8]));
+    CHECK(DAP_PACKET_SIZE - 8 == uart.tx_size);
+    CHECK(0 == memcmp(uart.tx, &request[5], 20));
+    CHECK(0 == memcmp(&uart.tx[20], &request[28], DAP_PACKET_SIZE - 28));
+    CHECK(canary(response, 12));
+
+    // Too little room for the count
+    reset(0);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_write(&request[2], DAP_PACKET_SIZE - 6, DAP_PACKET_SIZE - 6);
+    request[DAP_PACKET_SIZE - 1] = ID_DAP_Vendor16;
+    num = DAP_ExecuteCommand(request, response);
+    CHECK(((DAP_PACKET_SIZE << 16) | 8) == num);
+    CHECK(ID_DAP_Invalid == response[7]);
+    CHECK(DAP_PACKET_SIZE - 6 == uart.tx_size);
+    CHECK(canary(response, 8));
+}
+
+// Check a statistics response and return its size
+static uint32_t check_stats(const uint8_t *buf)
+{
+    CHECK(ID_DAP_Vendor14 == buf[0]);
+    CHECK(0x11223344 == get32(&buf[1]));
+    CHECK(0x200 == get32(&buf[5]));
+    CHECK(0x1FF == get32(&buf[9]));
+    CHECK(7 == get32(&buf[13]));
+    CHECK(0x80000001 == get32(&buf[17]));
+    return 21;
+}
+
+// The statistics are little endian, and are only cleared when asked
+static void test_stats(void)
+{
+    reset(0);
+    request[0] = ID_DAP_Vendor14;
+    request[1] = 0;
+    CHECK(((2 << 16) | 21) == DAP_ExecuteCommand(request, response));
+    check_stats(response);
+    CHECK(!uart.stats_cleared);
+    CHECK(canary(response, 21));
+
+    request[1] = 1;
+    CHECK(((2 << 16) | 21) == DAP_ExecuteCommand(request, response));
+    check_stats(response);
+    CHECK(uart.stats_cleared);
+}
+
+// Statistics in DAP_ExecuteCommands need room for all of the values
+static void test_stats_batched(void)
+{
+    uint32_t num;
+
+    // Filled with reads of DAP_PACKET_SIZE - 27 bytes, which leave 20
+    // bytes of the response
+    reset(200);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_read(&request[2], DAP_PACKET_SIZE - 27);
+    request[5] = ID_DAP_Vendor14;
+    request[6] = 1;
+    num = DAP_ExecuteCommand(request, response);
+    CHECK(((6 << 16) | (DAP_PACKET_SIZE - 19)) == num);
+    check_read(&response[2], DAP_PACKET_SIZE - 27, 0);
+    CHECK(ID_DAP_Invalid == response[DAP_PACKET_SIZE - 20]);
+    CHECK(!uart.stats_cleared);
+    CHECK(canary(response, DAP_PACKET_SIZE - 19));
+
+    // One byte less of data leaves just enough
+    reset(200);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_read(&request[2], DAP_PACKET_SIZE - 28);
+    request[5] = ID_DAP_Vendor14;
+    request[6] = 1;
+    num = DAP_ExecuteCommand(request, response);
+    CHECK(((7 << 16) | DAP_PACKET_SIZE) == num);
+    CHECK(21 == check_stats(&response[DAP_PACKET_SIZE - 21]));
+    CHECK(uart.stats_cleared);
+    CHECK(canary(response, DAP_PACKET_SIZE));
+
+    // The action byte would be past the end of the request
+    reset(0);
+    request[0] = ID_DAP_ExecuteCommands;
+    request[1] = 2;
+    put_write(&request[2], DAP_PACKET_SIZE - 6, DAP_PACKET_SIZE - 6);
+    request[DAP_PACKET_SIZE - 1] = ID_DAP_Vendor14;
+    num = DAP_ExecuteCommand(request, response);
+    CHECK(((DAP_PACKET_SIZE << 16) | 8) == num);
+    CHECK(ID_DAP_Invalid == response[7]);
+    CHECK(!uart.stats_cleared);
+    CHECK(canary(response, 8));
+}
+
+int main(void)
+{
+    printf("dap_vendor\n");
+    test_read();
+    test_read_batched();
+    test_write();
+    test_write_batched();
+    test_stats();
+    test_stats_batched();
+    return host_test_result();
+}
@@ -0,0 +1,103 @@
+#
+# DAPLink Interface Firmware
+# Copyright (c) 2021, ARM Limited, All Rights Reserved
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+
+"""Make the delta files test_delta applies
+
+Each case is a flash image, the new image to program and a delta file
+made by tools/make_delta.py. The cases are listed in cases.txt with the
+base address and the result test_delta should see.
+"""
+
+from __future__ import absolute_import
+from __future__ import print_function
+
+import os
+import random
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "..", "tools"))
+import make_delta  # noqa: E402
+
+# Must match test_delta.c
+FLASH_START = 0x10000
+FLASH_SIZE = 0x10000
+SECTOR_SIZE = 0x1000
+
+
+def random_bytes(rng, size):
+    return bytes(bytearray(rng.randrange(256) for _ in range(size)))
+
+
+def change(data, offset, new):
+    return data[:offset] + new + data[offset + len(new):]
+
+
+def main():
+    out_dir = sys.argv[1]
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    rng = random.Random(1)
+    flash = random_bytes(rng, FLASH_SIZE)
+    cases = []
+
+    def add(name, addr, base, new, expect="ok", flash_image=None, sector_size=SECTOR_SIZE):
+        if flash_image is None:
+            offset = addr - FLASH_START
+            flash_image = change(flash, offset, base)
+        delta = make_delta.create_delta(base, new, addr, sector_size)
+        if expect == "parser":
+            # A version this firmware does not know
+            delta = change(delta, 8, struct.pack("<I", make_delta.DELTA_VERSION + 1))
+        for ext, data in (("flash", flash_image), ("new", new), ("dlt", delta)):
+            with open(os.path.join(out_dir, "%s.%s" % (name, ext)), "wb") as file_handle:
+                file_handle.write(data)
+        cases.append("%s 0x%x %s" % (name, addr, expect))
+
+    base = random_bytes(rng, 0x8000)
+    add("same", FLASH_START, base, base)
+    add("patch", FLASH_START, base, change(base, 0x3010, b"\x00" * 16))
+    add("patch_small_sectors", FLASH_START, base, change(base, 0x3010, b"\x00" * 16), sector_size=0x400)
+    add("insert", FLASH_START, base, base[:0x2100] + random_bytes(rng, 100) + base[0x2100:])
+    add("insert_small_sectors", FLASH_START, base, base[:0x2100] + random_bytes(rng, 100) + base[0x2100:],
+        sector_size=0x400)
+    add("delete", FLASH_START, base, base[:0x1800] + base[0x1900:])
+    add("move", FLASH_START, base, base[0x4000:0x6000] + base[0x2000:0x4000] + base[0x6000:])
+    add("grow", FLASH_START, base, base + random_bytes(rng, 0x1803))
+    add("new", FLASH_START, base, random_bytes(rng, 0x2345))
+    add("offset", FLASH_START + 0x2200, base[:0x5000], change(base[:0x5000], 0x1ffe, b"\x12\x34\x56"))
+    add("end_of_flash", FLASH_START + FLASH_SIZE - 0x3000, base[:0x3000],
+        change(base[:0x3000], 0x2ff0, b"\x00" * 16))
+
+    add("base_crc", FLASH_START, base, change(base, 0x100, b"\x00"), expect="base_crc",
+        flash_image=change(flash, 0, change(base, 0x7000, b"\x00")))
+    add("version", FLASH_START, base, change(base, 0x100, b"\x00"), expect="parser")
+    add("below_flash", FLASH_START - 0x1000, base[:0x800], change(base[:0x800], 0, b"\x00"),
+        expect="address", flash_image=flash)
+    add("past_flash", FLASH_START + FLASH_SIZE - 0x1000, base[:0x2000], change(base[:0x2000], 0, b"\x00"),
+        expect="address", flash_image=flash)
+    add("grows_past_flash", FLASH_START + FLASH_SIZE - 0x1000, base[:0x1000], base[:0x1000] * 2,
+        expect="address")
+
+    with open(os.path.join(out_dir, "cases.txt"), "w") as file_handle:
+        file_handle.write("\n".join(cases) + "\n")
+
+
+if __name__ == "__main__":
+    main()
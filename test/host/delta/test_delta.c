@@ -0,0 +1,316 @@
+/**
+ * @file    test_delta.c
+ * @brief   Applies delta files made by tools/make_delta.py to simulated flash
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta.h"
+#include "flash_decoder.h"
+#include "flash_manager.h"
+#include "flash_stats.h"
+#include "target_board.h"
+#include "util.h"
+#include "host_test.h"
+
+// Must match delta/make_cases.py
+#define FLASH_START     0x10000
+#define FLASH_SIZE      0x10000
+#define SECTOR_SIZE     0x1000
+#define PAGE_SIZE       0x400
+#define SECTOR_COUNT    (FLASH_SIZE / SECTOR_SIZE)
+
+static struct {
+    uint8_t data[FLASH_SIZE];
+    bool erased[SECTOR_COUNT];      // Sectors erased since the flash was loaded
+} flash;
+
+static bool range_valid(uint32_t addr, uint32_t size)
+{
+    return (addr >= FLASH_START) && (addr - FLASH_START < FLASH_SIZE) &&
+           (size <= FLASH_SIZE - (addr - FLASH_START));
+}
+
+static error_t sim_init(void)
+{
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_uninit(void)
+{
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_program_page(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    if (!CHECK(range_valid(addr, size))) {
+        return ERROR_WRITE;
+    }
+    memcpy(&flash.data[addr - FLASH_START], buf, size);
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_erase_sector(uint32_t addr)
+{
+    if (!CHECK(range_valid(addr, SECTOR_SIZE) && (0 == addr % SECTOR_SIZE))) {
+        return ERROR_ERASE_SECTOR;
+    }
+    memset(&flash.data[addr - FLASH_START], 0xFF, SECTOR_SIZE);
+    flash.erased[(addr - FLASH_START) / SECTOR_SIZE] = true;
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_erase_chip(void)
+{
+    CHECK(false);
+    return ERROR_ERASE_ALL;
+}
+
+static uint32_t sim_program_page_min_size(uint32_t addr)
+{
+    return PAGE_SIZE;
+}
+
+static uint32_t sim_erase_sector_size(uint32_t addr)
+{
+    return SECTOR_SIZE;
+}
+
+static uint8_t sim_busy(void)
+{
+    return 0;
+}
+
+static error_t sim_read(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    if (!CHECK(range_valid(addr, size))) {
+        return ERROR_ALGO_DATA_SEQ;
+    }
+    memcpy(buf, &flash.data[addr - FLASH_START], size);
+    return ERROR_SUCCESS;
+}
+
+static bool sim_erased_value(uint32_t addr, uint8_t *value)
+{
+    *value = 0xFF;
+    return true;
+}
+
+static const flash_intf_t sim_intf = {
+    .init = sim_init,
+    .uninit = sim_uninit,
+    .program_page = sim_program_page,
+    .erase_sector = sim_erase_sector,
+    .erase_chip = sim_erase_chip,
+    .program_page_min_size = sim_program_page_min_size,
+    .erase_sector_size = sim_erase_sector_size,
+    .flash_busy = sim_busy,
+    .read = sim_read,
+    .erased_value = sim_erased_value,
+};
+
+static target_cfg_t sim_target_cfg = {
+    .flash_regions[0] = {
+        .start = FLASH_START,
+        .end = FLASH_START + FLASH_SIZE,
+        .flags = kRegionIsDefault,
+    },
+};
+
+const board_info_t g_board_info = {
+    .target_cfg = &sim_target_cfg,
+};
+
+error_t flash_decoder_get_flash(flash_decoder_type_t type, uint32_t addr, bool addr_valid, uint32_t *start_addr, const flash_intf_t **flash_intf)
+{
+    CHECK(FLASH_DECODER_TYPE_TARGET == type);
+    *start_addr = FLASH_START;
+    *flash_intf = &sim_intf;
+    return ERROR_SUCCESS;
+}
+
+uint32_t flash_stats_start(void)
+{
+    return 0;
+}
+
+void flash_stats_end(flash_stats_phase_t phase, uint32_t start, error_t status)
+{
+}
+
+void flash_stats_add_programmed(uint32_t size)
+{
+}
+
+void config_ram_set_page_erase(bool page_erase_enable)
+{
+}
+
+void vfs_user_state_changed(void)
+{
+}
+
+// crc32.c takes unsigned long to be 32 bits, so the same CRC as zlib's,
+// which make_delta.py uses
+uint32_t crc32_continue(uint32_t prev_crc, const void *data, int nBytes)
+{
+    const uint8_t *bytes = data;
+    uint32_t crc = ~prev_crc;
+    int bit;
+
+    while (nBytes-- > 0) {
+        crc ^= *bytes++;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint8_t *load(const char *dir, const char *name, const char *ext, uint32_t *size)
+{
+    char path[256];
+    FILE *file;
+    uint8_t *data;
+    long len;
+
+    snprintf(path, sizeof(path), "%s/%s.%s", dir, name, ext);
+    file = fopen(path, "rb");
+    if (!CHECK(NULL != file)) {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = malloc(len + 1);
+    CHECK(len == fread(data, 1, len, file));
+    fclose(file);
+    *size = len;
+    return data;
+}
+
+// Pass the delta to the stream in pieces of chunk bytes
+static error_t apply(const uint8_t *delta, uint32_t size, uint32_t chunk)
+{
+    error_t status;
+    error_t close_status;
+    uint32_t pos;
+
+    CHECK(delta_detect(delta, size));
+    CHECK(ERROR_SUCCESS == delta_open());
+    status = ERROR_SUCCESS;
+    for (pos = 0; (pos < size) && (ERROR_SUCCESS == status); pos += chunk) {
+        status = delta_write(delta + pos, MIN(chunk, size - pos));
+    }
+    close_status = delta_close();
+    if (ERROR_SUCCESS_DONE == status) {
+        status = close_status;
+    }
+    return status;
+}
+
+static error_t expected_status(const char *expect)
+{
+    if (0 == strcmp(expect, "ok")) {
+        return ERROR_SUCCESS;
+    } else if (0 == strcmp(expect, "base_crc")) {
+        return ERROR_DELTA_BASE_CRC;
+    } else if (0 == strcmp(expect, "address")) {
+        return ERROR_DELTA_ADDRESS;
+    } else if (0 == strcmp(expect, "parser")) {
+        return ERROR_DELTA_PARSER;
+    }
+    CHECK(false);
+    return ERROR_INTERNAL;
+}
+
+// Load the flash with the image the target holds, apply the delta and
+// check the flash holds the new image, with only the sectors that change
+// erased. A delta that fails leaves the flash as it was.
+static void run_case(const char *dir, const char *name, uint32_t addr, const char *expect)
+{
+    static const uint32_t chunks[] = {1, 7, 512, 0x10000};
+    uint32_t flash_size, new_size, delta_size;
+    uint8_t *flash_image = load(dir, name, "flash", &flash_size);
+    uint8_t *new_image = load(dir, name, "new", &new_size);
+    uint8_t *delta = load(dir, name, "dlt", &delta_size);
+    error_t expected = expected_status(expect);
+    uint8_t expected_flash[FLASH_SIZE];
+    uint32_t offset;
+    uint32_t sector;
+    uint32_t i;
+
+    CHECK(FLASH_SIZE == flash_size);
+    memcpy(expected_flash, flash_image, FLASH_SIZE);
+    if (ERROR_SUCCESS == expected) {
+        offset = addr - FLASH_START;
+        memcpy(&expected_flash[offset], new_image, new_size);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+        memcpy(flash.data, flash_image, FLASH_SIZE);
+        memset(flash.erased, 0, sizeof(flash.erased));
+        if (!CHECK(expected == apply(delta, delta_size, chunks[i]))) {
+            printf("  %s in %u byte pieces\n", name, chunks[i]);
+        }
+        CHECK(0 == memcmp(flash.data, expected_flash, FLASH_SIZE));
+        for (sector = 0; sector < SECTOR_COUNT; sector++) {
+            bool changed = 0 != memcmp(&flash_image[sector * SECTOR_SIZE],
+                                       &expected_flash[sector * SECTOR_SIZE], SECTOR_SIZE);
+            CHECK(changed == flash.erased[sector]);
+        }
+    }
+
+    free(flash_image);
+    free(new_image);
+    free(delta);
+}
+
+// Run each case listed in cases.txt in the directory given
+int main(int argc, char *argv[])
+{
+    char path[256];
+    char name[64];
+    char expect[16];
+    unsigned int addr;
+    uint32_t count = 0;
+    FILE *cases;
+
+    printf("delta\n");
+    if (argc != 2) {
+        printf("Usage: %s <directory made by make_cases.py>\n", argv[0]);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/cases.txt", argv[1]);
+    cases = fopen(path, "r");
+    if (!CHECK(NULL != cases)) {
+        return host_test_result();
+    }
+    while (3 == fscanf(cases, "%63s %x %15s", name, &addr, expect)) {
+        run_case(argv[1], name, addr, expect);
+        count++;
+    }
+    fclose(cases);
+    printf("  %u delta files\n", count);
+    CHECK(count > 0);
+    return host_test_result();
+}
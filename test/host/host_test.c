@@ -0,0 +1,53 @@
+/**
+ * @file    host_test.c
+ * @brief   Implementation of host_test.h
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "host_test.h"
+
+static unsigned checks;
+static unsigned failures;
+
+bool host_test_check(bool expression, const char *text, const char *filename, int line)
+{
+    // util_assert can also run on threads started by a test
+    __atomic_fetch_add(&checks, 1, __ATOMIC_RELAXED);
+
+    if (!expression) {
+        __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+        printf("%s:%i: check failed: %s\n", filename, line, text);
+    }
+
+    return expression;
+}
+
+int host_test_result(void)
+{
+    printf("%u checks, %u failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
+
+// Replaces util.c which needs the firmware environment
+void _util_assert(bool expression, const char *filename, uint16_t line)
+{
+    host_test_check(expression, "util_assert", filename, line);
+}
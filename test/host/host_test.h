@@ -0,0 +1,44 @@
+/**
+ * @file    host_test.h
+ * @brief   Minimal checks for the host unit tests
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Record a failure if expression is false. Returns the expression.
+#define CHECK(expression) host_test_check((expression), #expression, __FILE__, __LINE__)
+
+bool host_test_check(bool expression, const char *text, const char *filename, int line);
+
+// Print a summary and get the exit code for main.
+// util_assert failures in the code under test count as failures.
+int host_test_result(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file    IO_Config.h
+ * @brief   Interrupt control for modules built on the host
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IO_CONFIG_H__
+#define __IO_CONFIG_H__
+
+#include <stdint.h>
+
+// CMSIS intrinsics used by cortex_m.h, circ_buf.c and serial_capture.c.
+// Host tests have no interrupts to hold off. The barrier is a full fence
+// so the single producer, single consumer buffers can be tested from
+// two threads.
+static inline int __disable_irq(void)
+{
+    return 0;
+}
+
+static inline void __enable_irq(void)
+{
+}
+
+static inline uint32_t __get_xPSR(void)
+{
+    return 0;
+}
+
+static inline void __DMB(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#define __COMPILER_BARRIER()    __asm volatile ("" ::: "memory")
+
+#endif
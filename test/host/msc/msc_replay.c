@@ -0,0 +1,720 @@
+/**
+ * @file    msc_replay.c
+ * @brief   Replay host command traces against the simulated MSC drive
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A trace describes the commands a host OS sends while copying one image
+// to the drive. Sectors are given relative to a region of the drive so the
+// same trace works for any drive geometry and image size. One command per
+// line, '#' starts a comment:
+//
+//   mount                      Read the boot sector, both FATs and the root
+//                              directory, then TEST UNIT READY
+//   tur                        TEST UNIT READY
+//   read REGION FIRST COUNT    READ(10) of COUNT sectors, or "all" of them.
+//                              REGION is boot, fat, fat2, dir or data.
+//   dir size0|mid|final [hidden]
+//                              Write the root directory sectors that change
+//                              when the image entry is added with size 0, the
+//                              size of its first "mid" sectors or its final
+//                              size. "hidden" also adds the macOS resource
+//                              fork entry.
+//   fat                        Write the changed sectors of both FATs
+//   hidden                     Write the data of the macOS resource fork
+//   data FIRST LAST CHUNK      Write image sectors FIRST to LAST ("end" is the
+//                              last sector, "mid" the middle one and "mid+N"
+//                              N after it) with CHUNK sectors per WRITE(10).
+//                              A FIRST above LAST writes the chunks in
+//                              descending order.
+//   idle MS                    No traffic for MS milliseconds
+//   lun N                      Send the following commands to logical unit N.
+//                              The other commands use the geometry of unit 0.
+//   config                     Remount the configuration drive the way
+//                              creating a config file does
+//   fails [bin]                The transfer is expected to fail, or with
+//                              "bin" only when the image is a BIN file
+//
+// After the trace the host stays idle until the drive is removed and comes
+// back. The image in flash and the transfer status are then checked.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rl_usb.h"
+#include "vfs_manager.h"
+#include "flash_stats.h"
+#include "error.h"
+#include "util.h"
+#include "msc_sim.h"
+#include "host_test.h"
+
+#define SECTOR_SIZE         512
+#define DIR_ENTRY_SIZE      32
+#define HIDDEN_SIZE         4096
+#define MAX_RETRIES         100
+#define RETRY_DELAY_MS      100
+#define COMPLETE_TIMEOUT_MS 60000
+
+// Same defaults as vfs_manager.c, shown in the report
+#ifndef VFS_REORDER_SECTORS
+#define VFS_REORDER_SECTORS 0
+#endif
+
+#ifndef VFS_BLOCK_GROUP
+#define VFS_BLOCK_GROUP 1
+#endif
+
+// Sense keys
+#define SENSE_NOT_READY         0x02
+#define SENSE_UNIT_ATTENTION    0x06
+
+typedef struct {
+    const char *name;           // 8.3 name as stored in the directory
+    uint8_t *data;
+    uint32_t size;
+    uint32_t first_cluster;
+    uint32_t clusters;
+    bool hidden;
+} host_file_t;
+
+// The host's view of the drive
+static struct {
+    uint32_t sectors_per_cluster;
+    uint32_t fat_start;
+    uint32_t fat_sectors;
+    uint32_t dir_start;
+    uint32_t dir_sectors;
+    uint32_t data_start;
+    uint32_t total_sectors;
+    uint32_t clusters;
+    uint8_t *fat;               // FAT as last written to the drive
+    uint8_t *dir;               // Root directory as last written to the drive
+} drive;
+
+static host_file_t image = {"IMAGE   BIN"};
+static host_file_t hidden = {"_IMAGE~1BIN"};
+static uint8_t *binary;
+static uint32_t binary_size = 0x40000;
+static bool hex_format;
+static msc_sim_speed_t speed = MSC_SIM_FULL_SPEED;
+static uint64_t last_write_us;
+static uint32_t failures;
+static bool expect_fail;
+
+static void fail(const char *msg, uint32_t line)
+{
+    printf("  FAIL: %s (line %u)\n", msg, line);
+    failures++;
+}
+
+static uint16_t get16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *data)
+{
+    return get16(data) | ((uint32_t)get16(data + 2) << 16);
+}
+
+static void put16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+static void put32(uint8_t *data, uint32_t value)
+{
+    put16(data, value & 0xFFFF);
+    put16(data + 2, value >> 16);
+}
+
+// Send a command the way a host driver does, handling unit attention
+// and not ready conditions reported through REQUEST SENSE
+static bool command(const uint8_t *cb, uint32_t cb_size, uint8_t *data, uint32_t size, bool data_in)
+{
+    uint32_t retry;
+
+    for (retry = 0; retry < MAX_RETRIES; retry++) {
+        uint8_t sense_cb[6] = {SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0};
+        uint8_t sense[18];
+        uint8_t key;
+
+        if (CSW_CMD_PASSED == msc_sim_command(cb, cb_size, data, size, data_in)) {
+            if (!data_in && size) {
+                last_write_us = msc_sim_time_us();
+            }
+
+            return true;
+        }
+
+        if (CSW_CMD_PASSED != msc_sim_command(sense_cb, sizeof(sense_cb), sense, sizeof(sense), true)) {
+            return false;
+        }
+
+        key = sense[2] & 0x0F;
+
+        if (SENSE_NOT_READY == key) {
+            msc_sim_idle(RETRY_DELAY_MS);
+        } else if (SENSE_UNIT_ATTENTION != key) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static bool transfer(uint8_t opcode, uint32_t sector, uint8_t *data, uint32_t count)
+{
+    uint8_t cb[10] = {opcode};
+    put32(&cb[2], __builtin_bswap32(sector));
+    cb[7] = count >> 8;
+    cb[8] = count & 0xFF;
+    return command(cb, sizeof(cb), data, count * SECTOR_SIZE, SCSI_READ10 == opcode);
+}
+
+static bool test_unit_ready(void)
+{
+    uint8_t cb[6] = {SCSI_TEST_UNIT_READY};
+    return command(cb, sizeof(cb), NULL, 0, false);
+}
+
+// Write the sectors of a region that differ from what the host wrote last
+static bool write_changes(uint32_t start, uint8_t *old, const uint8_t *new, uint32_t sectors)
+{
+    uint32_t i;
+
+    for (i = 0; i < sectors; i++) {
+        uint8_t *sector = old + i * SECTOR_SIZE;
+
+        if (0 == memcmp(sector, new + i * SECTOR_SIZE, SECTOR_SIZE)) {
+            continue;
+        }
+
+        memcpy(sector, new + i * SECTOR_SIZE, SECTOR_SIZE);
+
+        if (!transfer(SCSI_WRITE10, start + i, sector, 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t first_free_cluster(const uint8_t *fat)
+{
+    uint32_t cluster;
+
+    for (cluster = 2; cluster < drive.clusters + 2; cluster++) {
+        if (0 == get16(fat + cluster * 2)) {
+            return cluster;
+        }
+    }
+
+    return 0;
+}
+
+static bool allocate(host_file_t *file)
+{
+    uint32_t cluster_size = drive.sectors_per_cluster * SECTOR_SIZE;
+    uint32_t first = first_free_cluster(drive.fat);
+    uint32_t last;
+
+    if (image.clusters && !file->hidden) {
+        return true;
+    }
+
+    // The resource fork goes after the image
+    if (file->hidden && image.clusters) {
+        first = MAX(first, image.first_cluster + image.clusters);
+    }
+
+    file->clusters = (file->size + cluster_size - 1) / cluster_size;
+    file->first_cluster = first;
+    last = first + file->clusters;
+    return first && (last <= drive.clusters + 2);
+}
+
+static void chain(uint8_t *fat, const host_file_t *file)
+{
+    uint32_t i;
+
+    for (i = 0; i < file->clusters; i++) {
+        uint32_t cluster = file->first_cluster + i;
+        put16(fat + cluster * 2, (i + 1 == file->clusters) ? 0xFFFF : cluster + 1);
+    }
+}
+
+static bool mount(void)
+{
+    uint8_t boot[SECTOR_SIZE];
+    uint32_t reserved;
+    uint32_t root_entries;
+
+    if (!transfer(SCSI_READ10, 0, boot, 1)) {
+        return false;
+    }
+
+    if (SECTOR_SIZE != get16(&boot[11]) || 2 != boot[16]) {
+        return false;
+    }
+
+    drive.sectors_per_cluster = boot[13];
+    reserved = get16(&boot[14]);
+    root_entries = get16(&boot[17]);
+    drive.total_sectors = get16(&boot[19]) ? get16(&boot[19]) : get32(&boot[32]);
+    drive.fat_sectors = get16(&boot[22]);
+    drive.fat_start = reserved;
+    drive.dir_start = drive.fat_start + 2 * drive.fat_sectors;
+    drive.dir_sectors = root_entries * DIR_ENTRY_SIZE / SECTOR_SIZE;
+    drive.data_start = drive.dir_start + drive.dir_sectors;
+    drive.clusters = (drive.total_sectors - drive.data_start) / drive.sectors_per_cluster;
+    free(drive.fat);
+    free(drive.dir);
+    drive.fat = malloc(drive.fat_sectors * SECTOR_SIZE);
+    drive.dir = malloc(drive.dir_sectors * SECTOR_SIZE);
+    image.clusters = 0;
+    hidden.clusters = 0;
+
+    return transfer(SCSI_READ10, drive.fat_start, drive.fat, drive.fat_sectors) &&
+           transfer(SCSI_READ10, drive.dir_start, drive.dir, drive.dir_sectors) &&
+           test_unit_ready() && allocate(&image);
+}
+
+// Find the entry for a file or the first free one
+static uint8_t *dir_entry(uint8_t *dir, const host_file_t *file)
+{
+    uint32_t i;
+
+    for (i = 0; i < drive.dir_sectors * SECTOR_SIZE / DIR_ENTRY_SIZE; i++) {
+        uint8_t *entry = dir + i * DIR_ENTRY_SIZE;
+
+        if ((0 == entry[0]) || (0xE5 == entry[0]) || (0 == memcmp(entry, file->name, 11))) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static bool set_entry(uint8_t *dir, const host_file_t *file, uint32_t size)
+{
+    uint8_t *entry = dir_entry(dir, file);
+
+    if (!entry) {
+        return false;
+    }
+
+    memset(entry, 0, DIR_ENTRY_SIZE);
+    memcpy(entry, file->name, 11);
+    entry[11] = file->hidden ? 0x22 : 0x20;
+    put16(&entry[26], size ? file->first_cluster : 0);
+    put32(&entry[28], size);
+    return true;
+}
+
+static bool write_dir(uint32_t image_size, bool with_hidden)
+{
+    uint32_t size = drive.dir_sectors * SECTOR_SIZE;
+    uint8_t *dir = malloc(size);
+    bool ok;
+
+    memcpy(dir, drive.dir, size);
+    ok = set_entry(dir, &image, image_size);
+
+    if (with_hidden) {
+        ok = ok && hidden.clusters && set_entry(dir, &hidden, hidden.size);
+    }
+
+    ok = ok && write_changes(drive.dir_start, drive.dir, dir, drive.dir_sectors);
+    free(dir);
+    return ok;
+}
+
+static bool write_fat(void)
+{
+    uint32_t size = drive.fat_sectors * SECTOR_SIZE;
+    uint8_t *fat = malloc(size);
+    uint8_t *old = malloc(size);
+    bool ok;
+
+    memcpy(fat, drive.fat, size);
+    memcpy(old, drive.fat, size);
+    chain(fat, &image);
+
+    if (hidden.clusters) {
+        chain(fat, &hidden);
+    }
+
+    // Both copies get the same sectors
+    ok = write_changes(drive.fat_start, drive.fat, fat, drive.fat_sectors) &&
+         write_changes(drive.fat_start + drive.fat_sectors, old, fat, drive.fat_sectors);
+    free(old);
+    free(fat);
+    return ok;
+}
+
+static uint32_t file_sector(const host_file_t *file)
+{
+    return drive.data_start + (file->first_cluster - 2) * drive.sectors_per_cluster;
+}
+
+static bool write_data(const host_file_t *file, uint32_t first, uint32_t last, uint32_t chunk)
+{
+    uint8_t *buf = malloc(chunk * SECTOR_SIZE);
+    bool descending = first > last;
+    uint32_t lo = MIN(first, last);
+    uint32_t hi = MAX(first, last);
+    uint32_t chunks = (hi - lo) / chunk + 1;
+    uint32_t i;
+    bool ok = true;
+
+    for (i = 0; ok && (i < chunks); i++) {
+        uint32_t start = lo + (descending ? chunks - 1 - i : i) * chunk;
+        uint32_t count = MIN(chunk, hi + 1 - start);
+        uint32_t offset = start * SECTOR_SIZE;
+
+        // Data past the end of the file is zero
+        memset(buf, 0, chunk * SECTOR_SIZE);
+
+        if (offset < file->size) {
+            memcpy(buf, file->data + offset, MIN(file->size - offset, count * SECTOR_SIZE));
+        }
+
+        ok = transfer(SCSI_WRITE10, file_sector(file) + start, buf, count);
+    }
+
+    free(buf);
+    return ok;
+}
+
+static bool read_region(const char *region, uint32_t first, const char *count_arg)
+{
+    uint32_t start;
+    uint32_t sectors;
+    uint32_t count;
+    uint8_t *buf;
+    bool ok;
+
+    if (0 == strcmp(region, "boot")) {
+        start = 0;
+        sectors = drive.fat_start;
+    } else if (0 == strcmp(region, "fat")) {
+        start = drive.fat_start;
+        sectors = drive.fat_sectors;
+    } else if (0 == strcmp(region, "fat2")) {
+        start = drive.fat_start + drive.fat_sectors;
+        sectors = drive.fat_sectors;
+    } else if (0 == strcmp(region, "dir")) {
+        start = drive.dir_start;
+        sectors = drive.dir_sectors;
+    } else if (0 == strcmp(region, "data")) {
+        start = drive.data_start;
+        sectors = drive.total_sectors - drive.data_start;
+    } else {
+        return false;
+    }
+
+    if (first >= sectors) {
+        return false;
+    }
+
+    count = (0 == strcmp(count_arg, "all")) ? sectors - first : strtoul(count_arg, NULL, 0);
+    count = MIN(count, sectors - first);
+    buf = malloc(count * SECTOR_SIZE);
+    ok = transfer(SCSI_READ10, start + first, buf, count);
+    free(buf);
+    return ok;
+}
+
+static uint32_t parse_sector(const char *arg)
+{
+    if (0 == strcmp(arg, "end")) {
+        return (image.size + SECTOR_SIZE - 1) / SECTOR_SIZE - 1;
+    } else if (0 == strncmp(arg, "mid", 3)) {
+        return image.size / SECTOR_SIZE / 2 + strtoul(arg + 3, NULL, 0);
+    }
+
+    return strtoul(arg, NULL, 0);
+}
+
+static bool run_line(char *line, uint32_t line_num)
+{
+    char *argv[5];
+    uint32_t argc = 0;
+    char *tok;
+
+    line[strcspn(line, "#\r\n")] = 0;
+
+    for (tok = strtok(line, " \t"); tok && (argc < ARRAY_SIZE(argv)); tok = strtok(NULL, " \t")) {
+        argv[argc++] = tok;
+    }
+
+    if (0 == argc) {
+        return true;
+    }
+
+    if (0 == strcmp(argv[0], "mount")) {
+        return mount();
+    } else if (0 == strcmp(argv[0], "tur")) {
+        return test_unit_ready();
+    } else if ((0 == strcmp(argv[0], "read")) && (4 == argc)) {
+        return read_region(argv[1], strtoul(argv[2], NULL, 0), argv[3]);
+    } else if ((0 == strcmp(argv[0], "dir")) && (argc >= 2)) {
+        uint32_t size = 0;
+
+        if (0 == strcmp(argv[1], "final")) {
+            size = image.size;
+        } else if (0 == strcmp(argv[1], "mid")) {
+            size = parse_sector("mid") * SECTOR_SIZE;
+        }
+
+        return write_dir(size, (3 == argc) && (0 == strcmp(argv[2], "hidden")));
+    } else if (0 == strcmp(argv[0], "fat")) {
+        return write_fat();
+    } else if (0 == strcmp(argv[0], "hidden")) {
+        return allocate(&hidden) && write_data(&hidden, 0, hidden.size / SECTOR_SIZE - 1, drive.sectors_per_cluster);
+    } else if ((0 == strcmp(argv[0], "data")) && (4 == argc)) {
+        return write_data(&image, parse_sector(argv[1]), parse_sector(argv[2]), MAX(strtoul(argv[3], NULL, 0), 1));
+    } else if ((0 == strcmp(argv[0], "idle")) && (2 == argc)) {
+        msc_sim_idle(strtoul(argv[1], NULL, 0));
+        return true;
+    } else if ((0 == strcmp(argv[0], "lun")) && (2 == argc)) {
+        msc_sim_set_lun(strtoul(argv[1], NULL, 0));
+        return true;
+    } else if (0 == strcmp(argv[0], "config")) {
+        vfs_mngr_config_remount();
+        return true;
+    } else if (0 == strcmp(argv[0], "fails")) {
+        expect_fail = (1 == argc) || ((0 == strcmp(argv[1], "bin")) && !hex_format);
+        return true;
+    }
+
+    printf("  unknown command '%s' on line %u\n", argv[0], line_num);
+    return false;
+}
+
+// Image with a vector table that passes validation followed by
+// a pattern that is unlikely to repeat
+static void build_binary(void)
+{
+    uint32_t x = 0x12345678;
+    uint32_t i;
+
+    binary = malloc(binary_size);
+
+    for (i = 0; i < binary_size / 4; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        put32(binary + i * 4, x);
+    }
+
+    put32(binary, MSC_SIM_RAM_START + 0x1000);
+
+    for (i = 1; i < 16; i++) {
+        put32(binary + i * 4, MSC_SIM_FLASH_START + 0x101 + i * 2);
+    }
+}
+
+static uint32_t hex_record(char *out, uint8_t type, uint16_t addr, const uint8_t *data, uint8_t size)
+{
+    uint8_t sum = size + (addr >> 8) + (addr & 0xFF) + type;
+    uint32_t len = sprintf(out, ":%02X%04X%02X", size, addr, type);
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        len += sprintf(out + len, "%02X", data[i]);
+        sum += data[i];
+    }
+
+    return len + sprintf(out + len, "%02X\r\n", (uint8_t)(0x100 - sum));
+}
+
+static void build_file(void)
+{
+    uint32_t addr;
+    uint32_t len = 0;
+
+    build_binary();
+
+    if (!hex_format) {
+        image.data = binary;
+        image.size = binary_size;
+        return;
+    }
+
+    // 16 byte data records take 45 characters
+    image.name = "IMAGE   HEX";
+    hidden.name = "_IMAGE~1HEX";
+    image.data = malloc(binary_size / 16 * 45 + binary_size / 0x10000 * 17 + 64);
+
+    for (addr = 0; addr < binary_size; addr += 16) {
+        uint32_t target = MSC_SIM_FLASH_START + addr;
+
+        if (0 == (target & 0xFFFF)) {
+            uint8_t upper[2] = {target >> 24, (target >> 16) & 0xFF};
+            len += hex_record((char *)image.data + len, 4, 0, upper, 2);
+        }
+
+        len += hex_record((char *)image.data + len, 0, target & 0xFFFF, binary + addr, MIN(16, binary_size - addr));
+    }
+
+    len += hex_record((char *)image.data + len, 1, 0, NULL, 0);
+    image.size = len;
+}
+
+static void build_hidden(void)
+{
+    // AppleDouble header, the rest is unused
+    static const uint8_t header[] = {0x00, 0x05, 0x16, 0x07, 0x00, 0x02, 0x00, 0x00};
+
+    hidden.hidden = true;
+    hidden.size = HIDDEN_SIZE;
+    hidden.data = calloc(1, HIDDEN_SIZE);
+    memcpy(hidden.data, header, sizeof(header));
+}
+
+static void report(const char *trace, uint64_t start_us, uint64_t done_us, uint64_t ready_us)
+{
+    const msc_sim_stats_t *stats = msc_sim_get_stats();
+    const flash_stats_t *fstats = flash_stats_get();
+    double seconds = (done_us - start_us) / 1e6;
+    double cpu_seconds = stats->cpu_ns / 1e9;
+
+    printf("%s: %.11s, %u byte image, %s speed, block group %u, reorder %u\n", trace, image.name,
+           binary_size, MSC_SIM_HIGH_SPEED == speed ? "high" : "full", VFS_BLOCK_GROUP, VFS_REORDER_SECTORS);
+    printf("  result          %s\n", failures ? "FAIL" : "PASS");
+    printf("  commands        %u (%u packets)\n", stats->commands, stats->packets);
+    printf("  stream_write    %u calls\n", stats->stream_writes);
+    printf("  transfer        %.0f ms, %.2f MB/s\n", seconds * 1000, image.size / seconds / 1e6);
+    printf("  firmware cpu    %.1f ms, %.1f MB/s\n", cpu_seconds * 1000,
+           cpu_seconds > 0 ? image.size / cpu_seconds / 1e6 : 0);
+    printf("  completion      %.0f ms after the last write\n", (done_us - last_write_us) / 1e3);
+    printf("  remount         %.0f ms\n", (ready_us - done_us) / 1e3);
+    printf("  flash           %u bytes received, %u bytes programmed, failed phase %s\n",
+           fstats->bytes_received, fstats->bytes_programmed, flash_stats_phase_name(fstats->failed_phase));
+}
+
+static bool replay(const char *trace)
+{
+    FILE *file = fopen(trace, "r");
+    char line[256];
+    uint32_t line_num = 0;
+    uint64_t start_us;
+    uint64_t done_us;
+    uint32_t waited;
+    const char *name = strrchr(trace, '/') ? strrchr(trace, '/') + 1 : trace;
+
+    if (!file) {
+        printf("%s: cannot open\n", trace);
+        return false;
+    }
+
+    msc_sim_init(speed);
+    start_us = msc_sim_time_us();
+
+    while (fgets(line, sizeof(line), file)) {
+        line_num++;
+
+        if (!run_line(line, line_num)) {
+            fail("command failed", line_num);
+            break;
+        }
+    }
+
+    fclose(file);
+
+    // Wait for the drive to go away and come back
+    for (waited = 0; (0 == msc_sim_get_stats()->disconnects) && (waited < COMPLETE_TIMEOUT_MS); waited++) {
+        msc_sim_idle(1);
+    }
+
+    done_us = msc_sim_time_us();
+
+    if (0 == msc_sim_get_stats()->disconnects) {
+        fail("drive was not removed", line_num);
+    }
+
+    for (waited = 0; !msc_sim_media_ready() && (waited < COMPLETE_TIMEOUT_MS); waited++) {
+        msc_sim_idle(1);
+    }
+
+    if (!msc_sim_media_ready()) {
+        fail("drive did not come back", line_num);
+    }
+
+    if (expect_fail) {
+        if (ERROR_SUCCESS == vfs_mngr_get_transfer_status()) {
+            fail("transfer did not fail", line_num);
+        }
+    } else if (ERROR_SUCCESS != vfs_mngr_get_transfer_status()) {
+        printf("  transfer status: %s\n", error_get_string(vfs_mngr_get_transfer_status()));
+        fail("transfer failed", line_num);
+    } else if (0 != memcmp(msc_sim_get_flash(), binary, binary_size)) {
+        fail("flash does not match the image", line_num);
+    }
+
+    report(name, start_us, done_us, msc_sim_time_us());
+    return 0 == failures;
+}
+
+static void usage(void)
+{
+    printf("usage: msc_replay [--hs] [--hex] [--size BYTES] TRACE\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *trace = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--hs")) {
+            speed = MSC_SIM_HIGH_SPEED;
+        } else if (0 == strcmp(argv[i], "--hex")) {
+            hex_format = true;
+        } else if ((0 == strcmp(argv[i], "--size")) && (i + 1 < argc)) {
+            binary_size = strtoul(argv[++i], NULL, 0) & ~3;
+        } else if (!trace && ('-' != argv[i][0])) {
+            trace = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (!trace || (binary_size < 64) || (binary_size > MSC_SIM_FLASH_SIZE)) {
+        usage();
+        return 2;
+    }
+
+    build_file();
+    build_hidden();
+
+    // util_assert failures in the firmware also fail the run
+    if (!replay(trace)) {
+        host_test_result();
+        return 1;
+    }
+
+    return host_test_result();
+}
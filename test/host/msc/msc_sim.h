@@ -0,0 +1,86 @@
+/**
+ * @file    msc_sim.h
+ * @brief   Host simulation of the DAPLink mass storage interface
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MSC_SIM_H
+#define MSC_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start of the simulated target flash and RAM
+#define MSC_SIM_FLASH_START     0x00000000
+#define MSC_SIM_FLASH_SIZE      0x00100000
+#define MSC_SIM_RAM_START       0x20000000
+#define MSC_SIM_RAM_SIZE        0x00040000
+
+// Erased state of the simulated flash
+#define MSC_SIM_FLASH_ERASED    0xFF
+
+typedef enum {
+    MSC_SIM_FULL_SPEED,
+    MSC_SIM_HIGH_SPEED,
+} msc_sim_speed_t;
+
+// Counters collected while the simulation runs
+typedef struct {
+    uint32_t commands;          // SCSI commands sent
+    uint32_t packets;           // Bulk packets in either direction
+    uint32_t stream_writes;     // Calls to stream_write
+    uint32_t disconnects;       // Times the drive was removed for a remount
+    uint64_t cpu_ns;            // Host time spent in firmware code
+} msc_sim_stats_t;
+
+// Reset the firmware modules and connect the drive
+void msc_sim_init(msc_sim_speed_t speed);
+
+// Send one SCSI command over the bulk only transport and return the CSW
+// status. Data is read into or written from data depending on data_in.
+uint8_t msc_sim_command(const uint8_t *cb, uint32_t cb_size, uint8_t *data, uint32_t size, bool data_in);
+
+// Logical unit the following commands are sent to
+void msc_sim_set_lun(uint8_t lun);
+
+// Let simulated time pass without any USB traffic
+void msc_sim_idle(uint32_t ms);
+
+// Simulated time since msc_sim_init
+uint64_t msc_sim_time_us(void);
+
+// True if the main drive is currently present
+bool msc_sim_media_ready(void);
+
+const msc_sim_stats_t *msc_sim_get_stats(void);
+const uint8_t *msc_sim_get_flash(void);
+
+// Hooks in the firmware side of the simulation
+void msc_sim_target_reset(void);
+void msc_sim_count_stream_write(void);
+void msc_sim_count_disconnect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
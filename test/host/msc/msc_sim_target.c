@@ -0,0 +1,304 @@
+/**
+ * @file    msc_sim_target.c
+ * @brief   In-memory target flash and firmware services for the MSC simulation
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "cmsis_os2.h"
+#include "daplink.h"
+#include "flash_intf.h"
+#include "main.h"
+#include "settings.h"
+#include "target_board.h"
+#include "target_family.h"
+#include "virtual_fs.h"
+#include "vfs_manager.h"
+#include "util.h"
+#include "msc_sim.h"
+
+#define SECTOR_SIZE     0x1000
+#define PAGE_SIZE       0x400
+
+#ifndef VFS_DISK_SIZE
+#define VFS_DISK_SIZE   MB(64)
+#endif
+
+static uint8_t flash[MSC_SIM_FLASH_SIZE];
+static bool flash_open;
+
+static error_t target_flash_init(void)
+{
+    flash_open = true;
+    return ERROR_SUCCESS;
+}
+
+static error_t target_flash_uninit(void)
+{
+    flash_open = false;
+    return ERROR_SUCCESS;
+}
+
+static bool flash_range_valid(uint32_t addr, uint32_t size)
+{
+    return flash_open && (addr >= MSC_SIM_FLASH_START) &&
+           (addr - MSC_SIM_FLASH_START <= MSC_SIM_FLASH_SIZE) &&
+           (size <= MSC_SIM_FLASH_SIZE - (addr - MSC_SIM_FLASH_START));
+}
+
+static error_t target_flash_program_page(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    uint32_t i;
+
+    if (!flash_range_valid(addr, size)) {
+        return ERROR_WRITE;
+    }
+
+    // Programming can only clear bits
+    for (i = 0; i < size; i++) {
+        flash[addr - MSC_SIM_FLASH_START + i] &= buf[i];
+    }
+
+    if (0 != memcmp(&flash[addr - MSC_SIM_FLASH_START], buf, size)) {
+        return ERROR_WRITE_VERIFY;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static error_t target_flash_erase_sector(uint32_t addr)
+{
+    if ((addr % SECTOR_SIZE) || !flash_range_valid(addr, SECTOR_SIZE)) {
+        return ERROR_ERASE_SECTOR;
+    }
+
+    memset(&flash[addr - MSC_SIM_FLASH_START], MSC_SIM_FLASH_ERASED, SECTOR_SIZE);
+    return ERROR_SUCCESS;
+}
+
+static error_t target_flash_erase_chip(void)
+{
+    if (!flash_open) {
+        return ERROR_ERASE_ALL;
+    }
+
+    memset(flash, MSC_SIM_FLASH_ERASED, sizeof(flash));
+    return ERROR_SUCCESS;
+}
+
+static uint32_t target_flash_program_page_min_size(uint32_t addr)
+{
+    return PAGE_SIZE;
+}
+
+static uint32_t target_flash_erase_sector_size(uint32_t addr)
+{
+    return SECTOR_SIZE;
+}
+
+static uint8_t target_flash_busy(void)
+{
+    return 0;
+}
+
+static error_t target_flash_set(uint32_t addr)
+{
+    return ERROR_SUCCESS;
+}
+
+static error_t target_flash_read(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    if (!flash_range_valid(addr, size)) {
+        return ERROR_ALGO_DATA_SEQ;
+    }
+
+    memcpy(buf, &flash[addr - MSC_SIM_FLASH_START], size);
+    return ERROR_SUCCESS;
+}
+
+static bool target_flash_erased_value(uint32_t addr, uint8_t *value)
+{
+    *value = MSC_SIM_FLASH_ERASED;
+    return true;
+}
+
+static const flash_intf_t flash_intf = {
+    target_flash_init,
+    target_flash_uninit,
+    target_flash_program_page,
+    target_flash_erase_sector,
+    target_flash_erase_chip,
+    target_flash_program_page_min_size,
+    target_flash_erase_sector_size,
+    target_flash_busy,
+    target_flash_set,
+    target_flash_read,
+    target_flash_erased_value,
+};
+
+const flash_intf_t *const flash_intf_target = &flash_intf;
+const flash_intf_t *const flash_intf_target_custom = 0;
+const flash_intf_t *const flash_intf_target_ram = 0;
+const flash_intf_t *const flash_intf_iap_protected = 0;
+
+static target_cfg_t sim_target_cfg = {
+    .flash_regions[0] = {
+        .start = MSC_SIM_FLASH_START,
+        .end = MSC_SIM_FLASH_START + MSC_SIM_FLASH_SIZE,
+        .flags = kRegionIsDefault,
+    },
+    .ram_regions[0] = {
+        .start = MSC_SIM_RAM_START,
+        .end = MSC_SIM_RAM_START + MSC_SIM_RAM_SIZE,
+    },
+};
+
+const board_info_t g_board_info = {
+    .info_version = kBoardInfoVersion,
+    .board_id = "0000",
+    .target_cfg = &sim_target_cfg,
+};
+
+const target_family_descriptor_t *g_target_family = 0;
+
+void msc_sim_target_reset(void)
+{
+    memset(flash, MSC_SIM_FLASH_ERASED, sizeof(flash));
+    flash_open = false;
+}
+
+const uint8_t *msc_sim_get_flash(void)
+{
+    return flash;
+}
+
+bool daplink_is_bootloader(void)
+{
+    return false;
+}
+
+bool daplink_is_interface(void)
+{
+    return true;
+}
+
+bool config_get_automation_allowed(void)
+{
+    return false;
+}
+
+bool config_get_auto_rst(void)
+{
+    return false;
+}
+
+void config_ram_set_page_erase(bool page_erase_enable)
+{
+}
+
+void main_blink_msc_led(main_led_state_t state)
+{
+}
+
+// Single threaded RTOS. The simulated firmware always runs on the USB thread.
+osThreadId_t osThreadGetId(void)
+{
+    return (osThreadId_t)1;
+}
+
+osMutexId_t osMutexNew(const osMutexAttr_t *attr)
+{
+    return (osMutexId_t)1;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout)
+{
+    return osOK;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id)
+{
+    return osOK;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return 100;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return 1000000;
+}
+
+// The drive holds the files of the interface firmware drive that
+// matter for programming. Magic files and status files are not simulated.
+void vfs_user_build_filesystem(void)
+{
+    vfs_init("DAPLINK    ", VFS_DISK_SIZE);
+    vfs_create_file("MBED    HTM", 0, 0, 512);
+
+    if (VFS_DRIVE_CONFIG == VFS_DRIVE_MAIN) {
+        vfs_create_file("DETAILS TXT", 0, 0, 1024);
+    }
+}
+
+void vfs_user_build_config_filesystem(void)
+{
+    vfs_init("DAPLINK_CFG", VFS_CLUSTERS_MIN * VFS_CLUSTER_SIZE);
+    vfs_create_file("DETAILS TXT", 0, 0, 1024);
+}
+
+void vfs_user_file_change_handler(const vfs_filename_t filename, vfs_file_change_t change, vfs_file_t file, vfs_file_t new_file_data)
+{
+}
+
+void vfs_user_disconnecting(void)
+{
+    msc_sim_count_disconnect();
+}
+
+void vfs_user_state_changed(void)
+{
+}
+
+// Count the calls vfs_manager makes into the stream layer.
+// The build links with -Wl,--wrap=stream_write.
+error_t __real_stream_write(const uint8_t *data, uint32_t size);
+
+error_t __wrap_stream_write(const uint8_t *data, uint32_t size)
+{
+    msc_sim_count_stream_write();
+    return __real_stream_write(data, size);
+}
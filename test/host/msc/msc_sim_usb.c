@@ -0,0 +1,322 @@
+/**
+ * @file    msc_sim_usb.c
+ * @brief   Simulated bulk endpoints and host side of the bulk only transport
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "rl_usb.h"
+#include "usb_for_lib.h"
+#include "vfs_manager.h"
+#include "util.h"
+#include "msc_sim.h"
+
+#define EP_BULK             2
+#define CBW_SIZE            31
+#define CSW_SIZE            13
+
+// Bulk packets per frame the host controller schedules for one endpoint.
+// Full speed frames are 1ms, high speed microframes are 125us.
+#define FS_PACKETS_PER_FRAME    19
+#define FS_FRAME_US             1000
+#define HS_PACKETS_PER_FRAME    13
+#define HS_FRAME_US             125
+
+// The interface main loop runs vfs_mngr_periodic at this interval
+#define PERIODIC_MS             90
+
+// USB device configuration normally provided by usb_config.c
+const U8 usbd_msc_ep_bulkin = EP_BULK;
+const U8 usbd_msc_ep_bulkout = EP_BULK;
+const U16 usbd_msc_maxpacketsize[2] = {64, 512};
+static const U8 inquiry_data[] = "ARM     " "DAPLink SIM     " "1.0 ";
+const U8 *usbd_msc_inquiry_data = inquiry_data;
+const U16 USBD_MSC_BulkBufSize = 512;
+U8 USBD_MSC_BulkBuf[512];
+
+// USB core state normally provided by usbd_core.c
+U32 USBD_EndPointHalt;
+U32 USBD_EndPointStall;
+U8 USBD_HighSpeed;
+USB_SETUP_PACKET USBD_SetupPacket;
+U8 USBD_EP0Buf[64];
+
+static msc_sim_stats_t stats;
+static uint64_t time_us;
+static uint64_t next_periodic_us;
+static uint32_t frame_us;
+static uint32_t packets_per_frame;
+static uint32_t tag;
+static uint8_t lun;
+
+// Endpoint buffers
+static uint8_t in_packet[512];
+static uint32_t in_size;
+static bool in_full;
+static bool in_stalled;
+static const uint8_t *out_packet;
+static uint32_t out_size;
+static bool out_stalled;
+
+static uint64_t cpu_start(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void cpu_end(uint64_t start)
+{
+    stats.cpu_ns += cpu_start() - start;
+}
+
+// Run the main loop work that is due by the current time
+static void run_periodic(void)
+{
+    while (time_us >= next_periodic_us) {
+        uint64_t start = cpu_start();
+        vfs_mngr_periodic(PERIODIC_MS);
+        cpu_end(start);
+        next_periodic_us += PERIODIC_MS * 1000;
+    }
+}
+
+// Account for the bus time of one packet
+static void bus_packet(void)
+{
+    stats.packets++;
+    time_us += frame_us / packets_per_frame;
+}
+
+U32 USBD_ReadEP(U32 EPNum, U8 *pData, U32 cnt)
+{
+    uint32_t size = MIN(cnt, out_size);
+    memcpy(pData, out_packet, size);
+    return size;
+}
+
+U32 USBD_WriteEP(U32 EPNum, U8 *pData, U32 cnt)
+{
+    // The host must have taken the previous packet. Writes to
+    // a stalled endpoint replace what was queued.
+    util_assert(!in_full || in_stalled);
+    util_assert(cnt <= sizeof(in_packet));
+    memcpy(in_packet, pData, cnt);
+    in_size = cnt;
+    in_full = true;
+    return cnt;
+}
+
+void USBD_SetStallEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        in_stalled = true;
+        // A stall discards anything queued
+        in_full = false;
+    } else {
+        out_stalled = true;
+    }
+}
+
+void USBD_ClrStallEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        // Clearing the halt flushes the endpoint so the
+        // class driver writes the CSW again
+        in_stalled = false;
+        in_full = false;
+    } else {
+        out_stalled = false;
+    }
+}
+
+// Host sends CLEAR_FEATURE(ENDPOINT_HALT), handled as in usbd_core.c
+static void clear_halt(U32 EPNum)
+{
+    U32 m = (EPNum & 0x80) ? ((1 << 16) << (EPNum & 0x0F)) : (1 << EPNum);
+    uint64_t start = cpu_start();
+
+    if (USBD_EndPointStall & m) {
+        cpu_end(start);
+        return;
+    }
+
+    USBD_SetupPacket.wIndexL = EPNum;
+    USBD_ClrStallEP(EPNum);
+    USBD_MSC_ClrStallEP(EPNum);
+    USBD_EndPointHalt &= ~m;
+    cpu_end(start);
+}
+
+static void send_out(const uint8_t *data, uint32_t size)
+{
+    uint64_t start;
+    bus_packet();
+    out_packet = data;
+    out_size = size;
+    start = cpu_start();
+    USBD_MSC_EP_BULKOUT_Event(0);
+    cpu_end(start);
+    run_periodic();
+}
+
+// Take the packet queued on the IN endpoint. Returns its size or -1 if
+// the endpoint is stalled or the device has nothing to send.
+static int receive_in(uint8_t *data, uint32_t size)
+{
+    uint32_t received;
+    uint64_t start;
+
+    if (in_stalled || !in_full) {
+        return -1;
+    }
+
+    bus_packet();
+    received = MIN(in_size, size);
+    memcpy(data, in_packet, received);
+    in_full = false;
+    start = cpu_start();
+    USBD_MSC_EP_BULKIN_Event(0);
+    cpu_end(start);
+    run_periodic();
+    return received;
+}
+
+void msc_sim_init(msc_sim_speed_t speed)
+{
+    memset(&stats, 0, sizeof(stats));
+    time_us = 0;
+    next_periodic_us = PERIODIC_MS * 1000;
+    USBD_HighSpeed = MSC_SIM_HIGH_SPEED == speed;
+    frame_us = USBD_HighSpeed ? HS_FRAME_US : FS_FRAME_US;
+    packets_per_frame = USBD_HighSpeed ? HS_PACKETS_PER_FRAME : FS_PACKETS_PER_FRAME;
+    msc_sim_target_reset();
+    lun = 0;
+    // Same order as usbd_init and main in the interface firmware
+    usbd_msc_init();
+    USBD_MSC_Reset();
+    vfs_mngr_fs_enable(true);
+
+    while (!USBD_MSC_MediaReady[0]) {
+        msc_sim_idle(PERIODIC_MS);
+    }
+}
+
+uint8_t msc_sim_command(const uint8_t *cb, uint32_t cb_size, uint8_t *data, uint32_t size, bool data_in)
+{
+    MSC_CBW cbw;
+    MSC_CSW csw;
+    uint32_t max_packet = usbd_msc_maxpacketsize[USBD_HighSpeed];
+    uint32_t done = 0;
+    int received;
+
+    util_assert(cb_size <= sizeof(cbw.CB));
+    memset(&cbw, 0, sizeof(cbw));
+    cbw.dSignature = MSC_CBW_Signature;
+    cbw.dTag = ++tag;
+    cbw.dDataLength = size;
+    cbw.bLUN = lun;
+    cbw.bmFlags = data_in ? 0x80 : 0x00;
+    cbw.bCBLength = cb_size;
+    memcpy(cbw.CB, cb, cb_size);
+    stats.commands++;
+    send_out((const uint8_t *)&cbw, CBW_SIZE);
+
+    // Data stage until it completes or the device stalls
+    while (done < size) {
+        uint32_t packet = MIN(size - done, max_packet);
+
+        if (data_in) {
+            received = receive_in(data + done, packet);
+
+            if (received < 0) {
+                break;
+            }
+
+            done += received;
+
+            if (received < packet) {
+                break;
+            }
+        } else {
+            if (out_stalled) {
+                break;
+            }
+
+            send_out(data + done, packet);
+            done += packet;
+        }
+    }
+
+    if (out_stalled) {
+        clear_halt(usbd_msc_ep_bulkout);
+    }
+
+    if (in_stalled) {
+        clear_halt(usbd_msc_ep_bulkin | 0x80);
+    }
+
+    // Status stage
+    memset(&csw, 0, sizeof(csw));
+    received = receive_in((uint8_t *)&csw, sizeof(csw));
+
+    if ((CSW_SIZE != received) || (MSC_CSW_Signature != csw.dSignature) || (cbw.dTag != csw.dTag)) {
+        util_assert(0);
+        return CSW_PHASE_ERROR;
+    }
+
+    return csw.bStatus;
+}
+
+void msc_sim_idle(uint32_t ms)
+{
+    time_us += (uint64_t)ms * 1000;
+    run_periodic();
+}
+
+uint64_t msc_sim_time_us(void)
+{
+    return time_us;
+}
+
+void msc_sim_set_lun(uint8_t new_lun)
+{
+    lun = new_lun;
+}
+
+bool msc_sim_media_ready(void)
+{
+    return USBD_MSC_MediaReady[0];
+}
+
+const msc_sim_stats_t *msc_sim_get_stats(void)
+{
+    return &stats;
+}
+
+void msc_sim_count_stream_write(void)
+{
+    stats.stream_writes++;
+}
+
+void msc_sim_count_disconnect(void)
+{
+    stats.disconnects++;
+}
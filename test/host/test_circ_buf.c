@@ -0,0 +1,333 @@
+/**
+ * @file    test_circ_buf.c
+ * @brief   Host tests for the circular buffer
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "circ_buf.h"
+#include "util.h"
+#include "host_test.h"
+
+#define BUFFER_SIZE     64
+
+// Small so the indices wrap often while two threads use the buffer
+#define SPSC_BUFFER_SIZE    16
+#define SPSC_STRESS_BYTES   (4 * 1024 * 1024)
+
+static circ_buf_t circ_buf;
+static uint8_t buffer[BUFFER_SIZE];
+static uint8_t data[BUFFER_SIZE * 2];
+
+static uint8_t pattern(uint32_t i)
+{
+    return (uint8_t)(i * 7 + 3);
+}
+
+// Move the head and tail to offset so the next write starts there
+static void init_at(uint32_t offset)
+{
+    uint32_t i;
+
+    circ_buf_init(&circ_buf, buffer, sizeof(buffer));
+    for (i = 0; i < offset; i++) {
+        circ_buf_push(&circ_buf, 0);
+        circ_buf_pop(&circ_buf);
+    }
+    CHECK(0 == circ_buf_count_used(&circ_buf));
+}
+
+static void test_push_pop(void)
+{
+    uint32_t i;
+
+    init_at(0);
+    CHECK(BUFFER_SIZE - 1 == circ_buf_count_free(&circ_buf));
+    for (i = 0; i < BUFFER_SIZE - 1; i++) {
+        circ_buf_push(&circ_buf, pattern(i));
+    }
+    CHECK(0 == circ_buf_count_free(&circ_buf));
+    CHECK(BUFFER_SIZE - 1 == circ_buf_count_used(&circ_buf));
+    for (i = 0; i < BUFFER_SIZE - 1; i++) {
+        CHECK(pattern(i) == circ_buf_pop(&circ_buf));
+    }
+    CHECK(0 == circ_buf_count_used(&circ_buf));
+}
+
+// circ_buf_read and circ_buf_write at every start offset and size
+static void test_read_write(void)
+{
+    uint32_t offset;
+    uint32_t size;
+    uint32_t i;
+
+    for (offset = 0; offset < BUFFER_SIZE; offset++) {
+        for (size = 0; size <= BUFFER_SIZE; size++) {
+            uint32_t expected = MIN(size, BUFFER_SIZE - 1);
+
+            init_at(offset);
+            for (i = 0; i < size; i++) {
+                data[i] = pattern(i);
+            }
+            CHECK(expected == circ_buf_write(&circ_buf, data, size));
+            CHECK(expected == circ_buf_count_used(&circ_buf));
+
+            memset(data, 0, sizeof(data));
+            CHECK(expected == circ_buf_read(&circ_buf, data, sizeof(data)));
+            for (i = 0; i < expected; i++) {
+                if (!CHECK(pattern(i) == data[i])) {
+                    break;
+                }
+            }
+            CHECK(0 == circ_buf_count_used(&circ_buf));
+        }
+    }
+}
+
+// The peeked segments cover all free space and all data, end at the wrap
+// and never hand out the byte that keeps a full buffer from looking empty
+static void test_peek_commit(void)
+{
+    uint32_t offset;
+    uint32_t i;
+
+    for (offset = 0; offset < BUFFER_SIZE; offset++) {
+        uint8_t *segment;
+        uint32_t cnt;
+        uint32_t total = 0;
+
+        init_at(offset);
+        CHECK(0 == circ_buf_peek_read(&circ_buf, &segment));
+
+        while ((cnt = circ_buf_peek_write(&circ_buf, &segment)) != 0) {
+            CHECK(segment >= buffer && segment + cnt <= buffer + sizeof(buffer));
+            for (i = 0; i < cnt; i++) {
+                segment[i] = pattern(total + i);
+            }
+            circ_buf_commit_write(&circ_buf, cnt);
+            total += cnt;
+        }
+        CHECK(BUFFER_SIZE - 1 == total);
+        CHECK(0 == circ_buf_count_free(&circ_buf));
+
+        total = 0;
+        while ((cnt = circ_buf_peek_read(&circ_buf, &segment)) != 0) {
+            CHECK(segment >= buffer && segment + cnt <= buffer + sizeof(buffer));
+            for (i = 0; i < cnt; i++) {
+                CHECK(pattern(total + i) == segment[i]);
+            }
+            // Release part of the segment to check partial commits
+            cnt = (cnt + 1) / 2;
+            circ_buf_commit_read(&circ_buf, cnt);
+            total += cnt;
+        }
+        CHECK(BUFFER_SIZE - 1 == total);
+        CHECK(0 == circ_buf_count_used(&circ_buf));
+    }
+}
+
+static void test_spsc(void)
+{
+    static circ_buf_spsc_t spsc;
+    static uint8_t spsc_buffer[BUFFER_SIZE];
+    uint8_t *segment;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t i;
+
+    // Indices close to wrapping at 2^32 and every start offset
+    for (offset = 0; offset < BUFFER_SIZE; offset++) {
+        for (size = 0; size <= BUFFER_SIZE + 1; size++) {
+            uint32_t expected = MIN(size, BUFFER_SIZE);
+
+            circ_buf_spsc_init(&spsc, spsc_buffer, sizeof(spsc_buffer));
+            spsc.head = spsc.tail = 0 - BUFFER_SIZE / 2 + offset;
+            for (i = 0; i < size; i++) {
+                data[i] = pattern(i);
+            }
+            CHECK(expected == circ_buf_spsc_write(&spsc, data, size));
+            CHECK(expected == circ_buf_spsc_count_used(&spsc));
+            CHECK(BUFFER_SIZE - expected == circ_buf_spsc_count_free(&spsc));
+            if (expected == BUFFER_SIZE) {
+                CHECK(0 == circ_buf_spsc_peek_write(&spsc, &segment));
+            }
+
+            memset(data, 0, sizeof(data));
+            if (expected) {
+                CHECK(pattern(0) == circ_buf_spsc_pop(&spsc));
+                CHECK(expected - 1 == circ_buf_spsc_read(&spsc, data + 1, sizeof(data)));
+            }
+            for (i = 1; i < expected; i++) {
+                if (!CHECK(pattern(i) == data[i])) {
+                    break;
+                }
+            }
+            CHECK(0 == circ_buf_spsc_count_used(&spsc));
+            CHECK(0 == circ_buf_spsc_peek_read(&spsc, &segment));
+        }
+    }
+}
+
+// Two threads stand in for an interrupt handler and the main task. The
+// producer writes a counting sequence in chunks of changing size using
+// each of the producer calls, and the consumer checks it arrives in order.
+typedef struct {
+    circ_buf_spsc_t *buf;
+    uint32_t errors;
+    uint32_t waits;
+} spsc_side_t;
+
+static void *spsc_producer(void *arg)
+{
+    spsc_side_t *side = arg;
+    uint8_t chunk[SPSC_BUFFER_SIZE * 2];
+    uint32_t sent = 0;
+    uint32_t seed = 1;
+
+    while (sent < SPSC_STRESS_BYTES) {
+        uint8_t *segment;
+        uint32_t size;
+        uint32_t i;
+
+        seed = seed * 1103515245 + 12345;
+        size = MIN((seed >> 16) % sizeof(chunk) + 1, SPSC_STRESS_BYTES - sent);
+
+        switch ((seed >> 8) % 3) {
+            case 0:
+                for (i = 0; i < size; i++) {
+                    chunk[i] = (uint8_t)(sent + i);
+                }
+                size = circ_buf_spsc_write(side->buf, chunk, size);
+                break;
+
+            case 1:
+                size = MIN(size, circ_buf_spsc_peek_write(side->buf, &segment));
+                for (i = 0; i < size; i++) {
+                    segment[i] = (uint8_t)(sent + i);
+                }
+                circ_buf_spsc_commit_write(side->buf, size);
+                break;
+
+            default:
+                size = 0;
+                if (circ_buf_spsc_count_free(side->buf)) {
+                    circ_buf_spsc_push(side->buf, (uint8_t)sent);
+                    size = 1;
+                }
+                break;
+        }
+
+        if (0 == size) {
+            side->waits++;
+            sched_yield();
+        }
+        sent += size;
+    }
+
+    return NULL;
+}
+
+static void *spsc_consumer(void *arg)
+{
+    spsc_side_t *side = arg;
+    uint8_t chunk[SPSC_BUFFER_SIZE * 2];
+    uint32_t received = 0;
+    uint32_t seed = 2;
+
+    while (received < SPSC_STRESS_BYTES) {
+        uint8_t *segment;
+        uint32_t size;
+        uint32_t i;
+
+        seed = seed * 1103515245 + 12345;
+        size = (seed >> 16) % sizeof(chunk) + 1;
+
+        switch ((seed >> 8) % 3) {
+            case 0:
+                size = circ_buf_spsc_read(side->buf, chunk, size);
+                segment = chunk;
+                break;
+
+            case 1:
+                size = MIN(size, circ_buf_spsc_peek_read(side->buf, &segment));
+                break;
+
+            default:
+                size = 0;
+                if (circ_buf_spsc_count_used(side->buf)) {
+                    chunk[0] = circ_buf_spsc_pop(side->buf);
+                    segment = chunk;
+                    size = 1;
+                }
+                break;
+        }
+
+        for (i = 0; i < size; i++) {
+            if (segment[i] != (uint8_t)(received + i)) {
+                side->errors++;
+            }
+        }
+        if (segment != chunk) {
+            circ_buf_spsc_commit_read(side->buf, size);
+        }
+
+        if (0 == size) {
+            side->waits++;
+            sched_yield();
+        }
+        received += size;
+    }
+
+    return NULL;
+}
+
+static void test_spsc_stress(void)
+{
+    static circ_buf_spsc_t spsc;
+    static uint8_t spsc_buffer[SPSC_BUFFER_SIZE];
+    spsc_side_t producer_side = {&spsc, 0, 0};
+    spsc_side_t consumer_side = {&spsc, 0, 0};
+    pthread_t producer;
+    pthread_t consumer;
+
+    circ_buf_spsc_init(&spsc, spsc_buffer, sizeof(spsc_buffer));
+    CHECK(0 == pthread_create(&producer, NULL, spsc_producer, &producer_side));
+    CHECK(0 == pthread_create(&consumer, NULL, spsc_consumer, &consumer_side));
+    CHECK(0 == pthread_join(producer, NULL));
+    CHECK(0 == pthread_join(consumer, NULL));
+
+    CHECK(0 == consumer_side.errors);
+    CHECK(0 == circ_buf_spsc_count_used(&spsc));
+    printf("  %u bytes between two threads, %u out of order, %u producer and %u consumer waits\n",
+           SPSC_STRESS_BYTES, consumer_side.errors, producer_side.waits, consumer_side.waits);
+}
+
+int main(void)
+{
+    printf("circ_buf\n");
+    test_push_pop();
+    test_read_write();
+    test_peek_commit();
+    test_spsc();
+    test_spsc_stress();
+    return host_test_result();
+}
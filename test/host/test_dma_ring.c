@@ -0,0 +1,211 @@
+/**
+ * @file    test_dma_ring.c
+ * @brief   Host tests for the DMA ring reader
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma_ring.h"
+#include "util.h"
+#include "host_test.h"
+
+#define RING_SIZE       64
+#define STREAM_BYTES    (1024 * 1024)
+
+// A DMA channel in circular mode. remaining counts down from the size
+// of the buffer and is reloaded when it reaches zero.
+static struct {
+    uint8_t buf[RING_SIZE];
+    uint32_t remaining;
+    uint32_t written;           // Bytes written since the start
+    bool half;                  // Half transfer flag
+    bool complete;              // Transfer complete flag
+} dma;
+
+static dma_ring_t ring;
+static uint32_t read;           // Bytes read since the start
+
+static uint8_t pattern(uint32_t i)
+{
+    return (uint8_t)(i * 13 + 5);
+}
+
+static void dma_start(void)
+{
+    memset(&dma, 0, sizeof(dma));
+    dma.remaining = RING_SIZE;
+    dma_ring_init(&ring, dma.buf, sizeof(dma.buf));
+    read = 0;
+}
+
+static void dma_write(uint32_t size)
+{
+    while (size--) {
+        dma.buf[RING_SIZE - dma.remaining] = pattern(dma.written++);
+        dma.remaining--;
+        if (RING_SIZE / 2 == dma.remaining) {
+            dma.half = true;
+        }
+        if (0 == dma.remaining) {
+            dma.complete = true;
+            dma.remaining = RING_SIZE;
+        }
+    }
+}
+
+// Read everything the way a UART interrupt handler does. Returns the
+// number of blocks it took.
+static uint32_t ring_read_all(uint32_t remaining)
+{
+    uint32_t blocks = 0;
+    uint8_t *data;
+    uint32_t cnt;
+    uint32_t i;
+
+    while ((cnt = dma_ring_peek_read(&ring, remaining, &data)) > 0) {
+        for (i = 0; i < cnt; i++) {
+            CHECK(pattern(read) == data[i]);
+            read++;
+        }
+        dma_ring_commit_read(&ring, cnt);
+        blocks++;
+    }
+    return blocks;
+}
+
+static void test_empty(void)
+{
+    uint8_t *data;
+
+    dma_start();
+    CHECK(0 == dma_ring_peek_read(&ring, dma.remaining, &data));
+    CHECK(dma.buf == data);
+    CHECK(0 == ring_read_all(dma.remaining));
+}
+
+// Data that does not reach the end of the buffer is one block
+static void test_partial(void)
+{
+    uint8_t *data;
+
+    dma_start();
+    dma_write(5);
+    CHECK(5 == dma_ring_peek_read(&ring, dma.remaining, &data));
+    CHECK(dma.buf == data);
+    dma_ring_commit_read(&ring, 2);
+    CHECK(3 == dma_ring_peek_read(&ring, dma.remaining, &data));
+    CHECK(dma.buf + 2 == data);
+    dma_ring_commit_read(&ring, 3);
+    read = 5;
+
+    dma_write(20);
+    CHECK(1 == ring_read_all(dma.remaining));
+    CHECK(dma.written == read);
+}
+
+// Data up to the last byte is one block and the reader wraps to the start
+static void test_to_end(void)
+{
+    dma_start();
+    dma_write(RING_SIZE - 1);
+    CHECK(1 == ring_read_all(dma.remaining));
+    dma_write(1);
+    CHECK(dma.complete);
+    CHECK(RING_SIZE == dma.remaining);
+    CHECK(1 == ring_read_all(dma.remaining));
+    CHECK(RING_SIZE == read);
+
+    dma_write(3);
+    CHECK(1 == ring_read_all(dma.remaining));
+    CHECK(dma.written == read);
+}
+
+// Data across the end of the buffer is two blocks
+static void test_wrap(void)
+{
+    uint8_t *data;
+
+    dma_start();
+    dma_write(RING_SIZE - 10);
+    CHECK(1 == ring_read_all(dma.remaining));
+    dma_write(25);
+    CHECK(10 == dma_ring_peek_read(&ring, dma.remaining, &data));
+    CHECK(dma.buf + RING_SIZE - 10 == data);
+    CHECK(2 == ring_read_all(dma.remaining));
+    CHECK(dma.written == read);
+    CHECK(dma.buf + 15 == ring.buf + ring.tail);
+}
+
+// A count read back as zero before the reload is the start of the buffer
+static void test_zero_remaining(void)
+{
+    dma_start();
+    dma_write(RING_SIZE - 4);
+    CHECK(1 == ring_read_all(dma.remaining));
+    dma_write(4);
+    CHECK(1 == ring_read_all(0));
+    CHECK(RING_SIZE == read);
+    CHECK(0 == ring_read_all(dma.remaining));
+}
+
+// Random bursts read at the half, complete and idle points, as the
+// interrupt handlers do, keep every byte in order
+static void test_stream(void)
+{
+    uint32_t reads = 0;
+
+    dma_start();
+    srand(1);
+    while (dma.written < STREAM_BYTES) {
+        uint32_t burst = rand() % (RING_SIZE * 2) + 1;
+
+        while (burst > 0) {
+            // The interrupts come at least every half buffer
+            uint32_t cnt = MIN(burst, RING_SIZE / 2 - (dma.written % (RING_SIZE / 2)));
+
+            dma_write(cnt);
+            burst -= cnt;
+            if (dma.half || dma.complete) {
+                dma.half = false;
+                dma.complete = false;
+                ring_read_all(dma.remaining);
+                reads++;
+            }
+        }
+        // Idle line
+        ring_read_all(dma.remaining);
+        reads++;
+    }
+    CHECK(dma.written == read);
+    printf("  %u bytes through a %u byte ring in %u reads\n", read, RING_SIZE, reads);
+}
+
+int main(void)
+{
+    printf("dma_ring\n");
+    test_empty();
+    test_partial();
+    test_to_end();
+    test_wrap();
+    test_zero_remaining();
+    test_stream();
+    return host_test_result();
+}
@@ -0,0 +1,441 @@
+/**
+ * @file    test_file_stream.c
+ * @brief   Host tests for the S-record and ELF file streams
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "file_stream.h"
+#include "flash_decoder.h"
+#include "validation.h"
+#include "cmsis_os2.h"
+#include "elf.h"
+#include "util.h"
+#include "host_test.h"
+
+// Low enough for the 16 bit addresses of S1 records
+#define MEMORY_START    0x8000
+#define MEMORY_SIZE     0x1000
+#define FILE_MAX_SIZE   0x4000
+
+// What the stream passed to the flash decoder
+static struct {
+    uint8_t data[MEMORY_SIZE];
+    bool written[MEMORY_SIZE];
+    uint32_t writes;
+    bool open;
+} memory;
+
+static const uint8_t image[] = "DAPLink S-record and ELF stream test image, "
+                               "long enough to need several records.";
+
+static uint8_t file[FILE_MAX_SIZE];
+static uint32_t file_size;
+
+flash_decoder_type_t flash_decoder_detect_type(const uint8_t *data, uint32_t size, uint32_t addr, bool addr_valid)
+{
+    return FLASH_DECODER_TYPE_UNKNOWN;
+}
+
+error_t flash_decoder_get_flash(flash_decoder_type_t type, uint32_t addr, bool addr_valid, uint32_t *start_addr, const flash_intf_t **flash_intf)
+{
+    // Only used for binary files
+    CHECK(false);
+    return ERROR_FD_UNSUPPORTED_UPDATE;
+}
+
+error_t flash_decoder_open(void)
+{
+    CHECK(!memory.open);
+    memory.open = true;
+    return ERROR_SUCCESS;
+}
+
+error_t flash_decoder_write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    uint32_t i;
+
+    CHECK(memory.open);
+    if (!CHECK((addr >= MEMORY_START) && (addr - MEMORY_START + size <= MEMORY_SIZE))) {
+        return ERROR_WRITE;
+    }
+    for (i = 0; i < size; i++) {
+        // Each byte is written once
+        CHECK(!memory.written[addr - MEMORY_START + i]);
+        memory.written[addr - MEMORY_START + i] = true;
+    }
+    memcpy(&memory.data[addr - MEMORY_START], data, size);
+    memory.writes++;
+    return ERROR_SUCCESS;
+}
+
+error_t flash_decoder_close(void)
+{
+    CHECK(memory.open);
+    memory.open = false;
+    return ERROR_SUCCESS;
+}
+
+uint8_t validate_hexfile(const uint8_t *buf)
+{
+    return ':' == buf[0];
+}
+
+osThreadId_t osThreadGetId(void)
+{
+    return 0;
+}
+
+static void file_append(const void *data, uint32_t size)
+{
+    CHECK(file_size + size <= sizeof(file));
+    memcpy(&file[file_size], data, size);
+    file_size += size;
+}
+
+// Add an S-record with an address of addr_size bytes and a checksum
+// that is off by cksum_error
+static void srec_record(char type, uint8_t addr_size, uint32_t addr, const uint8_t *data, uint8_t size, uint8_t cksum_error)
+{
+    uint8_t bytes[1 + 4 + 255 + 1];
+    uint8_t count = 0;
+    uint8_t sum = 0;
+    char line[2 + 2 * sizeof(bytes) + 3];
+    uint32_t len;
+    uint32_t i;
+
+    bytes[count++] = addr_size + size + 1;
+    for (i = addr_size; i > 0; i--) {
+        bytes[count++] = (uint8_t)(addr >> ((i - 1) * 8));
+    }
+    memcpy(&bytes[count], data, size);
+    count += size;
+    for (i = 0; i < count; i++) {
+        sum += bytes[i];
+    }
+    bytes[count++] = (uint8_t)~sum + cksum_error;
+
+    len = sprintf(line, "S%c", type);
+    for (i = 0; i < count; i++) {
+        len += sprintf(line + len, "%02X", bytes[i]);
+    }
+    len += sprintf(line + len, "\r\n");
+    file_append(line, len);
+}
+
+// The image as data records with an address of addr_size bytes, with a
+// header, count records and the matching termination record
+static void build_srec(uint8_t addr_size, char data_type, char end_type)
+{
+    uint32_t pos;
+
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    for (pos = 0; pos < sizeof(image); pos += 16) {
+        srec_record(data_type, addr_size, MEMORY_START + pos, image + pos, MIN(16, sizeof(image) - pos), 0);
+    }
+    srec_record('5', 2, (sizeof(image) + 15) / 16, NULL, 0, 0);
+    srec_record('6', 3, (sizeof(image) + 15) / 16, NULL, 0, 0);
+    srec_record(end_type, addr_size, MEMORY_START, NULL, 0, 0);
+}
+
+typedef struct {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t addr;
+    uint32_t filesz;
+} segment_desc_t;
+
+// An ELF file with the program headers given and the image at each
+// segment's file offset
+static void build_elf(const segment_desc_t *segments, uint16_t count, uint32_t size)
+{
+    elf32_ehdr_t ehdr;
+    elf32_phdr_t phdr;
+    uint32_t i;
+
+    memset(file, 0xCC, sizeof(file));
+    memset(&ehdr, 0, sizeof(ehdr));
+    ehdr.e_ident[ELF_EI_MAG0 + 0] = ELF_MAG0;
+    ehdr.e_ident[ELF_EI_MAG0 + 1] = ELF_MAG1;
+    ehdr.e_ident[ELF_EI_MAG0 + 2] = ELF_MAG2;
+    ehdr.e_ident[ELF_EI_MAG0 + 3] = ELF_MAG3;
+    ehdr.e_ident[ELF_EI_CLASS] = ELF_CLASS32;
+    ehdr.e_ident[ELF_EI_DATA] = ELF_DATA2LSB;
+    ehdr.e_type = ELF_ET_EXEC;
+    ehdr.e_phoff = sizeof(ehdr);
+    ehdr.e_ehsize = sizeof(ehdr);
+    ehdr.e_phentsize = sizeof(phdr);
+    ehdr.e_phnum = count;
+    memcpy(file, &ehdr, sizeof(ehdr));
+
+    for (i = 0; i < count; i++) {
+        memset(&phdr, 0, sizeof(phdr));
+        phdr.p_type = segments[i].type;
+        phdr.p_offset = segments[i].offset;
+        phdr.p_vaddr = segments[i].addr;
+        phdr.p_paddr = segments[i].addr;
+        phdr.p_filesz = segments[i].filesz;
+        phdr.p_memsz = segments[i].filesz;
+        memcpy(&file[sizeof(ehdr) + i * sizeof(phdr)], &phdr, sizeof(phdr));
+    }
+    for (i = 0; i < count; i++) {
+        uint32_t image_pos = segments[i].addr - MEMORY_START;
+        if ((segments[i].offset >= sizeof(ehdr) + count * sizeof(phdr)) &&
+                (image_pos + segments[i].filesz <= sizeof(image))) {
+            memcpy(&file[segments[i].offset], image + image_pos, segments[i].filesz);
+        }
+    }
+    file_size = size;
+}
+
+// Pass the file to the stream in pieces of chunk bytes. Returns the
+// first error, or the status of the close.
+static error_t stream(stream_type_t type, uint32_t chunk)
+{
+    error_t status = ERROR_SUCCESS;
+    error_t close_status;
+    uint32_t pos;
+
+    memset(&memory, 0, sizeof(memory));
+    CHECK(type == stream_start_identify(file, file_size));
+    CHECK(ERROR_SUCCESS == stream_open(type));
+    for (pos = 0; (pos < file_size) && (ERROR_SUCCESS == status); pos += chunk) {
+        status = stream_write(file + pos, MIN(chunk, file_size - pos));
+    }
+    close_status = stream_close();
+    CHECK(!memory.open);
+    if (ERROR_SUCCESS_DONE == status) {
+        status = close_status;
+    } else if (ERROR_SUCCESS == status) {
+        // The file ended without the stream finding its end
+        status = (ERROR_SUCCESS == close_status) ? ERROR_IAP_UPDT_INCOMPLETE : close_status;
+    }
+    return status;
+}
+
+// Stream the file in pieces of several sizes, expecting the status and,
+// when it succeeds, the image to be written
+static void check_stream(stream_type_t type, error_t expected)
+{
+    static const uint32_t chunks[] = {1, 3, 64, FILE_MAX_SIZE};
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+        if (!CHECK(expected == stream(type, chunks[i]))) {
+            printf("  %u byte pieces\n", chunks[i]);
+        }
+        if (ERROR_SUCCESS == expected) {
+            CHECK(0 == memcmp(memory.data, image, sizeof(image)));
+            for (j = 0; j < MEMORY_SIZE; j++) {
+                if (memory.written[j] != (j < sizeof(image))) {
+                    break;
+                }
+            }
+            CHECK(MEMORY_SIZE == j);
+        }
+    }
+}
+
+// Each address size, with header and count records that carry no data
+static void test_srec_valid(void)
+{
+    build_srec(2, '1', '9');
+    check_stream(STREAM_TYPE_SREC, ERROR_SUCCESS);
+    build_srec(3, '2', '8');
+    check_stream(STREAM_TYPE_SREC, ERROR_SUCCESS);
+    build_srec(4, '3', '7');
+    check_stream(STREAM_TYPE_SREC, ERROR_SUCCESS);
+
+    // Anything after the termination record is ignored
+    build_srec(4, '3', '7');
+    file_append("garbage", 7);
+    check_stream(STREAM_TYPE_SREC, ERROR_SUCCESS);
+}
+
+static void test_srec_checksum(void)
+{
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    srec_record('3', 4, MEMORY_START, image, 16, 0);
+    srec_record('3', 4, MEMORY_START + 16, image + 16, 16, 1);
+    srec_record('7', 4, MEMORY_START, NULL, 0, 0);
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_CKSUM);
+
+    // Records that program nothing are checked too
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    srec_record('3', 4, MEMORY_START, image, 16, 0);
+    srec_record('5', 2, 1, NULL, 0, 1);
+    srec_record('7', 4, MEMORY_START, NULL, 0, 0);
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_CKSUM);
+
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    srec_record('6', 3, 0, NULL, 0, 0x80);
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_CKSUM);
+}
+
+static void test_srec_malformed(void)
+{
+    uint8_t data[4] = {0};
+
+    // S4 is reserved
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    srec_record('4', 4, MEMORY_START, data, sizeof(data), 0);
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_PARSER);
+
+    // A byte count too small for the address
+    file_size = 0;
+    srec_record('0', 2, 0, (const uint8_t *)"test", 4, 0);
+    file_append("S30200FD\r\n", 10);
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_PARSER);
+
+    // A character that is not a hex digit
+    build_srec(2, '1', '9');
+    file[20] = 'G';
+    check_stream(STREAM_TYPE_SREC, ERROR_SREC_PARSER);
+
+    // A file without a termination record never ends
+    build_srec(2, '1', '9');
+    file_size -= 12;
+    check_stream(STREAM_TYPE_SREC, ERROR_IAP_UPDT_INCOMPLETE);
+}
+
+// Two segments, with a program header for a .bss and one that is not
+// PT_LOAD, neither of which has data to program
+static void test_elf_valid(void)
+{
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0x200, MEMORY_START, 0x40},
+        {ELF_PT_LOAD, 0x300, MEMORY_START + 0x40, sizeof(image) - 0x40},
+        {ELF_PT_LOAD, 0x400, MEMORY_START + 0x800, 0},
+        {4, 0x400, MEMORY_START + 0x800, 0x10},
+    };
+
+    build_elf(segments, ARRAY_SIZE(segments), 0x500);
+    check_stream(STREAM_TYPE_ELF, ERROR_SUCCESS);
+
+    // The end of the file may be left out, as it holds no segment data
+    build_elf(segments, ARRAY_SIZE(segments), 0x300 + sizeof(image) - 0x40);
+    check_stream(STREAM_TYPE_ELF, ERROR_SUCCESS);
+}
+
+// The first segment holds the ELF and program headers, as some linkers
+// produce. They are not programmed.
+static void test_elf_headers_in_segment(void)
+{
+    const uint32_t headers_size = sizeof(elf32_ehdr_t) + sizeof(elf32_phdr_t);
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0, MEMORY_START - headers_size, sizeof(image) + headers_size},
+    };
+
+    build_elf(segments, ARRAY_SIZE(segments), 0x200);
+    memcpy(&file[headers_size], image, sizeof(image));
+    check_stream(STREAM_TYPE_ELF, ERROR_SUCCESS);
+}
+
+// The first segment starts at the ELF header but the program headers come
+// later, so the segment data between them has streamed past unread
+static void test_elf_late_headers(void)
+{
+    const uint32_t phoff = 0x80;
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0, MEMORY_START, 0x100},
+    };
+    elf32_ehdr_t ehdr;
+
+    build_elf(segments, ARRAY_SIZE(segments), 0x200);
+    memcpy(&ehdr, file, sizeof(ehdr));
+    memmove(&file[phoff], &file[ehdr.e_phoff], sizeof(elf32_phdr_t));
+    ehdr.e_phoff = phoff;
+    memcpy(file, &ehdr, sizeof(ehdr));
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_UNSUPPORTED);
+}
+
+// Program headers in a different order to the segment data in the file
+static void test_elf_out_of_order(void)
+{
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0x400, MEMORY_START + 0x20, sizeof(image) - 0x20},
+        {ELF_PT_LOAD, 0x200, MEMORY_START, 0x20},
+    };
+    const segment_desc_t overlapping[] = {
+        {ELF_PT_LOAD, 0x200, MEMORY_START, 0x40},
+        {ELF_PT_LOAD, 0x220, MEMORY_START + 0x40, sizeof(image) - 0x40},
+    };
+
+    build_elf(segments, ARRAY_SIZE(segments), 0x500);
+    check_stream(STREAM_TYPE_ELF, ERROR_SUCCESS);
+
+    build_elf(overlapping, ARRAY_SIZE(overlapping), 0x500);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_UNSUPPORTED);
+}
+
+// A file that ends before all of its segment data
+static void test_elf_truncated(void)
+{
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0x200, MEMORY_START, 0x40},
+        {ELF_PT_LOAD, 0x300, MEMORY_START + 0x40, sizeof(image) - 0x40},
+    };
+
+    build_elf(segments, ARRAY_SIZE(segments), 0x300 + 8);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_PARSER);
+    build_elf(segments, ARRAY_SIZE(segments), 0x100);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_PARSER);
+    build_elf(segments, ARRAY_SIZE(segments), sizeof(elf32_ehdr_t) + 8);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_PARSER);
+}
+
+static void test_elf_malformed(void)
+{
+    const segment_desc_t segments[] = {
+        {ELF_PT_LOAD, 0x200, MEMORY_START, sizeof(image)},
+    };
+    const segment_desc_t no_data[] = {
+        {ELF_PT_LOAD, 0x200, MEMORY_START, 0},
+    };
+
+    // No program headers
+    build_elf(segments, 0, 0x300);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_PARSER);
+
+    // Nothing to program
+    build_elf(no_data, ARRAY_SIZE(no_data), 0x300);
+    check_stream(STREAM_TYPE_ELF, ERROR_ELF_UNSUPPORTED);
+}
+
+int main(void)
+{
+    printf("file_stream\n");
+    test_srec_valid();
+    test_srec_checksum();
+    test_srec_malformed();
+    test_elf_valid();
+    test_elf_headers_in_segment();
+    test_elf_late_headers();
+    test_elf_out_of_order();
+    test_elf_truncated();
+    test_elf_malformed();
+    return host_test_result();
+}
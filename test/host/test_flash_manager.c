@@ -0,0 +1,213 @@
+/**
+ * @file    test_flash_manager.c
+ * @brief   Host tests for the flash manager
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "flash_manager.h"
+#include "flash_stats.h"
+#include "util.h"
+#include "host_test.h"
+
+#define FLASH_START     0x10000
+#define FLASH_SIZE      0x4000
+#define SECTOR_SIZE     0x1000
+#define PAGE_SIZE       0x400
+#define PAGE_COUNT      (FLASH_SIZE / PAGE_SIZE)
+
+// Flash that reads back what was last programmed, so a page that is
+// skipped keeps the erased value
+static struct {
+    uint8_t data[FLASH_SIZE];
+    uint8_t erased;
+    uint32_t programmed;        // Pages passed to program_page
+} flash;
+
+static error_t sim_init(void)
+{
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_uninit(void)
+{
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_program_page(uint32_t addr, const uint8_t *buf, uint32_t size)
+{
+    CHECK((addr >= FLASH_START) && (addr + size <= FLASH_START + FLASH_SIZE));
+    memcpy(&flash.data[addr - FLASH_START], buf, size);
+    flash.programmed++;
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_erase_sector(uint32_t addr)
+{
+    CHECK(0 == addr % SECTOR_SIZE);
+    memset(&flash.data[addr - FLASH_START], flash.erased, SECTOR_SIZE);
+    return ERROR_SUCCESS;
+}
+
+static error_t sim_erase_chip(void)
+{
+    memset(flash.data, flash.erased, sizeof(flash.data));
+    return ERROR_SUCCESS;
+}
+
+static uint32_t sim_program_page_min_size(uint32_t addr)
+{
+    return PAGE_SIZE;
+}
+
+static uint32_t sim_erase_sector_size(uint32_t addr)
+{
+    return SECTOR_SIZE;
+}
+
+static uint8_t sim_busy(void)
+{
+    return 0;
+}
+
+static bool sim_erased_value(uint32_t addr, uint8_t *value)
+{
+    *value = flash.erased;
+    return true;
+}
+
+static const flash_intf_t sim_intf = {
+    .init = sim_init,
+    .uninit = sim_uninit,
+    .program_page = sim_program_page,
+    .erase_sector = sim_erase_sector,
+    .erase_chip = sim_erase_chip,
+    .program_page_min_size = sim_program_page_min_size,
+    .erase_sector_size = sim_erase_sector_size,
+    .flash_busy = sim_busy,
+    .erased_value = sim_erased_value,
+};
+
+// The same flash without a way to tell what it erases to
+static const flash_intf_t sim_intf_unknown = {
+    .init = sim_init,
+    .uninit = sim_uninit,
+    .program_page = sim_program_page,
+    .erase_sector = sim_erase_sector,
+    .erase_chip = sim_erase_chip,
+    .program_page_min_size = sim_program_page_min_size,
+    .erase_sector_size = sim_erase_sector_size,
+    .flash_busy = sim_busy,
+};
+
+uint32_t flash_stats_start(void)
+{
+    return 0;
+}
+
+void flash_stats_end(flash_stats_phase_t phase, uint32_t start, error_t status)
+{
+}
+
+void flash_stats_add_programmed(uint32_t size)
+{
+}
+
+void config_ram_set_page_erase(bool page_erase_enable)
+{
+}
+
+void vfs_user_state_changed(void)
+{
+}
+
+// Pages of data, 0xFF and 0x00 in turn
+static uint8_t image[FLASH_SIZE];
+
+static void build_image(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < FLASH_SIZE; i++) {
+        switch ((i / PAGE_SIZE) % 3) {
+            case 0:
+                image[i] = (uint8_t)(i * 7 + 1);
+                break;
+            case 1:
+                image[i] = 0xFF;
+                break;
+            default:
+                image[i] = 0x00;
+                break;
+        }
+    }
+}
+
+// Program the image and return the number of pages programmed
+static uint32_t program(const flash_intf_t *intf, uint8_t erased, bool sector_erase)
+{
+    flash.erased = erased;
+    flash.programmed = 0;
+    memset(flash.data, 0x5A, sizeof(flash.data));
+
+    if (sector_erase) {
+        CHECK(ERROR_SUCCESS == flash_manager_init_sector_erase(intf));
+    } else {
+        CHECK(ERROR_SUCCESS == flash_manager_init(intf));
+    }
+    CHECK(ERROR_SUCCESS == flash_manager_data(FLASH_START, image, sizeof(image)));
+    CHECK(ERROR_SUCCESS == flash_manager_uninit());
+    CHECK(0 == memcmp(flash.data, image, sizeof(image)));
+    CHECK(flash.programmed * PAGE_SIZE + flash_manager_get_skipped_size() == FLASH_SIZE);
+    return flash.programmed;
+}
+
+// Flash that erases to 0xFF skips the pages of 0xFF
+static void test_erased_ff(void)
+{
+    CHECK(PAGE_COUNT - 5 == program(&sim_intf, 0xFF, false));
+    CHECK(PAGE_COUNT - 5 == program(&sim_intf, 0xFF, true));
+}
+
+// Flash that erases to 0x00 still programs the pages of 0xFF
+static void test_erased_zero(void)
+{
+    CHECK(PAGE_COUNT - 5 == program(&sim_intf, 0x00, false));
+    CHECK(0 == memcmp(&flash.data[PAGE_SIZE], &image[PAGE_SIZE], PAGE_SIZE));
+    CHECK(PAGE_COUNT - 5 == program(&sim_intf, 0x00, true));
+}
+
+// Every page is programmed when the erased value is not known
+static void test_erased_unknown(void)
+{
+    CHECK(PAGE_COUNT == program(&sim_intf_unknown, 0xFF, false));
+    CHECK(0 == flash_manager_get_skipped_size());
+    CHECK(PAGE_COUNT == program(&sim_intf_unknown, 0x00, true));
+}
+
+int main(void)
+{
+    printf("flash_manager\n");
+    build_image();
+    test_erased_ff();
+    test_erased_zero();
+    test_erased_unknown();
+    return host_test_result();
+}
@@ -0,0 +1,104 @@
+/**
+ * @file    test_flash_stats.c
+ * @brief   Host tests for the flash statistics
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "flash_stats.h"
+#include "cmsis_os2.h"
+#include "host_test.h"
+
+// A 120MHz system timer, which wraps every 35.8 seconds, and a 10ms
+// kernel tick
+#define TIMER_FREQ      120000000
+#define TICK_FREQ       100
+
+static uint64_t now_timer;
+// Timer ticks between reading the tick count and the system timer
+static uint32_t read_gap;
+
+uint32_t osKernelGetTickCount(void)
+{
+    return (uint32_t)(now_timer / (TIMER_FREQ / TICK_FREQ));
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return TICK_FREQ;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    return (uint32_t)(now_timer + read_gap);
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return TIMER_FREQ;
+}
+
+static void at_us(uint64_t us)
+{
+    now_timer = us * (TIMER_FREQ / 1000000);
+}
+
+static uint32_t phase_us(uint64_t start_us, uint64_t end_us)
+{
+    uint32_t start;
+
+    flash_stats_reset();
+    at_us(start_us);
+    start = flash_stats_start();
+    at_us(end_us);
+    flash_stats_end(FLASH_STATS_PHASE_ERASE, start, ERROR_SUCCESS);
+    return flash_stats_get()->time_us[FLASH_STATS_PHASE_ERASE];
+}
+
+// Short phases keep the resolution of the system timer
+static void test_short(void)
+{
+    CHECK(1 == phase_us(1000, 1001));
+    CHECK(12345 == phase_us(1000, 13345));
+    CHECK(12345 == phase_us(35790000, 35802345));
+}
+
+// Phases longer than the system timer wraps are timed in full
+static void test_long(void)
+{
+    CHECK(40000000 == phase_us(1000, 40001000));
+    CHECK(600000000 == phase_us(35000000, 635000000));
+}
+
+// A tick counted between the two reads is taken from the system timer
+static void test_tick_between_reads(void)
+{
+    read_gap = TIMER_FREQ / TICK_FREQ / 2;
+    CHECK(100000000 == phase_us(9995000, 109995000));
+    read_gap = 0;
+}
+
+int main(void)
+{
+    printf("flash_stats\n");
+    test_short();
+    test_long();
+    test_tick_between_reads();
+    return host_test_result();
+}
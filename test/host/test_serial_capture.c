@@ -0,0 +1,296 @@
+/**
+ * @file    test_serial_capture.c
+ * @brief   Host tests for the serial capture file
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "serial_capture.h"
+#include "virtual_fs.h"
+#include "cmsis_os2.h"
+#include "util.h"
+#include "host_test.h"
+
+// Built with SERIAL_CAPTURE_SIZE 256, so the file shows up to 192
+// characters and 4 times are kept
+#define FILE_DATA_SIZE  192
+#define FILE_MAX_SIZE   4096
+
+static uint64_t now_us;
+
+static vfs_read_cb_t file_read;
+static uint32_t file_len;
+static char file[FILE_MAX_SIZE + 1];
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    return (uint32_t)now_us;
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return 1000000;
+}
+
+vfs_file_t vfs_create_file(const vfs_filename_t filename, vfs_read_cb_t read_cb, vfs_write_cb_t write_cb, uint32_t len)
+{
+    CHECK(0 == memcmp(filename, "SERIAL  TXT", sizeof(vfs_filename_t)));
+    CHECK(0 == write_cb);
+    file_read = read_cb;
+    file_len = len;
+    return (vfs_file_t)file;
+}
+
+static void at(uint32_t ms)
+{
+    now_us = (uint64_t)ms * 1000;
+}
+
+static void capture(const char *str)
+{
+    serial_capture_write((const uint8_t *)str, strlen(str));
+}
+
+// Build the file and read it from start to end a sector at a time
+static void mount(void)
+{
+    uint32_t sector;
+
+    file_read = 0;
+    serial_capture_create_files();
+    CHECK(0 != file_read);
+    CHECK(file_len <= FILE_MAX_SIZE);
+    memset(file, 0, sizeof(file));
+    for (sector = 0; sector * VFS_SECTOR_SIZE < file_len; sector++) {
+        uint32_t size = MIN(VFS_SECTOR_SIZE, file_len - sector * VFS_SECTOR_SIZE);
+        CHECK(size == file_read(sector, (uint8_t *)file + sector * VFS_SECTOR_SIZE, 1));
+    }
+    CHECK(0 == file_read(sector, (uint8_t *)file + sector * VFS_SECTOR_SIZE, 1));
+}
+
+static bool file_ends_with(const char *str)
+{
+    uint32_t len = strlen(str);
+
+    return (file_len == strlen(file)) && (file_len >= len) &&
+           (0 == strcmp(file + file_len - len, str));
+}
+
+static void test_empty(void)
+{
+    mount();
+    CHECK(0 == file_len);
+}
+
+// Each line starts with the time it arrived. A partial line is shown
+// as it is.
+static void test_lines(void)
+{
+    at(1234);
+    capture("hello\n");
+    at(2500);
+    capture("wor");
+    at(2550);
+    capture("ld\n");
+    at(2600);
+    capture("abc");
+    mount();
+    CHECK(0 == strcmp(file, "[     1.234] hello\n[     2.500] world\n[     2.600] abc"));
+    CHECK(file_len == strlen(file));
+    capture("\n");
+}
+
+// Lines in the same millisecond share one time
+static void test_same_ms(void)
+{
+    at(3000);
+    capture("a\nb\n");
+    capture("c\n");
+    at(3001);
+    capture("d\n");
+    mount();
+    CHECK(file_ends_with("[     3.000] a\n[     3.000] b\n[     3.000] c\n[     3.001] d\n"));
+}
+
+// Lines older than the times kept show an unknown time
+static void test_lost_times(void)
+{
+    char line[3] = "0\n";
+    uint32_t i;
+
+    for (i = 1; i <= 6; i++) {
+        at(4000 + i);
+        line[0] = '0' + i;
+        capture(line);
+    }
+    mount();
+    CHECK(file_ends_with("[     ?.???] 1\n[     ?.???] 2\n[     4.003] 3\n"
+                         "[     4.004] 4\n[     4.005] 5\n[     4.006] 6\n"));
+}
+
+// Once the ring has wrapped the file starts at the first whole line in
+// the newest characters
+static void test_window(void)
+{
+    char expected[FILE_MAX_SIZE] = "";
+    char line[32];
+    uint32_t i;
+
+    at(5000);
+    for (i = 0; i < 40; i++) {
+        sprintf(line, "line%02u\n", i);
+        capture(line);
+    }
+    mount();
+    for (i = 13; i < 40; i++) {
+        sprintf(line, "[     5.000] line%02u\n", i);
+        strcat(expected, line);
+    }
+    CHECK(0 == strcmp(file, expected));
+    CHECK(file_len == strlen(expected));
+}
+
+// A line longer than the file is cut at the start and keeps its time
+static void test_long_line(void)
+{
+    char expected[FILE_MAX_SIZE] = "[     6.000] ";
+    char line[251];
+
+    at(6000);
+    memset(line, 'x', 250);
+    line[250] = 0;
+    capture(line);
+    mount();
+    memset(expected + strlen(expected), 'x', FILE_DATA_SIZE);
+    CHECK(0 == strcmp(file, expected));
+    capture("\n");
+}
+
+// Sectors read in any order and several at a time match a read in order
+static void test_sectors(void)
+{
+    char sequential[FILE_MAX_SIZE];
+    char sectors[FILE_MAX_SIZE];
+    uint32_t i;
+
+    at(7000);
+    for (i = 0; i < 128; i++) {
+        capture("a\n");
+    }
+    mount();
+    CHECK(FILE_DATA_SIZE / 2 * 15 == file_len);
+    CHECK(file_ends_with("[     7.000] a\n[     7.000] a\n"));
+    memcpy(sequential, file, file_len);
+
+    memset(sectors, 0, sizeof(sectors));
+    CHECK(VFS_SECTOR_SIZE == file_read(1, (uint8_t *)sectors + VFS_SECTOR_SIZE, 1));
+    CHECK(file_len - 2 * VFS_SECTOR_SIZE == file_read(2, (uint8_t *)sectors + 2 * VFS_SECTOR_SIZE, 1));
+    CHECK(VFS_SECTOR_SIZE == file_read(0, (uint8_t *)sectors, 1));
+    CHECK(0 == memcmp(sequential, sectors, file_len));
+
+    memset(sectors, 0, sizeof(sectors));
+    CHECK(file_len == file_read(0, (uint8_t *)sectors, 3));
+    CHECK(0 == memcmp(sequential, sectors, file_len));
+    CHECK(file_len - VFS_SECTOR_SIZE == file_read(1, (uint8_t *)sectors, 4));
+    CHECK(0 == memcmp(sequential + VFS_SECTOR_SIZE, sectors, file_len - VFS_SECTOR_SIZE));
+}
+
+// Characters overwritten after the file was built read as spaces and
+// the file keeps its size
+static void test_overwritten(void)
+{
+    char line[SERIAL_CAPTURE_SIZE + 1];
+    char sectors[FILE_MAX_SIZE];
+    uint32_t len;
+    uint32_t i;
+
+    serial_capture_create_files();
+    len = file_len;
+    at(8000);
+    memset(line, 'z', SERIAL_CAPTURE_SIZE);
+    line[SERIAL_CAPTURE_SIZE] = 0;
+    capture(line);
+    capture("\n");
+
+    memset(sectors, 0, sizeof(sectors));
+    CHECK(len == file_read(0, (uint8_t *)sectors, 3));
+    CHECK(0 == memcmp(sectors, "[     7.000] ", 13));
+    for (i = 13; i < len; i++) {
+        if (' ' != sectors[i]) {
+            break;
+        }
+    }
+    CHECK(len == i);
+}
+
+// The time carries on across the wrap of the system timer as long as
+// it is updated more often than every half wrap
+static void test_clock_wrap(void)
+{
+    uint32_t ms;
+
+    for (ms = 8000; ms < 4290000; ms += 1000000) {
+        at(ms);
+        serial_capture_periodic();
+    }
+    at(4290000);
+    capture("before\n");
+    at(4300000);
+    capture("after\n");
+    for (ms = 4300000; ms < 10000000; ms += 1000000) {
+        at(ms);
+        serial_capture_periodic();
+    }
+    at(10000123);
+    capture("later\n");
+    mount();
+    CHECK(file_ends_with("[  4290.000] before\n[  4300.000] after\n[ 10000.123] later\n"));
+}
+
+// A count that goes back, as a timer read just before a wrap that is
+// yet to be counted did, leaves the time where it was
+static void test_clock_behind(void)
+{
+    at(10001000);
+    capture("a\n");
+    now_us -= 5;
+    capture("b\n");
+    serial_capture_periodic();
+    at(10001001);
+    capture("c\n");
+    mount();
+    CHECK(file_ends_with("[ 10001.000] a\n[ 10001.000] b\n[ 10001.001] c\n"));
+}
+
+int main(void)
+{
+    printf("serial_capture\n");
+    test_empty();
+    test_lines();
+    test_same_ms();
+    test_lost_times();
+    test_window();
+    test_long_line();
+    test_sectors();
+    test_overwritten();
+    test_clock_wrap();
+    test_clock_behind();
+    return host_test_result();
+}
@@ -0,0 +1,347 @@
+/**
+ * @file    test_virtual_fs.c
+ * @brief   Host test checking the drive image built by virtual_fs.c
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "virtual_fs.h"
+#include "compiler.h"
+#include "util.h"
+#include "host_test.h"
+
+// Each file reads back as its index in every byte
+#define FILE_PATTERN(idx)   (0xA0 + (idx))
+
+typedef struct {
+    vfs_filename_t name;
+    uint32_t size;
+} test_file_t;
+
+static const test_file_t test_files[] = {
+    {"MBED    HTM", 512},
+    {"DETAILS TXT", 1500},
+    {"EMPTY   TXT", 0},
+    {"FAIL    TXT", VFS_CLUSTER_SIZE},
+    // Large enough to need several FAT sectors
+    {"FLASH   BIN", VFS_CLUSTERS_MIN / 2 * VFS_CLUSTER_SIZE + 100},
+    {"RAM     BIN", 300 * VFS_CLUSTER_SIZE},
+};
+
+static uint32_t read_file(uint32_t idx, uint32_t sector_offset, uint8_t *data, uint32_t num_sectors)
+{
+    memset(data, FILE_PATTERN(idx), num_sectors * VFS_SECTOR_SIZE);
+    return num_sectors * VFS_SECTOR_SIZE;
+}
+
+#define READ_FILE(idx) \
+    static uint32_t read_file_##idx(uint32_t sector_offset, uint8_t *data, uint32_t num_sectors) \
+    { \
+        return read_file(idx, sector_offset, data, num_sectors); \
+    }
+READ_FILE(0)
+READ_FILE(1)
+READ_FILE(2)
+READ_FILE(3)
+READ_FILE(4)
+READ_FILE(5)
+
+static const vfs_read_cb_t read_cbs[] = {
+    read_file_0, read_file_1, read_file_2, read_file_3, read_file_4, read_file_5,
+};
+COMPILER_ASSERT(ARRAY_SIZE(read_cbs) == ARRAY_SIZE(test_files));
+
+// The last write each file received. Every byte written to a file is
+// expected to be the same.
+static struct {
+    uint32_t sector_offset;
+    uint32_t num_sectors;
+    uint8_t value;
+    bool uniform;
+} file_writes[ARRAY_SIZE(test_files)];
+
+static void write_file(uint32_t idx, uint32_t sector_offset, const uint8_t *data, uint32_t num_sectors)
+{
+    uint32_t i;
+
+    file_writes[idx].sector_offset = sector_offset;
+    file_writes[idx].num_sectors = num_sectors;
+    file_writes[idx].value = data[0];
+    file_writes[idx].uniform = true;
+    for (i = 0; i < num_sectors * VFS_SECTOR_SIZE; i++) {
+        if (data[i] != data[0]) {
+            file_writes[idx].uniform = false;
+        }
+    }
+}
+
+#define WRITE_FILE(idx) \
+    static void write_file_##idx(uint32_t sector_offset, const uint8_t *data, uint32_t num_sectors) \
+    { \
+        write_file(idx, sector_offset, data, num_sectors); \
+    }
+WRITE_FILE(0)
+WRITE_FILE(1)
+WRITE_FILE(2)
+WRITE_FILE(3)
+WRITE_FILE(4)
+WRITE_FILE(5)
+
+static const vfs_write_cb_t write_cbs[] = {
+    write_file_0, write_file_1, write_file_2, write_file_3, write_file_4, write_file_5,
+};
+COMPILER_ASSERT(ARRAY_SIZE(write_cbs) == ARRAY_SIZE(test_files));
+
+static uint16_t get16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *data)
+{
+    return get16(data) | ((uint32_t)get16(data + 2) << 16);
+}
+
+// Check the image on the drive the way a host would see it
+static void check_image(uint32_t disk_size)
+{
+    uint8_t sector[VFS_SECTOR_SIZE];
+    uint8_t *meta;
+    uint8_t *fat1;
+    uint8_t *fat2;
+    uint8_t *dir;
+    bool *used;
+    uint32_t bytes_per_sector;
+    uint32_t sectors_per_cluster;
+    uint32_t reserved;
+    uint32_t num_fats;
+    uint32_t root_entries;
+    uint32_t total_sectors;
+    uint32_t fat_sectors;
+    uint32_t dir_sectors;
+    uint32_t data_sector;
+    uint32_t clusters;
+    uint32_t i;
+
+    printf("  disk size 0x%x\n", disk_size);
+
+    // Boot sector
+    vfs_read(0, sector, 1);
+    CHECK(0x55 == sector[510] && 0xAA == sector[511]);
+    bytes_per_sector = get16(&sector[11]);
+    sectors_per_cluster = sector[13];
+    reserved = get16(&sector[14]);
+    num_fats = sector[16];
+    root_entries = get16(&sector[17]);
+    total_sectors = get16(&sector[19]) ? get16(&sector[19]) : get32(&sector[32]);
+    fat_sectors = get16(&sector[22]);
+    CHECK(VFS_SECTOR_SIZE == bytes_per_sector);
+    CHECK(VFS_CLUSTER_SIZE == sectors_per_cluster * bytes_per_sector);
+    CHECK(reserved >= 1);
+    CHECK(2 == num_fats);
+    CHECK(0 == (root_entries * 32) % bytes_per_sector);
+    CHECK(total_sectors * bytes_per_sector >= disk_size);
+    CHECK(total_sectors == vfs_get_total_size() / bytes_per_sector);
+    dir_sectors = root_entries * 32 / bytes_per_sector;
+    data_sector = reserved + num_fats * fat_sectors + dir_sectors;
+    clusters = (total_sectors - data_sector) / sectors_per_cluster;
+    printf("    %u clusters of %u bytes, %u FAT sectors\n", clusters, VFS_CLUSTER_SIZE, fat_sectors);
+    // Hosts pick FAT12, FAT16 or FAT32 from the number of clusters alone
+    CHECK(clusters >= 4085 && clusters < 65525);
+    CHECK(fat_sectors * bytes_per_sector / 2 >= clusters + 2);
+
+    // All of the metadata
+    meta = malloc(data_sector * VFS_SECTOR_SIZE);
+    used = calloc(clusters + 2, sizeof(bool));
+    vfs_read(0, meta, data_sector);
+    fat1 = meta + reserved * VFS_SECTOR_SIZE;
+    fat2 = fat1 + fat_sectors * VFS_SECTOR_SIZE;
+    dir = fat2 + fat_sectors * VFS_SECTOR_SIZE;
+    CHECK(0 == memcmp(fat1, fat2, fat_sectors * VFS_SECTOR_SIZE));
+    CHECK(get16(fat1) == (0xFF00 | sector[21]));
+    CHECK(0xFFFF == get16(fat1 + 2));
+
+    // Same reads one sector at a time
+    for (i = 0; i < data_sector; i++) {
+        vfs_read(i, sector, 1);
+        CHECK(0 == memcmp(sector, meta + i * VFS_SECTOR_SIZE, VFS_SECTOR_SIZE));
+    }
+
+    // Volume label then the files in order
+    CHECK(dir[11] & VFS_FILE_ATTR_VOLUME_LABEL);
+    CHECK(0 == memcmp(dir, "DAPLINK    ", 11));
+
+    for (i = 0; i < ARRAY_SIZE(test_files); i++) {
+        const uint8_t *de = dir + (i + 1) * 32;
+        uint32_t size = get32(&de[28]);
+        uint32_t cluster = get16(&de[26]) | (get16(&de[20]) << 16);
+        uint32_t expected = (test_files[i].size + VFS_CLUSTER_SIZE - 1) / VFS_CLUSTER_SIZE;
+        uint32_t count = 0;
+
+        CHECK(0 == memcmp(de, test_files[i].name, 11));
+        CHECK(test_files[i].size == size);
+
+        if (0 == size) {
+            CHECK(0 == cluster);
+            continue;
+        }
+
+        // Follow the cluster chain
+        while (cluster < 0xFFF8) {
+            uint32_t first = data_sector + (cluster - 2) * sectors_per_cluster;
+
+            if (!CHECK(cluster >= 2 && cluster < clusters + 2) || !CHECK(!used[cluster])) {
+                break;
+            }
+
+            used[cluster] = true;
+            count++;
+            // Contents come from the file's read callback
+            vfs_read(first + sectors_per_cluster - 1, sector, 1);
+            CHECK(FILE_PATTERN(i) == sector[0] && FILE_PATTERN(i) == sector[VFS_SECTOR_SIZE - 1]);
+            cluster = get16(fat1 + cluster * 2);
+        }
+
+        CHECK(expected == count);
+    }
+
+    // Entries after the last file are free
+    CHECK(0 == dir[(ARRAY_SIZE(test_files) + 1) * 32]);
+
+    // No lost clusters and nothing past the end of the volume
+    for (i = 2; i < fat_sectors * VFS_SECTOR_SIZE / 2; i++) {
+        if ((i < clusters + 2) && used[i]) {
+            continue;
+        }
+
+        if (!CHECK(0 == get16(fat1 + i * 2))) {
+            printf("    FAT entry %u is 0x%x\n", i, get16(fat1 + i * 2));
+            break;
+        }
+    }
+
+    free(used);
+    free(meta);
+}
+
+static bool sector_filled(const uint8_t *sector, uint8_t value)
+{
+    uint32_t i;
+
+    for (i = 0; i < VFS_SECTOR_SIZE; i++) {
+        if (sector[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Transfers of several sectors that span the end of one region and the
+// start of the next reach each region with its own part of the buffer
+static void check_multi_sector(void)
+{
+    uint8_t sectors[VFS_SECTOR_SIZE * 2];
+    uint8_t sector[VFS_SECTOR_SIZE];
+    uint32_t sectors_per_cluster;
+    uint32_t file1_sector;
+    uint32_t data_sector;
+
+    vfs_read(0, sector, 1);
+    sectors_per_cluster = sector[13];
+    data_sector = get16(&sector[14]) + sector[16] * get16(&sector[22]) + get16(&sector[17]) * 32 / VFS_SECTOR_SIZE;
+    // The first file is one cluster and the second follows it
+    file1_sector = data_sector + sectors_per_cluster;
+
+    // Root directory then the first file
+    vfs_read(data_sector - 1, sector, 1);
+    vfs_read(data_sector - 1, sectors, 2);
+    CHECK(0 == memcmp(sectors, sector, VFS_SECTOR_SIZE));
+    CHECK(sector_filled(sectors + VFS_SECTOR_SIZE, FILE_PATTERN(0)));
+
+    // End of the first file then the start of the second
+    vfs_read(file1_sector - 1, sectors, 2);
+    CHECK(sector_filled(sectors, FILE_PATTERN(0)));
+    CHECK(sector_filled(sectors + VFS_SECTOR_SIZE, FILE_PATTERN(1)));
+
+    memset(file_writes, 0, sizeof(file_writes));
+    memset(sectors, 0x11, VFS_SECTOR_SIZE);
+    memset(sectors + VFS_SECTOR_SIZE, 0x22, VFS_SECTOR_SIZE);
+    vfs_write(file1_sector - 1, sectors, 2);
+    CHECK(sectors_per_cluster - 1 == file_writes[0].sector_offset);
+    CHECK(1 == file_writes[0].num_sectors);
+    CHECK(0x11 == file_writes[0].value && file_writes[0].uniform);
+    CHECK(0 == file_writes[1].sector_offset);
+    CHECK(1 == file_writes[1].num_sectors);
+    CHECK(0x22 == file_writes[1].value && file_writes[1].uniform);
+}
+
+// Directory entries the host writes are not read back, since the
+// clusters they use are not in the FAT
+static void check_host_dir_entry(void)
+{
+    uint8_t sector[VFS_SECTOR_SIZE];
+    uint8_t written[VFS_SECTOR_SIZE];
+    uint8_t *de = written + (ARRAY_SIZE(test_files) + 1) * 32;
+    uint32_t dir_sector;
+
+    vfs_read(0, sector, 1);
+    dir_sector = get16(&sector[14]) + sector[16] * get16(&sector[22]);
+    vfs_read(dir_sector, written, 1);
+    memcpy(de, "IMAGE   BIN", 11);
+    de[11] = 0x20;
+    de[26] = 0x40;
+    de[28] = 0x10;
+    vfs_write(dir_sector, written, 1);
+
+    vfs_read(dir_sector, sector, 1);
+    CHECK(0 == memcmp(sector, written, de - written));
+    CHECK(0 == sector[de - written]);
+}
+
+static void test_disk_size(uint32_t disk_size)
+{
+    uint32_t i;
+
+    vfs_init("DAPLINK    ", disk_size);
+
+    for (i = 0; i < ARRAY_SIZE(test_files); i++) {
+        CHECK(VFS_FILE_INVALID != vfs_create_file(test_files[i].name, read_cbs[i], write_cbs[i], test_files[i].size));
+    }
+
+    check_image(disk_size);
+    check_multi_sector();
+    check_host_dir_entry();
+}
+
+int main(void)
+{
+    printf("virtual_fs with 0x%x byte clusters\n", VFS_CLUSTER_SIZE);
+    // Smallest and largest FAT16 drives for this cluster size, and the default
+    test_disk_size(VFS_CLUSTERS_MIN * VFS_CLUSTER_SIZE);
+    test_disk_size(VFS_CLUSTERS_MAX * VFS_CLUSTER_SIZE - KB(64));
+
+    if ((MB(64) / VFS_CLUSTER_SIZE >= VFS_CLUSTERS_MIN) && (MB(64) / VFS_CLUSTER_SIZE <= VFS_CLUSTERS_MAX)) {
+        test_disk_size(MB(64));
+    }
+
+    return host_test_result();
+}
@@ -0,0 +1,165 @@
+/**
+ * @file    stm32f1xx.h
+ * @brief   Simulated STM32F1 registers and HAL calls for the UART driver
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STM32F1XX_H
+#define STM32F1XX_H
+
+#include <stdint.h>
+
+// Just enough of the CMSIS device header and the HAL for
+// hic_hal/stm32/stm32f103xb/uart.c to build on the host. The
+// registers are plain memory that test_uart_stm32f103xb.c drives.
+
+typedef struct {
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+    volatile uint32_t BRR;
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t CR3;
+    volatile uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t CCR;
+    volatile uint32_t CNDTR;
+    volatile uint32_t CPAR;
+    volatile uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    volatile uint32_t ISR;
+    volatile uint32_t IFCR;
+} DMA_TypeDef;
+
+extern USART_TypeDef sim_usart2;
+extern GPIO_TypeDef sim_gpioa;
+extern DMA_TypeDef sim_dma1;
+extern DMA_Channel_TypeDef sim_dma1_channel6;
+
+#define USART2                  (&sim_usart2)
+#define GPIOA                   (&sim_gpioa)
+#define DMA1                    (&sim_dma1)
+#define DMA1_Channel6           (&sim_dma1_channel6)
+
+#define USART_SR_IDLE           (1 << 4)
+#define USART_SR_RXNE           (1 << 5)
+#define USART_SR_TXE            (1 << 7)
+#define USART_CR1_IDLEIE        (1 << 4)
+#define USART_CR1_RXNEIE        (1 << 5)
+#define USART_CR1_TXEIE         (1 << 7)
+#define USART_CR1_UE            (1 << 13)
+#define USART_CR3_DMAR          (1 << 6)
+#define USART_CR3_CTSE          (1 << 9)
+
+#define DMA_CCR_EN              (1 << 0)
+#define DMA_CCR_TCIE            (1 << 1)
+#define DMA_CCR_HTIE            (1 << 2)
+#define DMA_CCR_CIRC            (1 << 5)
+#define DMA_CCR_MINC            (1 << 7)
+#define DMA_CCR_PL_1            (2 << 12)
+#define DMA_ISR_GIF6            (1 << 20)
+#define DMA_ISR_TCIF6           (1 << 21)
+#define DMA_ISR_HTIF6           (1 << 22)
+#define DMA_IFCR_CGIF6          (1 << 20)
+
+#define USART_CR1_REG_INDEX     1
+#define USART_IT_RXNE           ((uint32_t)(USART_CR1_REG_INDEX << 28 | USART_CR1_RXNEIE))
+#define USART_IT_TXE            ((uint32_t)(USART_CR1_REG_INDEX << 28 | USART_CR1_TXEIE))
+
+typedef enum {
+    DMA1_Channel6_IRQn = 16,
+    USART2_IRQn = 38,
+} IRQn_Type;
+
+static inline void NVIC_EnableIRQ(IRQn_Type irq) {}
+static inline void NVIC_DisableIRQ(IRQn_Type irq) {}
+
+#define __HAL_RCC_USART2_CLK_ENABLE()   do {} while (0)
+#define __HAL_RCC_USART2_CLK_DISABLE()  do {} while (0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()    do {} while (0)
+#define __HAL_RCC_GPIOA_CLK_DISABLE()   do {} while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()     do {} while (0)
+
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+} HAL_StatusTypeDef;
+
+#define GPIO_PIN_0              ((uint16_t)0x0001)
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_2              ((uint16_t)0x0004)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+
+#define GPIO_MODE_INPUT         0
+#define GPIO_MODE_OUTPUT_PP     1
+#define GPIO_MODE_AF_PP         2
+#define GPIO_PULLUP             1
+#define GPIO_SPEED_FREQ_HIGH    3
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET,
+} GPIO_PinState;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+
+#define HAL_UART_PARITY_NONE    0
+#define HAL_UART_PARITY_EVEN    1
+#define HAL_UART_PARITY_ODD     2
+#define UART_STOPBITS_1         0
+#define UART_STOPBITS_2         1
+#define UART_WORDLENGTH_8B      0
+#define UART_WORDLENGTH_9B      1
+#define UART_HWCONTROL_NONE     0
+#define UART_HWCONTROL_CTS      USART_CR3_CTSE
+#define UART_MODE_TX_RX         3
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+} UART_InitTypeDef;
+
+typedef struct {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+} UART_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart);
+
+#endif
@@ -0,0 +1,492 @@
+/**
+ * @file    test_uart_stm32f103xb.c
+ * @brief   Host tests for the stm32f103xb UART driver on a simulated USART
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f1xx.h"
+#include "uart.h"
+#include "serial_capture.h"
+#include "util.h"
+#include "host_test.h"
+
+// The simulation advances one character time per step. Each step the
+// target may send a character to the HIC, the HIC may send one to the
+// target, and the main task may run. When the driver receives by DMA,
+// the character goes to DMA1 channel 6 and a step without a character
+// after one with sets the USART's idle flag.
+
+// Characters the target sends after RTS is released, as a UART with a
+// FIFO or a slow interrupt handler does
+#define TARGET_RTS_DELAY    8
+// The main task reads this many characters every MAIN_PERIOD steps, half
+// the line rate, and is held up for MAIN_STALL steps every MAIN_STALL_PERIOD
+// steps, like a USB host that polls slowly or a busy drag-n-drop transfer
+#define MAIN_PERIOD         4
+#define MAIN_READ           2
+#define MAIN_STALL_PERIOD   4096
+#define MAIN_STALL          1024
+#define TRANSFER_SIZE       (64 * 1024)
+// Written to DR before the transmit interrupt to see if it sent a character
+#define DR_UNUSED           0xFFFFFFFF
+
+USART_TypeDef sim_usart2;
+GPIO_TypeDef sim_gpioa;
+DMA_TypeDef sim_dma1;
+DMA_Channel_TypeDef sim_dma1_channel6;
+
+extern void USART2_IRQHandler(void);
+// Only in the build that receives by DMA
+extern void DMA1_Channel6_IRQHandler(void) __attribute__((weak));
+extern uint8_t rx_dma_data[] __attribute__((weak));
+
+static struct {
+    uint32_t step;
+    bool rts;                           // Driven by the HIC, high stops the target
+    bool cts;                           // Driven by the target, high stops the HIC
+    bool rts_history[TARGET_RTS_DELAY];
+    uint32_t rts_changes;
+
+    uint32_t target_sent;               // Characters the target sent to the HIC
+    uint32_t target_limit;
+    uint32_t target_received;           // Characters the HIC sent to the target
+    uint32_t target_errors;
+    uint32_t sent_while_cts_high;
+
+    uint32_t captured;                  // Characters passed to serial_capture_write
+    uint32_t capture_errors;
+
+    uint32_t main_received;             // Characters read by uart_read_data
+    uint32_t main_errors;
+    bool main_stalls;
+
+    uint32_t data_events;
+    uint32_t rx_interrupts;             // USART receive or idle and DMA interrupts
+    bool line_active;                   // A character was received since the last idle
+
+    uint32_t dma_reload;                // Count reloaded at the end of the buffer
+    uint32_t dma_cndtr;                 // Count as last set by the simulation
+    uint32_t dma_errors;
+} sim;
+
+static uint8_t pattern(uint32_t i)
+{
+    return (uint8_t)(i % 251);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init)
+{
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+    if ((GPIOA == port) && (GPIO_PIN_1 == pin)) {
+        if (sim.rts != (GPIO_PIN_SET == state)) {
+            sim.rts_changes++;
+        }
+        sim.rts = GPIO_PIN_SET == state;
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    huart->Instance->CR3 = huart->Init.HwFlowCtl;
+    huart->Instance->CR1 |= USART_CR1_UE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart)
+{
+    huart->Instance->CR1 = 0;
+    huart->Instance->CR3 = 0;
+    return HAL_OK;
+}
+
+void uart_data_event(void)
+{
+    sim.data_events++;
+}
+
+void serial_capture_write(const uint8_t *data, uint32_t size)
+{
+    while (size--) {
+        if (*data++ != pattern(sim.captured)) {
+            sim.capture_errors++;
+        }
+        sim.captured++;
+    }
+}
+
+// DMA1 channel 6 serves a request from the USART
+static void sim_dma_request(void)
+{
+    DMA_Channel_TypeDef *channel = DMA1_Channel6;
+    uint32_t irq = 0;
+
+    if (!(channel->CCR & DMA_CCR_EN) || (0 == channel->CNDTR)) {
+        return;
+    }
+    // A count the simulation did not set means the driver restarted the channel
+    if (channel->CNDTR != sim.dma_cndtr) {
+        sim.dma_reload = channel->CNDTR;
+    }
+    if ((channel->CPAR != (uint32_t)&USART2->DR) || (channel->CMAR != (uint32_t)rx_dma_data) ||
+            !(channel->CCR & DMA_CCR_MINC)) {
+        sim.dma_errors++;
+        return;
+    }
+
+    rx_dma_data[sim.dma_reload - channel->CNDTR] = USART2->DR;
+    USART2->SR &= ~USART_SR_RXNE;
+    channel->CNDTR--;
+    if (channel->CNDTR == sim.dma_reload / 2) {
+        DMA1->ISR |= DMA_ISR_GIF6 | DMA_ISR_HTIF6;
+        irq = channel->CCR & DMA_CCR_HTIE;
+    }
+    if (0 == channel->CNDTR) {
+        DMA1->ISR |= DMA_ISR_GIF6 | DMA_ISR_TCIF6;
+        irq = channel->CCR & DMA_CCR_TCIE;
+        if (channel->CCR & DMA_CCR_CIRC) {
+            channel->CNDTR = sim.dma_reload;
+        }
+    }
+    sim.dma_cndtr = channel->CNDTR;
+
+    if (irq) {
+        sim.rx_interrupts++;
+        DMA1_Channel6_IRQHandler();
+        if (DMA1->IFCR & DMA_IFCR_CGIF6) {
+            DMA1->ISR &= ~(DMA_ISR_GIF6 | DMA_ISR_HTIF6 | DMA_ISR_TCIF6);
+        }
+        DMA1->IFCR = 0;
+    }
+}
+
+static void sim_step(void)
+{
+    bool target_rts = sim.rts_history[sim.step % TARGET_RTS_DELAY];
+
+    sim.rts_history[sim.step % TARGET_RTS_DELAY] = sim.rts;
+    sim.step++;
+
+    // Target to HIC. The driver reads DR in the interrupt handler,
+    // which clears RXNE on the real USART.
+    if ((sim.target_sent < sim.target_limit) && !target_rts) {
+        USART2->DR = pattern(sim.target_sent++);
+        USART2->SR |= USART_SR_RXNE;
+        sim.line_active = true;
+        if (USART2->CR3 & USART_CR3_DMAR) {
+            sim_dma_request();
+        } else if (USART2->CR1 & USART_CR1_RXNEIE) {
+            sim.rx_interrupts++;
+            USART2_IRQHandler();
+        }
+        USART2->SR &= ~USART_SR_RXNE;
+    } else if (sim.line_active) {
+        // Reading SR then DR clears IDLE
+        sim.line_active = false;
+        USART2->SR |= USART_SR_IDLE;
+        if (USART2->CR1 & USART_CR1_IDLEIE) {
+            sim.rx_interrupts++;
+            USART2_IRQHandler();
+        }
+        USART2->SR &= ~USART_SR_IDLE;
+    }
+
+    // HIC to target, held off by CTS when CTSE is set
+    if ((USART2->CR1 & USART_CR1_TXEIE) && !((USART2->CR3 & USART_CR3_CTSE) && sim.cts)) {
+        USART2->DR = DR_UNUSED;
+        USART2->SR |= USART_SR_TXE;
+        USART2_IRQHandler();
+        USART2->SR &= ~USART_SR_TXE;
+        if (DR_UNUSED != USART2->DR) {
+            if (sim.cts) {
+                sim.sent_while_cts_high++;
+            }
+            if ((uint8_t)USART2->DR != pattern(sim.target_received)) {
+                sim.target_errors++;
+            }
+            sim.target_received++;
+        }
+    }
+
+    // Main task
+    if (sim.main_stalls && ((sim.step % MAIN_STALL_PERIOD) < MAIN_STALL)) {
+        return;
+    }
+    if (0 == (sim.step % MAIN_PERIOD)) {
+        uint8_t data[MAIN_READ];
+        int32_t cnt = uart_read_data(data, sizeof(data));
+        int32_t i;
+
+        for (i = 0; i < cnt; i++) {
+            if (data[i] != pattern(sim.main_received)) {
+                sim.main_errors++;
+            }
+            sim.main_received++;
+        }
+    }
+}
+
+static void sim_start(UART_FlowControl flow_control)
+{
+    UART_Configuration config = {
+        .Baudrate = 3000000,
+        .DataBits = UART_DATA_BITS_8,
+        .Parity = UART_PARITY_NONE,
+        .StopBits = UART_STOP_BITS_1,
+        .FlowControl = flow_control,
+    };
+
+    memset(&sim, 0, sizeof(sim));
+    memset(&sim_usart2, 0, sizeof(sim_usart2));
+    memset(&sim_dma1, 0, sizeof(sim_dma1));
+    memset(&sim_dma1_channel6, 0, sizeof(sim_dma1_channel6));
+    sim.main_stalls = true;
+    uart_initialize();
+    uart_clear_statistics();
+    uart_set_control_line_state(3);
+    uart_set_configuration(&config);
+}
+
+// Run until the target has sent everything and the main task has read it
+static void sim_receive(uint32_t size)
+{
+    uint32_t steps = 0;
+
+    sim.target_limit = size;
+    while (((sim.main_received < sim.target_sent) || (sim.target_sent < sim.target_limit)) &&
+            (steps++ < size * 16)) {
+        sim_step();
+    }
+}
+
+// Without flow control the target outruns the main task and data is lost
+static void test_overrun(void)
+{
+    UART_Statistics stats;
+
+    sim_start(UART_FLOW_CONTROL_NONE);
+    sim_receive(TRANSFER_SIZE);
+    CHECK(TRANSFER_SIZE == sim.target_sent);
+    CHECK(sim.main_errors > 0);
+    CHECK(0 == sim.rts_changes);
+    // The capture sees every character whether or not it was buffered
+    CHECK(sim.target_sent == sim.captured);
+    CHECK(0 == sim.capture_errors);
+
+    uart_get_statistics(&stats);
+    CHECK(stats.RxDropped > 0);
+    CHECK(stats.RxDropped < sim.target_sent);
+    CHECK(stats.RxBufferSize == stats.RxHighWater);
+    printf("  no flow control: %u of %u characters out of order or lost, %u dropped\n",
+           sim.main_errors, TRANSFER_SIZE, stats.RxDropped);
+}
+
+// RTS stops the target before the read buffer overflows
+static void test_rts(void)
+{
+    UART_Configuration config;
+    UART_Statistics stats;
+
+    sim_start(UART_FLOW_CONTROL_RTS_CTS);
+    uart_get_configuration(&config);
+    CHECK(UART_FLOW_CONTROL_RTS_CTS == config.FlowControl);
+    CHECK(USART2->CR3 & USART_CR3_CTSE);
+
+    sim_receive(TRANSFER_SIZE);
+    CHECK(TRANSFER_SIZE == sim.target_sent);
+    CHECK(TRANSFER_SIZE == sim.main_received);
+    CHECK(0 == sim.main_errors);
+    CHECK(sim.rts_changes > 0);
+    CHECK(!sim.rts);
+    CHECK(0 == sim.dma_errors);
+
+    // The target stops before the buffer is full
+    uart_get_statistics(&stats);
+    CHECK(0 == stats.RxDropped);
+    CHECK(stats.RxHighWater >= stats.RxBufferSize * 3 / 4);
+    CHECK(stats.RxHighWater < stats.RxBufferSize);
+    printf("  RTS/CTS: %u characters in %u character times, %u RTS changes, %u errors\n",
+           sim.main_received, sim.step, sim.rts_changes, sim.main_errors);
+}
+
+// Characters reach the main task at the end of a burst, and with DMA
+// the driver is interrupted far less often than once per character
+static void test_rx_interrupts(void)
+{
+    uint8_t data[64];
+    bool dma = false;
+    uint32_t i;
+
+    sim_start(UART_FLOW_CONTROL_RTS_CTS);
+    dma = (USART2->CR3 & USART_CR3_DMAR) != 0;
+
+    // A short burst is handed over when the line goes idle
+    sim.main_stalls = false;
+    sim.target_limit = 5;
+    for (i = 0; i < 6; i++) {
+        sim_step();
+    }
+    CHECK(5 == sim.target_sent);
+    CHECK(1 == sim.data_events);
+    CHECK(5 == uart_read_used() + sim.main_received);
+    CHECK(5 == uart_read_data(data, sizeof(data)) + sim.main_received);
+    CHECK(0 == uart_read_used());
+    sim.main_received = 5;
+
+    // A stream that wraps the DMA buffer many times
+    sim.rx_interrupts = 0;
+    sim_receive(TRANSFER_SIZE / 4);
+    CHECK(TRANSFER_SIZE / 4 == sim.main_received);
+    CHECK(0 == sim.main_errors);
+    CHECK(0 == sim.dma_errors);
+    if (dma) {
+        CHECK(sim.rx_interrupts * 32 <= sim.main_received);
+    } else {
+        CHECK(sim.rx_interrupts + 5 >= sim.main_received);
+    }
+    printf("  %s: %u characters, %u receive interrupts\n", dma ? "DMA" : "interrupt per character",
+           sim.main_received - 5, sim.rx_interrupts);
+}
+
+// SET_CONTROL_LINE_STATE drives RTS with flow control on
+static void test_host_rts(void)
+{
+    uint32_t i;
+
+    // and is ignored without it
+    sim_start(UART_FLOW_CONTROL_NONE);
+    uart_set_control_line_state(0);
+    CHECK(!sim.rts);
+    CHECK(0 == sim.rts_changes);
+
+    sim_start(UART_FLOW_CONTROL_RTS_CTS);
+    sim.main_stalls = false;
+    CHECK(!sim.rts);
+    uart_set_control_line_state(1);
+    CHECK(sim.rts);
+
+    // The target stops once it sees RTS
+    sim.target_limit = 1024;
+    for (i = 0; i < 256; i++) {
+        sim_step();
+    }
+    CHECK(sim.target_sent <= TARGET_RTS_DELAY);
+
+    uart_set_control_line_state(3);
+    CHECK(!sim.rts);
+    sim_receive(1024);
+    CHECK(1024 == sim.main_received);
+    CHECK(0 == sim.main_errors);
+}
+
+// The HIC does not transmit while the target holds CTS high
+static void test_cts(void)
+{
+    uint8_t data[256];
+    uint32_t i;
+
+    sim_start(UART_FLOW_CONTROL_RTS_CTS);
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = pattern(i);
+    }
+
+    sim.cts = true;
+    CHECK(sizeof(data) == uart_write_data(data, sizeof(data)));
+    for (i = 0; i < 1024; i++) {
+        sim_step();
+    }
+    CHECK(0 == sim.target_received);
+
+    sim.cts = false;
+    for (i = 0; (i < 1024) && (sim.target_received < sizeof(data)); i++) {
+        sim_step();
+    }
+    CHECK(sizeof(data) == sim.target_received);
+    CHECK(0 == sim.target_errors);
+    CHECK(0 == sim.sent_while_cts_high);
+    CHECK(uart_write_free() > sizeof(data));
+}
+
+// Statistics are kept until cleared, not just until the next reset, so
+// characters lost before the host opens the port are still counted
+static void test_statistics(void)
+{
+    UART_Statistics stats;
+    uint8_t data[100];
+
+    sim_start(UART_FLOW_CONTROL_NONE);
+    sim_receive(TRANSFER_SIZE / 4);
+    memset(data, 0, sizeof(data));
+    CHECK(sizeof(data) == uart_write_data(data, sizeof(data)));
+    uart_reset();
+
+    uart_get_statistics(&stats);
+    CHECK(512 == stats.RxBufferSize);
+    CHECK(512 == stats.TxBufferSize);
+    CHECK(stats.RxDropped > 0);
+    CHECK(stats.RxBufferSize == stats.RxHighWater);
+    CHECK(sizeof(data) == stats.TxHighWater);
+
+    uart_clear_statistics();
+    uart_get_statistics(&stats);
+    CHECK(512 == stats.RxBufferSize);
+    CHECK(512 == stats.TxBufferSize);
+    CHECK(0 == stats.RxDropped);
+    CHECK(0 == stats.RxHighWater);
+    CHECK(0 == stats.TxHighWater);
+}
+
+// A board can turn flow control on for every configuration
+static void test_enable_flow_control(void)
+{
+    UART_Configuration config;
+
+    sim_start(UART_FLOW_CONTROL_NONE);
+    CHECK(!(USART2->CR3 & USART_CR3_CTSE));
+    uart_enable_flow_control(true);
+    CHECK(USART2->CR3 & USART_CR3_CTSE);
+
+    uart_get_configuration(&config);
+    config.FlowControl = UART_FLOW_CONTROL_NONE;
+    uart_set_configuration(&config);
+    uart_get_configuration(&config);
+    CHECK(UART_FLOW_CONTROL_RTS_CTS == config.FlowControl);
+    CHECK(USART2->CR3 & USART_CR3_CTSE);
+
+    uart_enable_flow_control(false);
+    CHECK(!(USART2->CR3 & USART_CR3_CTSE));
+    CHECK(!sim.rts);
+}
+
+int main(void)
+{
+    printf("stm32f103xb UART\n");
+    test_overrun();
+    test_rts();
+    test_rx_interrupts();
+    test_host_rts();
+    test_cts();
+    test_enable_flow_control();
+    test_statistics();
+    return host_test_result();
+}
@@ -0,0 +1,605 @@
+/**
+ * @file    usbd_sim.c
+ * @brief   Simulated USB device controller and host scheduler
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "rl_usb.h"
+#include "usb_for_lib.h"
+#include "util.h"
+#include "usbd_sim.h"
+
+// Bulk packets per frame the host controller schedules for the device.
+// Full speed frames are 1ms, high speed microframes are 125us. Every
+// transaction, including a NAKed token, takes one of these slots.
+#define FS_PACKETS_PER_FRAME    19
+#define FS_FRAME_NS             1000000
+#define HS_PACKETS_PER_FRAME    13
+#define HS_FRAME_NS             125000
+
+#define EP_BUF_SIZE             512
+#define SETUP_SIZE              8
+#define EP0_MAX_PACKET          64
+
+// Frames a control transfer waits for a NAKing device
+#define CONTROL_TIMEOUT_US      500000
+
+typedef struct {
+    uint8_t buf[EP_BUF_SIZE];
+    uint32_t size;
+    uint32_t max_packet;
+    bool full;
+    bool stalled;
+    bool enabled;
+} endpoint_t;
+
+static endpoint_t ep_in[USBD_SIM_EP_COUNT];
+static endpoint_t ep_out[USBD_SIM_EP_COUNT];
+static uint8_t setup_packet[SETUP_SIZE];
+static bool setup_pending;
+static bool connected;
+static uint8_t address;
+static usbd_sim_speed_t bus_speed;
+static uint64_t frame_ns;
+static uint64_t slot_ns;
+static uint64_t time_ns;
+static uint64_t frame_end_ns;
+static uint32_t frame_number;
+static void (*thread_hook)(void);
+static usbd_sim_stats_t stats;
+
+static uint64_t cpu_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run_thread(void)
+{
+    uint64_t start;
+
+    if (!thread_hook) {
+        return;
+    }
+
+    start = cpu_now();
+    thread_hook();
+    stats.thread_cpu_ns += cpu_now() - start;
+}
+
+// Deliver an endpoint event the way USBD_Handler does without RTX
+static void ep_event(uint8_t num, U32 event)
+{
+    uint64_t start = cpu_now();
+
+    if (USBD_P_EP[num]) {
+        USBD_P_EP[num](event);
+    }
+
+    stats.cpu_ns[num] += cpu_now() - start;
+}
+
+static void start_frame(void)
+{
+    uint64_t start;
+
+    frame_end_ns += frame_ns;
+    frame_number++;
+    stats.frames++;
+    start = cpu_now();
+
+    if (USBD_P_SOF_Event) {
+        USBD_P_SOF_Event();
+    }
+
+    stats.sof_cpu_ns += cpu_now() - start;
+    run_thread();
+}
+
+static void advance(uint64_t ns)
+{
+    time_ns += ns;
+
+    while (time_ns >= frame_end_ns) {
+        start_frame();
+    }
+}
+
+// Take a slot for one transaction. A transaction that does not fit in
+// the rest of the frame waits for the next one.
+static void bus_transaction(void)
+{
+    if (time_ns + slot_ns > frame_end_ns) {
+        advance(frame_end_ns - time_ns);
+    }
+
+    time_ns += slot_ns;
+}
+
+static void flush_endpoint(endpoint_t *ep)
+{
+    ep->full = false;
+    ep->size = 0;
+}
+
+void USBD_Init(void)
+{
+    memset(ep_in, 0, sizeof(ep_in));
+    memset(ep_out, 0, sizeof(ep_out));
+    setup_pending = false;
+    connected = false;
+    address = 0;
+}
+
+void USBD_Connect(BOOL con)
+{
+    connected = con;
+}
+
+void USBD_Reset(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < USBD_SIM_EP_COUNT; i++) {
+        flush_endpoint(&ep_in[i]);
+        flush_endpoint(&ep_out[i]);
+        ep_in[i].stalled = false;
+        ep_out[i].stalled = false;
+        ep_in[i].enabled = false;
+        ep_out[i].enabled = false;
+    }
+
+    ep_in[0].max_packet = EP0_MAX_PACKET;
+    ep_out[0].max_packet = EP0_MAX_PACKET;
+    ep_in[0].enabled = true;
+    ep_out[0].enabled = true;
+    setup_pending = false;
+    address = 0;
+}
+
+void USBD_Suspend(void)
+{
+}
+
+void USBD_Resume(void)
+{
+}
+
+void USBD_WakeUp(void)
+{
+}
+
+void USBD_WakeUpCfg(BOOL cfg)
+{
+}
+
+void USBD_SetAddress(U32 adr, U32 setup)
+{
+    // The address takes effect after the status stage
+    if (!setup) {
+        address = adr;
+    }
+}
+
+void USBD_Configure(BOOL cfg)
+{
+}
+
+void USBD_ConfigEP(USB_ENDPOINT_DESCRIPTOR *pEPD)
+{
+    uint32_t num = pEPD->bEndpointAddress & 0x0F;
+    endpoint_t *ep = (pEPD->bEndpointAddress & 0x80) ? &ep_in[num] : &ep_out[num];
+
+    util_assert(pEPD->wMaxPacketSize <= EP_BUF_SIZE);
+    ep->max_packet = pEPD->wMaxPacketSize;
+    flush_endpoint(ep);
+}
+
+void USBD_DirCtrlEP(U32 dir)
+{
+}
+
+void USBD_EnableEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        ep_in[EPNum & 0x0F].enabled = true;
+    } else {
+        ep_out[EPNum & 0x0F].enabled = true;
+    }
+}
+
+void USBD_DisableEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        ep_in[EPNum & 0x0F].enabled = false;
+    } else {
+        ep_out[EPNum & 0x0F].enabled = false;
+    }
+}
+
+void USBD_ResetEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        flush_endpoint(&ep_in[EPNum & 0x0F]);
+    } else {
+        flush_endpoint(&ep_out[EPNum & 0x0F]);
+    }
+}
+
+void USBD_SetStallEP(U32 EPNum)
+{
+    if (EPNum & 0x80) {
+        ep_in[EPNum & 0x0F].stalled = true;
+    } else {
+        ep_out[EPNum & 0x0F].stalled = true;
+    }
+}
+
+void USBD_ClrStallEP(U32 EPNum)
+{
+    // Like the LPC43xx controller, clearing an IN halt flushes the endpoint
+    if (EPNum & 0x80) {
+        ep_in[EPNum & 0x0F].stalled = false;
+        flush_endpoint(&ep_in[EPNum & 0x0F]);
+    } else {
+        ep_out[EPNum & 0x0F].stalled = false;
+    }
+}
+
+void USBD_ClearEPBuf(U32 EPNum)
+{
+    USBD_ResetEP(EPNum);
+}
+
+U32 USBD_ReadEP(U32 EPNum, U8 *pData, U32 cnt)
+{
+    endpoint_t *ep = &ep_out[EPNum & 0x0F];
+    uint32_t size;
+
+    if ((0 == (EPNum & 0x0F)) && setup_pending) {
+        size = MIN(cnt, SETUP_SIZE);
+        memcpy(pData, setup_packet, size);
+        setup_pending = false;
+        return size;
+    }
+
+    if (!ep->full) {
+        return 0;
+    }
+
+    size = MIN(cnt, ep->size);
+    memcpy(pData, ep->buf, size);
+    flush_endpoint(ep);
+    return size;
+}
+
+U32 USBD_WriteEP(U32 EPNum, U8 *pData, U32 cnt)
+{
+    endpoint_t *ep = &ep_in[EPNum & 0x0F];
+
+    util_assert(cnt <= ep->max_packet);
+    cnt = MIN(cnt, ep->max_packet);
+
+    // The host must have taken the previous packet. Writes to
+    // a stalled endpoint replace what was queued.
+    if (ep->full && !ep->stalled) {
+        stats.overwrites++;
+    }
+
+    if (cnt) {
+        memcpy(ep->buf, pData, cnt);
+    }
+
+    ep->size = cnt;
+    ep->full = true;
+    return cnt;
+}
+
+U32 USBD_GetFrame(void)
+{
+    return frame_number & 0x7FF;
+}
+
+U32 USBD_GetError(void)
+{
+    return 0;
+}
+
+void USBD_SignalHandler(void)
+{
+    // Events are delivered as the host runs each transaction
+}
+
+void USBD_Handler(void)
+{
+}
+
+void usbd_sim_bus_reset(void)
+{
+    // Same order as the reset and port change interrupts of USBD_Handler
+    USBD_Reset();
+    usbd_reset_core();
+
+    if (USBD_P_Reset_Event) {
+        USBD_P_Reset_Event();
+    }
+
+    USBD_HighSpeed = USBD_SIM_HIGH_SPEED == bus_speed;
+
+    if (USBD_P_Resume_Event) {
+        USBD_P_Resume_Event();
+    }
+
+    // Reset signalling lasts at least 10ms
+    advance(10 * 1000000);
+}
+
+void usbd_sim_attach(usbd_sim_speed_t speed)
+{
+    util_assert(connected);
+    bus_speed = speed;
+    frame_ns = USBD_SIM_HIGH_SPEED == speed ? HS_FRAME_NS : FS_FRAME_NS;
+    slot_ns = frame_ns / (USBD_SIM_HIGH_SPEED == speed ? HS_PACKETS_PER_FRAME : FS_PACKETS_PER_FRAME);
+    time_ns = 0;
+    frame_end_ns = frame_ns;
+    frame_number = 0;
+    usbd_sim_reset_stats();
+    usbd_sim_bus_reset();
+}
+
+usbd_sim_handshake_t usbd_sim_out(uint8_t num, const uint8_t *data, uint32_t size)
+{
+    endpoint_t *ep = &ep_out[num & 0x0F];
+
+    num &= 0x0F;
+    bus_transaction();
+
+    if (!ep->enabled || ep->stalled) {
+        return USBD_SIM_STALL;
+    }
+
+    if (ep->full) {
+        stats.naks[num]++;
+        run_thread();
+        return USBD_SIM_NAK;
+    }
+
+    util_assert(size <= ep->max_packet);
+
+    if (size) {
+        memcpy(ep->buf, data, size);
+    }
+
+    ep->size = size;
+    ep->full = true;
+    stats.packets[num]++;
+    stats.bytes[num] += size;
+    ep_event(num, USBD_EVT_OUT);
+    run_thread();
+    return USBD_SIM_ACK;
+}
+
+usbd_sim_handshake_t usbd_sim_in(uint8_t num, uint8_t *data, uint32_t *size)
+{
+    endpoint_t *ep = &ep_in[num & 0x0F];
+
+    num &= 0x0F;
+    bus_transaction();
+    *size = 0;
+
+    if (!ep->enabled || ep->stalled) {
+        return USBD_SIM_STALL;
+    }
+
+    if (!ep->full) {
+        stats.naks[num]++;
+        run_thread();
+        return USBD_SIM_NAK;
+    }
+
+    memcpy(data, ep->buf, ep->size);
+    *size = ep->size;
+    flush_endpoint(ep);
+    stats.packets[num]++;
+    stats.bytes[num] += *size;
+    ep_event(num, USBD_EVT_IN);
+    run_thread();
+    return USBD_SIM_ACK;
+}
+
+static void send_setup(const uint8_t *setup)
+{
+    bus_transaction();
+    // A setup packet is always accepted and clears a halt on endpoint 0
+    memcpy(setup_packet, setup, SETUP_SIZE);
+    setup_pending = true;
+    ep_in[0].stalled = false;
+    ep_out[0].stalled = false;
+    flush_endpoint(&ep_in[0]);
+    flush_endpoint(&ep_out[0]);
+    stats.packets[0]++;
+    ep_event(0, USBD_EVT_SETUP);
+    run_thread();
+}
+
+// Zero length handshake packet ending a control transfer
+static usbd_sim_handshake_t status_stage(bool in)
+{
+    uint64_t deadline = time_ns + (uint64_t)CONTROL_TIMEOUT_US * 1000;
+    usbd_sim_handshake_t handshake;
+    uint8_t packet[EP0_MAX_PACKET];
+    uint32_t size = 0;
+
+    do {
+        handshake = in ? usbd_sim_in(0, packet, &size) : usbd_sim_out(0, NULL, 0);
+    } while ((USBD_SIM_NAK == handshake) && (time_ns < deadline));
+
+    util_assert(0 == size);
+    return handshake;
+}
+
+int usbd_sim_control(uint8_t request_type, uint8_t request, uint16_t value,
+                     uint16_t index, uint8_t *data, uint16_t length)
+{
+    uint8_t setup[SETUP_SIZE] = {
+        request_type, request, value & 0xFF, value >> 8,
+        index & 0xFF, index >> 8, length & 0xFF, length >> 8
+    };
+    bool data_in = request_type & 0x80;
+    uint8_t packet[EP0_MAX_PACKET];
+    uint32_t done = 0;
+    int result;
+
+    send_setup(setup);
+
+    // Data stage
+    while (done < length) {
+        uint32_t packet_size = MIN(length - done, EP0_MAX_PACKET);
+
+        if (data_in) {
+            result = usbd_sim_bulk_in(0, packet, packet_size, CONTROL_TIMEOUT_US);
+        } else {
+            result = usbd_sim_bulk_out(0, data + done, packet_size, CONTROL_TIMEOUT_US);
+        }
+
+        if (result < 0) {
+            return -1;
+        }
+
+        if (data_in) {
+            memcpy(data + done, packet, result);
+        }
+
+        done += result;
+
+        if (result < packet_size) {
+            break;
+        }
+    }
+
+    // Status stage in the opposite direction
+    if (status_stage(!(data_in && length)) != USBD_SIM_ACK) {
+        return -1;
+    }
+
+    return done;
+}
+
+static int bulk_transfer(uint8_t num, uint8_t *in_data, const uint8_t *out_data,
+                         uint32_t size, uint32_t timeout_us)
+{
+    uint32_t max_packet = usbd_sim_max_packet(in_data ? (num | 0x80) : num);
+    uint64_t deadline = time_ns + (uint64_t)timeout_us * 1000;
+    uint32_t done = 0;
+
+    // A zero length request still moves one (zero length) packet
+    do {
+        uint32_t packet = MIN(size - done, max_packet);
+        uint32_t received = 0;
+        usbd_sim_handshake_t handshake;
+
+        if (in_data) {
+            uint8_t buf[EP_BUF_SIZE];
+            handshake = usbd_sim_in(num, buf, &received);
+
+            if (USBD_SIM_ACK == handshake) {
+                util_assert(received <= size - done);
+                received = MIN(received, size - done);
+                memcpy(in_data + done, buf, received);
+            }
+        } else {
+            handshake = usbd_sim_out(num, out_data + done, packet);
+            received = packet;
+        }
+
+        if (USBD_SIM_STALL == handshake) {
+            return -1;
+        }
+
+        if (USBD_SIM_NAK == handshake) {
+            if (time_ns >= deadline) {
+                break;
+            }
+
+            continue;
+        }
+
+        done += received;
+
+        if (received < max_packet) {
+            break;
+        }
+    } while (done < size);
+
+    return done;
+}
+
+int usbd_sim_bulk_out(uint8_t ep, const uint8_t *data, uint32_t size, uint32_t timeout_us)
+{
+    return bulk_transfer(ep & 0x0F, NULL, data, size, timeout_us);
+}
+
+int usbd_sim_bulk_in(uint8_t ep, uint8_t *data, uint32_t size, uint32_t timeout_us)
+{
+    return bulk_transfer(ep & 0x0F, data, NULL, size, timeout_us);
+}
+
+void usbd_sim_idle_us(uint32_t us)
+{
+    uint64_t end = time_ns + (uint64_t)us * 1000;
+
+    while (frame_end_ns <= end) {
+        advance(frame_end_ns - time_ns);
+    }
+
+    time_ns = end;
+}
+
+void usbd_sim_set_thread_hook(void (*hook)(void))
+{
+    thread_hook = hook;
+}
+
+uint32_t usbd_sim_max_packet(uint8_t ep)
+{
+    return (ep & 0x80) ? ep_in[ep & 0x0F].max_packet : ep_out[ep & 0x0F].max_packet;
+}
+
+uint8_t usbd_sim_address(void)
+{
+    return address;
+}
+
+uint64_t usbd_sim_time_us(void)
+{
+    return time_ns / 1000;
+}
+
+void usbd_sim_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+const usbd_sim_stats_t *usbd_sim_get_stats(void)
+{
+    return &stats;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    usbd_sim.h
+ * @brief   Simulated USB device controller and host scheduler
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef USBD_SIM_H
+#define USBD_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// usbd_sim.c implements usbd_hw.h in place of a HIC's USB driver. The
+// controller calls the usbd_core.c and class driver event handlers the
+// way a non-RTX USBD_Handler does, from a host that schedules its
+// transactions in full speed frames or high speed microframes and
+// generates a start of frame at the beginning of each one.
+
+#define USBD_SIM_EP_COUNT       16
+
+typedef enum {
+    USBD_SIM_FULL_SPEED,
+    USBD_SIM_HIGH_SPEED,
+} usbd_sim_speed_t;
+
+typedef enum {
+    USBD_SIM_ACK,
+    USBD_SIM_NAK,
+    USBD_SIM_STALL,
+} usbd_sim_handshake_t;
+
+// Counters collected while the simulation runs. Endpoint counters are
+// indexed by endpoint number and count both directions.
+typedef struct {
+    uint32_t frames;                        // Start of frame events
+    uint32_t packets[USBD_SIM_EP_COUNT];    // Packets acknowledged
+    uint32_t naks[USBD_SIM_EP_COUNT];       // Tokens answered with NAK
+    uint64_t bytes[USBD_SIM_EP_COUNT];      // Payload moved
+    uint64_t cpu_ns[USBD_SIM_EP_COUNT];     // Host time in endpoint events
+    uint64_t sof_cpu_ns;                    // Host time in SOF events
+    uint64_t thread_cpu_ns;                 // Host time in the thread hook
+    uint32_t overwrites;                    // IN packets replaced before the host took them
+} usbd_sim_stats_t;
+
+// Attach the device at the given speed and reset the bus. usbd_init and
+// usbd_connect must have been called.
+void usbd_sim_attach(usbd_sim_speed_t speed);
+
+// Reset the bus the way a host does before enumeration
+void usbd_sim_bus_reset(void);
+
+// Run a control transfer on endpoint 0. Returns the length of the data
+// stage or -1 if the device stalled the request.
+int usbd_sim_control(uint8_t request_type, uint8_t request, uint16_t value,
+                     uint16_t index, uint8_t *data, uint16_t length);
+
+// Single transactions. A zero size OUT sends a zero length packet and
+// size returns the length of the IN packet.
+usbd_sim_handshake_t usbd_sim_out(uint8_t ep, const uint8_t *data, uint32_t size);
+usbd_sim_handshake_t usbd_sim_in(uint8_t ep, uint8_t *data, uint32_t *size);
+
+// Bulk transfers split into max packet size transactions. NAKed tokens
+// are retried until timeout_us of simulated time passes. Returns the bytes
+// moved or -1 on a stall. An IN transfer ends early on a short packet.
+int usbd_sim_bulk_out(uint8_t ep, const uint8_t *data, uint32_t size, uint32_t timeout_us);
+int usbd_sim_bulk_in(uint8_t ep, uint8_t *data, uint32_t size, uint32_t timeout_us);
+
+// Let frames pass without traffic
+void usbd_sim_idle_us(uint32_t us);
+
+// Called between bus transactions and after each start of frame to run
+// the work the firmware does outside interrupt context
+void usbd_sim_set_thread_hook(void (*hook)(void));
+
+// Max packet size of an endpoint as configured by the device
+uint32_t usbd_sim_max_packet(uint8_t ep);
+
+// Address set by the host with SET_ADDRESS
+uint8_t usbd_sim_address(void);
+
+// Simulated time since usbd_sim_attach
+uint64_t usbd_sim_time_us(void);
+
+void usbd_sim_reset_stats(void);
+const usbd_sim_stats_t *usbd_sim_get_stats(void);
+
+// Size of the RAM disk behind the MSC interface and of
+// the buffer of the looped back UART
+#define USBD_SIM_DISK_SIZE          0x40000
+#define USBD_SIM_UART_BUFFER_SIZE   512
+
+// Counters kept by the firmware side of the simulation
+typedef struct {
+    uint32_t cdc_events;        // Times the main thread ran cdc_process_event
+    uint32_t line_codings;      // UART configuration changes
+} usbd_sim_target_stats_t;
+
+// Hooks in the firmware side of the simulation
+void usbd_sim_target_init(void);
+const usbd_sim_target_stats_t *usbd_sim_target_get_stats(void);
+uint8_t *usbd_sim_get_disk(void);
+uint32_t usbd_sim_uart_baudrate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
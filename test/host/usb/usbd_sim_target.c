@@ -0,0 +1,232 @@
+/**
+ * @file    usbd_sim_target.c
+ * @brief   RAM disk, UART loopback and firmware services for the USB simulation
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "rl_usb.h"
+#include "cmsis_os2.h"
+#include "main.h"
+#include "uart.h"
+#include "info.h"
+#include "target_family.h"
+#include "util.h"
+#include "usbd_sim.h"
+
+#define SECTOR_SIZE         512
+
+static uint8_t disk[USBD_SIM_DISK_SIZE];
+static uint8_t block_buf[SECTOR_SIZE];
+
+// The UART is looped back so everything the firmware
+// writes to it can be read back straight away
+static uint8_t loopback[USBD_SIM_UART_BUFFER_SIZE];
+static uint32_t loopback_head;
+static uint32_t loopback_tail;
+static UART_Configuration uart_config;
+static bool uart_open;
+
+static bool cdc_event;
+static usbd_sim_target_stats_t stats;
+
+extern void cdc_process_event(void);
+
+static const char unique_id_descriptor[] = {
+    2 + 8 * 2, 3,
+    '0', 0, '0', 0, '0', 0, '0', 0, 'S', 0, 'I', 0, 'M', 0, '0', 0,
+};
+
+void usbd_msc_init(void)
+{
+    USBD_MSC_LunCount = 1;
+    USBD_MSC_MemorySize[0] = sizeof(disk);
+    USBD_MSC_BlockSize = SECTOR_SIZE;
+    USBD_MSC_BlockGroup = 1;
+    USBD_MSC_BlockCount[0] = sizeof(disk) / SECTOR_SIZE;
+    USBD_MSC_BlockBuf = block_buf;
+    USBD_MSC_MediaReady[0] = 1;
+}
+
+void usbd_msc_read_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks)
+{
+    util_assert(0 == lun);
+    util_assert((block + num_of_blocks) * SECTOR_SIZE <= sizeof(disk));
+    memcpy(buf, &disk[block * SECTOR_SIZE], num_of_blocks * SECTOR_SIZE);
+}
+
+void usbd_msc_write_sect(U8 lun, U32 block, U8 *buf, U32 num_of_blocks)
+{
+    util_assert(0 == lun);
+    util_assert((block + num_of_blocks) * SECTOR_SIZE <= sizeof(disk));
+    memcpy(&disk[block * SECTOR_SIZE], buf, num_of_blocks * SECTOR_SIZE);
+}
+
+uint8_t *usbd_sim_get_disk(void)
+{
+    return disk;
+}
+
+int32_t uart_initialize(void)
+{
+    uart_open = true;
+    uart_reset();
+    return 1;
+}
+
+int32_t uart_uninitialize(void)
+{
+    uart_open = false;
+    return 1;
+}
+
+int32_t uart_reset(void)
+{
+    loopback_head = 0;
+    loopback_tail = 0;
+    return 1;
+}
+
+int32_t uart_set_configuration(UART_Configuration *config)
+{
+    uart_config = *config;
+    stats.line_codings++;
+    return 1;
+}
+
+int32_t uart_get_configuration(UART_Configuration *config)
+{
+    *config = uart_config;
+    return 1;
+}
+
+int32_t uart_write_free(void)
+{
+    return sizeof(loopback) - (loopback_head - loopback_tail);
+}
+
+int32_t uart_write_data(uint8_t *data, uint16_t size)
+{
+    uint32_t i;
+
+    util_assert(uart_open);
+    size = MIN(size, uart_write_free());
+
+    // Data looped back into an empty buffer raises
+    // the receive event of a real UART driver
+    if (size && (loopback_head == loopback_tail)) {
+        uart_data_event();
+    }
+
+    for (i = 0; i < size; i++) {
+        loopback[loopback_head++ % sizeof(loopback)] = data[i];
+    }
+
+    return size;
+}
+
+int32_t uart_read_data(uint8_t *data, uint16_t size)
+{
+    uint32_t i;
+
+    size = MIN(size, loopback_head - loopback_tail);
+
+    for (i = 0; i < size; i++) {
+        data[i] = loopback[loopback_tail++ % sizeof(loopback)];
+    }
+
+    return size;
+}
+
+uint32_t usbd_sim_uart_baudrate(void)
+{
+    return uart_config.Baudrate;
+}
+
+// The main thread of the interface firmware runs between USB transactions
+// and handles the events posted to it the way main.c does
+static void main_thread(void)
+{
+    if (cdc_event) {
+        cdc_event = false;
+        stats.cdc_events++;
+        cdc_process_event();
+    }
+}
+
+void usbd_sim_target_init(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(disk, 0, sizeof(disk));
+    cdc_event = false;
+    usbd_sim_set_thread_hook(main_thread);
+}
+
+const usbd_sim_target_stats_t *usbd_sim_target_get_stats(void)
+{
+    return &stats;
+}
+
+void main_cdc_send_event(void)
+{
+    cdc_event = true;
+}
+
+void main_blink_cdc_led(main_led_state_t state)
+{
+}
+
+void main_reset_target(uint8_t send_unique_id)
+{
+}
+
+uint8_t target_set_state(target_state_t state)
+{
+    return 1;
+}
+
+const char *info_get_unique_id_string_descriptor(void)
+{
+    return unique_id_descriptor;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return 100;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return 1000000;
+}
@@ -0,0 +1,403 @@
+/**
+ * @file    usbd_sim_test.c
+ * @brief   Host test driving the interface firmware USB stack through usbd_sim.c
+ *
+ * DAPLink Interface Firmware
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The test enumerates the device with the descriptors of the HIC's
+// usb_config.c, then moves data through the MSC and CDC interfaces at
+// full and high speed. Throughput and latency are in simulated bus time.
+// CPU cost is host time spent in the firmware.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rl_usb.h"
+#include "usb_def.h"
+#include "usb_msc.h"
+#include "usb_cdc.h"
+#include "util.h"
+#include "usbd_sim.h"
+#include "host_test.h"
+
+#define CONFIG_DESC_MAX     512
+#define CBW_SIZE            31
+#define CSW_SIZE            13
+#define SECTOR_SIZE         512
+#define TIMEOUT_US          1000000
+
+// Data moved by the throughput measurements
+#define MSC_TEST_SIZE       0x10000
+#define CDC_TEST_SIZE       0x4000
+#define LATENCY_SAMPLES     32
+
+// Same default as usbd_cdc_acm.c
+#ifndef USBD_CDC_ACM_SEND_IMMEDIATE
+#define USBD_CDC_ACM_SEND_IMMEDIATE 0
+#endif
+
+// Requests
+#define REQUEST_IN          0x80
+#define REQUEST_CLASS_IF    0x21
+
+// Interfaces and endpoints found in the configuration descriptor
+typedef struct {
+    int msc_if;
+    uint8_t msc_in;
+    uint8_t msc_out;
+    int cdc_if;
+    uint8_t cdc_int;
+    uint8_t cdc_in;
+    uint8_t cdc_out;
+    uint16_t bulk_max_packet;
+} device_t;
+
+static device_t dev;
+static uint32_t tag;
+static uint8_t msc_data[MSC_TEST_SIZE];
+static uint8_t cdc_data[CDC_TEST_SIZE];
+static uint8_t cdc_received[CDC_TEST_SIZE];
+
+static uint16_t get16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static void put32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static uint32_t get32(const uint8_t *data)
+{
+    return get16(data) | ((uint32_t)get16(data + 2) << 16);
+}
+
+static int get_descriptor(uint8_t type, uint8_t index, uint16_t lang, uint8_t *data, uint16_t length)
+{
+    return usbd_sim_control(REQUEST_IN, USB_REQUEST_GET_DESCRIPTOR, (type << 8) | index, lang, data, length);
+}
+
+static void parse_config(const uint8_t *desc, uint32_t size)
+{
+    uint32_t offset = 0;
+    int iface = -1;
+    uint8_t iface_class = 0;
+
+    memset(&dev, 0, sizeof(dev));
+    dev.msc_if = -1;
+    dev.cdc_if = -1;
+
+    while (offset + 2 <= size) {
+        const uint8_t *d = desc + offset;
+
+        if (!CHECK(d[0] >= 2 && offset + d[0] <= size)) {
+            return;
+        }
+
+        if (USB_INTERFACE_DESCRIPTOR_TYPE == d[1]) {
+            iface = d[2];
+            iface_class = d[5];
+
+            if (USB_DEVICE_CLASS_STORAGE == iface_class) {
+                CHECK(MSC_SUBCLASS_SCSI == d[6] && MSC_PROTOCOL_BULK_ONLY == d[7]);
+                dev.msc_if = iface;
+            } else if (CDC_COMMUNICATION_INTERFACE_CLASS == iface_class) {
+                dev.cdc_if = iface;
+            }
+        } else if (USB_ENDPOINT_DESCRIPTOR_TYPE == d[1]) {
+            uint8_t address = d[2];
+            uint16_t max_packet = get16(&d[4]);
+
+            if (USB_DEVICE_CLASS_STORAGE == iface_class) {
+                *((address & 0x80) ? &dev.msc_in : &dev.msc_out) = address & 0x0F;
+                dev.bulk_max_packet = max_packet;
+            } else if (CDC_COMMUNICATION_INTERFACE_CLASS == iface_class) {
+                dev.cdc_int = address & 0x0F;
+            } else if (CDC_DATA_INTERFACE_CLASS == iface_class) {
+                *((address & 0x80) ? &dev.cdc_in : &dev.cdc_out) = address & 0x0F;
+                CHECK(dev.bulk_max_packet == max_packet);
+            }
+        }
+
+        offset += d[0];
+    }
+}
+
+static void enumerate(usbd_sim_speed_t speed)
+{
+    uint8_t desc[CONFIG_DESC_MAX];
+    uint16_t total;
+    int size;
+
+    // Hosts read the start of the device descriptor for the
+    // endpoint 0 packet size before they set the address
+    memset(desc, 0, sizeof(desc));
+    CHECK(8 == get_descriptor(USB_DEVICE_DESCRIPTOR_TYPE, 0, 0, desc, 8));
+    CHECK(64 == desc[7]);
+    usbd_sim_bus_reset();
+    CHECK(0 == usbd_sim_control(0x00, USB_REQUEST_SET_ADDRESS, 5, 0, NULL, 0));
+    CHECK(5 == usbd_sim_address());
+
+    size = get_descriptor(USB_DEVICE_DESCRIPTOR_TYPE, 0, 0, desc, 18);
+    CHECK(18 == size && 18 == desc[0] && USB_DEVICE_DESCRIPTOR_TYPE == desc[1]);
+    CHECK(get16(&desc[2]) >= 0x0200);
+
+    // Serial number from info.c
+    if (CHECK(desc[16])) {
+        size = get_descriptor(USB_STRING_DESCRIPTOR_TYPE, desc[16], 0x0409, desc, 255);
+        CHECK(size == desc[0] && USB_STRING_DESCRIPTOR_TYPE == desc[1]);
+        CHECK((2 + 8 * 2 == size) && ('S' == desc[10]));
+    }
+
+    // Configuration header first, then all of it
+    CHECK(9 == get_descriptor(USB_CONFIGURATION_DESCRIPTOR_TYPE, 0, 0, desc, 9));
+    total = get16(&desc[2]);
+    CHECK(total <= sizeof(desc));
+    size = get_descriptor(USB_CONFIGURATION_DESCRIPTOR_TYPE, 0, 0, desc, total);
+    CHECK(size == total);
+    parse_config(desc, size);
+    printf("  configuration: %u bytes, %u interfaces, MSC EP%u, CDC EP%u/EP%u\n",
+           total, desc[4], dev.msc_in, dev.cdc_in, dev.cdc_int);
+    CHECK(dev.msc_if >= 0 && dev.msc_in && dev.msc_out);
+    CHECK(dev.cdc_if >= 0 && dev.cdc_in && dev.cdc_out && dev.cdc_int);
+    CHECK((USBD_SIM_HIGH_SPEED == speed ? 512 : 64) == dev.bulk_max_packet);
+
+    // Unsupported requests stall and the next setup packet clears it
+    CHECK(-1 == usbd_sim_control(0x00, USB_REQUEST_SET_DESCRIPTOR, 0, 0, NULL, 0));
+    CHECK(!usbd_configured());
+    CHECK(0 == usbd_sim_control(0x00, USB_REQUEST_SET_CONFIGURATION, 1, 0, NULL, 0));
+    CHECK(usbd_configured());
+    CHECK(1 == usbd_sim_control(REQUEST_IN, USB_REQUEST_GET_CONFIGURATION, 0, 0, desc, 1));
+    CHECK(1 == desc[0]);
+    CHECK(usbd_sim_max_packet(dev.msc_in | 0x80) == dev.bulk_max_packet);
+}
+
+// One SCSI command over the bulk only transport. Returns the CSW status.
+static int scsi(const uint8_t *cb, uint32_t cb_size, uint8_t *data, uint32_t size, bool data_in)
+{
+    uint8_t cbw[CBW_SIZE];
+    uint8_t csw[CSW_SIZE];
+    int done;
+
+    memset(cbw, 0, sizeof(cbw));
+    put32(&cbw[0], MSC_CBW_Signature);
+    put32(&cbw[4], ++tag);
+    put32(&cbw[8], size);
+    cbw[12] = data_in ? 0x80 : 0x00;
+    cbw[14] = cb_size;
+    memcpy(&cbw[15], cb, cb_size);
+
+    if (!CHECK(CBW_SIZE == usbd_sim_bulk_out(dev.msc_out, cbw, CBW_SIZE, TIMEOUT_US))) {
+        return -1;
+    }
+
+    if (size) {
+        done = data_in ? usbd_sim_bulk_in(dev.msc_in, data, size, TIMEOUT_US) :
+               usbd_sim_bulk_out(dev.msc_out, data, size, TIMEOUT_US);
+        CHECK(size == done);
+    }
+
+    done = usbd_sim_bulk_in(dev.msc_in, csw, CSW_SIZE, TIMEOUT_US);
+
+    if (!CHECK(CSW_SIZE == done) || !CHECK(MSC_CSW_Signature == get32(&csw[0])) ||
+            !CHECK(tag == get32(&csw[4]))) {
+        return -1;
+    }
+
+    return csw[12];
+}
+
+static int read_write10(uint8_t op, uint32_t sector, uint8_t *data, uint32_t count)
+{
+    uint8_t cb[10] = {op, 0, sector >> 24, sector >> 16, sector >> 8, sector, 0, count >> 8, count};
+    return scsi(cb, sizeof(cb), data, count * SECTOR_SIZE, SCSI_READ10 == op);
+}
+
+static void test_msc(void)
+{
+    const usbd_sim_stats_t *stats = usbd_sim_get_stats();
+    uint8_t inquiry[] = {SCSI_INQUIRY, 0, 0, 0, 36, 0};
+    uint8_t capacity[] = {SCSI_READ_CAPACITY, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t data[36];
+    uint64_t start_us;
+    uint64_t cpu_ns;
+    uint32_t i;
+
+    CHECK(1 == usbd_sim_control(REQUEST_IN | REQUEST_CLASS_IF, MSC_REQUEST_GET_MAX_LUN, 0, dev.msc_if, data, 1));
+    CHECK(0 == data[0]);
+    CHECK(CSW_CMD_PASSED == scsi(inquiry, sizeof(inquiry), data, sizeof(data), true));
+    CHECK(0 == memcmp(&data[8], "MBED    ", 8));
+    CHECK(CSW_CMD_PASSED == scsi(capacity, sizeof(capacity), data, 8, true));
+    CHECK(USBD_SIM_DISK_SIZE / SECTOR_SIZE - 1 == ((uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3]));
+
+    for (i = 0; i < sizeof(msc_data); i++) {
+        msc_data[i] = i * 7 + (i >> 8);
+    }
+
+    // Written with 64 sector commands like the hosts in msc/traces
+    usbd_sim_reset_stats();
+    start_us = usbd_sim_time_us();
+
+    for (i = 0; i < sizeof(msc_data) / SECTOR_SIZE; i += 64) {
+        CHECK(CSW_CMD_PASSED == read_write10(SCSI_WRITE10, i, &msc_data[i * SECTOR_SIZE], 64));
+    }
+
+    cpu_ns = stats->cpu_ns[dev.msc_out] + stats->cpu_ns[dev.msc_in];
+    printf("  MSC write: %u KB/s, %u frames, %u ns CPU per KB\n",
+           (uint32_t)(sizeof(msc_data) * 1000000 / 1024 / (usbd_sim_time_us() - start_us)),
+           stats->frames, (uint32_t)(cpu_ns * 1024 / sizeof(msc_data)));
+    CHECK(0 == memcmp(usbd_sim_get_disk(), msc_data, sizeof(msc_data)));
+
+    usbd_sim_reset_stats();
+    start_us = usbd_sim_time_us();
+    memset(msc_data, 0, sizeof(msc_data));
+
+    for (i = 0; i < sizeof(msc_data) / SECTOR_SIZE; i += 64) {
+        CHECK(CSW_CMD_PASSED == read_write10(SCSI_READ10, i, &msc_data[i * SECTOR_SIZE], 64));
+    }
+
+    cpu_ns = stats->cpu_ns[dev.msc_out] + stats->cpu_ns[dev.msc_in];
+    printf("  MSC read: %u KB/s, %u frames, %u ns CPU per KB\n",
+           (uint32_t)(sizeof(msc_data) * 1000000 / 1024 / (usbd_sim_time_us() - start_us)),
+           stats->frames, (uint32_t)(cpu_ns * 1024 / sizeof(msc_data)));
+    CHECK(0 == memcmp(usbd_sim_get_disk(), msc_data, sizeof(msc_data)));
+    CHECK(0 == stats->overwrites);
+}
+
+static void test_cdc(usbd_sim_speed_t speed)
+{
+    const usbd_sim_stats_t *stats = usbd_sim_get_stats();
+    const uint32_t frame_us = USBD_SIM_HIGH_SPEED == speed ? 125 : 1000;
+    uint8_t line_coding[7];
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint64_t start_us;
+    uint64_t latency_us = 0;
+    uint64_t latency_max_us = 0;
+    uint32_t cdc_events;
+    uint32_t i;
+
+    // 115200 8N1
+    put32(line_coding, 115200);
+    line_coding[4] = 0;
+    line_coding[5] = 0;
+    line_coding[6] = 8;
+    CHECK(7 == usbd_sim_control(REQUEST_CLASS_IF, CDC_SET_LINE_CODING, 0, dev.cdc_if, line_coding, 7));
+    CHECK(115200 == usbd_sim_uart_baudrate());
+    memset(line_coding, 0, sizeof(line_coding));
+    CHECK(7 == usbd_sim_control(REQUEST_IN | REQUEST_CLASS_IF, CDC_GET_LINE_CODING, 0, dev.cdc_if, line_coding, 7));
+    CHECK(115200 == get32(line_coding) && 8 == line_coding[6]);
+    CHECK(0 == usbd_sim_control(REQUEST_CLASS_IF, CDC_SET_CONTROL_LINE_STATE, 3, dev.cdc_if, NULL, 0));
+
+    for (i = 0; i < sizeof(cdc_data); i++) {
+        cdc_data[i] = i ^ (i >> 7);
+    }
+
+    // Keep the OUT endpoint busy while reading the looped back data
+    usbd_sim_reset_stats();
+    cdc_events = usbd_sim_target_get_stats()->cdc_events;
+    start_us = usbd_sim_time_us();
+
+    while ((received < sizeof(cdc_data)) && (usbd_sim_time_us() - start_us < TIMEOUT_US)) {
+        uint8_t packet[512];
+        uint32_t size;
+
+        if (sent < sizeof(cdc_data)) {
+            size = MIN(sizeof(cdc_data) - sent, dev.bulk_max_packet);
+
+            if (USBD_SIM_ACK == usbd_sim_out(dev.cdc_out, &cdc_data[sent], size)) {
+                sent += size;
+            }
+        }
+
+        if (USBD_SIM_ACK == usbd_sim_in(dev.cdc_in, packet, &size)) {
+            CHECK(received + size <= sizeof(cdc_received));
+            size = MIN(size, sizeof(cdc_received) - received);
+            memcpy(&cdc_received[received], packet, size);
+            received += size;
+        }
+    }
+
+    // The transfer ends with a zero length packet
+    CHECK(0 == usbd_sim_bulk_in(dev.cdc_in, cdc_received, 0, TIMEOUT_US));
+    CHECK(sizeof(cdc_data) == received);
+    CHECK(0 == memcmp(cdc_data, cdc_received, sizeof(cdc_data)));
+    printf("  CDC loopback: %u KB/s, %u NAKs, %u main thread wakeups, %u ns CPU per KB\n",
+           (uint32_t)(received * 1000000ULL / 1024 / (usbd_sim_time_us() - start_us)),
+           stats->naks[dev.cdc_in] + stats->naks[dev.cdc_out],
+           usbd_sim_target_get_stats()->cdc_events - cdc_events,
+           (uint32_t)((stats->cpu_ns[dev.cdc_in] + stats->sof_cpu_ns + stats->thread_cpu_ns) * 1024 / received));
+
+    // Single characters typed into a terminal. Without immediate sends
+    // data only moves to the IN endpoint on a start of frame.
+    for (i = 0; i < LATENCY_SAMPLES; i++) {
+        uint8_t c = 'a' + i;
+        uint8_t echo = 0;
+        uint64_t latency;
+
+        usbd_sim_idle_us(frame_us * (i % 4) + 7 * i % frame_us);
+        start_us = usbd_sim_time_us();
+        CHECK(1 == usbd_sim_bulk_out(dev.cdc_out, &c, 1, TIMEOUT_US));
+        CHECK(1 == usbd_sim_bulk_in(dev.cdc_in, &echo, 1, TIMEOUT_US));
+        CHECK(c == echo);
+        latency = usbd_sim_time_us() - start_us;
+        latency_us += latency;
+        latency_max_us = MAX(latency_max_us, latency);
+    }
+
+    printf("  CDC echo latency: %u us average, %u us max\n",
+           (uint32_t)(latency_us / LATENCY_SAMPLES), (uint32_t)latency_max_us);
+    CHECK(latency_max_us <= (USBD_CDC_ACM_SEND_IMMEDIATE ? frame_us : 3 * frame_us));
+    CHECK(0 == stats->overwrites);
+
+    // With nothing to move the main thread is not woken
+    usbd_sim_idle_us(2 * frame_us);
+    cdc_events = usbd_sim_target_get_stats()->cdc_events;
+    usbd_sim_idle_us(10000);
+    CHECK(cdc_events == usbd_sim_target_get_stats()->cdc_events);
+}
+
+static void test_speed(usbd_sim_speed_t speed)
+{
+    printf("%s speed%s\n", USBD_SIM_HIGH_SPEED == speed ? "High" : "Full",
+           USBD_CDC_ACM_SEND_IMMEDIATE ? ", CDC immediate send" : "");
+    usbd_sim_target_init();
+    usbd_init();
+    usbd_connect(__TRUE);
+    usbd_sim_attach(speed);
+    enumerate(speed);
+    test_msc();
+    test_cdc(speed);
+
+    // A bus reset deconfigures the device
+    usbd_sim_bus_reset();
+    CHECK(!usbd_configured());
+    CHECK(0 == usbd_sim_address());
+    usbd_connect(__FALSE);
+}
+
+int main(void)
+{
+    test_speed(USBD_SIM_FULL_SPEED);
+    test_speed(USBD_SIM_HIGH_SPEED);
+    return host_test_result();
+}
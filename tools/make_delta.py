@@ -0,0 +1,184 @@
+#
+# DAPLink Interface Firmware
+# Copyright (c) 2021, ARM Limited, All Rights Reserved
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may
+# not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Create a delta file that turns one binary image into another
+
+The delta file (.dlt) can be copied onto the DAPLink drive instead of the
+full image. DAPLink checks that the image on the target matches the base
+image, then programs only the sectors that change. See
+source/daplink/drag-n-drop/delta.h for a description of the format.
+"""
+
+from __future__ import absolute_import
+from __future__ import print_function
+
+import argparse
+import struct
+import zlib
+
+DELTA_MAGIC = b"DAPDELTA"
+DELTA_VERSION = 1
+DELTA_OP_COPY = 0x1
+DELTA_OP_DATA = 0x2
+DELTA_OP_TYPE_SHIFT = 28
+DELTA_OP_LENGTH_MAX = 0x0FFFFFFF
+
+# Size of the blocks used to find moved data in the base image
+MATCH_SIZE = 32
+# A copy costs 8 bytes so shorter unchanged runs are sent as data
+MIN_COPY_SIZE = 8
+
+
+def dec_or_hex(val):
+    return int(val, 0)
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+class DeltaWriter(object):
+    """Collect operations, merging adjacent ones where possible"""
+
+    def __init__(self):
+        self.ops = []
+
+    def copy(self, src, size):
+        if self.ops and self.ops[-1][0] == DELTA_OP_COPY:
+            last_src, last_size = self.ops[-1][1], self.ops[-1][2]
+            if last_src + last_size == src:
+                self.ops[-1] = (DELTA_OP_COPY, last_src, last_size + size)
+                return
+        self.ops.append((DELTA_OP_COPY, src, size))
+
+    def data(self, data):
+        if self.ops and self.ops[-1][0] == DELTA_OP_DATA:
+            self.ops[-1] = (DELTA_OP_DATA, self.ops[-1][1] + data, None)
+            return
+        self.ops.append((DELTA_OP_DATA, data, None))
+
+    def encode(self):
+        out = bytearray()
+        for op_type, arg, size in self.ops:
+            if op_type == DELTA_OP_COPY:
+                for pos in range(0, size, DELTA_OP_LENGTH_MAX):
+                    length = min(size - pos, DELTA_OP_LENGTH_MAX)
+                    out += struct.pack("<II", (op_type << DELTA_OP_TYPE_SHIFT) | length, arg + pos)
+            else:
+                for pos in range(0, len(arg), DELTA_OP_LENGTH_MAX):
+                    chunk = arg[pos:pos + DELTA_OP_LENGTH_MAX]
+                    out += struct.pack("<I", (op_type << DELTA_OP_TYPE_SHIFT) | len(chunk))
+                    out += chunk
+        return bytes(out)
+
+
+def build_index(base):
+    """Map each word aligned block of the base image to its offsets"""
+    index = {}
+    for offset in range(0, len(base) - MATCH_SIZE + 1, 4):
+        index.setdefault(base[offset:offset + MATCH_SIZE], []).append(offset)
+    return index
+
+
+def unchanged_length(base, new, pos):
+    length = 0
+    end = min(len(base), len(new))
+    while pos + length < end and base[pos + length] == new[pos + length]:
+        length += 1
+    return length
+
+
+def find_move(base, new, pos, index, sector_start, sector_end):
+    """Find the longest run of new at pos that can be copied from elsewhere in base
+
+    The source must not lie in a sector before the one being written, so a
+    copy from lower addresses has to stop at the end of the current sector.
+    """
+    best_src, best_len = None, 0
+    for src in index.get(new[pos:pos + MATCH_SIZE], []):
+        if src < sector_start or src == pos:
+            continue
+        max_len = min(len(new) - pos, len(base) - src)
+        if src < pos:
+            max_len = min(max_len, sector_end - pos)
+        if max_len < MATCH_SIZE:
+            continue
+        length = MATCH_SIZE
+        while length < max_len and new[pos + length] == base[src + length]:
+            length += 1
+        if length > best_len:
+            best_src, best_len = src, length
+    return best_src, best_len
+
+
+def create_delta(base, new, base_addr, sector_size):
+    index = build_index(base)
+    writer = DeltaWriter()
+    pos = 0
+    while pos < len(new):
+        same = unchanged_length(base, new, pos)
+        if same >= MIN_COPY_SIZE or pos + same == len(new):
+            if same:
+                writer.copy(pos, same)
+                pos += same
+                continue
+        # Sectors before the one being written may already be rewritten
+        # when the data is needed so they cannot be copied from
+        sector_start = (base_addr + pos) // sector_size * sector_size - base_addr
+        src, length = find_move(base, new, pos, index, sector_start, sector_start + sector_size)
+        if src is not None:
+            writer.copy(src, length)
+            pos += length
+        else:
+            writer.data(new[pos:pos + 1])
+            pos += 1
+
+    header = struct.pack("<8sIIIIII", DELTA_MAGIC, DELTA_VERSION, base_addr,
+                         len(base), crc32(base), len(new), crc32(new))
+    return header + writer.encode()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Delta file generator')
+    parser.add_argument("base", type=str,
+                        help="Binary image currently on the target")
+    parser.add_argument("new", type=str,
+                        help="Binary image to program")
+    parser.add_argument("--base-addr", type=dec_or_hex, default=0,
+                        help="Address both images are programmed to")
+    parser.add_argument("--sector-size", type=dec_or_hex, default=0x400,
+                        help="Erase sector size of the target. Must not be larger than the "
+                        "actual sector size, smaller values are always safe.")
+    parser.add_argument("--output", type=str, required=True,
+                        help="Output delta file, should end in .dlt")
+    args = parser.parse_args()
+
+    with open(args.base, 'rb') as file_handle:
+        base = file_handle.read()
+    with open(args.new, 'rb') as file_handle:
+        new = file_handle.read()
+
+    assert len(new) > 0, "New image is empty"
+    delta = create_delta(base, new, args.base_addr, args.sector_size)
+    with open(args.output, 'wb') as file_handle:
+        file_handle.write(delta)
+    print("Delta of %i bytes for an image of %i bytes" % (len(delta), len(new)))
+
+
+if __name__ == "__main__":
+    main()